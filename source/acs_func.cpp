@@ -36,6 +36,7 @@
 
 #include "acs_intr.h"
 #include "c_runcmd.h"
+#include "cam_sight.h"
 #include "d_event.h"
 #include "d_gi.h"
 #include "e_args.h"
@@ -1827,6 +1828,8 @@ static void ACS_setLineBlocking(int tag, int block)
    line_t *l;
    int linenum = -1;
 
+   CAM_InvalidateSightCache();
+
    while((l = P_FindLine(tag, &linenum)) != nullptr)
    {
       switch(block)
@@ -0,0 +1,82 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Bump allocation and small flat containers for bot map building.
+//
+//-----------------------------------------------------------------------------
+
+#include <stddef.h>
+#include "../z_zone.h"
+
+#include "b_arena.h"
+
+// Default chunk size. Larger requests get a chunk of their own.
+static const size_t ARENA_CHUNKSIZE = 256 * 1024;
+
+//
+// BotArena::alloc
+//
+// Returns zero-filled room of the given size and alignment
+//
+void *BotArena::alloc(size_t size, size_t align)
+{
+   uintptr_t pos = ((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1);
+   if(!cursor || pos + size > (uintptr_t)limit)
+   {
+      size_t header = (sizeof(Chunk) + alignof(max_align_t) - 1) &
+            ~(alignof(max_align_t) - 1);
+      size_t chunksize = header + size + align;
+      if(chunksize < ARENA_CHUNKSIZE)
+         chunksize = ARENA_CHUNKSIZE;
+      Chunk *chunk = ecalloc(Chunk *, 1, chunksize);
+      chunk->next = chunks;
+      chunks = chunk;
+      cursor = reinterpret_cast<byte *>(chunk) + header;
+      limit = reinterpret_cast<byte *>(chunk) + chunksize;
+      reserved += chunksize;
+      pos = ((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1);
+   }
+   cursor = reinterpret_cast<byte *>(pos + size);
+   used += size;
+   return reinterpret_cast<void *>(pos);
+}
+
+//
+// BotArena::clear
+//
+// Releases all chunks at once
+//
+void BotArena::clear()
+{
+   while(chunks)
+   {
+      Chunk *next = chunks->next;
+      efree(chunks);
+      chunks = next;
+   }
+   cursor = limit = nullptr;
+   used = reserved = 0;
+}
+
+// EOF
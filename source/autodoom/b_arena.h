@@ -0,0 +1,286 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Bump allocation and small flat containers for bot map building.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef B_ARENA_H_
+#define B_ARENA_H_
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "../doomtype.h"
+#include "../z_zone.h"
+
+//
+// BotArena
+//
+// Hands out memory from large chunks, which are all released at once when
+// the arena is destroyed. Individual allocations are never freed, and no
+// destructors are called by the arena itself.
+//
+class BotArena
+{
+public:
+   BotArena() = default;
+   BotArena(const BotArena &) = delete;
+   BotArena &operator = (const BotArena &) = delete;
+   ~BotArena()
+   {
+      clear();
+   }
+
+   void *alloc(size_t size, size_t align);
+   void clear();
+
+   //
+   // Constructs a T in the arena
+   //
+   template<typename T, typename... Args> T *make(Args &&... args)
+   {
+      return ::new(alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+   }
+
+   //
+   // Copies a run of plain items into the arena
+   //
+   template<typename T> T *copy(const T *items, size_t count)
+   {
+      static_assert(std::is_trivially_copyable<T>::value, "Plain data only");
+      if(!count)
+         return nullptr;
+      T *result = static_cast<T *>(alloc(count * sizeof(T), alignof(T)));
+      memcpy(result, items, count * sizeof(T));
+      return result;
+   }
+
+   //
+   // Uninitialized room for plain items
+   //
+   template<typename T> T *array(size_t count)
+   {
+      static_assert(std::is_trivially_copyable<T>::value, "Plain data only");
+      if(!count)
+         return nullptr;
+      return static_cast<T *>(alloc(count * sizeof(T), alignof(T)));
+   }
+
+   size_t getUsed() const
+   {
+      return used;
+   }
+   size_t getReserved() const
+   {
+      return reserved;
+   }
+
+private:
+   struct Chunk
+   {
+      Chunk *next;
+   };
+
+   Chunk *chunks = nullptr;
+   byte *cursor = nullptr;
+   byte *limit = nullptr;
+   size_t used = 0;      // bytes handed out
+   size_t reserved = 0;  // bytes taken from the zone
+};
+
+//
+// FlatSet
+//
+// Sorted set of plain values, kept in one array. The first few items are
+// stored inline, so most sets never touch the heap. Insertion and removal
+// are linear, which beats node based sets at the sizes seen in bot maps.
+//
+template<typename T, unsigned N> class FlatSet
+{
+   static_assert(std::is_trivially_copyable<T>::value, "Plain data only");
+
+public:
+   typedef T *iterator;
+   typedef const T *const_iterator;
+
+   FlatSet() = default;
+   FlatSet(const FlatSet &other)
+   {
+      *this = other;
+   }
+   FlatSet(FlatSet &&other) noexcept
+   {
+      *this = std::move(other);
+   }
+   ~FlatSet()
+   {
+      if(heap)
+         efree(heap);
+   }
+
+   FlatSet &operator = (const FlatSet &other)
+   {
+      if(this == &other)
+         return *this;
+      length = 0;
+      reserve(other.length);
+      memcpy(data(), other.data(), other.length * sizeof(T));
+      length = other.length;
+      return *this;
+   }
+   FlatSet &operator = (FlatSet &&other) noexcept
+   {
+      if(this == &other)
+         return *this;
+      if(heap)
+         efree(heap);
+      heap = other.heap;
+      capacity = other.capacity;
+      length = other.length;
+      if(!heap)
+         memcpy(local, other.local, length * sizeof(T));
+      other.heap = nullptr;
+      other.capacity = N;
+      other.length = 0;
+      return *this;
+   }
+
+   bool operator == (const FlatSet &other) const
+   {
+      return length == other.length &&
+            std::equal(begin(), end(), other.begin());
+   }
+
+   bool insert(T value)
+   {
+      T *pos = std::lower_bound(begin(), end(), value);
+      if(pos != end() && *pos == value)
+         return false;
+      size_t index = pos - begin();
+      reserve(length + 1);
+      T *items = data();
+      memmove(items + index + 1, items + index, (length - index) * sizeof(T));
+      items[index] = value;
+      ++length;
+      return true;
+   }
+
+   template<typename It> void insert(It first, It last)
+   {
+      for(; first != last; ++first)
+         insert(*first);
+   }
+
+   size_t erase(T value)
+   {
+      T *pos = std::lower_bound(begin(), end(), value);
+      if(pos == end() || *pos != value)
+         return 0;
+      memmove(pos, pos + 1, (end() - pos - 1) * sizeof(T));
+      --length;
+      return 1;
+   }
+
+   size_t count(T value) const
+   {
+      return std::binary_search(begin(), end(), value) ? 1 : 0;
+   }
+
+   void clear()
+   {
+      length = 0;
+   }
+
+   size_t size() const
+   {
+      return length;
+   }
+   bool empty() const
+   {
+      return !length;
+   }
+
+   iterator begin()
+   {
+      return data();
+   }
+   iterator end()
+   {
+      return data() + length;
+   }
+   const_iterator begin() const
+   {
+      return data();
+   }
+   const_iterator end() const
+   {
+      return data() + length;
+   }
+   const_iterator cbegin() const
+   {
+      return begin();
+   }
+   const_iterator cend() const
+   {
+      return end();
+   }
+
+private:
+   // Not pointing to local while inline, so the set can be moved as bytes
+   T *data()
+   {
+      return heap ? heap : local;
+   }
+   const T *data() const
+   {
+      return heap ? heap : local;
+   }
+
+   void reserve(size_t count)
+   {
+      if(count <= capacity)
+         return;
+      size_t newcap = capacity * 2;
+      if(newcap < count)
+         newcap = count;
+      T *items = emalloc(T *, newcap * sizeof(T));
+      memcpy(items, data(), length * sizeof(T));
+      if(heap)
+         efree(heap);
+      heap = items;
+      capacity = newcap;
+   }
+
+   T local[N];
+   T *heap = nullptr;
+   size_t capacity = N;
+   size_t length = 0;
+};
+
+#endif
+
+// EOF
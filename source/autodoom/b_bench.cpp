@@ -0,0 +1,532 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Headless bot autoplay benchmark.
+//
+//      -botbench <map> [<map>...] starts a coordinator, which runs a copy of
+//      the program for each map, with the same arguments plus -benchworker.
+//      The workers have no video or sound and let the bots play their map
+//      from a fixed random seed until it's exited or the tic limit is
+//      reached. Each worker writes its result to a file, from which the
+//      coordinator builds the report.
+//
+//      Coordinator options:
+//      -benchjobs <n>       number of workers running at once (default: CPUs)
+//      -benchreport <file>  report file, CSV if it ends with .csv, otherwise
+//                           JSON (default: botbench.json)
+//      -benchtics <n>       tic limit for each map (default: 20 minutes)
+//      -benchseed <n>       random seed (default: 1993)
+//
+//      The bot_tracebench console command times the bot geometry traversals
+//      on the current map, called with templated callbacks and through the
+//      std::function wrappers.
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../z_zone.h"
+
+#include "../c_io.h"
+#include "../c_runcmd.h"
+#include "../d_player.h"
+#include "../doomdef.h"
+#include "../doomstat.h"
+#include "../m_argv.h"
+#include "b_bench.h"
+#include "b_botmap.h"
+#include "b_path.h"
+#include "b_util.h"
+
+// true in processes started by the coordinator
+bool bench_worker;
+
+//
+// Result of one map, as written by the worker
+//
+struct benchresult_t
+{
+   char   status[16];    // exit, timeout or failed
+   int    tics;
+   int    kills, totalkills;
+   int    items, totalitems;
+   int    secrets, totalsecrets;
+   int    deaths;
+   double clocks[NUMBENCHCLOCKS];   // seconds
+   double walltime;                 // seconds, from level start
+};
+
+//
+// Worker state
+//
+static struct
+{
+   const char *map;
+   const char *resultfile;
+   int         maxtics;
+   bool        started;       // the level has begun
+   bool        wasdead[MAXPLAYERS];
+   std::chrono::steady_clock::time_point start;
+   benchresult_t result;
+} worker;
+
+enum
+{
+   DEFAULT_SEED = 1993,
+   DEFAULT_MAXTICS = 20 * 60 * TICRATE,
+};
+
+//
+// B_benchIntParm
+//
+// Gets an integer command-line parameter, or the default if missing
+//
+static int B_benchIntParm(const char *name, int defvalue)
+{
+   int p = M_CheckParm(name);
+   if(p && p < myargc - 1)
+      return atoi(myargv[p + 1]);
+   return defvalue;
+}
+
+//
+// B_BenchIsCoordinator
+//
+// True if this process must run a benchmark instead of the game. Also sets
+// up worker processes.
+//
+bool B_BenchIsCoordinator()
+{
+   int p = M_CheckParm("-benchworker");
+   if(p && p < myargc - 2)
+   {
+      bench_worker = true;
+      worker.map = myargv[p + 1];
+      worker.resultfile = myargv[p + 2];
+      worker.maxtics = B_benchIntParm("-benchtics", DEFAULT_MAXTICS);
+      return false;
+   }
+   return M_CheckParm("-botbench") != 0;
+}
+
+//
+// B_BenchWorkerMap
+//
+// The map played by this worker, or nullptr if not a worker
+//
+const char *B_BenchWorkerMap()
+{
+   return bench_worker ? worker.map : nullptr;
+}
+
+//
+// B_BenchSeed
+//
+// Random seed used by all workers
+//
+unsigned B_BenchSeed()
+{
+   return (unsigned)B_benchIntParm("-benchseed", DEFAULT_SEED);
+}
+
+//
+// B_BenchAddTime
+//
+void B_BenchAddTime(benchclock_e which, double seconds)
+{
+   worker.result.clocks[which] += seconds;
+}
+
+//
+// B_benchFinish
+//
+// Writes the result and quits the worker
+//
+static void B_benchFinish(const char *status)
+{
+   benchresult_t &result = worker.result;
+   std::chrono::duration<double> elapsed =
+         std::chrono::steady_clock::now() - worker.start;
+
+   strncpy(result.status, status, sizeof(result.status) - 1);
+   result.totalkills = totalkills;
+   result.totalitems = totalitems;
+   result.totalsecrets = totalsecret;
+   result.walltime = elapsed.count();
+   for(int i = 0; i < MAXPLAYERS; ++i)
+   {
+      if(!playeringame[i])
+         continue;
+      result.kills += players[i].killcount;
+      result.items += players[i].itemcount;
+      result.secrets += players[i].secretcount;
+   }
+
+   FILE *f = fopen(worker.resultfile, "w");
+   if(f)
+   {
+      fprintf(f, "%s %d %d %d %d %d %d %d %d %.9f %.9f %.6f\n", result.status,
+              result.tics, result.kills, result.totalkills, result.items,
+              result.totalitems, result.secrets, result.totalsecrets,
+              result.deaths, result.clocks[BENCH_BOT], result.clocks[BENCH_TICKER],
+              result.walltime);
+      fclose(f);
+   }
+
+   // Leave right away: the normal exit would save the configuration files,
+   // which all workers share.
+   fflush(nullptr);
+   _Exit(f ? 0 : 1);
+}
+
+//
+// B_BenchTicker
+//
+// Called after each game tic. Ends the worker once the map is exited or the
+// time runs out.
+//
+void B_BenchTicker()
+{
+   if(!bench_worker)
+      return;
+
+   if(gamestate != GS_LEVEL)
+   {
+      if(worker.started)
+         B_benchFinish("exit");
+      return;
+   }
+
+   if(!worker.started)
+   {
+      worker.started = true;
+      worker.start = std::chrono::steady_clock::now();
+   }
+
+   for(int i = 0; i < MAXPLAYERS; ++i)
+   {
+      if(!playeringame[i])
+         continue;
+      bool dead = players[i].playerstate == PST_DEAD;
+      if(dead && !worker.wasdead[i])
+         ++worker.result.deaths;
+      worker.wasdead[i] = dead;
+   }
+
+   if(++worker.result.tics >= worker.maxtics)
+      B_benchFinish("timeout");
+}
+
+//=============================================================================
+//
+// Coordinator
+//
+
+//
+// One map to play. Set up before the coordinator threads start, and only uses
+// the C++ heap, since those threads run alongside the main one.
+//
+struct benchjob_t
+{
+   const char   *map;
+   std::string   resultfile;
+   int           exitcode;
+   benchresult_t result = {};
+};
+
+//
+// B_runJob
+//
+// Plays one map in a worker and reads its result
+//
+static void B_runJob(benchjob_t &job)
+{
+   // Runs on coordinator threads, so keep away from the zone heap
+   std::vector<const char *> args(myargv, myargv + myargc);
+   args.push_back("-benchworker");
+   args.push_back(job.map);
+   args.push_back(job.resultfile.c_str());
+   args.push_back("-nodraw");
+   args.push_back("-noblit");
+   args.push_back("-nosound");
+   args.push_back(nullptr);
+
+   remove(job.resultfile.c_str());
+   job.exitcode = B_RunProcess(args);
+
+   benchresult_t &result = job.result;
+   FILE *f = fopen(job.resultfile.c_str(), "r");
+   if(f)
+   {
+      if(fscanf(f, "%15s %d %d %d %d %d %d %d %d %lf %lf %lf", result.status,
+                &result.tics, &result.kills, &result.totalkills, &result.items,
+                &result.totalitems, &result.secrets, &result.totalsecrets,
+                &result.deaths, &result.clocks[BENCH_BOT],
+                &result.clocks[BENCH_TICKER], &result.walltime) != 12)
+      {
+         result.status[0] = 0;
+      }
+      fclose(f);
+      remove(job.resultfile.c_str());
+   }
+   if(!result.status[0])
+   {
+      memset(&result, 0, sizeof(result));
+      strcpy(result.status, "failed");
+   }
+
+   printf("botbench: %s %s in %d tics\n", job.map, result.status, result.tics);
+}
+
+//
+// B_perTic
+//
+// Microseconds spent per tic
+//
+static double B_perTic(const benchresult_t &result, benchclock_e which)
+{
+   return result.tics ? result.clocks[which] * 1e6 / result.tics : 0;
+}
+
+//
+// B_writeReport
+//
+static bool B_writeReport(const char *filename, const std::vector<benchjob_t> &jobs,
+                          unsigned seed, double walltime)
+{
+   FILE *f = fopen(filename, "w");
+   if(!f)
+      return false;
+
+   size_t len = strlen(filename);
+   if(len >= 4 && !strcasecmp(filename + len - 4, ".csv"))
+   {
+      fputs("map,status,exitcode,tics,kills,totalkills,items,totalitems,"
+            "secrets,totalsecrets,deaths,bot_us_per_tic,ticker_us_per_tic,"
+            "wall_seconds\n", f);
+      for(const benchjob_t &job : jobs)
+      {
+         const benchresult_t &r = job.result;
+         fprintf(f, "%s,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f\n",
+                 job.map, r.status, job.exitcode, r.tics, r.kills, r.totalkills,
+                 r.items, r.totalitems, r.secrets, r.totalsecrets, r.deaths,
+                 B_perTic(r, BENCH_BOT), B_perTic(r, BENCH_TICKER), r.walltime);
+      }
+   }
+   else
+   {
+      fprintf(f, "{\n  \"seed\": %u,\n  \"wall_seconds\": %.3f,\n  \"maps\": [\n",
+              seed, walltime);
+      for(size_t i = 0; i < jobs.size(); ++i)
+      {
+         const benchjob_t &job = jobs[i];
+         const benchresult_t &r = job.result;
+         fprintf(f, "    { \"map\": \"%s\", \"status\": \"%s\", \"exitcode\": %d, "
+                 "\"tics\": %d, \"kills\": %d, \"totalkills\": %d, "
+                 "\"items\": %d, \"totalitems\": %d, \"secrets\": %d, "
+                 "\"totalsecrets\": %d, \"deaths\": %d, "
+                 "\"bot_us_per_tic\": %.3f, \"ticker_us_per_tic\": %.3f, "
+                 "\"wall_seconds\": %.3f }%s\n",
+                 job.map, r.status, job.exitcode, r.tics, r.kills, r.totalkills,
+                 r.items, r.totalitems, r.secrets, r.totalsecrets, r.deaths,
+                 B_perTic(r, BENCH_BOT), B_perTic(r, BENCH_TICKER), r.walltime,
+                 i + 1 < jobs.size() ? "," : "");
+      }
+      fputs("  ]\n}\n", f);
+   }
+
+   fclose(f);
+   return true;
+}
+
+//
+// B_BenchRun
+//
+// Runs the benchmark as given by the command line
+//
+void B_BenchRun()
+{
+   const char *reportname = "botbench.json";
+   int p = M_CheckParm("-benchreport");
+   if(p && p < myargc - 1)
+      reportname = myargv[p + 1];
+
+   std::vector<benchjob_t> jobs;
+   p = M_CheckParm("-botbench");
+   for(++p; p < myargc && myargv[p][0] != '-' && myargv[p][0] != '@'; ++p)
+   {
+      jobs.emplace_back();
+      benchjob_t &job = jobs.back();
+      job.map = myargv[p];
+      job.resultfile = std::string(reportname) + "." +
+         std::to_string(jobs.size() - 1) + ".tmp";
+   }
+   if(jobs.empty())
+   {
+      puts("botbench: no maps given");
+      return;
+   }
+
+   int numworkers = B_benchIntParm("-benchjobs",
+                                   (int)std::thread::hardware_concurrency());
+   if(numworkers < 1)
+      numworkers = 1;
+   if(numworkers > (int)jobs.size())
+      numworkers = (int)jobs.size();
+
+   unsigned seed = B_BenchSeed();
+   printf("botbench: %d maps, %d at once, seed %u\n", (int)jobs.size(),
+          numworkers, seed);
+
+   auto start = std::chrono::steady_clock::now();
+
+   std::atomic<size_t> nextjob(0);
+   auto runner = [&jobs, &nextjob]() {
+      size_t index;
+      while((index = nextjob++) < jobs.size())
+         B_runJob(jobs[index]);
+   };
+   std::vector<std::thread> threads;
+   for(int i = 0; i < numworkers; ++i)
+      threads.emplace_back(runner);
+   for(std::thread &thread : threads)
+      thread.join();
+
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   if(B_writeReport(reportname, jobs, seed, elapsed.count()))
+      printf("botbench: wrote %s in %.1f seconds\n", reportname, elapsed.count());
+   else
+      printf("botbench: couldn't write %s\n", reportname);
+}
+
+//
+// B_timeCalls
+//
+// Runs func on each item, returning the average time in nanoseconds
+//
+template<typename T, typename F>
+static double B_timeCalls(const std::vector<T> &items, F &&func)
+{
+   auto start = std::chrono::steady_clock::now();
+   for(const T &item : items)
+      func(item);
+   std::chrono::duration<double, std::nano> elapsed =
+         std::chrono::steady_clock::now() - start;
+   return items.empty() ? 0 : elapsed.count() / items.size();
+}
+
+//
+// bot_tracebench
+//
+// Times the traversals between random subsector centres of the current map.
+// The callbacks capture as much as Bot::stepLedges, so std::function has to
+// allocate them.
+//
+CONSOLE_COMMAND(bot_tracebench, 0)
+{
+   if(gamestate != GS_LEVEL || !botMap || botMap->ssectors.isEmpty())
+   {
+      C_Printf("No bot map is loaded\n");
+      return;
+   }
+   int count = Console.argc ? Console.argv[0]->toInt() : 100000;
+   if(count <= 0)
+      count = 100000;
+
+   typedef std::function<bool(const BotMap::Line &, const divline_t &, fixed_t)>
+      linehit_t;
+
+   std::mt19937 rng(B_BenchSeed());
+   std::uniform_int_distribution<int> pick(0, (int)botMap->ssectors.getLength() - 1);
+   std::vector<divline_t> traces(count);
+   for(divline_t &trace : traces)
+   {
+      v2fixed_t start = botMap->ssectors[pick(rng)].mid;
+      trace = divline_t::points(start, botMap->ssectors[pick(rng)].mid);
+   }
+   std::vector<const BSubsec *> sources(count / 100 + 1);
+   for(const BSubsec *&source : sources)
+      source = &botMap->ssectors[pick(rng)];
+
+   // Keeps the results alive
+   fixed_t fracsum = 0;
+   int blocksum = 0, sssum = 0;
+   fixed_t height = players[consoleplayer].mo ? players[consoleplayer].mo->height :
+         41 * FRACUNIT;
+   v2fixed_t pad = {};
+
+   auto lineHit = [&fracsum, pad, height](const BotMap::Line &, const divline_t &,
+                                          fixed_t frac) {
+      fracsum += frac + pad.x + height;
+      return true;
+   };
+   auto blockHit = [&blocksum, pad, height](int b) {
+      blocksum += b + pad.y + height;
+   };
+   auto passHit = [height](const BNeigh &neigh) {
+      return botMap->canPass(*neigh.myss, *neigh.otherss, height);
+   };
+   auto scanHit = [&sssum, pad](const BSubsec &) {
+      sssum += 1 + pad.x;
+      return false;
+   };
+
+   double traverse[2], touched[2], breadth[2];
+   traverse[0] = B_timeCalls(traces, [&](const divline_t &trace) {
+      botMap->pathTraverse(trace, lineHit);
+   });
+   traverse[1] = B_timeCalls(traces, [&](const divline_t &trace) {
+      botMap->pathTraverse(trace, linehit_t(lineHit));
+   });
+   touched[0] = B_timeCalls(traces, [&](const divline_t &trace) {
+      botMap->getTouchedBlocks(trace.v, trace.v + trace.dv, blockHit);
+   });
+   touched[1] = B_timeCalls(traces, [&](const divline_t &trace) {
+      botMap->getTouchedBlocks(trace.v, trace.v + trace.dv,
+                               std::function<void(int)>(blockHit));
+   });
+   breadth[0] = B_timeCalls(sources, [&](const BSubsec *source) {
+      B_FindBreadthFirst(*source, passHit, scanHit);
+   });
+   breadth[1] = B_timeCalls(sources, [&](const BSubsec *source) {
+      B_FindBreadthFirst(*source, std::function<bool(const BNeigh &)>(passHit),
+                         std::function<bool(const BSubsec &)>(scanHit));
+   });
+
+   C_Printf("Per call, template / std::function (ns):\n"
+            "pathTraverse: %.0f / %.0f\n"
+            "getTouchedBlocks: %.0f / %.0f\n"
+            "B_FindBreadthFirst: %.0f / %.0f\n", traverse[0], traverse[1],
+            touched[0], touched[1], breadth[0], breadth[1]);
+   if(!fracsum && !blocksum && !sssum)
+      C_Printf("Nothing was traversed\n");
+}
+
+// EOF
+
@@ -0,0 +1,87 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Headless bot autoplay benchmark. A coordinator process runs one worker
+//      process per map and gathers their results into a single report.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef B_BENCH_H_
+#define B_BENCH_H_
+
+#include <chrono>
+
+//
+// Timed parts of each benchmark tic
+//
+enum benchclock_e
+{
+   BENCH_BOT,     // Bot::DoCommands
+   BENCH_TICKER,  // P_Ticker
+   NUMBENCHCLOCKS
+};
+
+extern bool bench_worker;
+
+bool B_BenchIsCoordinator();
+void B_BenchRun();
+
+const char *B_BenchWorkerMap();
+unsigned B_BenchSeed();
+void B_BenchAddTime(benchclock_e which, double seconds);
+void B_BenchTicker();
+
+//
+// BenchClock
+//
+// Adds the time of its scope to a benchmark clock. Does nothing outside of
+// benchmark workers.
+//
+class BenchClock
+{
+public:
+   explicit BenchClock(benchclock_e inWhich) : which(inWhich)
+   {
+      if(bench_worker)
+         start = std::chrono::steady_clock::now();
+   }
+   ~BenchClock()
+   {
+      if(bench_worker)
+      {
+         std::chrono::duration<double> elapsed =
+               std::chrono::steady_clock::now() - start;
+         B_BenchAddTime(which, elapsed.count());
+      }
+   }
+
+private:
+   benchclock_e which;
+   std::chrono::steady_clock::time_point start;
+};
+
+#endif
+
+// EOF
+
@@ -28,14 +28,21 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <vector>
 #include "../z_zone.h"
 
 #include "b_botmap.h"
 #include "b_botmaptemp.h"
+#include "b_cachegen.h"
+#include "b_cluster.h"
 #include "b_compression.h"
+#include "b_flowfield.h"
 #include "b_glbsp.h"
+#include "b_lineeffect.h"
 #include "b_msector.h"
 #include "../c_io.h"
+#include "../c_runcmd.h"
 #include "../cam_sight.h"
 #include "../d_files.h"
 #include "../doomstat.h"
@@ -43,9 +50,12 @@
 #include "../e_player.h"
 #include "../ev_actions.h"
 #include "../ev_specials.h"
+#include "../g_game.h"
+#include "../hal/i_mapfile.h"
 #include "../m_bbox.h"
 #include "../m_buffer.h"
 #include "../m_hash.h"
+#include "../m_profile.h"
 #include "../m_utils.h"
 #include "../m_qstr.h"
 #include "../p_map.h"
@@ -65,6 +75,92 @@ const int CACHE_BUFFER_SIZE = 16384;
 
 static const char* const BOTMAP_CACHE_MAGIC = "BOTMAP13";
 
+//
+// Flat cache layout
+//
+// Uncompressed alternative to the gzip cache, meant to be mapped into memory
+// and copied out with few conversions. The file starts with FlatHeader,
+// followed by the sections, each being an array of records. All fields are
+// 32-bit, in the byte order of the machine which wrote the file. Links are
+// record indices, with -1 meaning none. Bump the magic if anything changes.
+//
+static const char BOTMAP_FLAT_MAGIC[] = "BOTMAPF1";
+static const uint32_t BOTMAP_FLAT_ENDIAN_MARK = 0x01020304;
+
+enum FlatSection
+{
+   FS_VERTICES,      // BotMap::Vertex
+   FS_MSECTORS,      // metasectors, as written by MetaSector::writeToFile
+   FS_LINES,         // FlatLine
+   FS_SEGS,          // FlatSeg
+   FS_SEGBLOCKLISTS, // int32_t blockmap indices, pointed by FlatSeg
+   FS_SUBSECS,       // FlatSubsec
+   FS_NEIGHS,        // FlatNeigh, pointed by FlatSubsec
+   FS_NODES,         // BotMap::Node
+   FS_SEGBLOCKS,     // FlatRange into FS_SEGBLOCKREFS
+   FS_SEGBLOCKREFS,  // int32_t seg indices
+   FS_LINEBLOCKS,    // FlatRange into FS_LINEBLOCKREFS
+   FS_LINEBLOCKREFS, // int32_t line indices
+   FS_NUM
+};
+
+struct FlatSectionInfo
+{
+   uint32_t offset;  // from the start of the file, 4-byte aligned
+   uint32_t count;   // records
+   uint32_t size;    // bytes
+};
+
+struct FlatHeader
+{
+   char magic[8];
+   uint32_t endianMark;
+   uint32_t headerSize;
+   int32_t radius;
+   int32_t bMapOrgX, bMapOrgY, bMapWidth, bMapHeight;
+   int32_t nullMSec;
+   FlatSectionInfo sections[FS_NUM];
+};
+
+struct FlatLine
+{
+   int32_t v[2], msec[2], specline;
+};
+
+struct FlatSeg
+{
+   int32_t v[2], dx, dy, ln, isback, partner, bbox[4], midx, midy, owner;
+   int32_t blockFirst, blockCount;
+};
+
+struct FlatSubsec
+{
+   int32_t segs, msector, nsegs, midx, midy, neighFirst, neighCount;
+};
+
+struct FlatNeigh
+{
+   int32_t otherss, myss, line, vx, vy, dx, dy, dist;
+};
+
+struct FlatRange
+{
+   int32_t first, count;
+};
+
+static_assert(sizeof(BotMap::Vertex) == 8 && sizeof(BotMap::Node) == 24,
+              "Vertex and Node are copied as they are in the flat cache");
+
+static const size_t flatRecordSize[FS_NUM] =
+{
+   sizeof(BotMap::Vertex), 0, sizeof(FlatLine), sizeof(FlatSeg),
+   sizeof(int32_t), sizeof(FlatSubsec), sizeof(FlatNeigh),
+   sizeof(BotMap::Node), sizeof(FlatRange), sizeof(int32_t),
+   sizeof(FlatRange), sizeof(int32_t)
+};
+
+bool bot_flatcache = true;
+
 //
 // String representation
 //
@@ -82,95 +178,27 @@ qstring BotMap::Line::toString() const
 //
 // BotMap::getTouchedBlocks
 //
-// Lists the blocks the line touches into a collection, code from P_Setup.cpp,
-// P_CreateBlockmap
+// Wrapper for callers holding a std::function
 //
 void BotMap::getTouchedBlocks(v2fixed_t v1, v2fixed_t v2,
                               const std::function<void(int)> &func) const
 {
-   fixed_t minx = botMap->bMapOrgX >> FRACBITS;
-   fixed_t miny = botMap->bMapOrgY >> FRACBITS;
-   unsigned tot = botMap->bMapWidth * botMap->bMapHeight;
-   int x = (v1.x >> FRACBITS) - minx;
-   int y = (v1.y >> FRACBITS) - miny;
-   
-   // x-y deltas
-   int adx = (v2.x - v1.x) >> FRACBITS, dx = adx < 0 ? -1 : 1;
-   int ady = (v2.y - v1.y) >> FRACBITS, dy = ady < 0 ? -1 : 1;
-   
-   // difference in preferring to move across y (>0)
-   // instead of x (<0)
-   int diff = !adx ? 1 : !ady ? -1 :
-   (((x / BOTMAPBLOCKUNITS) * BOTMAPBLOCKUNITS) +
-    (dx > 0 ? BOTMAPBLOCKUNITS-1 : 0) - x) * (ady = D_abs(ady)) * dx -
-   (((y / BOTMAPBLOCKUNITS) * BOTMAPBLOCKUNITS) +
-    (dy > 0 ? BOTMAPBLOCKUNITS-1 : 0) - y) * (adx = D_abs(adx)) * dy;
-   
-   // starting block, and pointer to its blocklist structure
-   int b = (y / BOTMAPBLOCKUNITS) * botMap->bMapWidth + (x / BOTMAPBLOCKUNITS);
-   
-   // ending block
-   int bend = (((v2.y >> FRACBITS) - miny) / BOTMAPBLOCKUNITS) *
-   botMap->bMapWidth + (((v2.x >> FRACBITS) - minx) / BOTMAPBLOCKUNITS);
-   
-   // delta for pointer when moving across y
-   dy *= botMap->bMapWidth;
-   
-   // deltas for diff inside the loop
-   adx *= BOTMAPBLOCKUNITS;
-   ady *= BOTMAPBLOCKUNITS;
-   
-   // Now we simply iterate block-by-block until we reach the end block.
-   while((unsigned int) b < tot)    // failsafe -- should ALWAYS be true
-   {
-      func(b);
-      
-      // If we have reached the last block, exit
-      if(b == bend)
-         break;
-      
-      // Move in either the x or y direction to the next block
-      if(diff < 0)
-      {
-         diff += ady;
-         b += dx;
-      }
-      else
-      {
-         diff -= adx;
-         b += dy;
-      }
-   }
+   getTouchedBlocks<const std::function<void(int)> &>(v1, v2, func);
 }
 
 //
 // BotMap::getBoxTouchedBlocks
 //
-// Obtains blocks touched by a rectangular box
+// Wrapper for callers holding a std::function
 //
 void BotMap::getBoxTouchedBlocks(fixed_t top, fixed_t bottom,
                                   fixed_t left, fixed_t right,
                                   const std::function<void(int b)> &func) const
 {
-   
-   int xl, xh, yl, yh, bx, by;
-   
-   xl = (left - bMapOrgX) / BOTMAPBLOCKSIZE;
-   xh = (right - bMapOrgX) / BOTMAPBLOCKSIZE;
-   yl = (bottom - bMapOrgY) / BOTMAPBLOCKSIZE;
-   yh = (top - bMapOrgY) / BOTMAPBLOCKSIZE;
-   
-   for (bx = xl; bx <= xh; ++bx)
-   {
-      for (by = yl; by <= yh; ++by)
-      {
-         func(bx + by * bMapWidth);
-      }
-   }
+   getBoxTouchedBlocks<const std::function<void(int)> &>(top, bottom, left, right,
+                                                         func);
 }
 
-
-
 BotMap::Subsec &BotMap::pointInSubsector(v2fixed_t pos) const
 {
    int nodenum = this->numnodes - 1;
@@ -230,12 +258,13 @@ int BotMap::pointOnSide(v2fixed_t pos, const Node &node) const
 //
 void BotMap::unsetThingPosition(const Mobj *thing)
 {
-   if(mobjSecMap.count(thing))
-   {
-      for (auto it = mobjSecMap[thing].begin(); it != mobjSecMap[thing].end(); ++it)
-         (*it)->mobjlist.erase(thing);
-      mobjSecMap[thing].makeEmpty();
-   }
+   ssContents.unlinkMobj(thing, [this](int ss) {
+      if(clusters)
+         clusters->mobjUnlinked(ssectors[ss]);
+      // the thing may have stopped being an item already
+      if(flowFields)
+         flowFields->contentsChanged(ssectors[ss]);
+   });
 }
 
 //
@@ -246,6 +275,14 @@ void BotMap::unsetThingPosition(const Mobj *thing)
 void BotMap::setThingPosition(const Mobj *thing)
 {
    fixed_t rad = thing->radius + botMap->radius;
+
+   auto linked = [this, thing](const Subsec &ss)
+   {
+      if(clusters)
+         clusters->mobjLinked(ss);
+      if(flowFields && thing->flags & MF_SPECIAL)
+         flowFields->contentsChanged(ss);
+   };
    
    fixed_t top = thing->y + rad;
    fixed_t bottom = thing->y - rad;
@@ -274,8 +311,8 @@ void BotMap::setThingPosition(const Mobj *thing)
            {
 
                // if seg crosses thing bbox, add it
-               mobjSecMap[thing].add(sg->owner);
-               sg->owner->mobjlist.insert(thing);
+               if(ssContents.linkMobj(thing, ssIndex(*sg->owner)))
+                  linked(*sg->owner);
                foundlines = true;
            }
        }
@@ -285,11 +322,28 @@ void BotMap::setThingPosition(const Mobj *thing)
    {
       // not found any intersections, now it's time to set the pointInSubsector
       Subsec &thingSec = pointInSubsector(v2fixed_t(*thing));
-      thingSec.mobjlist.insert(thing);
-      mobjSecMap[thing].add(&thingSec);
+      if(ssContents.linkMobj(thing, ssIndex(thingSec)))
+         linked(thingSec);
    }
 }
 
+//
+// BotMap::~BotMap
+//
+BotMap::~BotMap()
+{
+   efree(vertices);
+   efree(lines);
+   efree(nodes);
+
+   delete[] sectorFlags;
+
+   delete clusters;
+   delete flowFields;
+
+   clearMsecList();
+}
+
 //
 // BotMap::operator new
 //
@@ -383,6 +437,88 @@ bool BotMap::canPassNow(const BSubsec &s1, const BSubsec &s2, fixed_t height) co
    return canPassNow(ms1, ms2, height);
 }
 
+//
+// BotMap::invalidatePassability
+//
+// Called when sector heights or player locks change, so cached canPass
+// results must be discarded.
+//
+void BotMap::invalidatePassability()
+{
+   if(clusters)
+      clusters->invalidate();
+   if(flowFields)
+      flowFields->geometryChanged();
+   LevelStateStack::Invalidate();
+}
+
+//
+// B_passThresholds
+//
+// Which of the steps and gaps between a sector and a neighbour are within the
+// reach of a walker of the given height. canPass only depends on these.
+//
+static unsigned B_passThresholds(fixed_t floor, fixed_t ceiling, fixed_t ofloor,
+                                 fixed_t oceiling, fixed_t height)
+{
+   return (floor - ofloor > 24 * FRACUNIT) |
+      (ofloor - floor > 24 * FRACUNIT) << 1 |
+      (ceiling - ofloor >= height) << 2 |
+      (oceiling - floor >= height) << 3 |
+      (ceiling - floor >= height) << 4;
+}
+
+//
+// BotMap::sectorMoved
+//
+// Called by the plane movers after a level sector changed its heights. The
+// cached passability is only dropped if a step or gap next to the sector now
+// crosses the step height or the height of a player.
+//
+void BotMap::sectorMoved(const sector_t &sector, fixed_t oldfloor, fixed_t oldceiling)
+{
+   if(&sector < sectors || &sector >= sectors + numsectors)
+      return;
+
+   fixed_t heights[MAXPLAYERS];
+   int numheights = 0;
+   for(int i = 0; i < MAXPLAYERS; ++i)
+   {
+      if(playeringame[i] && players[i].mo)
+         heights[numheights++] = players[i].mo->height;
+   }
+   if(!numheights)
+      heights[numheights++] = 56 * FRACUNIT;
+
+   const fixed_t floor = sector.srf.floor.height;
+   const fixed_t ceiling = sector.srf.ceiling.height;
+   for(int h = 0; h < numheights; ++h)
+   {
+      if(B_passThresholds(floor, ceiling, floor, ceiling, heights[h]) !=
+         B_passThresholds(oldfloor, oldceiling, oldfloor, oldceiling, heights[h]))
+      {
+         invalidatePassability();
+         return;
+      }
+      for(int i = 0; i < sector.linecount; ++i)
+      {
+         const line_t &line = *sector.lines[i];
+         const sector_t *other = line.frontsector == &sector ? line.backsector :
+                                                               line.frontsector;
+         if(!other || other == &sector)
+            continue;
+         const fixed_t ofloor = other->srf.floor.height;
+         const fixed_t oceiling = other->srf.ceiling.height;
+         if(B_passThresholds(floor, ceiling, ofloor, oceiling, heights[h]) !=
+            B_passThresholds(oldfloor, oldceiling, ofloor, oceiling, heights[h]))
+         {
+            invalidatePassability();
+            return;
+         }
+      }
+   }
+}
+
 //
 // B_setMobjPositions
 //
@@ -442,8 +578,8 @@ static void B_traceTriggerPoints(const line_t &line, fixed_t range, bool isgun,
 
    auto addpoint = [&line, mid, isgun](v2fixed_t point)
    {
-      BSubsec &ss = botMap->pointInSubsector(point);
-      if(ss.linelist.count(&line))
+      int ss = botMap->ssIndex(botMap->pointInSubsector(point));
+      if(botMap->ssContents.hasLine(ss, &line))
          return;
 
       // now check that there's no occlusion
@@ -468,7 +604,7 @@ static void B_traceTriggerPoints(const line_t &line, fixed_t range, bool isgun,
          return !(line.extflags & EX_ML_BLOCKALL) && line.sidenum[1] >= 0;
       });
       if(pass)
-         ss.linelist[&line] = point;
+         botMap->ssContents.addLine(ss, &line, point);
 
    };
 
@@ -566,9 +702,12 @@ static void B_buildTempBotMapFromScratch(fixed_t radius, const char *digest)
 	tempBotMap = new TempBotMap;
 
 	// Generate it
-	B_BEGIN_CLOCK
-	tempBotMap->generateForRadius(radius);
-	B_MEASURE_CLOCK(generateForRadius)
+	{
+		PROFILE_ZONE("generateForRadius");
+		tempBotMap->generateForRadius(radius);
+	}
+	B_Log("Temporary bot map arena: %u KiB",
+	      (unsigned)(tempBotMap->arenaSize() >> 10));
 	
 	// Move the metasector list to the final bot map
    for (DLListItem<MetaSector> *item = tempBotMap->getMsecList().head; item; item = item->dllNext)
@@ -577,17 +716,20 @@ static void B_buildTempBotMapFromScratch(fixed_t radius, const char *digest)
    }
 	
 	// Feed it into GLBSP. botMap will get in turn all needed data
-	B_NEW_CLOCK
-	B_GLBSP_Start();
-	B_MEASURE_CLOCK(B_GLBSP_Start)
+	{
+		PROFILE_ZONE("B_GLBSP_Start");
+		B_GLBSP_Start();
+	}
 
 	// Prevent tempBotMap from crashing
 	tempBotMap->getMsecList().head = nullptr;
 	
 	// Delete the temp. map
-	B_NEW_CLOCK
-	delete tempBotMap;
-	B_MEASURE_CLOCK(deleteTempBotMap)
+	{
+		PROFILE_ZONE("deleteTempBotMap");
+		delete tempBotMap;
+	}
+	B_Log("Bot map arena: %u KiB", (unsigned)(botMap->arena.getReserved() >> 10));
 
 }
 
@@ -704,13 +846,11 @@ void BotMap::cacheToFile(const char* path) const
     // Sanity check
    B_Log("BotMap: saving to cache %s", path);
 
-    GZCompression file;
+    // Serialize here, but leave the slow compression to a worker thread, so
+    // the level can start meanwhile
+    MemoryOutBuffer file;
     file.setThrowing(true);
-    if (!file.createFile(path, CACHE_BUFFER_SIZE, BufferedFileBase::LENDIAN, CompressLevel_Space))
-    {
-        C_Printf(FC_ERROR "WARNING: can't create bot map cache file at %s\n", path);
-        return;
-    }
+    file.create(CACHE_BUFFER_SIZE, BufferedFileBase::LENDIAN);
 
     // now we write it
    int total = static_cast<int>(numverts + metasectors.getLength() * 2 +
@@ -795,10 +935,10 @@ void BotMap::cacheToFile(const char* path) const
             file.writeSint32(seg.mid.x);
             file.writeSint32(seg.mid.y);
             file.writeSint32(seg.owner ? (int32_t)(seg.owner - &ssectors[0]) : -1);
-            file.writeUint32((uint32_t)seg.blocklist.getLength());
-            for (auto j : seg.blocklist)
+            file.writeUint32((uint32_t)seg.numblocks);
+            for (int j = 0; j < seg.numblocks; ++j)
             {
-                file.writeSint32(j);
+                file.writeSint32(seg.blocklist[j]);
             }
         }
 
@@ -810,8 +950,7 @@ void BotMap::cacheToFile(const char* path) const
             file.writeSint32(ssector.segs ? (int32_t)(ssector.segs - &segs[0]) : -1);
             file.writeSint32(ssector.msector ? msecIndexMap[ssector.msector] : -1);
             file.writeSint32(ssector.nsegs);
-            // mobjlist dynamic
-            // linelist dynamic
+            // ssContents dynamic
             file.writeSint32(ssector.mid.x);
             file.writeSint32(ssector.mid.y);
             file.writeUint32((uint32_t)ssector.neighs.getLength());
@@ -867,24 +1006,18 @@ void BotMap::cacheToFile(const char* path) const
 
         file.writeSint32(radius);
 
-        // mobjSecMap dynamic
         // lineSecMap dynamic
         // livingMonsters dynamic
         // thrownProjectiles dynamic
         // sectorFlags dynamic
         // gunLines dynamic
        file.close();
+       B_WriteCompressedAsync(path, std::move(file.getData()), CompressLevel_Space);
     }
     catch (const BufferedIOException&)
     {
         C_Printf(FC_ERROR "WARNING: can't write bot map cache file at %s\n", path);
         file.close();
-
-        // try to delete it if it fails in the middle of the write.
-        if (remove(path) != 0)
-        {
-            C_Printf(FC_ERROR "WARNING: can't delete cache file at %s\n", path);
-        }
     }
 }
 
@@ -1009,11 +1142,14 @@ void BotMap::loadFromCache(const char* path)
          file.readUint32(su32);
          if (!B_CheckAllocSize(su32))
              FAIL();
+         int *blocklist = botMap->arena.array<int>(su32);
          for (uint32_t v = 0; v < su32; ++v)
          {
             file.readSint32(i32);
-            sg.blocklist.add(i32);
+            blocklist[v] = i32;
          }
+         sg.blocklist = blocklist;
+         sg.numblocks = (int)su32;
       }
 
       // ssectors
@@ -1198,6 +1334,487 @@ void BotMap::loadFromCache(const char* path)
 #undef FAIL
 }
 
+//
+// BotMap::cacheToFlatFile
+//
+// Stores the contents to the flat cache format. Compared to cacheToFile, it's
+// larger on disk, but much faster to load.
+//
+void BotMap::cacheToFlatFile(const char *path) const
+{
+   B_Log("BotMap: saving to flat cache %s", path);
+
+   FlatHeader header = {};
+   memcpy(header.magic, BOTMAP_FLAT_MAGIC, sizeof(header.magic));
+   header.endianMark = BOTMAP_FLAT_ENDIAN_MARK;
+   header.headerSize = sizeof(FlatHeader);
+   header.radius = radius;
+   header.bMapOrgX = bMapOrgX;
+   header.bMapOrgY = bMapOrgY;
+   header.bMapWidth = bMapWidth;
+   header.bMapHeight = bMapHeight;
+   header.nullMSec = -1;
+
+   std::vector<byte> data(sizeof(FlatHeader));
+   auto addSection = [&data, &header](FlatSection section, const void *records,
+                                      size_t count, size_t size) {
+      FlatSectionInfo &info = header.sections[section];
+      info.offset = (uint32_t)data.size();
+      info.count = (uint32_t)count;
+      info.size = (uint32_t)size;
+      const byte *bytes = static_cast<const byte *>(records);
+      data.insert(data.end(), bytes, bytes + size);
+      data.resize((data.size() + 3) & ~(size_t)3);   // keep records aligned
+   };
+   auto index = [](const void *p, const void *base, size_t size) -> int32_t {
+      if(!p)
+         return -1;
+      return (int32_t)((static_cast<const byte *>(p) -
+                        static_cast<const byte *>(base)) / size);
+   };
+
+   addSection(FS_VERTICES, vertices, numverts, numverts * sizeof(Vertex));
+
+   // Metasectors are polymorphic, so they keep their own serialization
+   msecIndexMap.clear();
+   int i = 0;
+   for(const MetaSector *msec : metasectors)
+   {
+      if(msec == nullMSec)
+         header.nullMSec = i;
+      msecIndexMap[msec] = i++;
+   }
+
+   MemoryOutBuffer msecFile;
+   msecFile.setThrowing(true);
+   msecFile.create(CACHE_BUFFER_SIZE, BufferedFileBase::LENDIAN);
+   try
+   {
+      for(const MetaSector *msec : metasectors)
+         msec->writeToFile(msecFile);
+      msecFile.close();
+   }
+   catch(const BufferedIOException &)
+   {
+      C_Printf(FC_ERROR "WARNING: can't write bot map cache file at %s\n", path);
+      return;
+   }
+   addSection(FS_MSECTORS, msecFile.getData().data(), metasectors.getLength(),
+              msecFile.getData().size());
+
+   auto msecIndex = [this](const MetaSector *msec) -> int32_t {
+      return msec ? msecIndexMap[msec] : -1;
+   };
+
+   std::vector<FlatLine> flines(numlines);
+   for(i = 0; i < numlines; ++i)
+   {
+      const Line &ln = lines[i];
+      FlatLine &fl = flines[i];
+      fl.v[0] = index(ln.v[0], vertices, sizeof(Vertex));
+      fl.v[1] = index(ln.v[1], vertices, sizeof(Vertex));
+      fl.msec[0] = msecIndex(ln.msec[0]);
+      fl.msec[1] = msecIndex(ln.msec[1]);
+      fl.specline = index(ln.specline, ::lines, sizeof(line_t));
+   }
+   addSection(FS_LINES, flines.data(), flines.size(),
+              flines.size() * sizeof(FlatLine));
+
+   std::vector<FlatSeg> fsegs;
+   std::vector<int32_t> blocklists;
+   fsegs.reserve(segs.getLength());
+   for(const Seg &seg : segs)
+   {
+      FlatSeg fs;
+      fs.v[0] = index(seg.v[0], vertices, sizeof(Vertex));
+      fs.v[1] = index(seg.v[1], vertices, sizeof(Vertex));
+      fs.dx = seg.dx;
+      fs.dy = seg.dy;
+      fs.ln = index(seg.ln, lines, sizeof(Line));
+      fs.isback = seg.isback;
+      fs.partner = index(seg.partner, &segs[0], sizeof(Seg));
+      memcpy(fs.bbox, seg.bbox, sizeof(fs.bbox));
+      fs.midx = seg.mid.x;
+      fs.midy = seg.mid.y;
+      fs.owner = index(seg.owner, &ssectors[0], sizeof(Subsec));
+      fs.blockFirst = (int32_t)blocklists.size();
+      fs.blockCount = (int32_t)seg.numblocks;
+      blocklists.insert(blocklists.end(), seg.blocklist,
+                        seg.blocklist + seg.numblocks);
+      fsegs.push_back(fs);
+   }
+   addSection(FS_SEGS, fsegs.data(), fsegs.size(), fsegs.size() * sizeof(FlatSeg));
+   addSection(FS_SEGBLOCKLISTS, blocklists.data(), blocklists.size(),
+              blocklists.size() * sizeof(int32_t));
+
+   std::vector<FlatSubsec> fsubsecs;
+   std::vector<FlatNeigh> fneighs;
+   fsubsecs.reserve(ssectors.getLength());
+   for(const Subsec &ss : ssectors)
+   {
+      FlatSubsec fss;
+      fss.segs = index(ss.segs, &segs[0], sizeof(Seg));
+      fss.msector = msecIndex(ss.msector);
+      fss.nsegs = ss.nsegs;
+      fss.midx = ss.mid.x;
+      fss.midy = ss.mid.y;
+      fss.neighFirst = (int32_t)fneighs.size();
+      fss.neighCount = (int32_t)ss.neighs.getLength();
+      for(const Neigh &neigh : ss.neighs)
+      {
+         FlatNeigh fn;
+         fn.otherss = index(neigh.otherss, &ssectors[0], sizeof(Subsec));
+         fn.myss = index(neigh.myss, &ssectors[0], sizeof(Subsec));
+         fn.line = index(neigh.line, lines, sizeof(Line));
+         fn.vx = neigh.v.x;
+         fn.vy = neigh.v.y;
+         fn.dx = neigh.d.x;
+         fn.dy = neigh.d.y;
+         fn.dist = neigh.dist;
+         fneighs.push_back(fn);
+      }
+      fsubsecs.push_back(fss);
+   }
+   addSection(FS_SUBSECS, fsubsecs.data(), fsubsecs.size(),
+              fsubsecs.size() * sizeof(FlatSubsec));
+   addSection(FS_NEIGHS, fneighs.data(), fneighs.size(),
+              fneighs.size() * sizeof(FlatNeigh));
+
+   addSection(FS_NODES, nodes, numnodes, numnodes * sizeof(Node));
+
+   std::vector<FlatRange> ranges;
+   std::vector<int32_t> refs;
+   ranges.reserve(segBlocks.getLength());
+   for(const auto &coll : segBlocks)
+   {
+      ranges.push_back({ (int32_t)refs.size(), (int32_t)coll.getLength() });
+      for(const Seg *pseg : coll)
+         refs.push_back(index(pseg, &segs[0], sizeof(Seg)));
+   }
+   addSection(FS_SEGBLOCKS, ranges.data(), ranges.size(),
+              ranges.size() * sizeof(FlatRange));
+   addSection(FS_SEGBLOCKREFS, refs.data(), refs.size(), refs.size() * sizeof(int32_t));
+
+   ranges.clear();
+   refs.clear();
+   for(const auto &coll : lineBlocks)
+   {
+      ranges.push_back({ (int32_t)refs.size(), (int32_t)coll.getLength() });
+      for(const Line *pline : coll)
+         refs.push_back(index(pline, lines, sizeof(Line)));
+   }
+   addSection(FS_LINEBLOCKS, ranges.data(), ranges.size(),
+              ranges.size() * sizeof(FlatRange));
+   addSection(FS_LINEBLOCKREFS, refs.data(), refs.size(), refs.size() * sizeof(int32_t));
+
+   memcpy(data.data(), &header, sizeof(header));
+   B_WriteRawAsync(path, std::move(data));
+}
+
+//
+// B_flatLink
+//
+// Relocates a flat cache index into a pointer, checking the range
+//
+template<typename T, typename U>
+static bool B_flatLink(T *&p, U *base, int32_t index, size_t max)
+{
+   if(index == -1)
+   {
+      p = nullptr;
+      return true;
+   }
+   if(index < 0 || (size_t)index >= max)
+      return false;
+   p = base + index;
+   return true;
+}
+
+//
+// B_flatRangeValid
+//
+// Checks that a FlatRange fits its referenced section
+//
+static bool B_flatRangeValid(int32_t first, int32_t count, uint32_t max)
+{
+   return first >= 0 && count >= 0 && (uint32_t)first <= max &&
+   (uint32_t)count <= max - (uint32_t)first;
+}
+
+//
+// BotMap::loadFromFlatCache
+//
+// Tries to load bot map from a flat cache file. The file is mapped into
+// memory, so the only work left is relocating the index links into pointers,
+// which is also where they get validated. Any inconsistency rejects the file.
+//
+void BotMap::loadFromFlatCache(const char *path)
+{
+#define FAIL() do { delete botMap; botMap = nullptr; return; } while(0)
+
+   B_Log("BotMap: loading from flat cache %s", path);
+
+   MappedFile file;
+   if(!file.open(path))
+   {
+      B_Log("Couldn't open file");
+      return;
+   }
+
+   const byte *base = file.getData();
+   size_t filesize = file.getSize();
+
+   FlatHeader header;
+   if(filesize < sizeof(header))
+      return;
+   memcpy(&header, base, sizeof(header));
+   if(memcmp(header.magic, BOTMAP_FLAT_MAGIC, sizeof(header.magic)) ||
+      header.endianMark != BOTMAP_FLAT_ENDIAN_MARK ||
+      header.headerSize != sizeof(FlatHeader))
+   {
+      B_Log("Flat cache is from another version or platform");
+      return;
+   }
+
+   for(int s = 0; s < FS_NUM; ++s)
+   {
+      const FlatSectionInfo &info = header.sections[s];
+      if(info.offset % 4 || info.offset > filesize || info.size > filesize - info.offset)
+         return;
+      if(flatRecordSize[s] && info.size != info.count * flatRecordSize[s])
+         return;
+   }
+
+   const FlatSectionInfo *sections = header.sections;
+   static const FlatSection mainSections[] =
+   {
+      FS_VERTICES, FS_MSECTORS, FS_LINES, FS_SEGS, FS_SUBSECS, FS_NODES,
+      FS_SEGBLOCKS, FS_LINEBLOCKS
+   };
+   for(FlatSection s : mainSections)
+      if(!B_CheckAllocSize((int)sections[s].count))
+         return;
+
+   // The blockmaps must cover the whole grid, and there must be something for
+   // the node walk to land on
+   uint64_t numblocks = (uint64_t)header.bMapWidth * (uint64_t)header.bMapHeight;
+   if(header.bMapWidth <= 0 || header.bMapHeight <= 0 ||
+      sections[FS_SEGBLOCKS].count != numblocks ||
+      sections[FS_LINEBLOCKS].count != numblocks || !sections[FS_SUBSECS].count)
+   {
+      B_Log("Flat cache is truncated or inconsistent");
+      return;
+   }
+
+   auto section = [base, sections](FlatSection s) {
+      return base + sections[s].offset;
+   };
+
+   botMap = new (PU_STATIC, nullptr) BotMap;
+   BotMap &map = *botMap;
+
+   map.radius = header.radius;
+   map.bMapOrgX = header.bMapOrgX;
+   map.bMapOrgY = header.bMapOrgY;
+   map.bMapWidth = header.bMapWidth;
+   map.bMapHeight = header.bMapHeight;
+
+   map.numverts = (int)sections[FS_VERTICES].count;
+   map.vertices = estructalloc(Vertex, map.numverts);
+   memcpy(map.vertices, section(FS_VERTICES), sections[FS_VERTICES].size);
+
+   MemoryInBuffer msecFile;
+   msecFile.setThrowing(true);
+   msecFile.open(section(FS_MSECTORS), sections[FS_MSECTORS].size,
+                 BufferedFileBase::LENDIAN);
+   try
+   {
+      for(uint32_t u = 0; u < sections[FS_MSECTORS].count; ++u)
+      {
+         MetaSector *msec = MetaSector::readFromFile(msecFile);
+         if(!msec)
+            FAIL();
+         map.metasectors.add(msec);
+      }
+   }
+   catch(const BufferedIOException &)
+   {
+      FAIL();
+   }
+   for(MetaSector *msec : map.metasectors)
+   {
+      if(!msec->convertIndicesToPointers())
+         FAIL();
+   }
+
+   size_t nummsecs = map.metasectors.getLength();
+   MetaSector *const *msecs = nummsecs ? &map.metasectors[0] : nullptr;
+   auto msecLink = [msecs, nummsecs](const MetaSector *&p, int32_t index) {
+      MetaSector *const *item;
+      if(!B_flatLink(item, msecs, index, nummsecs))
+         return false;
+      p = item ? *item : nullptr;
+      return true;
+   };
+
+   if(header.nullMSec != -1)
+   {
+      if(header.nullMSec < 0 || (size_t)header.nullMSec >= nummsecs)
+         FAIL();
+      map.nullMSec = msecs[header.nullMSec];
+   }
+
+   map.numlines = (int)sections[FS_LINES].count;
+   map.lines = estructalloc(Line, map.numlines);
+   const FlatLine *flines = reinterpret_cast<const FlatLine *>(section(FS_LINES));
+   for(int i = 0; i < map.numlines; ++i)
+   {
+      Line &ln = map.lines[i];
+      const FlatLine &fl = flines[i];
+      if(!B_flatLink(ln.v[0], map.vertices, fl.v[0], map.numverts) ||
+         !B_flatLink(ln.v[1], map.vertices, fl.v[1], map.numverts) ||
+         !msecLink(ln.msec[0], fl.msec[0]) || !msecLink(ln.msec[1], fl.msec[1]) ||
+         !B_flatLink(ln.specline, ::lines, fl.specline, ::numlines))
+      {
+         FAIL();
+      }
+   }
+
+   // Create all segs and subsectors first, so they can point to each other
+   uint32_t u;
+   for(u = 0; u < sections[FS_SEGS].count; ++u)
+      map.segs.addNew();
+   for(u = 0; u < sections[FS_SUBSECS].count; ++u)
+      map.ssectors.addNew();
+   Seg *segs = map.segs.getLength() ? &map.segs[0] : nullptr;
+   Subsec *ssectors = map.ssectors.getLength() ? &map.ssectors[0] : nullptr;
+   size_t numsegs = map.segs.getLength();
+   size_t numssectors = map.ssectors.getLength();
+
+   const FlatSeg *fsegs = reinterpret_cast<const FlatSeg *>(section(FS_SEGS));
+   const int32_t *blocklists = reinterpret_cast<const int32_t *>(section(FS_SEGBLOCKLISTS));
+   for(u = 0; u < numsegs; ++u)
+   {
+      Seg &sg = segs[u];
+      const FlatSeg &fs = fsegs[u];
+      if(!B_flatLink(sg.v[0], map.vertices, fs.v[0], map.numverts) ||
+         !B_flatLink(sg.v[1], map.vertices, fs.v[1], map.numverts) ||
+         !B_flatLink(sg.ln, map.lines, fs.ln, map.numlines) ||
+         !B_flatLink(sg.partner, segs, fs.partner, numsegs) ||
+         !B_flatLink(sg.owner, ssectors, fs.owner, numssectors) ||
+         !B_flatRangeValid(fs.blockFirst, fs.blockCount, sections[FS_SEGBLOCKLISTS].count))
+      {
+         FAIL();
+      }
+      sg.dx = fs.dx;
+      sg.dy = fs.dy;
+      sg.isback = fs.isback ? true : false;
+      memcpy(sg.bbox, fs.bbox, sizeof(sg.bbox));
+      sg.mid.x = fs.midx;
+      sg.mid.y = fs.midy;
+      for(int32_t j = 0; j < fs.blockCount; ++j)
+      {
+         int32_t block = blocklists[fs.blockFirst + j];
+         if(block < 0 || (uint64_t)block >= numblocks)
+            FAIL();
+      }
+      sg.blocklist = map.arena.copy<int>(blocklists + fs.blockFirst,
+                                         fs.blockCount);
+      sg.numblocks = fs.blockCount;
+   }
+
+   const FlatSubsec *fsubsecs = reinterpret_cast<const FlatSubsec *>(section(FS_SUBSECS));
+   const FlatNeigh *fneighs = reinterpret_cast<const FlatNeigh *>(section(FS_NEIGHS));
+   for(u = 0; u < numssectors; ++u)
+   {
+      Subsec &ss = ssectors[u];
+      const FlatSubsec &fss = fsubsecs[u];
+      if(!B_flatLink(ss.segs, segs, fss.segs, numsegs) ||
+         !msecLink(ss.msector, fss.msector) ||
+         !B_flatRangeValid(fss.neighFirst, fss.neighCount, sections[FS_NEIGHS].count))
+      {
+         FAIL();
+      }
+      // the segs must stay inside the array
+      if(fss.segs == -1 ? fss.nsegs != 0 :
+         !B_flatRangeValid(fss.segs, fss.nsegs, (uint32_t)numsegs))
+      {
+         FAIL();
+      }
+      ss.nsegs = fss.nsegs;
+      ss.mid.x = fss.midx;
+      ss.mid.y = fss.midy;
+      ss.neighs.resize(fss.neighCount);
+      for(int32_t j = 0; j < fss.neighCount; ++j)
+      {
+         Neigh &n = ss.neighs[j];
+         const FlatNeigh &fn = fneighs[fss.neighFirst + j];
+         if(!B_flatLink(n.otherss, ssectors, fn.otherss, numssectors) ||
+            !B_flatLink(n.myss, ssectors, fn.myss, numssectors) ||
+            !B_flatLink(n.line, map.lines, fn.line, map.numlines))
+         {
+            FAIL();
+         }
+         n.v.x = fn.vx;
+         n.v.y = fn.vy;
+         n.d.x = fn.dx;
+         n.d.y = fn.dy;
+         n.dist = fn.dist;
+      }
+   }
+
+   map.numnodes = (int)sections[FS_NODES].count;
+   map.nodes = estructalloc(Node, map.numnodes);
+   memcpy(map.nodes, section(FS_NODES), sections[FS_NODES].size);
+
+   // Children come before their parents, so the walk from the root ends
+   for(int i = 0; i < map.numnodes; ++i)
+   {
+      for(int child : map.nodes[i].child)
+      {
+         if(child & NF_SUBSECTOR ? (size_t)(child & ~NF_SUBSECTOR) >= numssectors :
+            child < 0 || child >= i)
+         {
+            FAIL();
+         }
+      }
+   }
+
+   const FlatRange *ranges = reinterpret_cast<const FlatRange *>(section(FS_SEGBLOCKS));
+   const int32_t *refs = reinterpret_cast<const int32_t *>(section(FS_SEGBLOCKREFS));
+   for(u = 0; u < sections[FS_SEGBLOCKS].count; ++u)
+   {
+      const FlatRange &range = ranges[u];
+      if(!B_flatRangeValid(range.first, range.count, sections[FS_SEGBLOCKREFS].count))
+         FAIL();
+      auto &coll = map.segBlocks.addNew();
+      coll.resize(range.count);
+      for(int32_t j = 0; j < range.count; ++j)
+      {
+         if(!B_flatLink(coll[j], segs, refs[range.first + j], numsegs))
+            FAIL();
+      }
+   }
+
+   ranges = reinterpret_cast<const FlatRange *>(section(FS_LINEBLOCKS));
+   refs = reinterpret_cast<const int32_t *>(section(FS_LINEBLOCKREFS));
+   for(u = 0; u < sections[FS_LINEBLOCKS].count; ++u)
+   {
+      const FlatRange &range = ranges[u];
+      if(!B_flatRangeValid(range.first, range.count, sections[FS_LINEBLOCKREFS].count))
+         FAIL();
+      auto &coll = map.lineBlocks.addNew();
+      coll.resize(range.count);
+      for(int32_t j = 0; j < range.count; ++j)
+      {
+         if(!B_flatLink(coll[j], map.lines, refs[range.first + j], map.numlines))
+            FAIL();
+      }
+   }
+
+#undef FAIL
+}
+
 //
 // BotMap::addCornerNeighs
 //
@@ -1207,12 +1824,15 @@ void BotMap::addCornerNeighs()
 {
     // Lists of neighbours for each subsector
     std::unordered_map<const Subsec *, std::unordered_set<const Subsec *>> ssJoinMap;
-    // List of subsectors which have received punctual neighs
-    std::unordered_map<const Subsec *, std::unordered_set<const Subsec *>> ssVisitedMap;
-    // List of subsectors going into this vertex
-    std::unordered_map<const Vertex *, std::unordered_set<Subsec *>> vertSsList;
+    // List of subsectors going into each vertex, sorted by address
+    std::vector<std::vector<Subsec *>> vertSsList(numverts);
+
+    auto addToVertex = [this, &vertSsList](const Vertex *v, Subsec *ss) {
+       if(v >= vertices && v < vertices + numverts)
+          vertSsList[v - vertices].push_back(ss);
+    };
 
-    for (const Seg& seg : segs)
+    for (Seg& seg : segs)
     {
         // Null is a valid value
         if (seg.partner)
@@ -1220,60 +1840,118 @@ void BotMap::addCornerNeighs()
             ssJoinMap[seg.owner].insert(seg.partner->owner);
             ssJoinMap[seg.partner->owner].insert(seg.owner);
 
-            vertSsList[seg.v[0]].insert(seg.partner->owner);
-            vertSsList[seg.v[1]].insert(seg.partner->owner);
+            addToVertex(seg.v[0], seg.partner->owner);
+            addToVertex(seg.v[1], seg.partner->owner);
         }
-        vertSsList[seg.v[0]].insert(seg.owner);
-        vertSsList[seg.v[1]].insert(seg.owner);
+        addToVertex(seg.v[0], seg.owner);
+        addToVertex(seg.v[1], seg.owner);
     }
 
+    auto joined = [&ssJoinMap](const Subsec *ss1, const Subsec *ss2) {
+       auto it = ssJoinMap.find(ss1);
+       return it != ssJoinMap.end() && it->second.count(ss2);
+    };
+
+    // Find the corner-only pairs on worker threads. Each worker keeps its own
+    // list, so they can be merged in vertex order.
+    struct CornerPair
+    {
+       Subsec *ss[2];
+       int vertex;
+    };
+    std::vector<std::vector<CornerPair>> found(B_WorkerCount());
+    B_ParallelFor(numverts, [&](int begin, int end, int worker) {
+       for (int i = begin; i < end; ++i)
+       {
+          std::vector<Subsec *> &ssset = vertSsList[i];
+          std::sort(ssset.begin(), ssset.end());
+          ssset.erase(std::unique(ssset.begin(), ssset.end()), ssset.end());
+          for (auto it = ssset.begin(); it != ssset.end(); ++it)
+          {
+             for (auto jt = it + 1; jt != ssset.end(); ++jt)
+             {
+                // Skip them if neighbours
+                if (joined(*it, *jt) || joined(*jt, *it))
+                   continue;
+                found[worker].push_back({ { *it, *jt }, i });
+             }
+          }
+       }
+    });
+
+    // List of subsectors which have received punctual neighs
+    std::unordered_map<const Subsec *, std::unordered_set<const Subsec *>> ssVisitedMap;
+
     Neigh n;
     n.line = nullptr;
    n.d = {};
 
-    for (int i = 0; i < numverts; ++i)
+    for (const std::vector<CornerPair> &pairs : found)
     {
-        const Vertex &v = vertices[i];
-        auto kt = vertSsList.find(&v);
-        if (kt == vertSsList.end())
-            continue;
-
-        const std::unordered_set<Subsec *> *ssset = &kt->second;
-        for (auto it = ssset->begin(); it != ssset->end(); ++it)
+        for (const CornerPair &pair : pairs)
         {
-            for (auto jt = it; jt != ssset->cend(); ++jt)
-            {
-                if (jt == it)   // hack to be able to start one step ahead
-                    continue;
-                // Skip them if neighbours
-                if (ssJoinMap[*it].count(*jt) || ssJoinMap[*jt].count(*it))
-                    continue;
-                // Add neighs, if not already
-                if (!ssVisitedMap[*it].count(*jt))
-                {
-                    ssVisitedMap[*it].insert(*jt);
-
-                    n.otherss = *jt;
-                    n.myss = *it;
-                   n.v = v2fixed_t(v);
-                    n.dist = ((*jt)->mid - n.v).sqrtabs() + (n.v - (*it)->mid).sqrtabs();
-                    (*it)->neighs.add(n);
-                }
-                if (!ssVisitedMap[*jt].count(*it))
-                {
-                    ssVisitedMap[*jt].insert(*it);
-
-                    n.otherss = *it;
-                    n.myss = *jt;
-                   n.v = v2fixed_t(v);
-                    n.dist = ((*jt)->mid - n.v).sqrtabs() + (n.v - (*it)->mid).sqrtabs();
-                    (*jt)->neighs.add(n);
-                }
-            }
+            // Add neighs, if not already
+            if (!ssVisitedMap[pair.ss[0]].insert(pair.ss[1]).second)
+                continue;
+            ssVisitedMap[pair.ss[1]].insert(pair.ss[0]);
+
+            n.v = v2fixed_t(vertices[pair.vertex]);
+            n.dist = (pair.ss[1]->mid - n.v).sqrtabs() + (n.v - pair.ss[0]->mid).sqrtabs();
+
+            n.otherss = pair.ss[1];
+            n.myss = pair.ss[0];
+            pair.ss[0]->neighs.add(n);
+
+            n.otherss = pair.ss[0];
+            n.myss = pair.ss[1];
+            pair.ss[1]->neighs.add(n);
         }
     }
 }
 
+//
+// BotMap::CacheVersion
+//
+// Identifies the format of both cache kinds, for the cache index
+//
+const char *BotMap::CacheVersion()
+{
+   static const qstring version = qstring(BOTMAP_CACHE_MAGIC) << "+" <<
+         BOTMAP_FLAT_MAGIC;
+   return version.constPtr();
+}
+
+//
+// BotMap::IsCacheFileCurrent
+//
+// Checks whether a cache file was written by this version, by looking at
+// its magic. The flat cache is recognized by its .flat extension.
+//
+bool BotMap::IsCacheFileCurrent(const char *path)
+{
+   size_t len = strlen(path);
+   if(len >= 5 && !strcasecmp(path + len - 5, ".flat"))
+   {
+      FILE *f = fopen(path, "rb");
+      if(!f)
+         return false;
+      FlatHeader header;
+      bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+            !memcmp(header.magic, BOTMAP_FLAT_MAGIC, sizeof(header.magic)) &&
+            header.endianMark == BOTMAP_FLAT_ENDIAN_MARK &&
+            header.headerSize == sizeof(FlatHeader);
+      fclose(f);
+      return valid;
+   }
+
+   GZExpansion file;
+   if(!file.openFile(path, BufferedFileBase::LENDIAN))
+      return false;
+   char magic[8];
+   return file.read(magic, sizeof(magic)) == sizeof(magic) &&
+      !memcmp(magic, BOTMAP_CACHE_MAGIC, sizeof(magic));
+}
+
 //
 // B_BuildBotMap
 //
@@ -1281,6 +1959,10 @@ void BotMap::addCornerNeighs()
 //
 void BotMap::Build()
 {
+   PROFILE_ZONE("BotMap::Build");
+
+   // A previous level may still be writing its cache
+   B_WaitAsyncWrites();
 
 	// Check for hash existence
 	char* digest = g_levelHash.digestToString();
@@ -1299,43 +1981,80 @@ void BotMap::Build()
        }
    }
 
-   B_Log("Looking for level cache %s...", hashFileName.constPtr());
-   const char* fpath = D_CheckAutoDoomPathFile(hashFileName.constPtr(), false);
+   // The flat cache is the fastest to load, so try it first
+   qstring flatFileName("botmap-");
+   flatFileName << digest << ".flat";
+   bool needFlatFile = false;
+   bool created = false;
+   if (bot_flatcache)
+   {
+       B_Log("Looking for flat level cache %s...", flatFileName.constPtr());
+       const char *flatpath = D_CheckAutoDoomPathFile(flatFileName.constPtr(), false);
+       if (flatpath)
+       {
+           {
+              PROFILE_ZONE("loadFromFlatCache");
+              BotMap::loadFromFlatCache(flatpath);
+           }
+           if (botMap)
+               botMap->changeTag(PU_LEVEL);
+       }
+       needFlatFile = !botMap;
+   }
+
+   const char* fpath = nullptr;
+   if (!botMap)
+   {
+       B_Log("Looking for level cache %s...", hashFileName.constPtr());
+       fpath = D_CheckAutoDoomPathFile(hashFileName.constPtr(), false);
+   }
 
    if (fpath)
    {
        // Try building from it
-       BotMap::loadFromCache(fpath);
+       {
+          PROFILE_ZONE("loadFromCache");
+          BotMap::loadFromCache(fpath);
+       }
        if (botMap)
            botMap->changeTag(PU_LEVEL);
    }
 
-   if (!fpath || !botMap)
+   if (!botMap)
    {
        // Create the BotMap
-       B_BEGIN_CLOCK
-           botMap = new (PU_LEVEL, nullptr) BotMap;
-       B_MEASURE_CLOCK(newBotMap)
+       {
+          PROFILE_ZONE("newBotMap");
+          botMap = new (PU_LEVEL, nullptr) BotMap;
+       }
 
        fixed_t radius = mobjinfo[players[consoleplayer].pclass->type]->radius;
        botMap->radius = radius;
 
        // Create blockmap
-       B_NEW_CLOCK
-       botMap->createBlockMap();
-       B_MEASURE_CLOCK(createBlockMap)
+       {
+          PROFILE_ZONE("createBlockMap");
+          botMap->createBlockMap();
+       }
 
 	   B_Log("Level cache not found or invalid");
 	   B_buildTempBotMapFromScratch(radius, digest);
-       B_NEW_CLOCK
-       botMap->addCornerNeighs();
-       B_MEASURE_CLOCK(addCornerNeighs)
+       {
+          PROFILE_ZONE("addCornerNeighs");
+          botMap->addCornerNeighs();
+       }
        botMap->cacheToFile(M_SafeFilePath(g_autoDoomPath, hashFileName.constPtr()));
+       created = true;
    }
+   if (needFlatFile)
+   {
+       botMap->cacheToFlatFile(M_SafeFilePath(g_autoDoomPath, flatFileName.constPtr()));
+       created = true;
+   }
+   B_CacheTouch(digest, gamemapname, created);
    efree(digest);
 
-   // init validstuff
-   VALID_ALLOC(botMap->validLines, botMap->numlines);
+   botMap->ssContents.init((int)botMap->ssectors.getLength());
 
    // Place all mobjs on it
    B_setMobjPositions();
@@ -1345,7 +2064,13 @@ void BotMap::Build()
 
    // Find all doors
    botMap->getDoorSectors();
+
+   // Group the subsectors for path finding
+   botMap->clusters = new ClusterGraph(*botMap);
+   botMap->flowFields = new FlowFields(*botMap);
 }
 
-// EOF
+VARIABLE_TOGGLE(bot_flatcache, nullptr, onoff);
+CONSOLE_VARIABLE(bot_flatcache, bot_flatcache, 0) {}
 
+// EOF
@@ -35,8 +35,11 @@
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "b_arena.h"
 #include "b_msector.h"
+#include "b_substore.h"
 #include "b_util.h"
 #include "../e_rtti.h"
 #include "../m_collection.h"
@@ -44,6 +47,7 @@
 #include "../m_fixed.h"
 #include "../m_vector.h"
 #include "../p_map3d.h"
+#include "../p_maputl.h"
 #include "../r_defs.h"
 
 #define BOTMAPBLOCKUNITS 128
@@ -55,6 +59,9 @@
 typedef std::unordered_set<int> IntOSet;
 //typedef std::set<int> IntOSet;
 
+class ClusterGraph;
+class FlowFields;
+
 //
 // BotMap
 //
@@ -107,7 +114,8 @@ public:
       v2fixed_t mid;       // middle
       Subsec *owner; // subsector of this seg
       
-      PODCollection<int> blocklist; // list of touching map blocks
+      const int *blocklist;   // list of touching map blocks, in the arena
+      int numblocks;
    };
    Collection<Seg> segs;
 
@@ -142,8 +150,6 @@ public:
       Seg *segs;
       const MetaSector *msector;
       int nsegs;
-      std::unordered_set<const Mobj *> mobjlist;
-      std::unordered_map<const line_t *, v2fixed_t> linelist;
       v2fixed_t mid;
       // Fast neighbour lookup
       PODCollection<Neigh> neighs;
@@ -173,12 +179,21 @@ public:
    // level blockmap
    fixed_t bMapOrgX = 0, bMapOrgY = 0;
    int bMapWidth = 0, bMapHeight = 0;
+   BotArena arena;   // small per-item lists, freed along with the map
+
    Collection<PODCollection<Seg *> > segBlocks;
    Collection<PODCollection<Line *> > lineBlocks;
    fixed_t radius;
    
-   std::unordered_map<const Mobj *, PODCollection<Subsec *> >
-   mobjSecMap;
+   // Mobjs and trigger lines of each subsector
+   SubsecStore ssContents;
+
+   // Coarse graph for hierarchical path finding. Built after the mobjs and
+   // special lines are set.
+   ClusterGraph *clusters = nullptr;
+
+   // Ways to the nearest items, shared by all bots
+   FlowFields *flowFields = nullptr;
    
    //
    // Constructor
@@ -194,6 +209,8 @@ public:
       protoSeg.partner = NULL;
       protoSeg.mid.x = protoSeg.mid.y = 0;
       protoSeg.owner = NULL;
+      protoSeg.blocklist = NULL;
+      protoSeg.numblocks = 0;
       segs.setPrototype(&protoSeg);
       
       static Subsec protoSubsec;
@@ -212,19 +229,7 @@ public:
    // Destructor
    //
 	
-   ~BotMap()
-   {
-      efree(vertices);
-      efree(lines);
-      efree(nodes);
-
-      delete[] sectorFlags;
-
-      VALID_FREE(validLines);
-    
-      clearMsecList();
-      
-   }
+   ~BotMap();
    
    void *operator new(size_t size, int tag, BotMap **user);
    void operator delete (void *p);
@@ -234,6 +239,10 @@ public:
    
    int pointOnSide(v2fixed_t pos, const Node &node) const;
    Subsec &pointInSubsector(v2fixed_t pos) const;
+   template<typename F> void getTouchedBlocks(v2fixed_t v1, v2fixed_t v2, F &&func) const;
+   template<typename F> void getBoxTouchedBlocks(fixed_t top, fixed_t bottom,
+                                                 fixed_t left, fixed_t right,
+                                                 F &&func) const;
    void getTouchedBlocks(v2fixed_t v1, v2fixed_t v2, const std::function<void(int)> &func) const;
    void getBoxTouchedBlocks(fixed_t top, fixed_t bottom, fixed_t left, fixed_t right,
                             const std::function<void(int)> &func) const;
@@ -246,6 +255,18 @@ public:
    {
       return getBlockCoords(v.x, v.y);
    }
+   int ssIndex(const Subsec &ss) const
+   {
+      return (int)(&ss - ssectors.begin());
+   }
+   SubsecStore::Range<const Mobj *> mobjsIn(const Subsec &ss) const
+   {
+      return ssContents.mobjs(ssIndex(ss));
+   }
+   SubsecStore::Range<const line_t *> linesIn(const Subsec &ss) const
+   {
+      return ssContents.lines(ssIndex(ss));
+   }
    void unsetThingPosition(const Mobj *thing);
    void setThingPosition(const Mobj *thing);
    
@@ -253,8 +274,12 @@ public:
    bool canPass(const Subsec &s1, const Subsec &s2, fixed_t height) const;
    bool canPassNow(const MetaSector *s1, const MetaSector *s2, fixed_t height) const;
    bool canPassNow(const Subsec &s1, const Subsec &s2, fixed_t height) const;
+   void invalidatePassability();
+   void sectorMoved(const sector_t &sector, fixed_t oldfloor, fixed_t oldceiling);
    
    static void Build(); // The entry point from P_SetupLevel
+   static const char *CacheVersion();
+   static bool IsCacheFileCurrent(const char *path);
    
    static bool demoPlayingFlag;
    // if playing, this flag will be true during P_SetupLevel
@@ -275,10 +300,35 @@ public:
    };
    SectorTrait* sectorFlags = nullptr;
    
+   //
+   // Line crossed by a trace
+   //
+   struct Intercept
+   {
+      fixed_t frac;
+      const Line *line;
+   };
+
    // Defined in b_trace.cpp
+   const std::vector<Intercept> &collectIntercepts(divline_t &trace) const;
    bool pathTraverse(divline_t trace,
                      const std::function<bool(const Line&, const divline_t &, fixed_t)> &lineHit) const;
 
+   //
+   // Calls lineHit(line, trace, frac) for each line crossed by the trace,
+   // nearest first, until it returns false. lineHit must not start another
+   // traversal.
+   //
+   template<typename F> bool pathTraverse(divline_t trace, F &&lineHit) const
+   {
+      for(const Intercept &in : collectIntercepts(trace))
+      {
+         if(!lineHit(*in.line, static_cast<const divline_t &>(trace), in.frac))
+            return false;
+      }
+      return true;
+   }
+
 private:
     // Post-processing
     void getDoorSectors();
@@ -288,12 +338,13 @@ private:
 
     void cacheToFile(const char* path) const;
     static void loadFromCache(const char* path);
+    void cacheToFlatFile(const char *path) const;
+    static void loadFromFlatCache(const char *path);
 
    // Defined in b_trace.cpp
    bool blockLinesIterator(int x, int y,
                            bool lineHit(const Line &line, void *context),
                            void *context) const;
-   byte *validLines = nullptr;
 
    void clearMsecList()
 	{
@@ -310,6 +361,95 @@ private:
 };
 extern BotMap *botMap;
 
+//
+// BotMap::getTouchedBlocks
+//
+// Calls func for each block the line touches, code from P_Setup.cpp,
+// P_CreateBlockmap
+//
+template<typename F>
+void BotMap::getTouchedBlocks(v2fixed_t v1, v2fixed_t v2, F &&func) const
+{
+   fixed_t minx = bMapOrgX >> FRACBITS;
+   fixed_t miny = bMapOrgY >> FRACBITS;
+   unsigned tot = bMapWidth * bMapHeight;
+   int x = (v1.x >> FRACBITS) - minx;
+   int y = (v1.y >> FRACBITS) - miny;
+   
+   // x-y deltas
+   int adx = (v2.x - v1.x) >> FRACBITS, dx = adx < 0 ? -1 : 1;
+   int ady = (v2.y - v1.y) >> FRACBITS, dy = ady < 0 ? -1 : 1;
+   
+   // difference in preferring to move across y (>0)
+   // instead of x (<0)
+   int diff = !adx ? 1 : !ady ? -1 :
+   (((x / BOTMAPBLOCKUNITS) * BOTMAPBLOCKUNITS) +
+    (dx > 0 ? BOTMAPBLOCKUNITS-1 : 0) - x) * (ady = D_abs(ady)) * dx -
+   (((y / BOTMAPBLOCKUNITS) * BOTMAPBLOCKUNITS) +
+    (dy > 0 ? BOTMAPBLOCKUNITS-1 : 0) - y) * (adx = D_abs(adx)) * dy;
+   
+   // starting block, and pointer to its blocklist structure
+   int b = (y / BOTMAPBLOCKUNITS) * bMapWidth + (x / BOTMAPBLOCKUNITS);
+   
+   // ending block
+   int bend = (((v2.y >> FRACBITS) - miny) / BOTMAPBLOCKUNITS) *
+   bMapWidth + (((v2.x >> FRACBITS) - minx) / BOTMAPBLOCKUNITS);
+   
+   // delta for pointer when moving across y
+   dy *= bMapWidth;
+   
+   // deltas for diff inside the loop
+   adx *= BOTMAPBLOCKUNITS;
+   ady *= BOTMAPBLOCKUNITS;
+   
+   // Now we simply iterate block-by-block until we reach the end block.
+   while((unsigned int) b < tot)    // failsafe -- should ALWAYS be true
+   {
+      func(b);
+      
+      // If we have reached the last block, exit
+      if(b == bend)
+         break;
+      
+      // Move in either the x or y direction to the next block
+      if(diff < 0)
+      {
+         diff += ady;
+         b += dx;
+      }
+      else
+      {
+         diff -= adx;
+         b += dy;
+      }
+   }
+}
+
+//
+// BotMap::getBoxTouchedBlocks
+//
+// Calls func for each block touched by a rectangular box
+//
+template<typename F>
+void BotMap::getBoxTouchedBlocks(fixed_t top, fixed_t bottom,
+                                 fixed_t left, fixed_t right, F &&func) const
+{
+   int xl, xh, yl, yh, bx, by;
+   
+   xl = (left - bMapOrgX) / BOTMAPBLOCKSIZE;
+   xh = (right - bMapOrgX) / BOTMAPBLOCKSIZE;
+   yl = (bottom - bMapOrgY) / BOTMAPBLOCKSIZE;
+   yh = (top - bMapOrgY) / BOTMAPBLOCKSIZE;
+   
+   for (bx = xl; bx <= xh; ++bx)
+   {
+      for (by = yl; by <= yh; ++by)
+      {
+         func(bx + by * bMapWidth);
+      }
+   }
+}
+
 typedef BotMap::Subsec  BSubsec;
 typedef BotMap::Seg     BSeg;
 typedef BotMap::Neigh   BNeigh;
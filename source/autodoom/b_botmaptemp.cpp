@@ -36,6 +36,7 @@
 #include "../ev_specials.h"
 #include "../m_buffer.h"
 #include "../m_compare.h"
+#include "../m_profile.h"
 #include "../p_info.h"
 #include "../p_maputl.h"
 #include "../p_setup.h"
@@ -585,7 +586,7 @@ void TempBotMapPImpl::placeMSecLines()
 {
    int numms = (int)rawMSectors.getLength();
 
-   IntOSet simpleSet;
+   MSecIndexSet simpleSet;
    TempBotMap::Vertex *v = NULL, *oldv = NULL, *firstv = NULL;
 
    V_SetLoading(numms, "Bot lines");
@@ -699,7 +700,8 @@ void TempBotMapPImpl::fillMSecRefs()
 //
 // Deletes a line, cleaning everything up
 //
-void TempBotMap::deleteLine(Line *ln, IntOSet *targfront, IntOSet *targback)
+void TempBotMap::deleteLine(Line *ln, MSecIndexSet *targfront,
+                            MSecIndexSet *targback)
 {
    // erase line from all its links
    int i;
@@ -725,7 +727,7 @@ void TempBotMap::deleteLine(Line *ln, IntOSet *targfront, IntOSet *targback)
       *targfront = std::move(ln->msecIndices[0]);
    if(targback)
       *targback = std::move(ln->msecIndices[1]);
-   delete ln;
+   ln->~Line();   // the memory stays in the arena
 }
 
 //
@@ -734,7 +736,8 @@ void TempBotMap::deleteLine(Line *ln, IntOSet *targfront, IntOSet *targback)
 // Places a line, making sure it fits with what's already there
 //
 TempBotMap::Line &TempBotMap::placeLine(Vertex &v1, Vertex &v2, const line_t* assocLine,
-                                const IntOSet *msecGen, const IntOSet *bsecGen)
+                                const MSecIndexSet *msecGen,
+                                const MSecIndexSet *bsecGen)
 {
    // What can happen?
    // -- a line already exists between v1 and v2: just return that line
@@ -894,9 +897,7 @@ TempBotMap::Line &TempBotMap::placeLine(Vertex &v1, Vertex &v2, const line_t* as
       }
    }
 
-   Line *ln = new Line;
-   
-//   Line *ln = estructalloc(Line, 1);
+   Line *ln = arena.make<Line>();
    ln->v1 = &v1;
    ln->v2 = &v2;
    ln->metasec[0] = NULL;
@@ -1006,14 +1007,14 @@ TempBotMap::Vertex &TempBotMap::placeVertex(fixed_t x, fixed_t y)
             FixedMul64(y - ln.v1->y, ln.v2->y - y) > 0)
          {
             // inside the segment. Split it.
-            Vertex *vert = estructalloc(Vertex, 1);
+            Vertex *vert = arena.make<Vertex>();
             vert->x = x;
             vert->y = y;
             vert->blockIndex = b;
             vert->degree = 0;
             Vertex &ov1 = *ln.v1, &ov2 = *ln.v2;
             
-            IntOSet front, back;
+            MSecIndexSet front, back;
             const line_t* assocLine = ln.assocLine;
             deleteLine(&ln, &front, &back);
             vertexList.insert(vert);
@@ -1025,7 +1026,7 @@ TempBotMap::Vertex &TempBotMap::placeVertex(fixed_t x, fixed_t y)
          }
       }
    }
-   Vertex *vert = estructalloc(Vertex, 1);
+   Vertex *vert = arena.make<Vertex>();
    vert->x = x;
    vert->y = y;
    vert->blockIndex = b;
@@ -1181,7 +1182,7 @@ void TempBotMap::obtainMetaSectors()
    //
    struct MSecSetHash
    {
-      size_t operator()(const IntOSet *st) const
+      size_t operator()(const MSecIndexSet *st) const
       {
          size_t h = 0;
          
@@ -1194,12 +1195,13 @@ void TempBotMap::obtainMetaSectors()
    };
    struct MSecSetPred
    {
-      bool operator()(const IntOSet *st1, const IntOSet *st2) const
+      bool operator()(const MSecIndexSet *st1, const MSecIndexSet *st2) const
       {
          return *st1 == *st2;
       }
    };
-   std::unordered_map<IntOSet *, MetaSector *, MSecSetHash, MSecSetPred>
+   std::unordered_map<const MSecIndexSet *, MetaSector *, MSecSetHash,
+   MSecSetPred>
    mSecMap;
 
    //
@@ -1597,7 +1599,7 @@ void TempBotMap::clearUnusedVertices()
       {
          vertexList.remove(*item);
          vertexBMap[item->dllObject->blockIndex].remove(*item);
-         efree(*item);
+         // the memory stays in the arena
       }
    }
 }
@@ -1616,7 +1618,7 @@ lineListSize()
 
    pimpl = new TempBotMapPImpl(this);
    
-   static LinePtrSet lineBMapProto;
+   static LineBlock lineBMapProto;
    lineBMap.setPrototype(&lineBMapProto);
 }
 
@@ -1627,20 +1629,14 @@ lineListSize()
 //
 TempBotMap::~TempBotMap()
 {
-   {
-      DLListItem<Vertex> *item, *next;
-      for (item = vertexList.head; item != nullptr; item = next)
-      {
-         next = item->dllNext;
-         efree(item->dllObject);
-      }
-   }
+   // Vertices and lines are freed with the arena. Only the line sets which
+   // outgrew their inline room need their destructors.
    {
       DLListItem<Line> *item, *next;
       for (item = lineList.head; item != nullptr; item = next)
       {
          next = item->dllNext;
-         delete item->dllObject;
+         item->dllObject->~Line();
       }
    }
    {
@@ -1669,46 +1665,56 @@ void TempBotMap::generateForRadius(fixed_t inradius)
    generated = true;
    radius = inradius;//-0x4000;// 0.25 = 0000 0000 0000 0000 0100 0000 0000 0000
    
-   B_BEGIN_CLOCK
-   pimpl->getBSPLines();
-   B_MEASURE_CLOCK(getBSPLines)
+   {
+      PROFILE_ZONE("getBSPLines");
+      pimpl->getBSPLines();
+   }
    
-   B_NEW_CLOCK
-   pimpl->getLineMSectors();
-   B_MEASURE_CLOCK(getLineMSectors)
+   {
+      PROFILE_ZONE("getLineMSectors");
+      pimpl->getLineMSectors();
+   }
    
-   B_NEW_CLOCK
-   pimpl->getThingMSectors();
-   B_MEASURE_CLOCK(getThingMSectors)
+   {
+      PROFILE_ZONE("getThingMSectors");
+      pimpl->getThingMSectors();
+   }
 
 
-   B_NEW_CLOCK
-   createBlockMap();	// the tempbotmap part, derived from BotMap
-   B_MEASURE_CLOCK(createBlockMap)
+   {
+      PROFILE_ZONE("createBlockMap");
+      createBlockMap();	// the tempbotmap part, derived from BotMap
+   }
    
-   B_NEW_CLOCK
-   pimpl->placeBSPLines();
-   B_MEASURE_CLOCK(placeBSPLines)
+   {
+      PROFILE_ZONE("placeBSPLines");
+      pimpl->placeBSPLines();
+   }
    
-   B_NEW_CLOCK
-   pimpl->placeMSecLines();
-   B_MEASURE_CLOCK(placeMSecLines)
+   {
+      PROFILE_ZONE("placeMSecLines");
+      pimpl->placeMSecLines();
+   }
 
-   B_NEW_CLOCK
-   pimpl->fillMSecRefs();
-   B_MEASURE_CLOCK(fillMSecRefs)
+   {
+      PROFILE_ZONE("fillMSecRefs");
+      pimpl->fillMSecRefs();
+   }
 
-   B_NEW_CLOCK
-   obtainMetaSectors();
-   B_MEASURE_CLOCK(obtainMetaSectors)
+   {
+      PROFILE_ZONE("obtainMetaSectors");
+      obtainMetaSectors();
+   }
    
-   B_NEW_CLOCK
-   clearRedundantLines();
-   B_MEASURE_CLOCK(clearRedundantLines)
+   {
+      PROFILE_ZONE("clearRedundantLines");
+      clearRedundantLines();
+   }
    
-   B_NEW_CLOCK
-   clearUnusedVertices();
-   B_MEASURE_CLOCK(clearUnusedVertices)
+   {
+      PROFILE_ZONE("clearUnusedVertices");
+      clearUnusedVertices();
+   }
    
 //   checkVertices();
 //   checkLines();
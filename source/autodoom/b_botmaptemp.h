@@ -32,6 +32,7 @@
 #include <unordered_set>
 #include <set>
 
+#include "b_arena.h"
 #include "b_msector.h"
 #include "../m_collection.h"
 #include "../m_dllist.h"
@@ -39,6 +40,7 @@
 
 typedef std::unordered_set<int> IntOSet;
 //typedef std::set<int> IntOSet;
+typedef FlatSet<int, 2> MSecIndexSet;
 
 class OutBuffer;
 
@@ -71,19 +73,21 @@ public:
    //
    // Line
    //
-   // A line of the map
+   // A line of the map. Lives in the arena, so its destructor must be called
+   // explicitly.
    //
-   class Line : public ZoneObject
+   class Line
    {
    public:
       DLListItem<Line> listLink;
       Vertex *v1, *v2;        // end points
       PODCollection<int> blockIndices; // blockmap links
-      IntOSet msecIndices[2];  // metasector links
+      MSecIndexSet msecIndices[2];  // metasector links
       MetaSector *metasec[2];
       const line_t* assocLine;
    };
    typedef std::unordered_set<Line *> LinePtrSet;
+   typedef FlatSet<Line *, 8> LineBlock;
 private:
    
    //
@@ -92,12 +96,14 @@ private:
    
    bool generated;   // initialization flag
    fixed_t radius;   // reduction radius
+
+   BotArena arena;   // vertices and lines, all freed along with the map
    
    DLList<Vertex, &Vertex::listLink> vertexList;
    DLList<Vertex, &Vertex::blockLink> *vertexBMap;
    DLList<Line, &Line::listLink> lineList;
    int lineListSize;
-   Collection<LinePtrSet > lineBMap;
+   Collection<LineBlock> lineBMap;
    DLList<MetaSector, &MetaSector::listLink> msecList;
    
    //
@@ -107,10 +113,10 @@ private:
    void createBlockMap();
    
    void deleteVertex(Vertex *vert);
-   void deleteLine(Line *ln, IntOSet *targfront, IntOSet *targback);
+   void deleteLine(Line *ln, MSecIndexSet *targfront, MSecIndexSet *targback);
    Line &placeLine(Vertex &v1, Vertex &v2, const line_t* assocLine = nullptr,
-                   const IntOSet *msecGen = nullptr,
-                   const IntOSet *bsecGen = nullptr);
+                   const MSecIndexSet *msecGen = nullptr,
+                   const MSecIndexSet *bsecGen = nullptr);
    
    void obtainMetaSectors();
    
@@ -131,6 +137,7 @@ public:
    const DLListItem<Line> *lineGet() const {return lineList.head;}
    const DLListItem<Vertex> *vertGet() const {return vertexList.head;}
    const DLListItem<MetaSector> *msecGet() const {return msecList.head;}
+   size_t arenaSize() const {return arena.getReserved();}
    template <typename T> void setItemIndex(int dat, T *obj)
    {
       obj->listLink.dllData = dat;
@@ -0,0 +1,714 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Bot map cache precomputation and housekeeping.
+//
+//      -botcache builds the bot map caches of all maps in the loaded wads,
+//      without entering the game. The level hash naming each cache is only
+//      known once the level is set up, so just like -botbench it runs a copy
+//      of the program for each map, with the same arguments plus
+//      -botcacheworker. Each worker sets up its map, which loads or builds
+//      the cache, reports the level hash and quits. The bot_buildcaches
+//      console command does the same in the background.
+//
+//      Coordinator options:
+//      -botcachejobs <n>    number of workers running at once (default: CPUs)
+//
+//      The caches are listed in an index file, with the time of their last
+//      use. Along with the caches built by workers it keeps a fingerprint of
+//      the map lumps and of the loaded wads, so later runs only start workers
+//      for the maps whose cache is missing or out of date. Caches written by other versions are deleted, and so are the
+//      least recently used ones while all take more than bot_cachesize
+//      megabytes.
+//
+//-----------------------------------------------------------------------------
+
+#if __cplusplus >= 201703L || _MSC_VER >= 1914
+#include "../hal/i_platform.h"
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_MACOSX
+#include "../hal/i_directory.h"
+namespace fs = fsStopgap;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+#include "../z_zone.h"
+
+#include "b_botmap.h"
+#include "b_cachegen.h"
+#include "b_compression.h"
+#include "b_util.h"
+#include "../c_io.h"
+#include "../c_runcmd.h"
+#include "../doomdata.h"
+#include "../doomstat.h"
+#include "../m_argv.h"
+#include "../m_hash.h"
+#include "../p_setup.h"
+#include "../w_levels.h"
+#include "../w_wad.h"
+
+// Size limit of all bot map caches in megabytes (0 = no limit)
+int bot_cachesize = 1024;
+
+static const char CACHE_PREFIX[] = "botmap-";
+static const char CACHE_INDEX[] = "botmap-index.txt";
+
+//
+// One map whose cache is wanted. Also used by coordinator threads, so it
+// must stay off the zone heap.
+//
+struct cachejob_t
+{
+   std::string map;
+   std::string resultfile;
+   std::string source;     // fingerprint of the map lumps and loaded wads
+   std::string digest;     // level hash reported by the worker
+   int         exitcode;
+};
+
+//
+// Generation run in the background from the console
+//
+struct cacherun_t
+{
+   std::vector<cachejob_t> jobs;
+   std::atomic<bool>       done { false };
+};
+
+static std::shared_ptr<cacherun_t> background;
+
+//
+// Index entry of a cache
+//
+struct cacheentry_t
+{
+   long long   lastused;   // time()
+   std::string version;    // BotMap::CacheVersion when last used
+   std::string map;
+   std::string source;     // cachejob_t::source, if built by a worker
+};
+
+typedef std::map<std::string, cacheentry_t> cacheindex_t;
+
+//
+// B_cachePath
+//
+static std::string B_cachePath(const char *name)
+{
+   return std::string(g_autoDoomPath) + "/" + name;
+}
+
+//=============================================================================
+//
+// Index and housekeeping
+//
+
+//
+// B_loadCacheIndex
+//
+static void B_loadCacheIndex(cacheindex_t &index)
+{
+   FILE *f = fopen(B_cachePath(CACHE_INDEX).c_str(), "r");
+   if(!f)
+      return;
+
+   char line[256];
+   while(fgets(line, sizeof(line), f))
+   {
+      char digest[64], version[32], map[16], source[64];
+      long long lastused;
+      int fields;
+      if(line[0] == '#' ||
+         (fields = sscanf(line, "%63s %lld %31s %15s %63s", digest, &lastused,
+                          version, map, source)) < 4)
+      {
+         continue;
+      }
+      // Older indices have no fingerprint
+      index[digest] = { lastused, version, map,
+                        fields == 5 && strcmp(source, "-") ? source : "" };
+   }
+   fclose(f);
+}
+
+//
+// B_saveCacheIndex
+//
+static void B_saveCacheIndex(const cacheindex_t &index)
+{
+   FILE *f = fopen(B_cachePath(CACHE_INDEX).c_str(), "w");
+   if(!f)
+   {
+      B_Log("Couldn't write the bot map cache index");
+      return;
+   }
+   fputs("# level hash, last use time, cache version, map, map fingerprint\n", f);
+   for(const auto &item : index)
+   {
+      const cacheentry_t &entry = item.second;
+      fprintf(f, "%s %lld %s %s %s\n", item.first.c_str(), entry.lastused,
+              entry.version.c_str(), entry.map.c_str(),
+              entry.source.empty() ? "-" : entry.source.c_str());
+   }
+   fclose(f);
+}
+
+//
+// Cache files of one level hash
+//
+struct cachefiles_t
+{
+   std::vector<std::string> paths;
+   uintmax_t                size = 0;
+};
+
+//
+// B_removeCacheFiles
+//
+static void B_removeCacheFiles(const cachefiles_t &files)
+{
+   for(const std::string &path : files.paths)
+   {
+      B_Log("Removing bot map cache %s", path.c_str());
+      remove(path.c_str());
+   }
+}
+
+//
+// B_cacheHousekeeping
+//
+// Matches the index with the cache folder. Caches from other versions are
+// deleted, then the least recently used ones until within bot_cachesize.
+// The keep cache is spared, as it may be still being written.
+//
+static void B_cacheHousekeeping(cacheindex_t &index, const char *keep)
+{
+   const char *version = BotMap::CacheVersion();
+   const size_t prefixlen = sizeof(CACHE_PREFIX) - 1;
+
+   std::map<std::string, cachefiles_t> found;
+   const fs::directory_entry folder(g_autoDoomPath);
+   if(!folder.exists() || !folder.is_directory())
+      return;
+   const fs::directory_iterator itr(folder);
+   for(const fs::directory_entry &ent : itr)
+   {
+      if(ent.is_directory())
+         continue;
+      std::string name = ent.path().filename().generic_u8string();
+      if(name.compare(0, prefixlen, CACHE_PREFIX))
+         continue;
+      size_t dot = name.find('.', prefixlen);
+      if(dot == std::string::npos)
+         continue;
+      std::string extension = name.substr(dot);
+      if(extension != ".cache.gz" && extension != ".flat")
+         continue;
+
+      cachefiles_t &files = found[name.substr(prefixlen, dot - prefixlen)];
+      files.paths.push_back(ent.path().generic_u8string());
+      files.size += ent.file_size();
+   }
+
+   long long now = (long long)time(nullptr);
+   uintmax_t total = 0;
+   for(auto it = found.begin(); it != found.end();)
+   {
+      auto entry = index.find(it->first);
+      if(it->first != (keep ? keep : "") &&
+         (entry == index.end() || entry->second.version != version))
+      {
+         // Check the files themselves
+         cachefiles_t &files = it->second;
+         for(auto path = files.paths.begin(); path != files.paths.end();)
+         {
+            if(BotMap::IsCacheFileCurrent(path->c_str()))
+            {
+               ++path;
+               continue;
+            }
+            B_Log("Removing stale bot map cache %s", path->c_str());
+            files.size -= fs::directory_entry(path->c_str()).file_size();
+            remove(path->c_str());
+            path = files.paths.erase(path);
+         }
+         if(files.paths.empty())
+         {
+            it = found.erase(it);
+            continue;
+         }
+         // Caches not in the index were probably just built by workers
+         if(entry == index.end())
+            index[it->first] = { now, version, "-", "" };
+         else
+            entry->second.version = version;
+      }
+      total += it->second.size;
+      ++it;
+   }
+
+   // Forget the caches which were deleted
+   for(auto it = index.begin(); it != index.end();)
+   {
+      if(!found.count(it->first) && it->first != (keep ? keep : ""))
+         it = index.erase(it);
+      else
+         ++it;
+   }
+
+   if(bot_cachesize <= 0)
+      return;
+   uintmax_t limit = (uintmax_t)bot_cachesize << 20;
+   if(total <= limit)
+      return;
+
+   std::vector<const std::string *> order;
+   for(const auto &item : index)
+      order.push_back(&item.first);
+   std::sort(order.begin(), order.end(),
+             [&index](const std::string *a, const std::string *b) {
+      return index[*a].lastused < index[*b].lastused;
+   });
+
+   std::vector<std::string> evicted;
+   for(const std::string *digest : order)
+   {
+      if(total <= limit)
+         break;
+      if(keep && *digest == keep)
+         continue;
+      auto files = found.find(*digest);
+      if(files == found.end())
+         continue;
+      B_removeCacheFiles(files->second);
+      total -= files->second.size;
+      evicted.push_back(*digest);
+   }
+   for(const std::string &digest : evicted)
+      index.erase(digest);
+}
+
+//
+// B_CacheTouch
+//
+// Called when a level got its bot map, which either came from the cache or
+// was just stored to it. Newly stored caches may push out old ones.
+//
+void B_CacheTouch(const char *digest, const char *mapname, bool created)
+{
+   // Workers run in parallel, so their coordinator does it for them
+   if(B_CacheGenWorkerMap())
+      return;
+
+   cacheindex_t index;
+   B_loadCacheIndex(index);
+   cacheentry_t &entry = index[digest];
+   entry.lastused = (long long)time(nullptr);
+   entry.version = BotMap::CacheVersion();
+   entry.map = mapname;
+   if(created)
+      B_cacheHousekeeping(index, digest);
+   B_saveCacheIndex(index);
+}
+
+//=============================================================================
+//
+// Worker
+//
+
+//
+// B_CacheGenWorkerMap
+//
+// The map set up by this worker, or nullptr if not a worker
+//
+const char *B_CacheGenWorkerMap()
+{
+   int p = M_CheckParm("-botcacheworker");
+   return p && p < myargc - 2 ? myargv[p + 1] : nullptr;
+}
+
+//
+// B_cacheWorkerFinish
+//
+// Reports the level hash and quits the worker
+//
+static void B_cacheWorkerFinish()
+{
+   // The compressed cache is written by another thread
+   B_WaitAsyncWrites();
+
+   FILE *f = fopen(myargv[M_CheckParm("-botcacheworker") + 2], "w");
+   if(f)
+   {
+      char *digest = g_levelHash.digestToString();
+      fprintf(f, "%s\n", digest);
+      efree(digest);
+      fclose(f);
+   }
+
+   // Leave right away, without saving the shared configuration files
+   fflush(nullptr);
+   _Exit(f ? 0 : 1);
+}
+
+//=============================================================================
+//
+// Coordinator
+//
+
+//
+// B_wadsFingerprint
+//
+// Hashes the name and size of every lump, so the level hashes found by the
+// workers are only trusted with the same wads loaded. Thing definitions and
+// such also go into the level hash.
+//
+static void B_wadsFingerprint(HashData &hash)
+{
+   const int numlumps = wGlobalDir.getNumLumps();
+   lumpinfo_t **lumpinfo = wGlobalDir.getLumpInfo();
+   for(int i = 0; i < numlumps; ++i)
+   {
+      uint32_t size = (uint32_t)lumpinfo[i]->size;
+      hash.addData(reinterpret_cast<const uint8_t *>(lumpinfo[i]->name), 8);
+      hash.addData(reinterpret_cast<const uint8_t *>(&size), sizeof(size));
+   }
+}
+
+//
+// B_mapFingerprint
+//
+// Fingerprint of a map: the loaded wads plus the contents of its lumps. A
+// few lumps past a binary map may be included, which only means rebuilding
+// more often.
+//
+static std::string B_mapFingerprint(const wadlevel_t &level, const HashData &wads)
+{
+   const WadDirectory &dir = *level.dir;
+   const int numlumps = dir.getNumLumps();
+   lumpinfo_t **lumpinfo = dir.getLumpInfo();
+
+   bool udmf;
+   P_CheckLevel(&dir, level.lumpnum, nullptr, &udmf);
+   int last = std::min(level.lumpnum + ML_BEHAVIOR, numlumps - 1);
+   if(udmf)
+   {
+      for(last = level.lumpnum + 1; last < numlumps - 1; ++last)
+         if(!strncmp(lumpinfo[last]->name, "ENDMAP", 8))
+            break;
+   }
+
+   HashData hash(wads);
+   hash.addData(reinterpret_cast<const uint8_t *>(level.header),
+                (uint32_t)strlen(level.header));
+   for(int i = level.lumpnum + 1; i <= last; ++i)
+   {
+      hash.addData(reinterpret_cast<const uint8_t *>(lumpinfo[i]->name), 8);
+      if(!lumpinfo[i]->size)
+         continue;
+      WadLumpView view(dir, i, false);
+      hash.addData(view.getAs<uint8_t>(), (uint32_t)lumpinfo[i]->size);
+   }
+   hash.wrapUp();
+
+   char *digest = hash.digestToString();
+   std::string result(digest);
+   efree(digest);
+   return result;
+}
+
+//
+// B_isCacheCurrent
+//
+// True if the index has a current cache built from this map fingerprint
+//
+static bool B_isCacheCurrent(const cacheindex_t &index, const std::string &source)
+{
+   const char *version = BotMap::CacheVersion();
+   for(const auto &item : index)
+   {
+      if(item.second.source != source || item.second.version != version)
+         continue;
+      std::string path = B_cachePath(CACHE_PREFIX) + item.first;
+      if(BotMap::IsCacheFileCurrent((path + ".cache.gz").c_str()) ||
+         BotMap::IsCacheFileCurrent((path + ".flat").c_str()))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+//
+// B_collectMaps
+//
+// Makes a job for each map of the loaded wads whose cache is missing or out
+// of date. Returns the number of maps which already have it.
+//
+static int B_collectMaps(std::vector<cachejob_t> &jobs)
+{
+   cacheindex_t index;
+   B_loadCacheIndex(index);
+
+   HashData wads(HashData::SHA1);
+   B_wadsFingerprint(wads);
+
+   int current = 0;
+   std::string lastmap;
+   wadlevel_t *levels = W_FindAllMapsInLevelWad(&wGlobalDir);
+   for(const wadlevel_t *level = levels; level->header[0]; ++level)
+   {
+      // a map replaced by a later wad is listed again
+      if(!strcasecmp(lastmap.c_str(), level->header))
+         continue;
+      lastmap = level->header;
+
+      std::string source = B_mapFingerprint(*level, wads);
+      if(B_isCacheCurrent(index, source))
+      {
+         ++current;
+         continue;
+      }
+      jobs.emplace_back();
+      cachejob_t &job = jobs.back();
+      job.map = level->header;
+      job.source = source;
+      job.resultfile = B_cachePath(CACHE_PREFIX) + "job" +
+            std::to_string(jobs.size() - 1) + ".tmp";
+      job.exitcode = 0;
+   }
+   efree(levels);
+   return current;
+}
+
+//
+// B_runCacheJob
+//
+// Sets up one map in a worker and reads its level hash. Runs on coordinator
+// threads.
+//
+static void B_runCacheJob(cachejob_t &job, bool verbose)
+{
+   std::vector<const char *> args(myargv, myargv + myargc);
+   args.push_back("-botcacheworker");
+   args.push_back(job.map.c_str());
+   args.push_back(job.resultfile.c_str());
+   args.push_back("-nodraw");
+   args.push_back("-noblit");
+   args.push_back("-nosound");
+   args.push_back(nullptr);
+
+   remove(job.resultfile.c_str());
+   job.exitcode = B_RunProcess(args);
+
+   FILE *f = fopen(job.resultfile.c_str(), "r");
+   if(f)
+   {
+      char digest[64];
+      if(fscanf(f, "%63s", digest) == 1)
+         job.digest = digest;
+      fclose(f);
+      remove(job.resultfile.c_str());
+   }
+
+   if(verbose)
+   {
+      printf("botcache: %s %s\n", job.map.c_str(),
+             job.digest.empty() ? "failed" : job.digest.c_str());
+   }
+}
+
+//
+// B_runCacheJobs
+//
+static void B_runCacheJobs(std::vector<cachejob_t> &jobs, int numworkers,
+                           bool verbose)
+{
+   numworkers = std::max(1, std::min(numworkers, (int)jobs.size()));
+
+   std::atomic<size_t> nextjob(0);
+   auto runner = [&jobs, &nextjob, verbose]() {
+      size_t index;
+      while((index = nextjob++) < jobs.size())
+         B_runCacheJob(jobs[index], verbose);
+   };
+   std::vector<std::thread> threads;
+   for(int i = 0; i < numworkers; ++i)
+      threads.emplace_back(runner);
+   for(std::thread &thread : threads)
+      thread.join();
+}
+
+//
+// B_recordJobs
+//
+// Adds the worker caches to the index and cleans up. Returns the number of
+// failed maps.
+//
+static int B_recordJobs(const std::vector<cachejob_t> &jobs)
+{
+   cacheindex_t index;
+   B_loadCacheIndex(index);
+
+   int failed = 0;
+   long long now = (long long)time(nullptr);
+   for(const cachejob_t &job : jobs)
+   {
+      if(job.digest.empty())
+         ++failed;
+      else
+         index[job.digest] = { now, BotMap::CacheVersion(), job.map, job.source };
+   }
+
+   B_cacheHousekeeping(index, nullptr);
+   B_saveCacheIndex(index);
+   return failed;
+}
+
+//
+// B_CacheGenIsCoordinator
+//
+// True if this process must build the caches instead of playing
+//
+bool B_CacheGenIsCoordinator()
+{
+   return !B_CacheGenWorkerMap() && M_CheckParm("-botcache");
+}
+
+//
+// B_CacheGenRun
+//
+// Builds the caches as requested from the command line
+//
+void B_CacheGenRun()
+{
+   std::vector<cachejob_t> jobs;
+   int current = B_collectMaps(jobs);
+   if(jobs.empty())
+   {
+      if(current)
+         printf("botcache: all %d maps are up to date\n", current);
+      else
+         puts("botcache: no maps found");
+      return;
+   }
+
+   int numworkers = (int)std::thread::hardware_concurrency();
+   int p = M_CheckParm("-botcachejobs");
+   if(p && p < myargc - 1)
+      numworkers = atoi(myargv[p + 1]);
+
+   printf("botcache: %d maps, %d up to date, %d at once\n", (int)jobs.size(),
+          current, std::max(1, std::min(numworkers, (int)jobs.size())));
+
+   auto start = std::chrono::steady_clock::now();
+   B_runCacheJobs(jobs, numworkers, true);
+   int failed = B_recordJobs(jobs);
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   printf("botcache: done in %.1f seconds, %d failed\n", elapsed.count(), failed);
+}
+
+//
+// B_CacheGenTicker
+//
+// Called after each game tic. Ends workers once their level is set up, and
+// reports the end of background generation.
+//
+void B_CacheGenTicker()
+{
+   if(B_CacheGenWorkerMap())
+   {
+      if(gamestate == GS_LEVEL)
+         B_cacheWorkerFinish();
+      return;
+   }
+
+   if(!background || !background->done)
+      return;
+   int failed = B_recordJobs(background->jobs);
+   C_Printf("Built the bot map caches of %d maps, %d failed\n",
+            (int)background->jobs.size() - failed, failed);
+   background.reset();
+}
+
+//=============================================================================
+//
+// Console commands
+//
+
+VARIABLE_INT(bot_cachesize, nullptr, 0, 1 << 20, nullptr);
+CONSOLE_VARIABLE(bot_cachesize, bot_cachesize, 0) {}
+
+//
+// bot_buildcaches
+//
+// Builds the missing bot map caches of all maps in the background, leaving
+// one CPU core to the game
+//
+CONSOLE_COMMAND(bot_buildcaches, 0)
+{
+   if(background)
+   {
+      C_Printf("The bot map caches are already being built\n");
+      return;
+   }
+
+   auto run = std::make_shared<cacherun_t>();
+   int current = B_collectMaps(run->jobs);
+   if(run->jobs.empty())
+   {
+      if(current)
+         C_Printf("The bot map caches of all %d maps are up to date\n", current);
+      else
+         C_Printf("No maps found\n");
+      return;
+   }
+
+   int numworkers = (int)std::thread::hardware_concurrency() - 1;
+   background = run;
+   // Detached, so quitting the game doesn't wait for it
+   std::thread([run, numworkers]() {
+      B_runCacheJobs(run->jobs, numworkers, false);
+      run->done = true;
+   }).detach();
+
+   C_Printf("Building the bot map caches of %d maps\n", (int)run->jobs.size());
+}
+
+// EOF
@@ -0,0 +1,44 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Bot map cache precomputation and housekeeping. Worker processes build
+//      the missing caches of all maps ahead of time, and an index keeps the
+//      cache folder within a size limit.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef B_CACHEGEN_H_
+#define B_CACHEGEN_H_
+
+bool B_CacheGenIsCoordinator();
+void B_CacheGenRun();
+
+const char *B_CacheGenWorkerMap();
+void B_CacheGenTicker();
+
+void B_CacheTouch(const char *digest, const char *mapname, bool created);
+
+#endif
+
+// EOF
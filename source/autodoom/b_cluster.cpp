@@ -0,0 +1,275 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Coarse cluster graph over the bot map subsectors, used for
+//      hierarchical path finding.
+//
+//-----------------------------------------------------------------------------
+
+#include "../z_zone.h"
+
+#include "b_cluster.h"
+#include "../m_profile.h"
+#include "../r_defs.h"
+
+//
+// ClusterGraph::ClusterGraph
+//
+// Builds the clusters from a complete bot map. Must be called after mobjs and
+// special lines are placed on the map.
+//
+ClusterGraph::ClusterGraph(const BotMap &map) : m_map(map),
+m_first(&map.ssectors[0]), m_generation(1)
+{
+   PROFILE_ZONE("ClusterGraph");
+   buildClusters();
+   buildBorders();
+   buildDistances();
+   countGoals();
+
+   B_Log("Cluster graph: %d subsectors, %d clusters, %d borders, %d portals",
+         (int)ssCluster.getLength(), (int)clusters.getLength(),
+         (int)borders.getLength(), (int)portals.getLength());
+}
+
+//
+// ClusterGraph::isInternal
+//
+// True if the neigh can join two subsectors into the same cluster
+//
+bool ClusterGraph::isInternal(const BNeigh &neigh) const
+{
+   return neigh.otherss->msector == neigh.myss->msector &&
+   (!neigh.line || !neigh.line->specline);
+}
+
+//
+// ClusterGraph::isPortal
+//
+// True if the neigh leaves the cluster or may have special effects
+//
+bool ClusterGraph::isPortal(const BNeigh &neigh) const
+{
+   return (neigh.line && neigh.line->specline) ||
+   ssCluster[neigh.otherss - m_first] != ssCluster[neigh.myss - m_first];
+}
+
+//
+// ClusterGraph::buildClusters
+//
+// Grows clusters breadth-first from each unassigned subsector
+//
+void ClusterGraph::buildClusters()
+{
+   int numss = (int)m_map.ssectors.getLength();
+   ssCluster.resize(numss);
+   ssLocal.resize(numss);
+   ssList.reserve(numss);
+   for(int &c : ssCluster)
+      c = -1;
+
+   for(int i = 0; i < numss; ++i)
+   {
+      if(ssCluster[i] != -1)
+         continue;
+      int cindex = (int)clusters.getLength();
+      Cluster &cluster = clusters.addNew();
+      cluster.msector = m_map.ssectors[i].msector;
+      cluster.firstSubsec = (int)ssList.getLength();
+
+      ssCluster[i] = cindex;
+      ssLocal[i] = 0;
+      ssList.add(i);
+      cluster.numSubsecs = 1;
+
+      // ssList doubles as the queue, since cluster members are contiguous
+      for(int head = cluster.firstSubsec; head < (int)ssList.getLength() &&
+          cluster.numSubsecs < MAX_CLUSTER_SIZE; ++head)
+      {
+         for(const BNeigh &neigh : m_map.ssectors[ssList[head]].neighs)
+         {
+            int other = (int)(neigh.otherss - m_first);
+            if(ssCluster[other] != -1 || !isInternal(neigh))
+               continue;
+            ssCluster[other] = cindex;
+            ssLocal[other] = cluster.numSubsecs++;
+            ssList.add(other);
+            if(cluster.numSubsecs >= MAX_CLUSTER_SIZE)
+               break;
+         }
+      }
+   }
+}
+
+//
+// ClusterGraph::buildBorders
+//
+// Collects the subsectors having portals
+//
+void ClusterGraph::buildBorders()
+{
+   ssBorder.resize(ssCluster.getLength());
+   for(int &b : ssBorder)
+      b = -1;
+
+   for(Cluster &cluster : clusters)
+   {
+      cluster.firstBorder = (int)borders.getLength();
+      for(int i = 0; i < cluster.numSubsecs; ++i)
+      {
+         int ssindex = ssList[cluster.firstSubsec + i];
+         int firstPortal = (int)portals.getLength();
+         for(const BNeigh &neigh : m_map.ssectors[ssindex].neighs)
+            if(isPortal(neigh))
+               portals.add(&neigh);
+         if((int)portals.getLength() == firstPortal)
+            continue;
+
+         ssBorder[ssindex] = cluster.numBorders++;
+         Border &border = borders.addNew();
+         border.ssindex = ssindex;
+         border.firstPortal = firstPortal;
+         border.numPortals = (int)portals.getLength() - firstPortal;
+      }
+   }
+}
+
+//
+// ClusterGraph::buildDistances
+//
+// Caches the walking distance between each pair of borders of a cluster.
+// Clusters are independent, so they're spread over the worker threads.
+//
+void ClusterGraph::buildDistances()
+{
+   for(Cluster &cluster : clusters)
+   {
+      cluster.firstDist = (int)borderDist.getLength();
+      borderDist.resize(borderDist.getLength() +
+                        cluster.numBorders * cluster.numBorders);
+   }
+
+   B_ParallelFor((int)clusters.getLength(), [this](int begin, int end, int) {
+      fixed_t dist[MAX_CLUSTER_SIZE];
+      const BNeigh *prev[MAX_CLUSTER_SIZE];
+      for(int c = begin; c < end; ++c)
+      {
+         const Cluster &cluster = clusters[c];
+         for(int i = 0; i < cluster.numBorders; ++i)
+         {
+            localSearch(m_map.ssectors[borders[cluster.firstBorder + i].ssindex],
+                        dist, prev);
+            for(int j = 0; j < cluster.numBorders; ++j)
+            {
+               int ssindex = borders[cluster.firstBorder + j].ssindex;
+               borderDist[cluster.firstDist + i * cluster.numBorders + j] =
+               dist[ssLocal[ssindex]];
+            }
+         }
+      }
+   });
+}
+
+//
+// ClusterGraph::countGoals
+//
+// Marks the clusters which can contain goals. Mobjs are tracked afterwards by
+// BotMap as they move.
+//
+void ClusterGraph::countGoals()
+{
+   for(int i = 0; i < (int)ssCluster.getLength(); ++i)
+   {
+      const BSubsec &ss = m_map.ssectors[i];
+      Cluster &cluster = clusters[ssCluster[i]];
+      cluster.numMobjs += m_map.mobjsIn(ss).size();
+      if(cluster.staticGoals)
+         continue;
+      if(!m_map.linesIn(ss).empty() ||
+         ss.msector->getFloorSector()->damageflags & SDMG_EXITLEVEL)
+      {
+         cluster.staticGoals = true;
+         continue;
+      }
+      for(const BNeigh &neigh : ss.neighs)
+      {
+         if(neigh.line && neigh.line->specline)
+         {
+            cluster.staticGoals = true;
+            break;
+         }
+      }
+   }
+}
+
+//
+// ClusterGraph::localSearch
+//
+// Dijkstra search restricted to the cluster of source. Results are indexed by
+// the local subsector index (ssLocal). Clusters are small, so a simple
+// selection is used instead of a heap.
+//
+void ClusterGraph::localSearch(const BSubsec &source, fixed_t *dist,
+                               const BNeigh **prev) const
+{
+   const Cluster &cluster = clusterOf(source);
+   bool done[MAX_CLUSTER_SIZE];
+   for(int i = 0; i < cluster.numSubsecs; ++i)
+   {
+      dist[i] = D_MAXINT;
+      prev[i] = nullptr;
+      done[i] = false;
+   }
+   dist[ssLocal[&source - m_first]] = 0;
+
+   for(;;)
+   {
+      int best = -1;
+      for(int i = 0; i < cluster.numSubsecs; ++i)
+         if(!done[i] && dist[i] != D_MAXINT && (best == -1 || dist[i] < dist[best]))
+            best = i;
+      if(best == -1)
+         return;
+      done[best] = true;
+
+      const BSubsec &ss = m_map.ssectors[ssList[cluster.firstSubsec + best]];
+      for(const BNeigh &neigh : ss.neighs)
+      {
+         if(!isInternal(neigh))
+            continue;
+         int other = (int)(neigh.otherss - m_first);
+         if(ssCluster[other] != ssCluster[&ss - m_first])
+            continue;
+         int local = ssLocal[other];
+         fixed_t tentative = dist[best] + neigh.dist;
+         if(!done[local] && tentative < dist[local])
+         {
+            dist[local] = tentative;
+            prev[local] = &neigh;
+         }
+      }
+   }
+}
+
+// EOF
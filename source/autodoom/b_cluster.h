@@ -0,0 +1,145 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Coarse cluster graph over the bot map subsectors, used for
+//      hierarchical path finding.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef B_CLUSTER_H_
+#define B_CLUSTER_H_
+
+#include "b_botmap.h"
+#include "../m_collection.h"
+
+//
+// ClusterGraph
+//
+// Subsectors are grouped into small connected clusters sharing the same
+// metasector, so walking inside a cluster never depends on sector heights.
+// Clusters are joined through portal neighs, whose passability may change
+// when doors or lifts move. Distances between the border subsectors of each
+// cluster are computed once, when the graph is built.
+//
+class ClusterGraph : public ZoneObject
+{
+public:
+   enum
+   {
+      MAX_CLUSTER_SIZE = 64,  // max subsectors per cluster. Keep it small.
+   };
+
+   struct Cluster
+   {
+      const MetaSector *msector;
+      int firstSubsec;  // index into ssList
+      int numSubsecs;
+      int firstBorder;  // index into borders
+      int numBorders;
+      int firstDist;    // index into borderDist (numBorders * numBorders items)
+      int numMobjs;     // mobj links currently in the cluster
+      bool staticGoals; // has trigger lines or exit floors
+   };
+
+   //
+   // Subsector with at least one portal neigh
+   //
+   struct Border
+   {
+      int ssindex;
+      int firstPortal;  // index into portals
+      int numPortals;
+   };
+
+   PODCollection<Cluster> clusters;
+   PODCollection<int> ssCluster;    // cluster index of each subsector
+   PODCollection<int> ssLocal;      // index of each subsector within cluster
+   PODCollection<int> ssBorder;     // border index within cluster, or -1
+   PODCollection<int> ssList;       // subsector indices, grouped by cluster
+   PODCollection<Border> borders;
+   PODCollection<const BNeigh *> portals;
+   PODCollection<fixed_t> borderDist;
+
+   explicit ClusterGraph(const BotMap &map);
+
+   bool isPortal(const BNeigh &neigh) const;
+
+   //
+   // True if the pathfinder needs to look inside the cluster for goals
+   //
+   bool isEventful(const Cluster &cluster) const
+   {
+      return cluster.staticGoals || cluster.numMobjs > 0;
+   }
+
+   const Cluster &clusterOf(const BSubsec &ss) const
+   {
+      return clusters[ssCluster[&ss - m_first]];
+   }
+
+   fixed_t borderDistance(const Cluster &cluster, int from, int to) const
+   {
+      return borderDist[cluster.firstDist + from * cluster.numBorders + to];
+   }
+
+   void localSearch(const BSubsec &source, fixed_t *dist, const BNeigh **prev) const;
+
+   void mobjLinked(const BSubsec &ss)
+   {
+      ++clusters[ssCluster[&ss - m_first]].numMobjs;
+   }
+   void mobjUnlinked(const BSubsec &ss)
+   {
+      --clusters[ssCluster[&ss - m_first]].numMobjs;
+   }
+
+   //
+   // Passability generation. Bumped whenever a portal may have changed its
+   // canPass result.
+   //
+   unsigned generation() const
+   {
+      return m_generation;
+   }
+   void invalidate()
+   {
+      if(!++m_generation)
+         m_generation = 1; // zero is reserved for "never checked"
+   }
+
+private:
+   bool isInternal(const BNeigh &neigh) const;
+   void buildClusters();
+   void buildBorders();
+   void buildDistances();
+   void countGoals();
+
+   const BotMap &m_map;
+   const BSubsec *m_first;
+   unsigned m_generation;
+};
+
+#endif
+
+// EOF
@@ -28,9 +28,17 @@
 
 // Largely based on the http://www.zlib.net/zpipe.c example
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 #include "../z_zone.h"
 
+#include "../c_io.h"
+#include "../hal/i_directory.h"
 #include "../m_compare.h"
+#include "../v_misc.h"
 #include "b_compression.h"
 
 //
@@ -192,6 +200,370 @@ GZCompression::~GZCompression()
     close();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// MemoryOutBuffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// MemoryOutBuffer::create
+//
+// Prepares the buffer. pLen is the chunk size moved into memory at once.
+//
+bool MemoryOutBuffer::create(size_t pLen, int pEndian)
+{
+   m_data.clear();
+   initBuffer(pLen, pEndian);
+   return true;
+}
+
+//
+// MemoryOutBuffer::flush
+//
+bool MemoryOutBuffer::flush()
+{
+   if(idx)
+   {
+      m_data.insert(m_data.end(), buffer, buffer + idx);
+      idx = 0;
+   }
+   return true;
+}
+
+//
+// MemoryOutBuffer::close
+//
+// Moves the remaining data into memory. The data stays available.
+//
+void MemoryOutBuffer::close()
+{
+   flush();
+   BufferedFileBase::close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// MemoryInBuffer
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// MemoryInBuffer::open
+//
+// The data must stay valid while reading
+//
+void MemoryInBuffer::open(const void *data, size_t size, int pEndian)
+{
+   m_data = static_cast<const byte *>(data);
+   m_size = size;
+   m_pos = 0;
+   endian = pEndian;
+}
+
+//
+// MemoryInBuffer::read
+//
+size_t MemoryInBuffer::read(void *dest, size_t size)
+{
+   size_t r = emin(size, m_size - m_pos);
+   memcpy(dest, m_data + m_pos, r);
+   m_pos += r;
+   if(throwing && r != size)
+      throw BufferedIOException("Error reading");
+   return r;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous file writing
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Pending file write, handled by the writer thread
+//
+struct WriteJob
+{
+   std::string filename;
+   std::vector<byte> data;
+   int level;        // zlib level, if compressed
+   bool compressed;
+   std::string donemsg;    // shown once written, if not empty
+   std::string failmsg;    // shown if it couldn't be written, if not empty
+};
+
+static std::thread g_writeThread;
+static std::mutex g_writeMutex;
+static std::condition_variable g_writeDone;  // signalled after each job
+static std::deque<WriteJob> g_writeJobs;
+static std::string g_writeCurrent;           // file being written now
+static std::vector<std::string> g_writeFailures;
+static std::vector<std::string> g_writeMessages;   // for doom_printf
+static bool g_writeRunning;
+
+//
+// B_commitTempFile
+//
+// Replaces filename with the finished temporary file, or discards the latter
+// on failure.
+//
+static bool B_commitTempFile(const std::string &tempname,
+                             const std::string &filename, bool ok)
+{
+   if(ok)
+      ok = I_ReplaceFile(tempname.c_str(), filename.c_str());
+   if(!ok)
+      remove(tempname.c_str());
+   return ok;
+}
+
+//
+// B_deflateToFile
+//
+// Runs on the writer thread. Must not touch the zone heap or the console.
+// Writes to a temporary file first, so no incomplete file ever appears.
+//
+static bool B_deflateToFile(const std::string &filename, const std::vector<byte> &data,
+                            int level)
+{
+   std::string tempname = filename + ".tmp";
+   FILE *f = fopen(tempname.c_str(), "wb");
+   if(!f)
+      return false;
+
+   z_stream strm = {};
+   if(deflateInit(&strm, level) != Z_OK)
+   {
+      fclose(f);
+      remove(tempname.c_str());
+      return false;
+   }
+
+   static const size_t CHUNK = 16384;
+   unsigned char out[CHUNK];
+   bool ok = true;
+   strm.avail_in = static_cast<uInt>(data.size());
+   strm.next_in = const_cast<byte *>(data.data());
+   int ret;
+   do
+   {
+      strm.avail_out = CHUNK;
+      strm.next_out = out;
+      ret = deflate(&strm, Z_FINISH);
+      if(ret == Z_STREAM_ERROR)
+      {
+         ok = false;
+         break;
+      }
+      size_t have = CHUNK - strm.avail_out;
+      if(fwrite(out, 1, have, f) != have || ferror(f))
+      {
+         ok = false;
+         break;
+      }
+   } while(ret != Z_STREAM_END);
+
+   deflateEnd(&strm);
+   if(fclose(f) != 0)
+      ok = false;
+
+   return B_commitTempFile(tempname, filename, ok);
+}
+
+//
+// B_rawToFile
+//
+// Same as B_deflateToFile, without compression
+//
+static bool B_rawToFile(const std::string &filename, const std::vector<byte> &data)
+{
+   std::string tempname = filename + ".tmp";
+   FILE *f = fopen(tempname.c_str(), "wb");
+   if(!f)
+      return false;
+
+   bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+   if(fclose(f) != 0)
+      ok = false;
+
+   return B_commitTempFile(tempname, filename, ok);
+}
+
+//
+// B_writerThread
+//
+// Drains the job queue, then quits
+//
+static void B_writerThread()
+{
+   for(;;)
+   {
+      WriteJob job;
+      {
+         std::lock_guard<std::mutex> lock(g_writeMutex);
+         if(g_writeJobs.empty())
+         {
+            g_writeRunning = false;
+            return;
+         }
+         job = std::move(g_writeJobs.front());
+         g_writeJobs.pop_front();
+         g_writeCurrent = job.filename;
+      }
+
+      bool ok = job.compressed ? B_deflateToFile(job.filename, job.data, job.level)
+                               : B_rawToFile(job.filename, job.data);
+      {
+         std::lock_guard<std::mutex> lock(g_writeMutex);
+         g_writeCurrent.clear();
+         const std::string &message = ok ? job.donemsg : job.failmsg;
+         if(!message.empty())
+            g_writeMessages.push_back(message);
+         if(!ok)
+            g_writeFailures.push_back(std::move(job.filename));
+      }
+      g_writeDone.notify_all();
+   }
+}
+
+//
+// B_joinWriteThread
+//
+// Also called at exit, when the console can't be used anymore
+//
+static void B_joinWriteThread()
+{
+   if(g_writeThread.joinable())
+      g_writeThread.join();
+}
+
+//
+// B_queueWrite
+//
+// Adds a job, starting the writer thread if it's idle. Jobs are written in
+// the order they're queued.
+//
+static void B_queueWrite(WriteJob &&job)
+{
+   static bool atexitSet;
+   if(!atexitSet)
+   {
+      atexit(B_joinWriteThread);
+      atexitSet = true;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(g_writeMutex);
+      g_writeJobs.push_back(std::move(job));
+      if(g_writeRunning)
+         return;
+      g_writeRunning = true;
+   }
+
+   // The previous thread, if any, has already run out of jobs
+   B_joinWriteThread();
+   g_writeThread = std::thread(B_writerThread);
+}
+
+//
+// B_WriteCompressedAsync
+//
+// Compresses data into filename, on a separate thread. The messages, if any,
+// are shown from B_PollAsyncWrites after the file is done.
+//
+void B_WriteCompressedAsync(const char *filename, std::vector<byte> &&data,
+                            CompressLevel level, const char *donemsg,
+                            const char *failmsg)
+{
+   WriteJob job;
+   job.filename = filename;
+   job.data = std::move(data);
+   job.level = zlibLevelForCompressLevel(level);
+   job.compressed = true;
+   if(donemsg)
+      job.donemsg = donemsg;
+   if(failmsg)
+      job.failmsg = failmsg;
+   B_queueWrite(std::move(job));
+}
+
+//
+// B_WriteRawAsync
+//
+// Writes data into filename as it is, on a separate thread
+//
+void B_WriteRawAsync(const char *filename, std::vector<byte> &&data)
+{
+   WriteJob job;
+   job.filename = filename;
+   job.data = std::move(data);
+   job.level = 0;
+   job.compressed = false;
+   B_queueWrite(std::move(job));
+}
+
+//
+// B_reportWriteFailures
+//
+static void B_reportWriteFailures()
+{
+   std::lock_guard<std::mutex> lock(g_writeMutex);
+   for(const std::string &filename : g_writeFailures)
+      C_Printf(FC_ERROR "WARNING: can't write file at %s\n", filename.c_str());
+   g_writeFailures.clear();
+   for(const std::string &message : g_writeMessages)
+      doom_printf("%s", message.c_str());
+   g_writeMessages.clear();
+}
+
+//
+// B_PollAsyncWrites
+//
+// Called each tic to report the writes finished meanwhile, without waiting
+//
+void B_PollAsyncWrites()
+{
+   B_reportWriteFailures();
+}
+
+//
+// B_WaitAsyncWrites
+//
+// Waits for all the pending asynchronous writes to end, and reports failures.
+//
+void B_WaitAsyncWrites()
+{
+   if(!g_writeThread.joinable())
+      return;
+   B_joinWriteThread();
+   B_reportWriteFailures();
+}
+
+//
+// B_WaitAsyncWrite
+//
+// Waits only until the given file is written, if it's pending. The jobs
+// queued after it keep going.
+//
+void B_WaitAsyncWrite(const char *filename)
+{
+   {
+      std::unique_lock<std::mutex> lock(g_writeMutex);
+      g_writeDone.wait(lock, [filename] {
+         if(g_writeCurrent == filename)
+            return false;
+         for(const WriteJob &job : g_writeJobs)
+         {
+            if(job.filename == filename)
+               return false;
+         }
+         return true;
+      });
+   }
+   B_reportWriteFailures();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // GZExpansion
@@ -29,6 +29,7 @@
 #ifndef B_COMPRESSION_H_
 #define B_COMPRESSION_H_
 
+#include <vector>
 #include "../m_buffer.h"
 
 #include "../../zlib/zlib.h"
@@ -62,6 +63,64 @@ public:
     
 };
 
+//
+// MemoryOutBuffer
+//
+// Collects the output into memory, so it can be compressed and written to a
+// file later, away from the main thread.
+//
+class MemoryOutBuffer : public OutBuffer
+{
+   std::vector<byte> m_data;
+
+public:
+   bool create(size_t pLen, int pEndian);
+   bool flush() override;
+   void close() override;
+
+   std::vector<byte> &getData()
+   {
+      return m_data;
+   }
+};
+
+void B_WriteCompressedAsync(const char *filename, std::vector<byte> &&data,
+                            CompressLevel level = CompressLevel_Default,
+                            const char *donemsg = nullptr,
+                            const char *failmsg = nullptr);
+void B_WriteRawAsync(const char *filename, std::vector<byte> &&data);
+void B_PollAsyncWrites();
+void B_WaitAsyncWrites();
+void B_WaitAsyncWrite(const char *filename);
+
+//
+// MemoryInBuffer
+//
+// Reads from a memory range owned by someone else, such as a mapped file
+//
+class MemoryInBuffer : public InBuffer
+{
+   const byte *m_data;
+   size_t m_size;
+   size_t m_pos;
+
+public:
+   MemoryInBuffer() : InBuffer(), m_data(nullptr), m_size(0), m_pos(0)
+   {
+   }
+
+   void open(const void *data, size_t size, int pEndian);
+
+   int seek(long offset, int origin) = delete;
+   size_t read(void *dest, size_t size) override;
+   int skip(size_t skipAmt) = delete;
+
+   size_t tell() const
+   {
+      return m_pos;
+   }
+};
+
 class GZExpansion : public InBuffer
 {
    // increased from default 16384 (from zpipe.c common
@@ -0,0 +1,424 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Flow fields towards the nearest item of each kind, shared by all bots.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include "../z_zone.h"
+
+#include "b_flowfield.h"
+#include "b_lineeffect.h"
+#include "b_msector.h"
+#include "b_path.h"
+#include "../e_inventory.h"
+#include "../ev_specials.h"
+#include "../info.h"
+#include "../m_profile.h"
+#include "../metaapi.h"
+#include "../p_mobj.h"
+
+//
+// FlowFields::FlowFields
+//
+// The fields are only searched on the first update.
+//
+FlowFields::FlowFields(const BotMap &map) : m_map(map),
+m_first(&map.ssectors[0]), m_numss((int)map.ssectors.getLength())
+{
+   for(PODCollection<Cell> &cells : m_cells)
+      cells.resize(m_numss);
+   m_sources.resize(m_numss);
+   m_heights.resize(m_numss);
+   m_contentsDirty.resize(m_numss);
+   m_state.resize(m_numss);
+}
+
+//
+// FlowFields::Categories
+//
+// Gets the item categories of a pickup, as a bit mask
+//
+unsigned FlowFields::Categories(const Mobj &mo)
+{
+   if(mo.sprite < 0 || mo.sprite >= NUMSPRITES)
+      return 0;
+   const e_pickupfx_t *pickup = mo.info->pickupfx ? mo.info->pickupfx :
+         E_PickupFXForSprNum(mo.sprite);
+   if(!pickup)
+      return 0;
+
+   unsigned mask = 0;
+   for(unsigned i = 0; i < pickup->numEffects; ++i)
+   {
+      const itemeffect_t *effect = pickup->effects[i];
+      if(!effect)
+         continue;
+      switch(effect->getInt("class", ITEMFX_NONE))
+      {
+         case ITEMFX_HEALTH:
+            mask |= 1 << CAT_HEALTH;
+            break;
+         case ITEMFX_ARMOR:
+            mask |= 1 << CAT_ARMOR;
+            break;
+         case ITEMFX_AMMO:
+            mask |= 1 << CAT_AMMO;
+            break;
+         case ITEMFX_POWER:
+            mask |= 1 << CAT_POWER;
+            break;
+         case ITEMFX_WEAPONGIVER:
+            mask |= 1 << CAT_WEAPON;
+            break;
+         case ITEMFX_ARTIFACT:
+            mask |= 1 << CAT_ARTIFACT;
+            break;
+         default:
+            break;
+      }
+   }
+   if(pickup->flags & PFXF_GIVESBACKPACKAMMO)
+      mask |= 1 << CAT_AMMO;
+   return mask;
+}
+
+//
+// FlowFields::update
+//
+// Applies the changes since the last call. Everything is searched again if
+// the player height differs from last time.
+//
+void FlowFields::update(fixed_t height)
+{
+   // The fields only describe the real level
+   if(!LevelStateStack::IsClear())
+      return;
+
+   PROFILE_ZONE("FlowFields::update");
+
+   if(!m_ready || height != m_height)
+   {
+      m_height = height;
+      for(int i = 0; i < m_numss; ++i)
+      {
+         m_sources[i] = sourceMask(i);
+         m_heights[i] = heightsOf(i);
+         m_contentsDirty[i] = 0;
+      }
+      m_dirtyList.makeEmpty<true>();
+      m_moved = false;
+      for(int i = 0; i < NUMCATEGORIES; ++i)
+         build(i);
+      m_ready = true;
+      return;
+   }
+
+   m_sourceChanges.makeEmpty<true>();
+   for(int ss : m_dirtyList)
+   {
+      m_contentsDirty[ss] = 0;
+      unsigned mask = sourceMask(ss);
+      if(mask != m_sources[ss])
+      {
+         m_sourceChanges.add({ ss, m_sources[ss] });
+         m_sources[ss] = mask;
+      }
+   }
+   m_dirtyList.makeEmpty<true>();
+
+   m_moveList.makeEmpty<true>();
+   if(m_moved)
+   {
+      m_moved = false;
+      for(int i = 0; i < m_numss; ++i)
+      {
+         Heights heights = heightsOf(i);
+         Heights &old = m_heights[i];
+         if(heights.floor != old.floor || heights.altfloor != old.altfloor ||
+            heights.ceiling != old.ceiling)
+         {
+            old = heights;
+            m_moveList.add(i);
+         }
+      }
+   }
+
+   if(m_sourceChanges.isEmpty() && m_moveList.isEmpty())
+      return;
+   for(int i = 0; i < NUMCATEGORIES; ++i)
+      repair(i);
+}
+
+//
+// FlowFields::sourceMask
+//
+// Categories of the items currently in a subsector
+//
+unsigned FlowFields::sourceMask(int ss) const
+{
+   unsigned mask = 0;
+   for(const Mobj *mo : m_map.mobjsIn(m_first[ss]))
+   {
+      if(mo->flags & MF_SPECIAL)
+         mask |= Categories(*mo);
+   }
+   return mask;
+}
+
+//
+// FlowFields::heightsOf
+//
+FlowFields::Heights FlowFields::heightsOf(int ss) const
+{
+   const MetaSector &msector = *m_first[ss].msector;
+   return { msector.getFloorHeight(), msector.getAltFloorHeight(),
+            msector.getCeilingHeight() };
+}
+
+//
+// FlowFields::canFlow
+//
+// True if the neigh can be walked on. Teleporters are left to the regular
+// path finder, as they lead elsewhere.
+//
+bool FlowFields::canFlow(const BNeigh &neigh) const
+{
+   if(neigh.line && neigh.line->specline &&
+      EV_IsTeleportationSpecial(*neigh.line->specline))
+   {
+      return false;
+   }
+   return m_map.canPass(*neigh.myss, *neigh.otherss, m_height);
+}
+
+//
+// FlowFields::stepCost
+//
+// Length of the neigh, made longer through painful sectors like in the path
+// finder
+//
+fixed_t FlowFields::stepCost(const BNeigh &neigh) const
+{
+   int64_t cost = (int64_t)neigh.dist *
+      B_PainfulSectorFactor(*neigh.myss->msector->getFloorSector(), nullptr);
+   return cost < D_MAXINT ? (fixed_t)cost : D_MAXINT;
+}
+
+//
+// FlowFields::build
+//
+// Searches a whole field, starting from all its goals
+//
+void FlowFields::build(int category)
+{
+   Cell *cells = m_cells[category].begin();
+   unsigned bit = 1u << category;
+
+   m_heap.makeEmpty<true>();
+   for(int i = 0; i < m_numss; ++i)
+   {
+      if(m_sources[i] & bit)
+      {
+         cells[i] = { 0, nullptr, i };
+         push(i, 0);
+      }
+      else
+         cells[i] = { D_MAXINT, nullptr, -1 };
+   }
+   flow(cells);
+}
+
+//
+// FlowFields::repair
+//
+// Updates a field after its goals or the sector heights changed. The cells
+// whose steps lead to a lost goal or through a blocked neigh are cleared,
+// then searched again from the cells around them, together with the new
+// goals and the neighbourhood of the moved sectors.
+//
+void FlowFields::repair(int category)
+{
+   Cell *cells = m_cells[category].begin();
+   unsigned bit = 1u << category;
+
+   m_heap.makeEmpty<true>();
+   m_broken.makeEmpty<true>();
+
+   for(const SourceChange &change : m_sourceChanges)
+   {
+      if(change.before & bit && !(m_sources[change.ss] & bit))
+         m_broken.add(change.ss);
+   }
+   for(int ss : m_moveList)
+   {
+      const Cell &cell = cells[ss];
+      if(cell.next && !canFlow(*cell.next))
+         m_broken.add(ss);
+      for(const BNeigh &neigh : m_first[ss].neighs)
+      {
+         int other = (int)(neigh.otherss - m_first);
+         const BNeigh *next = cells[other].next;
+         if(next && next->otherss == m_first + ss && !canFlow(*next))
+            m_broken.add(other);
+      }
+   }
+   if(!m_broken.isEmpty())
+      resetBroken(cells);
+
+   for(const SourceChange &change : m_sourceChanges)
+   {
+      if(!(change.before & bit) && m_sources[change.ss] & bit)
+      {
+         cells[change.ss] = { 0, nullptr, change.ss };
+         push(change.ss, 0);
+      }
+   }
+   for(int ss : m_broken)
+      improve(cells, ss);
+   for(int ss : m_moveList)
+   {
+      improve(cells, ss);
+      for(const BNeigh &neigh : m_first[ss].neighs)
+         improve(cells, (int)(neigh.otherss - m_first));
+   }
+   flow(cells);
+}
+
+//
+// FlowFields::resetBroken
+//
+// Clears the broken cells and all cells whose steps lead through them. On
+// return, m_broken lists every cleared cell.
+//
+void FlowFields::resetBroken(Cell *cells)
+{
+   enum : byte
+   {
+      STATE_UNKNOWN,
+      STATE_KEPT,
+      STATE_BROKEN,
+      STATE_VISITING
+   };
+
+   byte *state = m_state.begin();
+   memset(state, STATE_UNKNOWN, m_numss);
+   for(int ss : m_broken)
+      state[ss] = STATE_BROKEN;
+
+   for(int i = 0; i < m_numss; ++i)
+   {
+      m_chain.makeEmpty<true>();
+      int ss = i;
+      while(state[ss] == STATE_UNKNOWN && cells[ss].next)
+      {
+         state[ss] = STATE_VISITING;
+         m_chain.add(ss);
+         ss = (int)(cells[ss].next->otherss - m_first);
+      }
+      byte result = state[ss] == STATE_BROKEN || state[ss] == STATE_VISITING ?
+            STATE_BROKEN : STATE_KEPT;
+      if(state[ss] == STATE_UNKNOWN)
+         state[ss] = STATE_KEPT;
+      for(int link : m_chain)
+         state[link] = result;
+   }
+
+   m_broken.makeEmpty<true>();
+   for(int i = 0; i < m_numss; ++i)
+   {
+      if(state[i] == STATE_BROKEN)
+      {
+         cells[i] = { D_MAXINT, nullptr, -1 };
+         m_broken.add(i);
+      }
+   }
+}
+
+//
+// FlowFields::improve
+//
+// Lets a cell take a shorter way through any of its neighbours
+//
+void FlowFields::improve(Cell *cells, int ss)
+{
+   for(const BNeigh &neigh : m_first[ss].neighs)
+   {
+      const Cell &other = cells[neigh.otherss - m_first];
+      if(other.dist == D_MAXINT)
+         continue;
+      fixed_t tentative = other.dist + stepCost(neigh);
+      if(tentative < 0 || tentative >= cells[ss].dist || !canFlow(neigh))
+         continue;
+      cells[ss] = { tentative, &neigh, other.goal };
+      push(ss, tentative);
+   }
+}
+
+//
+// FlowFields::push
+//
+void FlowFields::push(int ss, fixed_t dist)
+{
+   m_heap.add({ ss, dist });
+   std::push_heap(m_heap.begin(), m_heap.end());
+}
+
+//
+// FlowFields::flow
+//
+// Dijkstra search going backwards from the cells in the heap: each cell
+// offers itself as the next step to the neighbours which can walk into it.
+//
+void FlowFields::flow(Cell *cells)
+{
+   while(!m_heap.isEmpty())
+   {
+      std::pop_heap(m_heap.begin(), m_heap.end());
+      HeapEntry entry = m_heap.pop();
+      const Cell &cell = cells[entry.ss];
+      if(entry.dist != cell.dist)
+         continue;
+
+      const BSubsec &t = m_first[entry.ss];
+      for(const BNeigh &neigh : t.neighs)
+      {
+         const BSubsec &other = *neigh.otherss;
+         int index = (int)(&other - m_first);
+         for(const BNeigh &back : other.neighs)
+         {
+            if(back.otherss != &t)
+               continue;
+            fixed_t tentative = cell.dist + stepCost(back);
+            if(tentative < 0 || tentative >= cells[index].dist || !canFlow(back))
+               continue;
+            cells[index] = { tentative, &back, cell.goal };
+            push(index, tentative);
+         }
+      }
+   }
+}
+
+// EOF
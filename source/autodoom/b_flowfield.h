@@ -0,0 +1,176 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Flow fields towards the nearest item of each kind, shared by all bots.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef B_FLOWFIELD_H_
+#define B_FLOWFIELD_H_
+
+#include "b_botmap.h"
+#include "../m_collection.h"
+
+class Mobj;
+
+//
+// FlowFields
+//
+// For each item category, every subsector knows its distance to the nearest
+// subsector holding such an item, and the neigh to take towards it. They're
+// built by a reverse Dijkstra search started from all those subsectors at
+// once, using the real level state and a single player height.
+//
+// Picked up or spawned items and moving sectors only cause the parts of the
+// fields which depend on them to be searched again. All changes are applied
+// by update(), which must be called from the main thread while no bot is
+// thinking. The fields may then be read by any number of bots at once.
+//
+class FlowFields : public ZoneObject
+{
+public:
+   enum category_e
+   {
+      CAT_HEALTH,
+      CAT_ARMOR,
+      CAT_AMMO,
+      CAT_POWER,
+      CAT_WEAPON,
+      CAT_ARTIFACT,
+      NUMCATEGORIES
+   };
+
+   struct Cell
+   {
+      fixed_t dist;        // path length to the goal, D_MAXINT if none reached
+      const BNeigh *next;  // first step towards the goal, null if on it
+      int goal;            // subsector index of the goal, or -1
+   };
+
+   explicit FlowFields(const BotMap &map);
+
+   static unsigned Categories(const Mobj &mo);
+
+   //
+   // Called when mobjs are linked or unlinked on the subsector
+   //
+   void contentsChanged(const BSubsec &ss)
+   {
+      int index = (int)(&ss - m_first);
+      if(!m_contentsDirty[index])
+      {
+         m_contentsDirty[index] = 1;
+         m_dirtyList.add(index);
+      }
+   }
+
+   //
+   // Called when sector heights may have changed
+   //
+   void geometryChanged()
+   {
+      m_moved = true;
+   }
+
+   void update(fixed_t height);
+
+   //
+   // True if the fields are valid for players of the given height
+   //
+   bool isReady(fixed_t height) const
+   {
+      return m_ready && m_height == height;
+   }
+
+   const Cell &cell(int category, const BSubsec &ss) const
+   {
+      return m_cells[category][&ss - m_first];
+   }
+
+private:
+   struct Heights
+   {
+      fixed_t floor, altfloor, ceiling;
+   };
+
+   struct HeapEntry
+   {
+      int ss;
+      fixed_t dist;
+      bool operator < (const HeapEntry &o) const
+      {
+         return dist > o.dist;
+      }
+   };
+
+   // Source subsector whose categories changed since the last update
+   struct SourceChange
+   {
+      int ss;
+      unsigned before;
+   };
+
+   unsigned sourceMask(int ss) const;
+   Heights heightsOf(int ss) const;
+   bool canFlow(const BNeigh &neigh) const;
+   fixed_t stepCost(const BNeigh &neigh) const;
+
+   void build(int category);
+   void repair(int category);
+   void breakCell(int ss);
+   void resetBroken(Cell *cells);
+   void improve(Cell *cells, int ss);
+   void push(int ss, fixed_t dist);
+   void flow(Cell *cells);
+
+   const BotMap &m_map;
+   const BSubsec *m_first;
+   int m_numss;
+
+   PODCollection<Cell> m_cells[NUMCATEGORIES];
+   PODCollection<unsigned> m_sources;   // categories found in each subsector
+   PODCollection<Heights> m_heights;    // as of the last update
+
+   // Pending changes
+   PODCollection<byte> m_contentsDirty;
+   PODCollection<int> m_dirtyList;
+   bool m_moved = false;
+
+   // Changes being applied by update()
+   PODCollection<SourceChange> m_sourceChanges;
+   PODCollection<int> m_moveList;       // subsectors whose heights changed
+
+   // Scratch space
+   PODCollection<byte> m_state;         // see resetBroken
+   PODCollection<int> m_broken;
+   PODCollection<int> m_chain;
+   PODCollection<HeapEntry> m_heap;
+
+   fixed_t m_height = 0;
+   bool m_ready = false;
+};
+
+#endif
+
+// EOF
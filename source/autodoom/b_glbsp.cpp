@@ -309,11 +309,16 @@ void B_GLBSP_PutSegment(int v1idx, int v2idx, int back, int lnidx, int part,
    sg.mid.y = (sg.v[0]->y + sg.v[1]->y) >> 1;
    
    // put into blockmap
+   static PODCollection<int> blocklist;
+   blocklist.makeEmpty<true>();
    botMap->getTouchedBlocks(*sg.v[0], *sg.v[1], [&sg](int b)->void
    {
        botMap->segBlocks[b].add(&sg);
-       sg.blocklist.add(b);
+       blocklist.add(b);
     });
+   sg.blocklist = botMap->arena.copy<int>(blocklist.begin(),
+                                          blocklist.getLength());
+   sg.numblocks = (int)blocklist.getLength();
    
    // Bounding box
    if(sg.v[0]->x < sg.v[1]->x)
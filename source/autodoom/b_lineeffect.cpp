@@ -82,13 +82,13 @@ struct SectorStateEntry
 // The sector stack entry. Contains the actual referenced sector and the stack
 // of height pairs
 //
-static const player_t* g_keyPlayer;
-
-static bool g_useRealHeights;
+// Settings of the current state, defined further below
+static const player_t *B_keyPlayer();
+static bool B_useRealHeights();
 
 static fixed_t applyDoorCorrection(const sector_t& sector)
 {
-   if(g_useRealHeights)
+   if(B_useRealHeights())
       return sector.srf.ceiling.height;
    
    
@@ -96,9 +96,9 @@ static fixed_t applyDoorCorrection(const sector_t& sector)
    if(botMap && botMap->sectorFlags && botMap->sectorFlags[secnum].door.valid)
    {
       int lockID = botMap->sectorFlags[secnum].door.lock;
-      if(lockID && g_keyPlayer)
+      if(lockID && B_keyPlayer())
       {
-         if(E_PlayerCanUnlock(g_keyPlayer, lockID, false, true))
+         if(E_PlayerCanUnlock(B_keyPlayer(), lockID, false, true))
             return P_FindLowestCeilingSurrounding(&sector) - 4 * FRACUNIT;
       }
       else if(!lockID)
@@ -195,32 +195,121 @@ public:
    }
 };
 
-// A list of sectors, same size as sectors
-static Collection<SectorHeightStack> g_affectedSectors;
+//
+// The arguments of each successful push, parallel to the index list stack.
+// Used to identify the hypothetical state for caching.
+//
+struct PushedLine
+{
+   const line_t *line;
+   const player_t *player;
+   const sector_t *excludeSector;
+};
+
+//
+// LevelState
+//
+// A simulated level: the modified sector heights and the actions which did
+// it. Each bot owns one, so bots can think on separate threads; everything
+// else uses g_sharedState.
+//
+struct LevelState
+{
+   const player_t *keyPlayer = nullptr;
+   bool useRealHeights = false;
+
+   // A list of sectors, same size as sectors
+   Collection<SectorHeightStack> affectedSectors;
+
+   // The actual action stack. Keeps track of affectedSectors indices
+   Collection<PODCollection<int>> indexListStack;
+
+   PODCollection<PushedLine> pushedLines;
+
+   unsigned level = 0;  // g_levelCount when affectedSectors was set up
+};
+
+static LevelState g_sharedState;
+
+// The state used by the calling thread
+static thread_local LevelState *g_state = &g_sharedState;
+
+// Bumped by each InitLevel, so other states know to set up their sectors
+static unsigned g_levelCount;
 
-// The actual action stack. Keeps track of g_affectedSectors indices
-static Collection<PODCollection<int>> g_indexListStack;
+// Bumped when the real level changes, making cached what-if results stale
+static unsigned g_generation;
+
+static const player_t *B_keyPlayer()
+{
+   return g_state->keyPlayer;
+}
+
+static bool B_useRealHeights()
+{
+   return g_state->useRealHeights;
+}
 
 //
-// LevelStateStack::InitLevel
+// B_setupState
 //
-// Called from around P_SetupLevel, it should setup the collection from the
-// sectors array
+// Fills a state with the sectors of the current level
 //
-void LevelStateStack::InitLevel()
+static void B_setupState(LevelState &state)
 {
    static SectorHeightStack prototype;
    static PODCollection<int> prototype2;
-   g_affectedSectors.setPrototype(&prototype);
-   g_indexListStack.setPrototype(&prototype2);
-   
+   state.affectedSectors.setPrototype(&prototype);
+   state.indexListStack.setPrototype(&prototype2);
+
    // Reset the new-sectors list
-   g_affectedSectors.makeEmpty();
+   state.affectedSectors.makeEmpty();
    for(int i = 0; i < numsectors; ++i)
    {
-      g_affectedSectors.addNew().sector = sectors + i;
+      state.affectedSectors.addNew().sector = sectors + i;
    }
-   g_indexListStack.makeEmpty();
+   state.indexListStack.makeEmpty();
+   state.pushedLines.makeEmpty();
+   state.level = g_levelCount;
+}
+
+//
+// LevelStateStack::InitLevel
+//
+// Called from around P_SetupLevel, it should setup the collection from the
+// sectors array
+//
+void LevelStateStack::InitLevel()
+{
+   ++g_levelCount;
+   B_setupState(g_sharedState);
+   Invalidate();
+}
+
+//
+// LevelStateStack::NewState
+//
+// Creates a separate state, for a bot. It's set up when first bound.
+//
+LevelState *LevelStateStack::NewState()
+{
+   return new LevelState;
+}
+
+//
+// LevelStateStack::Bind
+//
+// Makes the calling thread use the given state, or the shared one if null.
+// States must be bound from the main thread first on each level, since that
+// sets up their sectors.
+//
+void LevelStateStack::Bind(LevelState *state)
+{
+   if(!state)
+      state = &g_sharedState;
+   if(state->level != g_levelCount)
+      B_setupState(*state);
+   g_state = state;
 }
 
 //
@@ -236,7 +325,7 @@ LevelStateStack::PushResult LevelStateStack::Push(const line_t& line, const play
    int secnum = -1;
    
    // Prepare the new list of indices to the global stack
-   PODCollection<int>& coll = g_indexListStack.addNew();
+   PODCollection<int>& coll = g_state->indexListStack.addNew();
 
    // Before/after checking
    SectorHeightStack *shs;
@@ -246,7 +335,7 @@ LevelStateStack::PushResult LevelStateStack::Push(const line_t& line, const play
    {
       if(!timed)
       {
-         shs = &g_affectedSectors[secnum];
+         shs = &g_state->affectedSectors[secnum];
          ceilterm = shs->isCeilingTerminal();
          floorterm = shs->isFloorTerminal();
       }
@@ -273,7 +362,7 @@ LevelStateStack::PushResult LevelStateStack::Push(const line_t& line, const play
       {
          // For each successful state push, add an index to the collection
 
-         if(::sectors + secnum == excludeSector && g_affectedSectors[secnum].stack.getLength())
+         if(::sectors + secnum == excludeSector && g_state->affectedSectors[secnum].stack.getLength())
          {
             B_Log("Exclude %d", secnum);
             continue;
@@ -288,9 +377,14 @@ LevelStateStack::PushResult LevelStateStack::Push(const line_t& line, const play
    if (coll.getLength() == 0)
    {
        // No valid state change, so cancel all this and return false
-       g_indexListStack.pop();
+       g_state->indexListStack.pop();
        return PushResult_none;
    }
+
+   PushedLine &pushed = g_state->pushedLines.addNew();
+   pushed.line = &line;
+   pushed.player = &player;
+   pushed.excludeSector = excludeSector;
    
    // okay
    // NOTE: only checking the tagged sector
@@ -299,15 +393,16 @@ LevelStateStack::PushResult LevelStateStack::Push(const line_t& line, const play
 
 void LevelStateStack::Pop()
 {
-    if (g_indexListStack.isEmpty())
+    if (g_state->indexListStack.isEmpty())
         I_Error("%s: already empty!", __FUNCTION__);
-    PODCollection<int>& coll = g_indexListStack[g_indexListStack.getLength() - 1];
+    PODCollection<int>& coll = g_state->indexListStack[g_state->indexListStack.getLength() - 1];
 
     for (int n : coll)
     {
-        g_affectedSectors[n].stack.pop();
+        g_state->affectedSectors[n].stack.pop();
     }
-    g_indexListStack.pop();
+    g_state->indexListStack.pop();
+    g_state->pushedLines.pop();
 }
 
 //
@@ -317,11 +412,12 @@ void LevelStateStack::Pop()
 //
 void LevelStateStack::Clear()
 {
-   for(auto& affectedSector : g_affectedSectors)
+   for(auto& affectedSector : g_state->affectedSectors)
    {
       affectedSector.stack.makeEmpty();
    }
-   g_indexListStack.makeEmpty();
+   g_state->indexListStack.makeEmpty();
+   g_state->pushedLines.makeEmpty();
 }
 
 //
@@ -703,7 +799,7 @@ static void B_handleWaggle(const line_t &line, fixed_t &maxRaise, fixed_t *minLo
       fixed_t raise, lower;
    };
 
-   static std::unordered_map<hashkey_t, amps_t, hashkey_t::hash_t> cache;
+   static thread_local std::unordered_map<hashkey_t, amps_t, hashkey_t::hash_t> cache;
 
    int height = line.args[1];
    int speed = line.args[2];
@@ -799,7 +895,7 @@ static void B_handleWaggle(const line_t &line, fixed_t &maxRaise, fixed_t *minLo
 static void B_pushSectorHeights(int secnum, const line_t& line,
                                 PODCollection<int>& indexList, const player_t& player)
 {
-   SectorHeightStack& affSector = g_affectedSectors[secnum];
+   SectorHeightStack& affSector = g_state->affectedSectors[secnum];
    const bool floorBlocked = affSector.isFloorTerminal();
    const bool ceilingBlocked = affSector.isCeilingTerminal();
    if(floorBlocked && ceilingBlocked)  // all blocked: impossible
@@ -1389,7 +1485,7 @@ static void B_pushSectorHeights(int secnum, const line_t& line,
    {
       if (floorBlocked || ceilingBlocked)
          return;
-      const SectorHeightStack& front = g_affectedSectors[line.frontsector - sectors];
+      const SectorHeightStack& front = g_state->affectedSectors[line.frontsector - sectors];
 
       sae.floorHeight = front.getFloorHeight();
       sae.ceilingHeight = sae.floorHeight + lastCeilingHeight - lastFloorHeight;
@@ -1686,7 +1782,7 @@ static bool B_fillInStairs(const sector_t* sector, SectorStateEntry& sae,
          if(comp[comp_stairs] || demo_version == 203)
             height += stairIncrement;
          
-         SectorHeightStack* otherAffSector = &g_affectedSectors[tsec - sectors];
+         SectorHeightStack* otherAffSector = &g_state->affectedSectors[tsec - sectors];
          if(otherAffSector->isFloorTerminal())
             continue;
          if(!comp[comp_stairs] && demo_version != 203)
@@ -1747,7 +1843,7 @@ static bool B_fillInGenStairs(const sector_t *sec, SectorStateEntry& sae, int sp
          if(demo_version < 202)
             height += dir * stairsize;
 
-         SectorHeightStack &otherAffSector = g_affectedSectors[tsec - sectors];
+         SectorHeightStack &otherAffSector = g_state->affectedSectors[tsec - sectors];
          if(otherAffSector.isFloorTerminal())
             continue;
          if(demo_version >= 202)
@@ -1785,7 +1881,7 @@ static bool B_fillInDonut(const sector_t& sector, SectorStateEntry& sae,
    if(!s2)
       return false;
    
-   SectorHeightStack& otherAffSector = g_affectedSectors[s2 - sectors];
+   SectorHeightStack& otherAffSector = g_state->affectedSectors[s2 - sectors];
    if(!comp[comp_floors] && otherAffSector.isFloorTerminal())
       return false;
    
@@ -1813,7 +1909,7 @@ static bool B_fillInDonut(const sector_t& sector, SectorStateEntry& sae,
       }
       else
       {
-         thirdAffSector = &g_affectedSectors[s3 - sectors];
+         thirdAffSector = &g_state->affectedSectors[s3 - sectors];
          s3_floorheight = thirdAffSector->getFloorHeight();
          s3_floorpic = thirdAffSector->getCeilingHeight();
       }
@@ -1878,7 +1974,7 @@ static fixed_t getMinTextureSize(const sector_t& sector)
 //
 fixed_t LevelStateStack::Ceiling(const sector_t& sector)
 {
-   return g_affectedSectors[&sector - sectors].getCeilingHeight();
+   return g_state->affectedSectors[&sector - sectors].getCeilingHeight();
 }
 
 //
@@ -1886,28 +1982,64 @@ fixed_t LevelStateStack::Ceiling(const sector_t& sector)
 //
 fixed_t LevelStateStack::Floor(const sector_t& sector)
 {
-   return g_affectedSectors[&sector - sectors].getFloorHeight();
+   return g_state->affectedSectors[&sector - sectors].getFloorHeight();
 }
 
 fixed_t LevelStateStack::AltFloor(const sector_t& sector)
 {
-    const SectorHeightStack& shs = g_affectedSectors[&sector - sectors];
+    const SectorHeightStack& shs = g_state->affectedSectors[&sector - sectors];
     return shs.getAltFloorHeight();
 }
 
 bool LevelStateStack::IsClear()
 {
-    return g_indexListStack.isEmpty();
+    return g_state->indexListStack.isEmpty();
 }
 
 void LevelStateStack::SetKeyPlayer(const player_t* player)
 {
-   g_keyPlayer = player;
+   g_state->keyPlayer = player;
 }
 
 void LevelStateStack::UseRealHeights(bool value)
 {
-   g_useRealHeights = value;
+   g_state->useRealHeights = value;
+}
+
+//
+// LevelStateStack::AppendStateKey
+//
+// Adds everything which decides the simulated heights to key. Equal keys
+// within the same generation give equal heights.
+//
+void LevelStateStack::AppendStateKey(std::vector<uintptr_t> &key)
+{
+   key.push_back((uintptr_t)g_state->keyPlayer);
+   key.push_back(g_state->useRealHeights);
+   for(const PushedLine &pushed : g_state->pushedLines)
+   {
+      key.push_back((uintptr_t)pushed.line);
+      key.push_back((uintptr_t)pushed.player);
+      key.push_back((uintptr_t)pushed.excludeSector);
+   }
+}
+
+//
+// LevelStateStack::Generation
+//
+unsigned LevelStateStack::Generation()
+{
+   return g_generation;
+}
+
+//
+// LevelStateStack::Invalidate
+//
+// Called when real sector heights or player inventories change
+//
+void LevelStateStack::Invalidate()
+{
+   ++g_generation;
 }
 
 //
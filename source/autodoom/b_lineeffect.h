@@ -30,16 +30,22 @@
 #ifndef __EternityEngine__b_lineeffect__
 #define __EternityEngine__b_lineeffect__
 
+#include <stdint.h>
+#include <vector>
 #include "../m_fixed.h"
 
 struct line_t;
 struct sector_t;
 struct player_t;
+struct LevelState;
 
 namespace LevelStateStack
 {
    void     InitLevel();
 
+   LevelState *NewState();
+   void     Bind(LevelState *state);
+
 enum PushResult
 {
    PushResult_none,        // no effect
@@ -66,6 +72,10 @@ inline static PushResult Peek(const line_t& line, const player_t& player,
    
    void SetKeyPlayer(const player_t* player);
    void UseRealHeights(bool value);
+
+   void     AppendStateKey(std::vector<uintptr_t> &key);
+   unsigned Generation();
+   void     Invalidate();
 }
 
 bool B_LineTriggersBackSector(const line_t &line);
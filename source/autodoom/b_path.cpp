@@ -27,18 +27,27 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <unordered_map>
 #include <vector>
 #include "../z_zone.h"
 
+#include "b_lineeffect.h"
 #include "b_path.h"
+#include "../c_runcmd.h"
 #include "../d_player.h"
+#include "../e_inventory.h"
 #include "../e_things.h"
 #include "../ev_specials.h"
 #include "../p_maputl.h"
 #include "../p_spec.h"
 #include "../r_state.h"
 
+// Use the cluster graph when looking for the nearest goal
+bool bot_clusterpath = true;
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Public methods
@@ -55,23 +64,40 @@ bool PathFinder::FindNextGoal(v2fixed_t pos, BotPath& path, bool urgent,
                               bool(*isGoal)(const BSubsec&, BotPathEnd&, void*),
                               void* parm)
 {
-    HeapEntry nhe;
+   BeginNextGoal(pos, urgent);
+   return ContinueNextGoal(path, isGoal, parm, 0) == PathSearchFound;
+}
+
+//
+// PathFinder::BeginNextGoal
+//
+// Starts a FindNextGoal search which can be spread across several tics by
+// ContinueNextGoal. Any unfinished search is discarded. Goals farther than
+// limit aren't looked for.
+//
+void PathFinder::BeginNextGoal(v2fixed_t pos, bool urgent, fixed_t limit)
+{
     m_dijkHeap.makeEmpty<true>();
 
     const BSubsec* first = &m_map->ssectors[0];
     
-    //compare.o = this;
-    //compare.first = first;
-    
     db[1].IncrementValidcount();
 
    const BSubsec& source = m_map->pointInSubsector(pos);
 
-    path.start = pos;
+   m_searchStart = pos;
+   m_urgent = urgent;
+   m_distLimit = limit;
 
-    //const BSubsec** front = db[1].ssqueue;
-    //const BSubsec** back = db[1].ssqueue;
-    BotPathEnd coord;
+   // The cluster graph only knows the real level state
+   m_clustered = bot_clusterpath && m_map->clusters && LevelStateStack::IsClear();
+   if(m_clustered && (m_passCache.getLength() != m_map->clusters->portals.getLength() ||
+                      m_passHeight != m_player->mo->height))
+   {
+      m_passCache.makeEmpty();
+      m_passCache.resize(m_map->clusters->portals.getLength());
+      m_passHeight = m_player->mo->height;
+   }
 
     int index = (int)(&source - first);
 
@@ -79,113 +105,28 @@ bool PathFinder::FindNextGoal(v2fixed_t pos, BotPath& path, bool urgent,
    db[1].items[index].prev = nullptr;
    db[1].items[index].dist = 0;
    db[1].items[index].pos = pos;
+   db[1].items[index].origin = -1;
 
+    HeapEntry nhe;
     nhe.ss = &source;
     nhe.dist = 0;
     m_dijkHeap.add(nhe);
 
-//    std::push_heap(front, back, compare);
-    const BSubsec* t;
-    const BNeigh* n;
-    path.inv.makeEmpty<true>();
-   path.sss.clear();
-    const TeleItem* bytele;
-    fixed_t tentative;
-
-   m_urgent = urgent;
+   m_searching = true;
+}
 
-//    std::make_heap(front, back, compare);
-    fixed_t founddist;
-    while (!m_dijkHeap.isEmpty())
-    {
-        std::pop_heap(m_dijkHeap.begin(), m_dijkHeap.end());
-        t = m_dijkHeap.back().ss;    // get the extracted one
-        founddist = m_dijkHeap.pop().dist;
-        if (founddist != db[1].items[t - first].dist)
-            continue;
-        
-        if (isGoal(*t, coord, parm))
-        {
-            path.last = t;
-            path.end = coord;
-           path.sss.insert(t);
-            for (;;)
-            {
-                n = db[1].items[t - first].prev;
-                if (!n)
-                    break;
-                path.inv.add(n);
-               path.sss.insert(n->myss);
-                t = n->myss;
-            }
-            return true;
-        }
-        
-        for (const BNeigh& neigh : t->neighs)
-        {
-            // Distance shall be from centre of source to middle of seg
-            
-            bytele = checkTeleportation(neigh);
-            index = (int)(neigh.otherss - first);
-            if (bytele)
-            {
-                index = (int)(bytele->ss - first);
-
-               fixed_t newdist;
-//               if(m_urgent)
-               {
-                  v2fixed_t org = db[1].items[t - first].pos;
-                  v2fixed_t proj = B_ProjectionOnSegment(org, neigh.v, neigh.d, 0);
-                  newdist = (proj - org).sqrtabs();
-               }
-//               else
-//                  newdist = (t->mid - neigh.v - neigh.d / 2).sqrtabs();
-
-               tentative = getAdjustedDistance(db[1].items[t - first].dist, newdist, t);
-                
-                if (db[1].items[index].visit != db[1].validcount ||
-                    tentative < db[1].items[index].dist)
-                {
-                    pushSubsectorToHeap(neigh, index, *bytele->ss, tentative, bytele->v);
-                }
-            }
-            else
-            {
-                // Hack to make the edge subsectors (which are never 'simple') less attractive to the pathfinder.
-                // Needed because the bot tends to easily fall off ledges because it chooses the subsector
-                // closest to the edge.
-                // FIXME: Still needs improvement.
-//                if(!msec->isInstanceOf(RTTI(SimpleMSector)))
-//                {
-//                    tentative = db[1].ssdist[t - first] + 2 * neigh.dist;
-//                }
-//                else
-
-               fixed_t newdist;
-               v2fixed_t proj;
-//               if(m_urgent)
-               {
-                  v2fixed_t org = db[1].items[t - first].pos;
-                  proj = B_ProjectionOnSegment(org, neigh.v, neigh.d, 0);
-                  newdist = (proj - org).sqrtabs();
-               }
-//               else
-//               {
-//                  newdist = neigh.dist;
-//                  proj = neigh.otherss->mid;
-//               }
-               tentative = getAdjustedDistance(db[1].items[t - first].dist, newdist, t);
-                
-                if((db[1].items[index].visit != db[1].validcount ||
-                    tentative < db[1].items[index].dist) &&
-                   m_map->canPass(*t, *neigh.otherss, m_player->mo->height))
-                {
-                    pushSubsectorToHeap(neigh, index, *neigh.otherss, tentative, proj);
-                }
-            }
-        }
-    }
-    return false;
+//
+// PathFinder::ContinueNextGoal
+//
+// Wrapper for callbacks taking a context pointer
+//
+PathSearchResult PathFinder::ContinueNextGoal(BotPath& path,
+                                              bool(*isGoal)(const BSubsec&, BotPathEnd&, void*),
+                                              void* parm, int budget)
+{
+   return ContinueNextGoal(path, [isGoal, parm](const BSubsec& ss, BotPathEnd& coord) {
+      return isGoal(ss, coord, parm);
+   }, budget);
 }
 
 void PathFinder::pushSubsectorToHeap(const BNeigh& neigh, int index, const BSubsec& ss,
@@ -195,6 +136,7 @@ void PathFinder::pushSubsectorToHeap(const BNeigh& neigh, int index, const BSubs
     db[1].items[index].prev = &neigh;
     db[1].items[index].dist = tentative;
    db[1].items[index].pos = pos;
+   db[1].items[index].origin = -1;
 
     HeapEntry &nhe = m_dijkHeap.addNew();
     nhe.dist = tentative;
@@ -202,86 +144,328 @@ void PathFinder::pushSubsectorToHeap(const BNeigh& neigh, int index, const BSubs
     std::push_heap(m_dijkHeap.begin(), m_dijkHeap.end());
 }
 
+//
+// PathFinder::expandClustered
+//
+// Cluster graph expansion of a subsector. The subsectors of clusters which
+// can't have any goals are skipped, by hopping between their borders.
+//
+void PathFinder::expandClustered(const BSubsec& t)
+{
+   const ClusterGraph &graph = *m_map->clusters;
+   const BSubsec *first = &m_map->ssectors[0];
+   int tindex = (int)(&t - first);
+
+   const ClusterGraph::Cluster &cluster = graph.clusterOf(t);
+   int border = graph.ssBorder[tindex];
+   if(graph.isEventful(cluster))
+   {
+      for(const BNeigh &neigh : t.neighs)
+         if(!graph.isPortal(neigh))
+            relaxNeigh(neigh, t, -1);
+   }
+   else if(db[1].items[tindex].origin == -1)
+   {
+      // Just entered the cluster: go straight to the other borders
+      if(border != -1)
+      {
+         for(int i = 0; i < cluster.numBorders; ++i)
+         {
+            if(i == border)
+               continue;
+            relaxBorderHop(t, *(first + graph.borders[cluster.firstBorder + i].ssindex),
+                           graph.borderDistance(cluster, border, i));
+         }
+      }
+      else
+      {
+         graph.localSearch(t, m_localDist, m_localPrev);
+         for(int i = 0; i < cluster.numBorders; ++i)
+         {
+            int ssindex = graph.borders[cluster.firstBorder + i].ssindex;
+            relaxBorderHop(t, *(first + ssindex), m_localDist[graph.ssLocal[ssindex]]);
+         }
+      }
+   }
+
+   if(border != -1)
+   {
+      const ClusterGraph::Border &b = graph.borders[cluster.firstBorder + border];
+      for(int i = b.firstPortal; i < b.firstPortal + b.numPortals; ++i)
+         relaxNeigh(*graph.portals[i], t, i);
+   }
+}
+
+//
+// PathFinder::relaxNeigh
+//
+// Updates the subsector behind neigh, the same way FindNextGoal does. Portal
+// is the index in the cluster graph, or -1 if the neigh is inside a cluster.
+//
+void PathFinder::relaxNeigh(const BNeigh& neigh, const BSubsec& t, int portal)
+{
+   const BSubsec *first = &m_map->ssectors[0];
+   const DataBox::Item &titem = db[1].items[&t - first];
+
+   v2fixed_t org = titem.pos;
+   v2fixed_t proj = B_ProjectionOnSegment(org, neigh.v, neigh.d, 0);
+   fixed_t tentative = getAdjustedDistance(titem.dist, (proj - org).sqrtabs(), &t);
+
+   const TeleItem *bytele = portal >= 0 ? checkTeleportation(neigh) : nullptr;
+   const BSubsec &dest = bytele ? *bytele->ss : *neigh.otherss;
+   int index = (int)(&dest - first);
+
+   if(db[1].items[index].visit == db[1].validcount &&
+      tentative >= db[1].items[index].dist)
+   {
+      return;
+   }
+   if(bytele)
+      pushSubsectorToHeap(neigh, index, dest, tentative, bytele->v);
+   else if(portal < 0 || canPassPortal(neigh, portal))
+      pushSubsectorToHeap(neigh, index, dest, tentative, proj);
+}
+
+//
+// PathFinder::relaxBorderHop
+//
+// Updates dest, reached from t through the inside of their cluster
+//
+void PathFinder::relaxBorderHop(const BSubsec& t, const BSubsec& dest, fixed_t add)
+{
+   if(add == D_MAXINT)
+      return;
+   const BSubsec *first = &m_map->ssectors[0];
+   int index = (int)(&dest - first);
+   fixed_t tentative = getAdjustedDistance(db[1].items[&t - first].dist, add, &t);
+   DataBox::Item &item = db[1].items[index];
+   if(item.visit == db[1].validcount && tentative >= item.dist)
+      return;
+
+   item.visit = db[1].validcount;
+   item.prev = nullptr;
+   item.dist = tentative;
+   item.pos = dest.mid;
+   item.origin = (int)(&t - first);
+
+   HeapEntry &nhe = m_dijkHeap.addNew();
+   nhe.dist = tentative;
+   nhe.ss = &dest;
+   std::push_heap(m_dijkHeap.begin(), m_dijkHeap.end());
+}
+
+//
+// PathFinder::canPassPortal
+//
+// Cached canPass. The cache is dropped whenever the bot map reports a change.
+//
+bool PathFinder::canPassPortal(const BNeigh& neigh, int portal)
+{
+   PassEntry &entry = m_passCache[portal];
+   unsigned generation = m_map->clusters->generation();
+   if(entry.stamp != generation)
+   {
+      entry.pass = m_map->canPass(*neigh.myss, *neigh.otherss, m_passHeight);
+      entry.stamp = generation;
+   }
+   return entry.pass;
+}
+
+//
+// PathFinder::buildPath
+//
+// Walks back from the goal. Border hops are expanded into neighs by searching
+// again inside their cluster.
+//
+void PathFinder::buildPath(const BSubsec* t, BotPath& path)
+{
+   const BSubsec *first = &m_map->ssectors[0];
+
+   path.start = m_searchStart;
+   path.inv.makeEmpty<true>();
+   path.sss.clear();
+   path.last = t;
+   path.sss.insert(t);
+   for(;;)
+   {
+      const DataBox::Item &item = db[1].items[t - first];
+      if(item.prev)
+      {
+         path.inv.add(item.prev);
+         t = item.prev->myss;
+         path.sss.insert(t);
+         continue;
+      }
+      if(item.origin == -1)
+         break;
+
+      const ClusterGraph &graph = *m_map->clusters;
+      const BSubsec *origin = first + item.origin;
+      graph.localSearch(*origin, m_localDist, m_localPrev);
+      for(const BNeigh *n = m_localPrev[graph.ssLocal[t - first]]; n;
+          n = m_localPrev[graph.ssLocal[n->myss - first]])
+      {
+         path.inv.add(n);
+         path.sss.insert(n->myss);
+      }
+      t = origin;
+   }
+}
+
+//
+// What-if reachability cache
+//
+// The subsectors found by AvailableGoals only depend on the source, the
+// player height and the simulated level state, so they're remembered in
+// search order. Callbacks are then just replayed on them. The whole cache is
+// dropped when the real level changes (LevelStateStack::Generation). Bots
+// thinking in parallel share it, so it's only accessed under g_reachMutex.
+//
+struct ReachKeyHash
+{
+   size_t operator () (const std::vector<uintptr_t> &key) const
+   {
+      size_t hash = 0;
+      for(uintptr_t value : key)
+         hash = hash * 31 + std::hash<uintptr_t>()(value);
+      return hash;
+   }
+};
+
+static std::unordered_map<std::vector<uintptr_t>, std::shared_ptr<const std::vector<int>>,
+                          ReachKeyHash> g_reachCache;
+static unsigned g_reachGeneration;
+static std::mutex g_reachMutex;
+
+enum
+{
+   REACH_CACHE_MAX = 4096, // entries kept before starting over
+};
+
+bool bot_reachcache = true;
+
 //
 // PathFinder::AvailableGoals
 //
-// Looks for any goals from point X. Uses simple breadth first search.
-// Returns all the good subsectors into the collection
-// Uses a function for criteria.
+// Wrapper for callbacks taking a context pointer
 //
 bool PathFinder::AvailableGoals(const BSubsec& source,
                                 std::unordered_set<const BSubsec*>* dests,
                                 PathResult(*isGoal)(const BSubsec&, void*),
                                 void* parm)
 {
-    db[0].IncrementValidcount();
+   return AvailableGoals(source, dests, [isGoal, parm](const BSubsec& ss) {
+      return isGoal(ss, parm);
+   });
+}
 
-    const BSubsec** front = db[0].ssqueue;
-    const BSubsec** back = db[0].ssqueue;
+//
+// B_appendKeySet
+//
+// Adds the keys the player has to a reach cache key, since they decide which
+// locked lines can be crossed. Keys can be given or taken in many places.
+//
+static void B_appendKeySet(std::vector<uintptr_t>& key, const player_t& player)
+{
+    const size_t numkeys = E_GetNumKeyItems();
+    const size_t bits = sizeof(uintptr_t) * 8;
+    for (size_t base = 0; base < numkeys; base += bits)
+    {
+        uintptr_t word = 0;
+        for (size_t i = base; i < numkeys && i < base + bits; ++i)
+            if (E_GetItemOwnedAmount(&player, E_KeyItemForIndex(i)) > 0)
+                word |= (uintptr_t)1 << (i - base);
+        key.push_back(word);
+    }
+}
 
+//
+// PathFinder::findReachOrder
+//
+// Looks up the subsectors found earlier by an AvailableGoals search from
+// source. If they're missing, returns null and sets up key for
+// storeReachOrder.
+//
+std::shared_ptr<const std::vector<int>>
+PathFinder::findReachOrder(const BSubsec& source, std::vector<uintptr_t>& key) const
+{
     const BSubsec* first = &m_map->ssectors[0];
-    db[0].items[&source - first].visit = db[0].validcount;
-    *back++ = &source;
-    const BSubsec* t;
-    PathResult res;
-    const TeleItem* bytele;
-    while (front < back)
+
+    key.clear();
+    key.push_back(&source - first);
+    key.push_back(m_player->mo->height);
+    B_appendKeySet(key, *m_player);
+    LevelStateStack::AppendStateKey(key);
+
+    std::lock_guard<std::mutex> lock(g_reachMutex);
+    if (g_reachGeneration != LevelStateStack::Generation() ||
+        g_reachCache.size() >= REACH_CACHE_MAX)
     {
-       I_Assert(front - db[0].ssqueue < (ptrdiff_t)db[0].sscount, "Front sscoount error: %d >= %u!\n",
-                eindex(front - db[0].ssqueue), db[0].sscount);
-        t = *front++;
-        res = isGoal(*t, parm);
-        if (res == PathAdd && dests)
-            dests->insert(t);
-        else if (res == PathDone)
-            return true;
-        for (const BNeigh& neigh : t->neighs)
-        {
-            bytele = checkTeleportation(neigh);
-            if (bytele)
-            {
-                if (db[0].items[bytele->ss - first].visit != db[0].validcount)
-                {
-                    db[0].items[bytele->ss - first].visit = db[0].validcount;
-                   I_Assert(back - db[0].ssqueue < (ptrdiff_t)db[0].sscount,
-                            "Back sscoount tele error: %d >= %u!\n", eindex(back - db[0].ssqueue),
-                            db[0].sscount);
-                    *back++ = bytele->ss;
-                }
-            }
-            else if (db[0].items[neigh.otherss - first].visit != db[0].validcount
-                && m_map->canPass(*t, *neigh.otherss, m_player->mo->height))
-            {
-                db[0].items[neigh.otherss - first].visit = db[0].validcount;
-               I_Assert(back - db[0].ssqueue < (ptrdiff_t)db[0].sscount, "Back sscoount error: %d >= %u!\n",
-                        eindex(back - db[0].ssqueue), db[0].sscount);
-                *back++ = neigh.otherss;
-            }
-        }
+        g_reachCache.clear();
+        g_reachGeneration = LevelStateStack::Generation();
     }
+    auto it = g_reachCache.find(key);
+    return it != g_reachCache.end() ? it->second : nullptr;
+}
+
+//
+// PathFinder::storeReachOrder
+//
+// Remembers the subsectors queued by the finished AvailableGoals search
+//
+void PathFinder::storeReachOrder(std::vector<uintptr_t>&& key, const BSubsec** back)
+{
+    const BSubsec* first = &m_map->ssectors[0];
+
+    auto order = std::make_shared<std::vector<int>>(back - db[0].ssqueue);
+    for (int i = 0; i < (int)order->size(); ++i)
+        (*order)[i] = (int)(db[0].ssqueue[i] - first);
 
-    return false;
+    std::lock_guard<std::mutex> lock(g_reachMutex);
+    if (g_reachGeneration == LevelStateStack::Generation())
+        g_reachCache.emplace(std::move(key), std::move(order));
 }
 
 //
-// Adjusts distance if the sector is painful
+// PathFinder::playerHeight
 //
-fixed_t PathFinder::getAdjustedDistance(fixed_t base, fixed_t add, const BSubsec *t) const
+fixed_t PathFinder::playerHeight() const
 {
-   fixed_t tentative = 0;
-   int factor = 1;
+   return m_player->mo->height;
+}
 
-   const sector_t *sector = t->msector->getFloorSector();
-   if(enable_nuke && !m_urgent && sector->damage > 0 &&
-      (!m_player->powers[pw_ironfeet] || sector->damageflags & SDMG_IGNORESUIT))
+//
+// B_PainfulSectorFactor
+//
+// How many times longer a walk through the sector should seem, because of its
+// damage. player may be null for someone without a radiation suit.
+//
+int B_PainfulSectorFactor(const sector_t &sector, const player_t *player)
+{
+   int factor = 1;
+   if(enable_nuke && sector.damage > 0 &&
+      (!player || !player->powers[pw_ironfeet] || sector.damageflags & SDMG_IGNORESUIT))
    {
-      if(sector->damagemask <= 0)
-         factor = sector->damage * 32;
+      if(sector.damagemask <= 0)
+         factor = sector.damage * 32;
       else
-         factor = sector->damage * 32 / sector->damagemask;
+         factor = sector.damage * 32 / sector.damagemask;
       if(factor < 1)
          factor = 1;
    }
+   return factor;
+}
+
+//
+// Adjusts distance if the sector is painful
+//
+fixed_t PathFinder::getAdjustedDistance(fixed_t base, fixed_t add, const BSubsec *t) const
+{
+   fixed_t tentative = 0;
+   int factor = 1;
+
+   if(!m_urgent)
+      factor = B_PainfulSectorFactor(*t->msector->getFloorSector(), m_player);
    tentative = base + add * factor;
    if(tentative < 0) // overflow case
       return D_MAXINT;
@@ -372,46 +556,42 @@ void PathFinder::DataBox::IncrementValidcount()
           items[i].visit = static_cast<unsigned short>(-1);
 }
 
+VARIABLE_TOGGLE(bot_clusterpath, nullptr, onoff);
+CONSOLE_VARIABLE(bot_clusterpath, bot_clusterpath, 0) {}
+
+VARIABLE_TOGGLE(bot_reachcache, nullptr, onoff);
+CONSOLE_VARIABLE(bot_reachcache, bot_reachcache, 0) {}
+
 //
-// Does a breadth-first (neighbourhood-based, but not distance-aware) search
-// from a starting subsector ahead.
+// B_BeginBreadthFirst
 //
-// There are two functions to use here:
-//  passfunc(): returns true if neigh can be passed (usually by a player).
-//  scanfunc(): returns true if subsector has goal.
-// Both functions can capture external parameters, so it's feasible to return
-// false from scanfunc() but still use it to gather data.
+// Gets the scratch space of this thread for a new B_FindBreadthFirst search
 //
-bool B_FindBreadthFirst(const BSubsec &first,
-                        std::function<bool(const BNeigh &)> &&passfunc,
-                        std::function<bool(const BSubsec &)> &&scanfunc)
+BreadthFirstScratch &B_BeginBreadthFirst()
 {
-   std::queue<const BSubsec *> q;
-   std::vector<bool> visited;
-   visited.resize(botMap->ssectors.getLength());
+   static thread_local BreadthFirstScratch scratch;
 
-   const BSubsec &fss = botMap->ssectors[0];
-
-   q.push(&first);
-   visited[&first - &fss] = true;
-   while(!q.empty())
+   size_t numss = botMap->ssectors.getLength();
+   if(scratch.visited.size() != numss || !++scratch.visitstamp)
    {
-      const BSubsec *ss = q.front();
-      q.pop();
-      if(scanfunc(*ss))
-         return true;
-      for(const auto &neigh : ss->neighs)
-      {
-         if(!passfunc(neigh))
-            continue;
-         const BSubsec *nss = neigh.otherss;
-         if(visited[nss - &fss])
-            continue;
-         q.push(nss);
-         visited[nss - &fss] = true;
-      }
+      scratch.visited.assign(numss, 0);
+      scratch.visitstamp = 1;
    }
-   return false;
+   return scratch;
+}
+
+//
+// B_FindBreadthFirst
+//
+// Wrapper for callers holding std::functions
+//
+bool B_FindBreadthFirst(const BSubsec &first,
+                        std::function<bool(const BNeigh &)> &&passfunc,
+                        std::function<bool(const BSubsec &)> &&scanfunc)
+{
+   return B_FindBreadthFirst<std::function<bool(const BNeigh &)> &,
+                             std::function<bool(const BSubsec &)> &>(first, passfunc,
+                                                                     scanfunc);
 }
 
 // EOF
@@ -31,8 +31,13 @@
 #define __EternityEngine__b_path__
 
 #include <map>
+#include <memory>
+#include <unordered_set>
+#include <vector>
 #include "b_botmap.h"
+#include "b_cluster.h"
 #include "b_util.h"
+#include "../i_system.h"
 #include "../m_collection.h"
 
 //
@@ -75,6 +80,14 @@ enum PathResult
     PathDone
 };
 
+enum PathSearchResult
+{
+    PathSearchNotFound,
+    PathSearchFound,
+    PathSearchOngoing,
+    PathSearchBeyondLimit   // nothing found within the distance limit
+};
+
 class PathFinder
 {
 public:
@@ -94,7 +107,30 @@ public:
 
     bool FindNextGoal(v2fixed_t pos, BotPath& path, bool urgent,
                       bool(*isGoal)(const BSubsec&, BotPathEnd&, void*), void* parm = nullptr);
+    template<typename F>
+    bool FindNextGoal(v2fixed_t pos, BotPath& path, bool urgent, F&& isGoal)
+    {
+       BeginNextGoal(pos, urgent);
+       return ContinueNextGoal(path, isGoal, 0) == PathSearchFound;
+    }
+    void BeginNextGoal(v2fixed_t pos, bool urgent, fixed_t limit = D_MAXINT);
+    PathSearchResult ContinueNextGoal(BotPath& path,
+                                      bool(*isGoal)(const BSubsec&, BotPathEnd&, void*),
+                                      void* parm, int budget);
+    template<typename F>
+    PathSearchResult ContinueNextGoal(BotPath& path, F&& isGoal, int budget);
+    bool IsSearching() const
+    {
+        return m_searching;
+    }
+    void AbortSearch()
+    {
+        m_searching = false;
+    }
     bool AvailableGoals(const BSubsec& source, std::unordered_set<const BSubsec*>* dests, PathResult(*isGoal)(const BSubsec&, void*), void* parm = nullptr);
+    template<typename F>
+    bool AvailableGoals(const BSubsec& source, std::unordered_set<const BSubsec*>* dests,
+                        F&& isGoal);
 
     void SetPlayer(const player_t *player)
     {
@@ -113,7 +149,9 @@ public:
         db[1].Clear();
         m_teleCache.clear();
         m_dijkHeap.clear();
+        m_passCache.clear();
        m_urgent = false;
+       m_searching = false;
     }
 
 private:
@@ -131,6 +169,7 @@ private:
           const BNeigh *prev;
           fixed_t dist;
           v2fixed_t pos;
+          int origin; // cluster entry subsector if reached by a border hop
        };
 
        Item *items;
@@ -169,12 +208,38 @@ private:
         }
     };
 
+    //
+    // PassEntry
+    //
+    // Cached canPass result of a cluster portal
+    //
+    struct PassEntry
+    {
+       unsigned stamp;  // ClusterGraph generation when checked
+       bool pass;
+    };
+
     PODCollection<HeapEntry>    m_dijkHeap;
+    PODCollection<PassEntry>    m_passCache;
+    fixed_t                     m_passHeight = 0;
+
+    // Scratch space for searches within a cluster
+    fixed_t m_localDist[ClusterGraph::MAX_CLUSTER_SIZE];
+    const BNeigh *m_localPrev[ClusterGraph::MAX_CLUSTER_SIZE];
     
     void            pushSubsectorToHeap(const BNeigh& neigh, int index, 
                                         const BSubsec& ss, fixed_t tentative, v2fixed_t pos);
+    void expandClustered(const BSubsec& t);
+    void relaxNeigh(const BNeigh& neigh, const BSubsec& t, int portal);
+    void relaxBorderHop(const BSubsec& t, const BSubsec& dest, fixed_t add);
+    bool canPassPortal(const BNeigh& neigh, int portal);
+    void buildPath(const BSubsec* t, BotPath& path);
     const TeleItem* checkTeleportation(const BNeigh& neigh);
    fixed_t getAdjustedDistance(fixed_t base, fixed_t add, const BSubsec *t) const;
+   fixed_t playerHeight() const;
+   std::shared_ptr<const std::vector<int>> findReachOrder(const BSubsec& source,
+                                                          std::vector<uintptr_t>& key) const;
+   void storeReachOrder(std::vector<uintptr_t>&& key, const BSubsec** back);
 
     const BotMap*   m_map;
     DataBox         db[2];
@@ -183,9 +248,296 @@ private:
    const player_t *m_player;
    bool m_urgent = false;
 
+   // State kept between BeginNextGoal and ContinueNextGoal calls
+   bool m_searching = false;
+   bool m_clustered = false;
+   v2fixed_t m_searchStart = {};
+   fixed_t m_distLimit = D_MAXINT;
+
     std::unordered_map<const line_t*, TeleItem> m_teleCache; // teleporter cache
 };
 
+extern bool bot_reachcache;
+
+//
+// PathFinder::ContinueNextGoal
+//
+// Runs the search started by BeginNextGoal. At most budget subsectors are
+// expanded (0 means no limit) before returning PathSearchOngoing. The path
+// is only written when the search ends. isGoal(ss, coord) tells whether a
+// subsector holds a goal, setting coord to it. Returns PathSearchBeyondLimit
+// once all subsectors within the distance limit were checked.
+//
+template<typename F>
+PathSearchResult PathFinder::ContinueNextGoal(BotPath& path, F&& isGoal, int budget)
+{
+    if(!m_searching)
+        return PathSearchNotFound;
+
+    const BSubsec* first = &m_map->ssectors[0];
+    BotPathEnd coord;
+
+    const BSubsec* t;
+    const TeleItem* bytele;
+    fixed_t tentative;
+    int index;
+    int expanded = 0;
+
+    fixed_t founddist;
+    while (!m_dijkHeap.isEmpty())
+    {
+        if(budget > 0 && expanded >= budget)
+            return PathSearchOngoing;
+
+        std::pop_heap(m_dijkHeap.begin(), m_dijkHeap.end());
+        t = m_dijkHeap.back().ss;    // get the extracted one
+        founddist = m_dijkHeap.pop().dist;
+        if (founddist != db[1].items[t - first].dist)
+            continue;
+        if (founddist > m_distLimit)
+        {
+            m_searching = false;
+            return PathSearchBeyondLimit;
+        }
+        ++expanded;
+
+        // Clusters without eventful contents can't hold goals
+        if ((!m_clustered || m_map->clusters->isEventful(m_map->clusters->clusterOf(*t))) &&
+            isGoal(*t, coord))
+        {
+            m_searching = false;
+            buildPath(t, path);
+            path.end = coord;
+            return PathSearchFound;
+        }
+
+        if (m_clustered)
+        {
+            expandClustered(*t);
+            continue;
+        }
+        
+        for (const BNeigh& neigh : t->neighs)
+        {
+            // Distance shall be from centre of source to middle of seg
+            
+            bytele = checkTeleportation(neigh);
+            index = (int)(neigh.otherss - first);
+            if (bytele)
+            {
+                index = (int)(bytele->ss - first);
+
+               fixed_t newdist;
+//               if(m_urgent)
+               {
+                  v2fixed_t org = db[1].items[t - first].pos;
+                  v2fixed_t proj = B_ProjectionOnSegment(org, neigh.v, neigh.d, 0);
+                  newdist = (proj - org).sqrtabs();
+               }
+//               else
+//                  newdist = (t->mid - neigh.v - neigh.d / 2).sqrtabs();
+
+               tentative = getAdjustedDistance(db[1].items[t - first].dist, newdist, t);
+                
+                if (db[1].items[index].visit != db[1].validcount ||
+                    tentative < db[1].items[index].dist)
+                {
+                    pushSubsectorToHeap(neigh, index, *bytele->ss, tentative, bytele->v);
+                }
+            }
+            else
+            {
+                // Hack to make the edge subsectors (which are never 'simple') less attractive to the pathfinder.
+                // Needed because the bot tends to easily fall off ledges because it chooses the subsector
+                // closest to the edge.
+                // FIXME: Still needs improvement.
+//                if(!msec->isInstanceOf(RTTI(SimpleMSector)))
+//                {
+//                    tentative = db[1].ssdist[t - first] + 2 * neigh.dist;
+//                }
+//                else
+
+               fixed_t newdist;
+               v2fixed_t proj;
+//               if(m_urgent)
+               {
+                  v2fixed_t org = db[1].items[t - first].pos;
+                  proj = B_ProjectionOnSegment(org, neigh.v, neigh.d, 0);
+                  newdist = (proj - org).sqrtabs();
+               }
+//               else
+//               {
+//                  newdist = neigh.dist;
+//                  proj = neigh.otherss->mid;
+//               }
+               tentative = getAdjustedDistance(db[1].items[t - first].dist, newdist, t);
+                
+                if((db[1].items[index].visit != db[1].validcount ||
+                    tentative < db[1].items[index].dist) &&
+                   m_map->canPass(*t, *neigh.otherss, playerHeight()))
+                {
+                    pushSubsectorToHeap(neigh, index, *neigh.otherss, tentative, proj);
+                }
+            }
+        }
+    }
+
+    m_searching = false;
+    path.start = m_searchStart;
+    path.inv.makeEmpty<true>();
+   path.sss.clear();
+    return PathSearchNotFound;
+}
+
+//
+// PathFinder::AvailableGoals
+//
+// Looks for any goals from point X. Uses simple breadth first search.
+// Returns all the good subsectors into the collection
+// Uses a function for criteria: isGoal(ss) returns a PathResult.
+//
+template<typename F>
+bool PathFinder::AvailableGoals(const BSubsec& source,
+                                std::unordered_set<const BSubsec*>* dests,
+                                F&& isGoal)
+{
+    const BSubsec* first = &m_map->ssectors[0];
+
+    std::vector<uintptr_t> key;
+    bool record = false;
+    if (bot_reachcache)
+    {
+        std::shared_ptr<const std::vector<int>> order = findReachOrder(source, key);
+        if (order)
+        {
+            for (int index : *order)
+            {
+                PathResult res = isGoal(first[index]);
+                if (res == PathAdd && dests)
+                    dests->insert(first + index);
+                else if (res == PathDone)
+                    return true;
+            }
+            return false;
+        }
+        record = true;
+    }
+
+    db[0].IncrementValidcount();
+
+    const BSubsec** front = db[0].ssqueue;
+    const BSubsec** back = db[0].ssqueue;
+
+    db[0].items[&source - first].visit = db[0].validcount;
+    *back++ = &source;
+    const BSubsec* t;
+    PathResult res;
+    const TeleItem* bytele;
+    while (front < back)
+    {
+       I_Assert(front - db[0].ssqueue < (ptrdiff_t)db[0].sscount, "Front sscoount error: %d >= %u!\n",
+                eindex(front - db[0].ssqueue), db[0].sscount);
+        t = *front++;
+        res = isGoal(*t);
+        if (res == PathAdd && dests)
+            dests->insert(t);
+        else if (res == PathDone)
+        {
+            // The callback may have pushed a new state, so this partial search
+            // isn't kept
+            return true;
+        }
+        for (const BNeigh& neigh : t->neighs)
+        {
+            bytele = checkTeleportation(neigh);
+            if (bytele)
+            {
+                if (db[0].items[bytele->ss - first].visit != db[0].validcount)
+                {
+                    db[0].items[bytele->ss - first].visit = db[0].validcount;
+                   I_Assert(back - db[0].ssqueue < (ptrdiff_t)db[0].sscount,
+                            "Back sscoount tele error: %d >= %u!\n", eindex(back - db[0].ssqueue),
+                            db[0].sscount);
+                    *back++ = bytele->ss;
+                }
+            }
+            else if (db[0].items[neigh.otherss - first].visit != db[0].validcount
+                && m_map->canPass(*t, *neigh.otherss, playerHeight()))
+            {
+                db[0].items[neigh.otherss - first].visit = db[0].validcount;
+               I_Assert(back - db[0].ssqueue < (ptrdiff_t)db[0].sscount, "Back sscoount error: %d >= %u!\n",
+                        eindex(back - db[0].ssqueue), db[0].sscount);
+                *back++ = neigh.otherss;
+            }
+        }
+    }
+
+    if (record)
+        storeReachOrder(std::move(key), back);
+
+    return false;
+}
+
+//
+// BreadthFirstScratch
+//
+// Scratch space of B_FindBreadthFirst, kept per thread, so bots thinking in
+// parallel have their own
+//
+struct BreadthFirstScratch
+{
+   std::vector<const BSubsec *> queue;
+   std::vector<unsigned> visited;
+   unsigned visitstamp = 0;
+};
+
+BreadthFirstScratch &B_BeginBreadthFirst();
+
+int B_PainfulSectorFactor(const sector_t &sector, const player_t *player);
+
+//
+// Does a breadth-first (neighbourhood-based, but not distance-aware) search
+// from a starting subsector ahead.
+//
+// There are two functions to use here:
+//  passfunc(): returns true if neigh can be passed (usually by a player).
+//  scanfunc(): returns true if subsector has goal.
+// Both functions can capture external parameters, so it's feasible to return
+// false from scanfunc() but still use it to gather data. They must not start
+// another search, since the scratch space is reused.
+//
+template<typename P, typename S>
+bool B_FindBreadthFirst(const BSubsec &first, P &&passfunc, S &&scanfunc)
+{
+   BreadthFirstScratch &scratch = B_BeginBreadthFirst();
+   std::vector<const BSubsec *> &queue = scratch.queue;
+   unsigned *visited = scratch.visited.data();
+   unsigned visitstamp = scratch.visitstamp;
+
+   const BSubsec &fss = botMap->ssectors[0];
+
+   queue.clear();
+   queue.push_back(&first);
+   visited[&first - &fss] = visitstamp;
+   for(size_t head = 0; head < queue.size(); ++head)
+   {
+      const BSubsec *ss = queue[head];
+      if(scanfunc(*ss))
+         return true;
+      for(const auto &neigh : ss->neighs)
+      {
+         if(!passfunc(neigh))
+            continue;
+         const BSubsec *nss = neigh.otherss;
+         if(visited[nss - &fss] == visitstamp)
+            continue;
+         queue.push_back(nss);
+         visited[nss - &fss] = visitstamp;
+      }
+   }
+   return false;
+}
+
 bool B_FindBreadthFirst(const BSubsec &first,
                         std::function<bool(const BNeigh &)> &&passfunc,
                         std::function<bool(const BSubsec &)> &&scanfunc);
@@ -0,0 +1,142 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Level-wide storage of the mobjs and trigger lines found in each bot
+//      map subsector.
+//
+//-----------------------------------------------------------------------------
+
+#include "../z_zone.h"
+
+#include "b_substore.h"
+
+//
+// SubsecStore::init
+//
+// Empties the store, preparing it for the given subsector count
+//
+void SubsecStore::init(int numssectors)
+{
+   m_mobjs.init(numssectors);
+   m_mobjLinks.init(numssectors);
+   m_links.clear();
+   m_freeLink = -1;
+   m_mobjHeads.clear();
+   m_lines.init(numssectors);
+   m_linePoints.init(numssectors);
+}
+
+//
+// SubsecStore::linkMobj
+//
+// Adds the mobj to the subsector. Returns false if it was already there.
+//
+bool SubsecStore::linkMobj(const Mobj *mo, int ss)
+{
+   int &head = m_mobjHeads.emplace(mo, -1).first->second;
+   for(int l = head; l != -1; l = m_links[l].next)
+      if(m_links[l].ss == ss)
+         return false;
+
+   int index;
+   if(m_freeLink != -1)
+   {
+      index = m_freeLink;
+      m_freeLink = m_links[index].next;
+   }
+   else
+   {
+      index = (int)m_links.getLength();
+      m_links.addNew();
+   }
+
+   Link &link = m_links[index];
+   link.ss = ss;
+   link.slot = m_mobjs.add(ss, mo);
+   m_mobjLinks.add(ss, index);
+   link.next = head;
+   head = index;
+   return true;
+}
+
+//
+// SubsecStore::unlinkMobj
+//
+// Removes the mobj from all its subsectors, calling onUnlink for each of them
+//
+void SubsecStore::unlinkMobj(const Mobj *mo, const std::function<void(int)> &onUnlink)
+{
+   auto it = m_mobjHeads.find(mo);
+   if(it == m_mobjHeads.end())
+      return;
+
+   int l = it->second;
+   while(l != -1)
+   {
+      const Link link = m_links[l];
+      m_mobjs.remove(link.ss, link.slot);
+      if(m_mobjLinks.remove(link.ss, link.slot))
+      {
+         // Another mobj took the slot
+         m_links[m_mobjLinks.begin(link.ss)[link.slot]].slot = link.slot;
+      }
+      onUnlink(link.ss);
+
+      m_links[l].next = m_freeLink;
+      m_freeLink = l;
+      l = link.next;
+   }
+   // Don't keep entries for every mobj which ever existed
+   m_mobjHeads.erase(it);
+}
+
+//
+// SubsecStore::findLine
+//
+// Returns the activation spot of the line from the subsector, if any
+//
+const v2fixed_t *SubsecStore::findLine(int ss, const line_t *line) const
+{
+   const line_t *const *first = m_lines.begin(ss);
+   int count = m_lines.count(ss);
+   for(int i = 0; i < count; ++i)
+      if(first[i] == line)
+         return m_linePoints.begin(ss) + i;
+   return nullptr;
+}
+
+//
+// SubsecStore::addLine
+//
+// Adds a trigger line, unless it's already in the subsector
+//
+void SubsecStore::addLine(int ss, const line_t *line, v2fixed_t point)
+{
+   if(hasLine(ss, line))
+      return;
+   m_lines.add(ss, line);
+   m_linePoints.add(ss, point);
+}
+
+// EOF
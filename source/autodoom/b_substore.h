@@ -0,0 +1,249 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Level-wide storage of the mobjs and trigger lines found in each bot
+//      map subsector.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef B_SUBSTORE_H_
+#define B_SUBSTORE_H_
+
+#include <functional>
+#include <unordered_map>
+#include "../m_collection.h"
+#include "../m_vector.h"
+
+class Mobj;
+struct line_t;
+
+//
+// SubsecSpans
+//
+// One contiguous span per subsector, all inside a single array. A full span
+// grows by moving to the end of the array, and the holes left behind are
+// reclaimed once they take too much room. Items keep their index within the
+// span (slot) when the span moves, so slots can be referenced from outside.
+// Two instances which get the same sequence of calls have the same layout,
+// which is used to keep parallel arrays.
+//
+template<typename T>
+class SubsecSpans
+{
+public:
+   void init(int numssectors)
+   {
+      m_spans.clear();
+      m_spans.resize(numssectors);
+      m_items.clear();
+      m_wasted = 0;
+   }
+
+   int count(int ss) const
+   {
+      return m_spans[ss].count;
+   }
+   T *begin(int ss) const
+   {
+      return m_items.begin() + m_spans[ss].first;
+   }
+   T *end(int ss) const
+   {
+      const Span &span = m_spans[ss];
+      return m_items.begin() + span.first + span.count;
+   }
+
+   //
+   // Appends an item and returns its slot. Invalidates the span pointers.
+   //
+   int add(int ss, const T &item)
+   {
+      Span &span = m_spans[ss];
+      if(span.count == span.capacity)
+         grow(span);
+      m_items[span.first + span.count] = item;
+      return span.count++;
+   }
+
+   //
+   // Removes the item by moving the last one of the span into its slot.
+   // Returns true if such a move happened.
+   //
+   bool remove(int ss, int slot)
+   {
+      Span &span = m_spans[ss];
+      --span.count;
+      if(slot == span.count)
+         return false;
+      m_items[span.first + slot] = m_items[span.first + span.count];
+      return true;
+   }
+
+private:
+   enum
+   {
+      INITIAL_CAPACITY = 2,
+      MIN_COMPACT_WASTE = 1024,  // don't bother compacting small arrays
+   };
+
+   struct Span
+   {
+      int first;
+      int count;
+      int capacity;
+   };
+
+   void grow(Span &span)
+   {
+      int newcapacity = span.capacity ? span.capacity * 2 : INITIAL_CAPACITY;
+      int length = (int)m_items.getLength();
+      if(span.capacity && span.first + span.capacity == length)
+      {
+         // Already at the end, so just extend it
+         m_items.resize(length + newcapacity - span.capacity);
+      }
+      else
+      {
+         m_items.resize(length + newcapacity);
+         for(int i = 0; i < span.count; ++i)
+            m_items[length + i] = m_items[span.first + i];
+         m_wasted += span.capacity;
+         span.first = length;
+      }
+      span.capacity = newcapacity;
+
+      if(m_wasted >= MIN_COMPACT_WASTE && m_wasted * 2 > (int)m_items.getLength())
+         compact();
+   }
+
+   void compact()
+   {
+      PODCollection<T> items;
+      items.resize(m_items.getLength() - m_wasted);
+      int length = 0;
+      for(Span &span : m_spans)
+      {
+         for(int i = 0; i < span.count; ++i)
+            items[length + i] = m_items[span.first + i];
+         span.first = length;
+         length += span.capacity;
+      }
+      m_items = std::move(items);
+      m_wasted = 0;
+   }
+
+   PODCollection<Span> m_spans;
+   PODCollection<T> m_items;
+   int m_wasted = 0;
+};
+
+//
+// SubsecStore
+//
+// Mobjs and trigger lines of each subsector, kept as structure of arrays which
+// the path finder scans in place. Mobj links are removed in constant time, by
+// swapping with the last one of the subsector.
+//
+class SubsecStore
+{
+public:
+   //
+   // Read-only range, for range-based for loops
+   //
+   template<typename T>
+   struct Range
+   {
+      const T *first;
+      const T *last;
+
+      const T *begin() const
+      {
+         return first;
+      }
+      const T *end() const
+      {
+         return last;
+      }
+      int size() const
+      {
+         return (int)(last - first);
+      }
+      bool empty() const
+      {
+         return first == last;
+      }
+   };
+
+   void init(int numssectors);
+
+   Range<const Mobj *> mobjs(int ss) const
+   {
+      return { m_mobjs.begin(ss), m_mobjs.end(ss) };
+   }
+   bool linkMobj(const Mobj *mo, int ss);
+   void unlinkMobj(const Mobj *mo, const std::function<void(int)> &onUnlink);
+
+   //
+   // Trigger lines, with the spots from which they can be activated
+   //
+   Range<const line_t *> lines(int ss) const
+   {
+      return { m_lines.begin(ss), m_lines.end(ss) };
+   }
+   const v2fixed_t *linePoints(int ss) const
+   {
+      return m_linePoints.begin(ss);
+   }
+   const v2fixed_t *findLine(int ss, const line_t *line) const;
+   bool hasLine(int ss, const line_t *line) const
+   {
+      return findLine(ss, line) != nullptr;
+   }
+   void addLine(int ss, const line_t *line, v2fixed_t point);
+
+private:
+   //
+   // Link of a mobj into a subsector. The links of each mobj form a list.
+   //
+   struct Link
+   {
+      int ss;
+      int slot;   // within the subsector span
+      int next;   // next link of the same mobj, or next free link
+   };
+
+   SubsecSpans<const Mobj *> m_mobjs;
+   SubsecSpans<int> m_mobjLinks;    // parallel to m_mobjs: index into m_links
+   PODCollection<Link> m_links;
+   int m_freeLink = -1;
+   std::unordered_map<const Mobj *, int> m_mobjHeads;  // first link of mobj
+
+   SubsecSpans<const line_t *> m_lines;
+   SubsecSpans<v2fixed_t> m_linePoints;   // parallel to m_lines
+};
+
+#endif
+
+// EOF
+
@@ -26,16 +26,22 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <queue>
+#include <unordered_map>
 #include "../z_zone.h"
 
 #include "b_analysis.h"
+#include "b_bench.h"
+#include "b_flowfield.h"
 #include "b_itemlearn.h"
+#include "b_lineeffect.h"
 #include "b_statistics.h"
 #include "b_think.h"
 #include "b_util.h"
 #include "b_vocabulary.h"
 #include "b_weapon.h"
+#include "../c_runcmd.h"
 #include "../cam_sight.h"
 #include "../d_event.h"
 #include "../d_gi.h"
@@ -52,9 +58,13 @@
 #include "../g_game.h"
 #include "../hu_stuff.h"
 #include "../in_lude.h"
+#include "../m_bbox.h"
 #include "../m_compare.h"
+#include "../m_profile.h"
 #include "../m_qstr.h"
 #include "../p_maputl.h"
+#include "../p_portalcross.h"
+#include "../p_setup.h"
 #include "../p_spec.h"
 #include "../r_state.h"
 
@@ -88,6 +98,59 @@ enum
 // The commands that the bots will send to the players to be added in G_Ticker
 Bot bots[MAXPLAYERS];
 
+// Max subsectors expanded per tic by a goal search (0 = no limit). Counted in
+// nodes rather than time, so bot behaviour stays the same on every machine.
+int bot_pathbudget = 2048;
+
+// Size in map units of the areas whose bots share sight checks (0 = exact)
+int bot_sightcell = 32;
+
+// Threads running the path searches and movement of bots (1 = main thread)
+int bot_threads = 1;
+
+// Try the nearest items from the shared flow fields before searching
+bool bot_flowfields = true;
+
+// Goal keys which other bots avoid, in the order of Bot::m_claims
+static const char *const g_claimKeys[] = { BOT_PICKUP, BOT_WALKTRIG, BOT_FLOORSECTOR };
+
+//
+// Sight results shared by all bots during a tic. Lookers within the same
+// cell of bot_sightcell units get the same answer for a given target.
+//
+struct SightKey
+{
+   fixed_t x, y, z;
+   int groupid;
+   const Mobj *target;
+
+   bool operator == (const SightKey &other) const
+   {
+      return x == other.x && y == other.y && z == other.z &&
+      groupid == other.groupid && target == other.target;
+   }
+};
+
+struct SightKeyHash
+{
+   size_t operator () (const SightKey &key) const
+   {
+      size_t hash = std::hash<const Mobj *>()(key.target);
+      hash = hash * 31 + key.x;
+      hash = hash * 31 + key.y;
+      hash = hash * 31 + key.z;
+      return hash * 31 + key.groupid;
+   }
+};
+
+static std::unordered_map<SightKey, bool, SightKeyHash> g_sightCache;
+static int g_sightCacheTic = -1;
+
+// Moving missiles, gathered once per tic for all bots. They're not in the
+// blockmap, so they can't be found by area.
+static PODCollection<const Mobj *> g_missiles;
+static int g_missilesTic = -1;
+
 //
 // Bot::mapInit
 //
@@ -99,9 +162,17 @@ void Bot::mapInit()
    B_EmptyTableAndDelete(goalEvents);  // remove all previously listed events
    m_searchstage = SearchStage_Normal;
 
+   // Benchmark workers must play the same way each run with the same seed
+   if(bench_worker)
+      random.initialize((int)(B_BenchSeed() + (unsigned)(pl - players)));
+
    m_finder.SetMap(botMap);
    m_finder.SetPlayer(pl);
+   m_finder.AbortSearch();
    m_hasPath = false;
+   m_inCombat = false;
+   m_flowGoalKey = nullptr;
+   m_flowCost = D_MAXINT;
 
    m_lostPathSS = nullptr;
 
@@ -125,6 +196,10 @@ void Bot::mapInit()
    m_lastExitMessage = 0;
 
    m_userInputTimeout = 0;
+
+   // Shared scan results may still refer to the previous level's mobjs
+   g_sightCacheTic = -1;
+   g_missilesTic = -1;
 }
 
 //
@@ -242,7 +317,7 @@ Bot::SpecialChoice Bot::shouldUseSpecial(const line_t& line, const BSubsec& line
            {
               m_lastExitMessage = gametic;
               // FIXME: do not send it now, but when bot actually goes there
-              HU_Say(pl, announcement);
+              say(announcement);
            }
            return SpecialChoice_favourable;
         }
@@ -572,22 +647,49 @@ bool Bot::checkItemType(const Mobj *special) const
 }
 
 //
-// Check if other bots already found the same goal
+// Check if other bots already found the same goal. Uses the goals saved at
+// the start of the tic, since the other bots may be thinking right now.
 //
 bool Bot::otherBotsHaveGoal(const char *key, v2fixed_t coord) const
 {
    if(m_searchstage > SearchStage_NUM)
       return false;
-   for(Bot &bot : bots)
+   int claim = 0;
+   while(claim < NUMCLAIMS - 1 && strcmp(g_claimKeys[claim], key))
+      ++claim;
+   for(const Bot &bot : bots)
    {
       if(&bot == this || !bot.active)
          continue;
-      if(bot.goalTable.getV2Fixed(key, v2fixed_t{ D_MININT, D_MININT }) == coord)
+      if(bot.m_claims[claim] == coord)
          return true;
    }
    return false;
 }
 
+//
+// Bot::claimGoal
+//
+// Sets a goal found by the current search
+//
+void Bot::claimGoal(const char *key, v2fixed_t coord)
+{
+   goalTable.setV2Fixed(key, coord);
+   m_newGoalKey = key;
+   m_newGoalCoord = coord;
+}
+
+//
+// Bot::saveClaims
+//
+// Copies the goals for otherBotsHaveGoal, before any bot thinks
+//
+void Bot::saveClaims()
+{
+   for(int i = 0; i < NUMCLAIMS; ++i)
+      m_claims[i] = goalTable.getV2Fixed(g_claimKeys[i], v2fixed_t{ D_MININT, D_MININT });
+}
+
 //
 // Returns true if there's an object of interest (item, switch or anything else
 // which can be a goal) in given subsector. Outputs the object's exact
@@ -631,7 +733,7 @@ bool Bot::objOfInterest(const BSubsec& ss, BotPathEnd& coord, void* v)
           {
              coord.kind = BotPathEnd::KindCoord;
              coord.coord = ss.mid;
-             self.goalTable.setV2Fixed(BOT_FLOORSECTOR, goaltag);
+             self.claimGoal(BOT_FLOORSECTOR, goaltag);
           }
           else if(self.m_deepSearchMode == DeepBeyond)
              self.m_deepPromise.flags |= DeepPromise::BENEFICIAL;
@@ -642,9 +744,9 @@ bool Bot::objOfInterest(const BSubsec& ss, BotPathEnd& coord, void* v)
     const Mobj* item;
     fixed_t fh;
     const Mobj& plmo = *self.pl->mo;
-    for (auto it = ss.mobjlist.begin(); it != ss.mobjlist.end(); ++it)
+    for (const Mobj *mobj : botMap->mobjsIn(ss))
     {
-        item = *it;
+        item = mobj;
         if (item == &plmo)
             continue;
         fh = ss.msector->getFloorHeight();
@@ -666,7 +768,7 @@ bool Bot::objOfInterest(const BSubsec& ss, BotPathEnd& coord, void* v)
                  {
                     coord.kind = BotPathEnd::KindCoord;
                     coord.coord = goaltag;
-                    self.goalTable.setV2Fixed(BOT_PICKUP, goaltag);
+                    self.claimGoal(BOT_PICKUP, goaltag);
                  }
                  else if(self.m_deepSearchMode == DeepBeyond)
                     self.m_deepPromise.flags |= DeepPromise::BENEFICIAL;
@@ -695,18 +797,21 @@ bool Bot::objOfInterest(const BSubsec& ss, BotPathEnd& coord, void* v)
     }
 
     // look for other triggers.
-    for (auto it = ss.linelist.begin(); it != ss.linelist.end(); ++it)
+    int ssindex = botMap->ssIndex(ss);
+    const v2fixed_t *points = botMap->ssContents.linePoints(ssindex);
+    for (const line_t *pline : botMap->ssContents.lines(ssindex))
     {
-       const line_t &line = *it->first;
+       const line_t &line = *pline;
+       const v2fixed_t &point = *points++;
        if(line.frontsector->isShut())  // quick out
           continue;
        // Check if it's really accessible
-       if(EV_IsSwitchSpecial(line) && !B_checkSwitchReach(it->second, line))
+       if(EV_IsSwitchSpecial(line) && !B_checkSwitchReach(point, line))
           continue;
        v2fixed_t margin = { FRACUNIT, FRACUNIT };  // weed off edge cases
-       if(EV_IsGunSpecial(line) && (!self.checkGunSwitchReach(it->second, line) ||
-                                    !self.checkGunSwitchReach(it->second - margin, line) ||
-                                    !self.checkGunSwitchReach(it->second + margin, line)))
+       if(EV_IsGunSpecial(line) && (!self.checkGunSwitchReach(point, line) ||
+                                    !self.checkGunSwitchReach(point - margin, line) ||
+                                    !self.checkGunSwitchReach(point + margin, line)))
        {
           continue;
        }
@@ -766,7 +871,7 @@ bool Bot::handleLineGoal(const BSubsec &ss, BotPathEnd &coord, const line_t& lin
             coord.walkLine = &line;
             //crd.x += self.random.range(-16, 16) * FRACUNIT;
             //crd.y += self.random.range(-16, 16) * FRACUNIT;
-            goalTable.setV2Fixed(BOT_WALKTRIG,goaltag);
+            claimGoal(BOT_WALKTRIG, goaltag);
            if(m_deepPromise.flags & DeepPromise::BENEFICIAL)
               m_deepPromise.prereqcoord = goaltag;
             return true;
@@ -834,42 +939,159 @@ Bot::Target &Bot::Target::operator = (Bot::Target &&other)
 }
 
 //
-// Populates the target list for combat situations
+// B_sightCell
 //
-void Bot::enemyVisible(Collection<Target>& targets)
+// Floor division, so cells on the negative side of the origin are as wide as
+// the others
+//
+static int B_sightCell(fixed_t coord)
 {
-    camsightparams_t cam;
-    cam.setLookerMobj(pl->mo);
+   int unit = coord >> FRACBITS;
+   int cell = unit / bot_sightcell;
+   if(unit % bot_sightcell < 0)
+      --cell;
+   return cell;
+}
+
+//
+// B_sightKey
+//
+// Key of the shared cache for looker seeing target. Also starts a new cache
+// on the first call of each tic.
+//
+static SightKey B_sightKey(const Mobj &looker, const Mobj &target)
+{
+   if(g_sightCacheTic != gametic)
+   {
+      g_sightCache.clear();
+      g_sightCacheTic = gametic;
+   }
+
+   SightKey key;
+   if(bot_sightcell > 0)
+   {
+      key.x = B_sightCell(looker.x);
+      key.y = B_sightCell(looker.y);
+      key.z = B_sightCell(looker.z);
+   }
+   else
+   {
+      key.x = looker.x;
+      key.y = looker.y;
+      key.z = looker.z;
+   }
+   key.groupid = looker.groupid;
+   key.target = &target;
+   return key;
+}
 
+//
+// B_updateMissiles
+//
+// Refreshes g_missiles on the first call of each tic
+//
+static void B_updateMissiles()
+{
+   if(g_missilesTic == gametic)
+      return;
+   g_missilesTic = gametic;
+   g_missiles.makeEmpty();
    for(const Thinker *th = thinkercap.next; th != &thinkercap; th = th->next)
    {
       const Mobj *mo = thinker_cast<const Mobj *>(th);
-      if(!mo)
-         continue;
-      Target target;
-      if(mo->flags & MF_SHOOTABLE && !(mo->flags & (MF_NOBLOCKMAP | MF_FRIEND)) && mo->health > 0 &&
-         (!mo->player || deathmatch))
-      {
-         target = Target(*mo, *pl->mo, false);
-      }
-      else if(mo->flags & MF_MISSILE && mo->flags & MF_NOBLOCKMAP && mo->momx | mo->momy &&
-              mo->damage && mo->target != pl->mo)
+      if(mo && mo->flags & MF_MISSILE && mo->flags & MF_NOBLOCKMAP &&
+         mo->momx | mo->momy && mo->damage)
       {
-         target = Target(*mo, *pl->mo, true);
+         g_missiles.add(mo);
       }
-      if (target.mobj && target.dist < MISSILERANGE / 2)
-      {
-         cam.setTargetMobj(mo);
-         if (CAM_CheckSight(cam))
+   }
+}
+
+//
+// Populates the target list for combat situations. Monsters are looked up in
+// the blockmap around the bot, instead of going through all the thinkers.
+//
+void Bot::enemyVisible(Collection<Target>& targets)
+{
+   static const fixed_t range = MISSILERANGE / 2;
+
+   struct Candidate
+   {
+      const Mobj *mo;
+      bool ismissile;
+   };
+   static PODCollection<Candidate> candidates;
+   static PODCollection<camsightparams_t> sightParams;
+   static PODCollection<SightKey> sightKeys;
+   static PODCollection<bool> sightResults;
+
+   candidates.makeEmpty<true>();
+
+   auto consider = [this](const Mobj &mo, bool ismissile) {
+      v2fixed_t delta(getThingX(pl->mo, &mo) - pl->mo->x,
+                      getThingY(pl->mo, &mo) - pl->mo->y);
+      if(delta.sqrtabs() < range)
+         candidates.add({ &mo, ismissile });
+   };
+
+   typedef decltype(consider) Consider;
+
+   // Walk through the linked portals too, so monsters behind them are found
+   fixed_t bbox[4];
+   bbox[BOXLEFT] = pl->mo->x - range;
+   bbox[BOXTOP] = pl->mo->y + range;
+   bbox[BOXRIGHT] = pl->mo->x + range;
+   bbox[BOXBOTTOM] = pl->mo->y - range;
+   P_TransPortalBlockWalker(bbox, pl->mo->groupid, false, &consider,
+      [](int x, int y, int groupid, void *data) -> bool
+   {
+      P_BlockThingsIterator(x, y, groupid, [](Mobj *mo, void *data) {
+         if(mo->flags & MF_SHOOTABLE && !(mo->flags & (MF_NOBLOCKMAP | MF_FRIEND)) &&
+            mo->health > 0 && (!mo->player || deathmatch) && !mo->isRemoved())
          {
-            targets.add(std::move(target));
-            std::push_heap(targets.begin(), targets.end());
+            (*static_cast<Consider *>(data))(*mo, false);
          }
-      }
+         return true;
+      }, data);
+      return true;
+   });
+
+   B_updateMissiles();
+   for(const Mobj *mo : g_missiles)
+      if(!mo->isRemoved() && mo->target != pl->mo)
+         consider(*mo, true);
+
+   // Check in one batch whatever the other bots haven't already seen
+   camsightparams_t cam;
+   cam.prev = nullptr;
+   cam.setLookerMobj(pl->mo);
+   sightParams.makeEmpty<true>();
+   sightKeys.makeEmpty<true>();
+   for(const Candidate &candidate : candidates)
+   {
+      SightKey key = B_sightKey(*pl->mo, *candidate.mo);
+      if(g_sightCache.count(key))
+         continue;
+      cam.setTargetMobj(candidate.mo);
+      sightParams.add(cam);
+      sightKeys.add(key);
+   }
+   sightResults.resize(sightParams.getLength());
+   CAM_CheckSightBatch(sightParams.begin(), sightResults.begin(),
+                       (int)sightParams.getLength());
+   for(size_t i = 0; i < sightKeys.getLength(); ++i)
+      g_sightCache[sightKeys[i]] = sightResults[i];
+
+   for(const Candidate &candidate : candidates)
+   {
+      if(!g_sightCache[B_sightKey(*pl->mo, *candidate.mo)])
+         continue;
+      targets.add(Target(*candidate.mo, *pl->mo, candidate.ismissile));
+      std::push_heap(targets.begin(), targets.end());
    }
 
    if(m_path.end.kind == BotPathEnd::KindWalkLine && EV_IsGunSpecial(*m_path.end.walkLine) &&
-      ss->linelist.count(m_path.end.walkLine) &&
+      botMap->ssContents.hasLine(botMap->ssIndex(*ss), m_path.end.walkLine) &&
       checkGunSwitchReach(v2fixed_t(*pl->mo), *m_path.end.walkLine) &&
       LevelStateStack::Peek(*m_path.end.walkLine, *pl, nullptr))
    {
@@ -953,6 +1175,17 @@ bool Bot::shouldChat(int intervalSec, int timekeeper) const
                                timekeeper + intervalSec * TICRATE < gametic);
 }
 
+//
+// Bot::say
+//
+// Chat from thinking, which may run on another thread. It's sent by
+// finishCommand.
+//
+void Bot::say(const char *message)
+{
+   m_chat.add(message);
+}
+
 const Bot::Target *Bot::pickBestTarget(const Collection<Target>& targets, CombatInfo &cinfo)
 {
    double totalThreat = 0;
@@ -1342,6 +1575,84 @@ static bool B_wantOpenDoor(const sector_t &sector)
    (doorTh && doorTh->direction == plat_down);
 }
 
+//
+// Bot::followFlowField
+//
+// Quick way to find a goal: the nearest item of each category is taken from
+// the shared flow fields and checked with objOfInterest, nearest first. The
+// first wanted one is put in m_flowPath, and its distance in m_flowCost. The
+// regular search then only has to look for other goals nearer than that.
+// Fails if the fields don't fit the current search or none of those items is
+// wanted.
+//
+bool Bot::followFlowField()
+{
+   const FlowFields *fields = botMap->flowFields;
+   if(!bot_flowfields || !fields || !fields->isReady(pl->mo->height) ||
+      m_searchstage != SearchStage_Normal || m_deepPromise.isActive() ||
+      !LevelStateStack::IsClear())
+   {
+      return false;
+   }
+
+   int categories[FlowFields::NUMCATEGORIES];
+   int numcategories = 0;
+   for(int i = 0; i < FlowFields::NUMCATEGORIES; ++i)
+   {
+      if(fields->cell(i, *ss).goal != -1)
+         categories[numcategories++] = i;
+   }
+   std::sort(categories, categories + numcategories, [fields, this](int a, int b) {
+      return fields->cell(a, *ss).dist < fields->cell(b, *ss).dist;
+   });
+
+   for(int i = 0; i < numcategories; ++i)
+   {
+      const BSubsec &goalss = botMap->ssectors[fields->cell(categories[i], *ss).goal];
+      BotPathEnd coord;
+      m_newGoalKey = nullptr;
+      if(!objOfInterest(goalss, coord, this))
+         continue;
+
+      // Only a candidate until the search is over
+      m_flowGoalKey = m_newGoalKey;
+      m_flowGoalCoord = m_newGoalCoord;
+      m_newGoalKey = nullptr;
+      m_flowCost = fields->cell(categories[i], *ss).dist;
+
+      m_flowPath.start = v2fixed_t(*pl->mo);
+      m_flowPath.inv.makeEmpty<true>();
+      m_flowPath.sss.clear();
+      m_flowPath.sss.insert(ss);
+      for(const BSubsec *t = ss; t != &goalss;)
+      {
+         const BNeigh *next = fields->cell(categories[i], *t).next;
+         m_flowPath.inv.add(next);
+         t = next->otherss;
+         m_flowPath.sss.insert(t);
+      }
+      std::reverse(m_flowPath.inv.begin(), m_flowPath.inv.end());
+      m_flowPath.last = &goalss;
+      m_flowPath.end = coord;
+      return true;
+   }
+   return false;
+}
+
+//
+// Bot::dropFlowGoal
+//
+// Forgets the flow field candidate, along with its claim unless the search
+// ended up claiming the same kind of goal
+//
+void Bot::dropFlowGoal()
+{
+   if(m_flowGoalKey && m_flowGoalKey != m_newGoalKey)
+      goalTable.removeAndDeleteAllObjects(m_flowGoalKey);
+   m_flowGoalKey = nullptr;
+   m_flowCost = D_MAXINT;
+}
+
 //
 // Bot::doNonCombatAI
 //
@@ -1352,8 +1663,44 @@ void Bot::doNonCombatAI()
     if (!m_hasPath)
     {
         LevelStateStack::SetKeyPlayer(pl);
-        if(!m_finder.FindNextGoal(v2fixed_t(*pl->mo), m_path, m_deepPromise.isUrgent(),
-                                  objOfInterest, this))
+
+        // Don't resume a search which was started for other goals
+        if(m_finder.IsSearching() && (m_searchUrgent != m_deepPromise.isUrgent() ||
+                                      m_searchPromised != m_deepPromise.isActive()))
+        {
+           m_finder.AbortSearch();
+        }
+
+        PathSearchResult result;
+        if(!m_finder.IsSearching())
+        {
+           dropFlowGoal();
+           m_searchUrgent = m_deepPromise.isUrgent();
+           m_searchPromised = m_deepPromise.isActive();
+           // An item known from the flow fields limits how far to look
+           followFlowField();
+           m_finder.BeginNextGoal(v2fixed_t(*pl->mo), m_searchUrgent, m_flowCost);
+        }
+        result = m_finder.ContinueNextGoal(m_path, objOfInterest, this, bot_pathbudget);
+        if(m_flowGoalKey && result != PathSearchOngoing)
+        {
+           if(result != PathSearchFound)
+           {
+              // nothing nearer, so go for the flow field item
+              m_path = std::move(m_flowPath);
+              m_newGoalKey = m_flowGoalKey;
+              m_newGoalCoord = m_flowGoalCoord;
+              result = PathSearchFound;
+           }
+           dropFlowGoal();
+        }
+        if(result == PathSearchOngoing)
+        {
+           // Not done yet: keep following the previous path while still on it
+           if(!m_path.last || ss == m_path.last || !m_path.sss.count(ss))
+              return;
+        }
+        else if(result == PathSearchNotFound)
         {
             ++m_searchstage;
            if(m_searchstage >= SearchStage_NUM && m_deepPromise.isActive())
@@ -1367,13 +1714,16 @@ void Bot::doNonCombatAI()
               shouldChat(IDLE_CHAT_INTERVAL_SEC, m_lastDunnoMessage))
            {
               m_lastDunnoMessage = gametic;
-              HU_Say(pl, "Dunno where to go now...");
+              say("Dunno where to go now...");
            }
             return;
         }
-        m_hasPath = true;
-        m_runfast = false;
-       m_lastDunnoMessage = 0;   // will reset here so new events appear
+        else
+        {
+           m_hasPath = true;
+           m_runfast = false;
+           m_lastDunnoMessage = 0;   // will reset here so new events appear
+        }
     }
 
     // found path to exit
@@ -1473,8 +1823,12 @@ void Bot::doNonCombatAI()
         }
     }
 
-   if(swline && ss->linelist.count(swline) && EV_IsGunSpecial(*swline))
-      npos = ss->linelist.find(swline)->second;
+   if(swline && EV_IsGunSpecial(*swline))
+   {
+      const v2fixed_t *point = botMap->ssContents.findLine(botMap->ssIndex(*ss), swline);
+      if(point)
+         npos = *point;
+   }
 
     m_intoSwitch = false;
     if (goalTable.hasKey(BOT_WALKTRIG) && m_path.end.kind == BotPathEnd::KindWalkLine &&
@@ -1828,17 +2182,17 @@ static bool B_userHasInput()
 }
 
 //
-// Bot::doCommand
+// Bot::prepareCommand
 //
-// Called from G_Ticker right before ticcmd is passed into the player. Gets the
-// tic command which may have already been copied to the player, and updates it
-// with bot output. Cannot just reset what was produced by G_BuildTiccmd,
-// because that also handles unrelated stuff.
+// Gets the tic command which may have already been copied to the player, to
+// be updated with bot output. Cannot just reset what was produced by
+// G_BuildTiccmd, because that also handles unrelated stuff. Returns true if
+// the bot has to think this tic.
 //
-void Bot::doCommand()
+bool Bot::prepareCommand()
 {
    if(!active)
-      return;  // do nothing if out of game
+      return false;  // do nothing if out of game
    if(pl == &players[consoleplayer])
    {
       if(gamestate == GS_LEVEL)
@@ -1846,7 +2200,7 @@ void Bot::doCommand()
          if(B_userHasInput())
             m_userInputTimeout = gametic + 35;
          if(gametic < m_userInputTimeout)
-            return;
+            return false;
       }
    }
    else
@@ -1865,10 +2219,10 @@ void Bot::doCommand()
          else
             pl->cmd.buttons ^= BT_USE; // mash it
       }
-      return;
+      return false;
    }
    if(gamestate != GS_LEVEL)
-      return;
+      return false;
 
    // Update the velocity
    m_realVelocity = v2fixed_t(*pl->mo) - m_lastPosition;
@@ -1882,26 +2236,146 @@ void Bot::doCommand()
 
     if(pl->health <= 0)
     {
+       // start over from wherever the bot respawns
+       m_finder.AbortSearch();
        if(gametic % DEATH_REVIVE_INTERVAL == 0)
           cmd->buttons |= BT_USE; // respawn
-       return; // don't try anything else in this case
+       return false; // don't try anything else in this case
     }
 
-   // Do non-combat for now
+   // Sets up the sectors of the state on a new level, so it must be here
+   LevelStateStack::Bind(m_levelState);
+   m_startcmd = *cmd;
+   return true;
+}
+
+//
+// Bot::think
+//
+// Path finding and movement. May run on any thread, in parallel with the
+// other bots.
+//
+void Bot::think()
+{
+   PROFILE_ZONE("Bot::think");
 
+   LevelStateStack::Bind(m_levelState);
+   m_newGoalKey = nullptr;
+
+   // Do non-combat for now
    doNonCombatAI();
+}
+
+//
+// Bot::finishCommand
+//
+// Merges the thinking results and does combat. Runs on the main thread, in
+// player order.
+//
+void Bot::finishCommand()
+{
+   PROFILE_ZONE("Bot::finishCommand");
+
+   LevelStateStack::Bind(m_levelState);
+
+   // Lower numbered bots keep goals which were found by several this tic. The
+   // others drop just that goal and think again, seeing the goals which the
+   // lower numbered bots have by now, as if the bots thought one by one.
+   if(m_newGoalKey && m_searchstage <= SearchStage_NUM &&
+      goalTable.getV2Fixed(m_newGoalKey, v2fixed_t{ D_MININT, D_MININT }) == m_newGoalCoord)
+   {
+      for(Bot *bot = bots; bot != this; ++bot)
+      {
+         if(bot->active && bot->goalTable.getV2Fixed(m_newGoalKey,
+                                                     v2fixed_t{ D_MININT, D_MININT }) ==
+            m_newGoalCoord)
+         {
+            goalTable.removeAndDeleteAllObjects(m_newGoalKey);
+            for(Bot *other = bots; other != this; ++other)
+               other->saveClaims();
+            m_finder.AbortSearch();
+            m_hasPath = false;
+            *cmd = m_startcmd;
+            m_chat.makeEmpty();
+            think();
+            break;
+         }
+      }
+   }
+   m_newGoalKey = nullptr;
+
+   for(const char *message : m_chat)
+      HU_Say(pl, message);
+   m_chat.makeEmpty();
+
    Collection<Target> targets;
     enemyVisible(targets);
     if (!targets.isEmpty())
+    {
+       // the bot will be pushed around while fighting, so search again after
+       if(!m_inCombat)
+          m_finder.AbortSearch();
+       m_inCombat = true;
        doCombatAI(targets);
+    }
     else
+    {
+       m_inCombat = false;
         justPunched = 0;
+    }
     
    
    // Limit commands before exiting
    capCommands();
 }
 
+//
+// Bot::DoCommands
+//
+// Adds the commands of all bots in game. Their path finding and movement runs
+// on up to bot_threads threads, each bot using its own LevelStateStack state
+// and seeing the goals of the others as they were when the tic started.
+// Everything else, including clashes over goals, is done in player order on
+// the main thread, so the commands don't depend on the number of threads.
+//
+void Bot::DoCommands()
+{
+   PROFILE_ZONE("Bot::DoCommands");
+
+   Bot *thinking[MAXPLAYERS];
+   int numthinking = 0;
+
+   for(Bot &bot : bots)
+      bot.saveClaims();
+   for(int i = 0; i < MAXPLAYERS; ++i)
+   {
+      if(playeringame[i] && bots[i].prepareCommand())
+         thinking[numthinking++] = &bots[i];
+   }
+
+   // Apply the level changes to the flow fields before they're shared
+   if(bot_flowfields && numthinking && botMap->flowFields)
+   {
+      LevelStateStack::Bind(nullptr);
+      botMap->flowFields->update(thinking[0]->pl->mo->height);
+   }
+
+   bool threaded = bot_threads > 1 && numthinking > 1;
+   if(threaded)
+      Z_SetThreaded(true);
+   B_ParallelFor(numthinking, [&thinking](int begin, int end, int) {
+      for(int i = begin; i < end; ++i)
+         thinking[i]->think();
+      LevelStateStack::Bind(nullptr);
+   }, bot_threads);
+   if(threaded)
+      Z_SetThreaded(false);
+
+   for(int i = 0; i < numthinking; ++i)
+      thinking[i]->finishCommand();
+   LevelStateStack::Bind(nullptr);
+}
+
 //
 // Bot::InitBots
 //
@@ -1914,9 +2388,25 @@ void Bot::InitBots()
    {
       bots[i].pl = players + i;
       bots[i].cmd = &bots[i].pl->cmd;
+      bots[i].m_levelState = LevelStateStack::NewState();
       B_AnalyzeWeapons(bots[i].pl->pclass);
    }
+
+   // Intern the goal keys now, as bots may set them from other threads
+   for(const char *key : g_claimKeys)
+      MetaTable::IndexForKey(key);
 }
 
-// EOF
+VARIABLE_INT(bot_pathbudget, nullptr, 0, D_MAXINT, nullptr);
+CONSOLE_VARIABLE(bot_pathbudget, bot_pathbudget, 0) {}
+
+VARIABLE_INT(bot_sightcell, nullptr, 0, 1024, nullptr);
+CONSOLE_VARIABLE(bot_sightcell, bot_sightcell, 0) {}
 
+VARIABLE_INT(bot_threads, nullptr, 1, MAXPLAYERS, nullptr);
+CONSOLE_VARIABLE(bot_threads, bot_threads, 0) {}
+
+VARIABLE_TOGGLE(bot_flowfields, nullptr, onoff);
+CONSOLE_VARIABLE(bot_flowfields, bot_flowfields, 0) {}
+
+// EOF
@@ -30,9 +30,10 @@
 #define __EternityEngine__b_think__
 
 struct player_t;
-struct ticcmd_t;
+struct LevelState;
 
 #include "b_path.h"
+#include "../d_ticcmd.h"
 #include "../metaapi.h"
 
 // goal metatable keys
@@ -81,6 +82,7 @@ class Bot : public ZoneObject
    };
    
    RandomGenerator          random;       // random generator for bot
+   LevelState              *m_levelState = nullptr;   // what-if level while thinking
    int                      m_straferunstate = 0;
    int m_combatStrafeState = -1; // -1 or 1
    PathFinder               m_finder;
@@ -89,6 +91,10 @@ class Bot : public ZoneObject
    BotPath                  m_path;
    bool                     m_runfast = false;
    bool                     m_hasPath = false;
+   bool                     m_inCombat = false;
+   // Goal state the ongoing path search was started for
+   bool                     m_searchUrgent = false;
+   bool                     m_searchPromised = false;
    v2fixed_t                m_realVelocity; // real momentum, i.e. difference from last tic
    v2fixed_t                m_lastPosition;
 
@@ -144,6 +150,28 @@ class Bot : public ZoneObject
    // internal states
    unsigned m_searchstage = 0;
 
+   // Goals of this bot as they were at the start of the tic, so others can
+   // check them while it thinks. Indexed like g_claimKeys.
+   enum
+   {
+      NUMCLAIMS = 3
+   };
+   v2fixed_t m_claims[NUMCLAIMS];
+
+   // Goal chosen while thinking this tic, to settle clashes with other bots
+   const char *m_newGoalKey = nullptr;
+   v2fixed_t m_newGoalCoord;
+
+   // Nearest wanted item from the flow fields, taken if the search started
+   // along with it finds nothing nearer
+   BotPath m_flowPath;
+   fixed_t m_flowCost = D_MAXINT;
+   const char *m_flowGoalKey = nullptr;
+   v2fixed_t m_flowGoalCoord;
+
+   ticcmd_t m_startcmd;    // command before thinking
+   PODCollection<const char *> m_chat;  // said after thinking
+
    //
    // Bot combat target
    //
@@ -207,6 +235,8 @@ class Bot : public ZoneObject
    void doCombatAI(const Collection<Target>& targets);
 
    bool shouldWaitSector(const BNeigh &neigh) const;
+   bool followFlowField();
+   void dropFlowGoal();
    void doNonCombatAI();
 
    // Movement control
@@ -235,6 +265,13 @@ class Bot : public ZoneObject
    static PathResult reachableItem(const BSubsec& ss, void* v);
 
    bool shouldChat(int intervalSec = 0, int timekeeper = 0) const;
+   void say(const char *message);
+   void claimGoal(const char *key, v2fixed_t coord);
+   void saveClaims();
+
+   bool prepareCommand();
+   void think();
+   void finishCommand();
    
 public:
    
@@ -250,7 +287,7 @@ public:
       random.initialize((unsigned)time(nullptr));
    }
    
-   void doCommand();
+   static void DoCommands();
    
    //
    // addXYEvent
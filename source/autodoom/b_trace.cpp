@@ -27,6 +27,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+#include <vector>
 #include "../z_zone.h"
 #include "b_botmap.h"
 #include "../doomstat.h"
@@ -47,6 +49,11 @@
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
+// Lines already checked by the current pathTraverse, and the lines crossed.
+// Kept per thread, so bots can trace while thinking in parallel.
+static thread_local std::vector<byte> g_validLines;
+static thread_local std::vector<BotMap::Intercept> g_intercepts;
+
 bool BotMap::blockLinesIterator(int x, int y,
                                 bool lineHit(const Line &, void *),
                                 void *context) const
@@ -60,9 +67,9 @@ bool BotMap::blockLinesIterator(int x, int y,
    {
       // TODO: linked portals
       size_t index = line - lines;
-      if(VALID_ISSET(validLines, index))
+      if(VALID_ISSET(g_validLines, index))
          continue;
-      VALID_SET(validLines, index);
+      VALID_SET(g_validLines, index);
       if(!lineHit(*line, context))
          return false;
    }
@@ -81,12 +88,18 @@ bool BotMap::blockLinesIterator(int x, int y,
 //                                                     //
 //                                                     //
 
-bool BotMap::pathTraverse(divline_t trace,
-                          const std::function<bool(const Line&, const divline_t &, fixed_t)> &lineHit) const
+//
+// BotMap::collectIntercepts
+//
+// Finds the lines crossed by the trace, sorted by distance. The trace is
+// nudged off block edges, and the crossings are relative to the result.
+//
+const std::vector<BotMap::Intercept> &BotMap::collectIntercepts(divline_t &trace) const
 {
    // Gotta copy all the code from other traversers
 
-   VALID_CLEAR(validLines, numlines);
+   g_validLines.assign(((numlines + 7) & ~7) / 8, 0);
+   g_intercepts.clear();
 
    // don't side exactly on a line
    if(!((trace.x - bMapOrgX) & (BOTMAPBLOCKSIZE - 1)))
@@ -171,40 +184,27 @@ bool BotMap::pathTraverse(divline_t trace,
    // Count is present to prevent a round off error from skipping the break
    v2fixed_t map = vt1;
 
-   struct Intercept
-   {
-      fixed_t frac;
-      const Line *line;
-   };
-
-   struct Context
-   {
-      divline_t *trace;
-      PODCollection<Intercept> intercepts;
-   } ctx;
-   ctx.trace = &orgtrace;
-
    static auto lineHitFunc = [](const Line &line, void *vcontext) {
-      auto ctx = (Context *)vcontext;
-      int s1 = P_PointOnDivlineSide(line.v[0]->x, line.v[0]->y, ctx->trace);
-      int s2 = P_PointOnDivlineSide(line.v[1]->x, line.v[1]->y, ctx->trace);
+      auto trace = (divline_t *)vcontext;
+      int s1 = P_PointOnDivlineSide(line.v[0]->x, line.v[0]->y, trace);
+      int s2 = P_PointOnDivlineSide(line.v[1]->x, line.v[1]->y, trace);
       if(s1 == s2)
          return true;   // seg not crossed
       divline_t dl = divline_t::points(*line.v[0], *line.v[1]);
-      s1 = P_PointOnDivlineSide(ctx->trace->x, ctx->trace->y, &dl);
-      s2 = P_PointOnDivlineSide(ctx->trace->x + ctx->trace->dx,
-                                ctx->trace->y + ctx->trace->dy, &dl);
+      s1 = P_PointOnDivlineSide(trace->x, trace->y, &dl);
+      s2 = P_PointOnDivlineSide(trace->x + trace->dx,
+                                trace->y + trace->dy, &dl);
       if(s1 == s2)
          return true;   // seg not crossed
 
-      ctx->intercepts.addNew().line = &line;
+      g_intercepts.push_back({ 0, &line });
 
       return true;
    };
 
    for(int count = 0; count < 100; ++count)
    {
-      blockLinesIterator(map.x, map.y, lineHitFunc, &ctx);
+      blockLinesIterator(map.x, map.y, lineHitFunc, &orgtrace);
       if((mapstep.x | mapstep.y) == 0)
          break;
       // From ZDoom (usable under the ZDoom code license):
@@ -240,8 +240,8 @@ bool BotMap::pathTraverse(divline_t trace,
             // block being entered need to be checked (which will happen when this
             // loop continues), but the other two blocks adjacent to the corner
             // also need to be checked.
-            blockLinesIterator(map.x + mapstep.x, map.y, lineHitFunc, &ctx);
-            blockLinesIterator(map.x, map.y + mapstep.y, lineHitFunc, &ctx);
+            blockLinesIterator(map.x + mapstep.x, map.y, lineHitFunc, &orgtrace);
+            blockLinesIterator(map.x, map.y + mapstep.y, lineHitFunc, &orgtrace);
             intercept += step;
             map += mapstep;
             if(map.x == vt2.x)
@@ -252,39 +252,29 @@ bool BotMap::pathTraverse(divline_t trace,
       }
    }
 
-   // traverse intercepts
-   PODCollection<Intercept>::iterator scan, end, in;
-
-   size_t count = ctx.intercepts.getLength();
-   end = ctx.intercepts.end();
-
-   for(scan = ctx.intercepts.begin(); scan < end; ++scan)
+   // sort intercepts
+   for(Intercept &in : g_intercepts)
    {
-      divline_t mdl = divline_t::points(*scan->line->v[0], *scan->line->v[1]);
-      scan->frac = P_InterceptVector(&orgtrace, &mdl);
+      divline_t mdl = divline_t::points(*in.line->v[0], *in.line->v[1]);
+      in.frac = P_InterceptVector(&orgtrace, &mdl);
    }
+   std::stable_sort(g_intercepts.begin(), g_intercepts.end(),
+                    [](const Intercept &a, const Intercept &b) {
+      return a.frac < b.frac;
+   });
 
-   in = nullptr;
-
-   while(count--)
-   {
-      fixed_t dist = D_MAXINT;
-      for(scan = ctx.intercepts.begin(); scan < end; ++scan)
-      {
-         if(scan->frac < dist)
-         {
-            dist = scan->frac;
-            in = scan;
-         }
-      }
-
-      if(in)
-      {
-         if(!lineHit(*in->line, orgtrace, in->frac))
-            return false;
-         in->frac = D_MAXINT;
-      }
-   }
+   trace = orgtrace;
+   return g_intercepts;
+}
 
-   return true;
+//
+// BotMap::pathTraverse
+//
+// Wrapper for callers holding a std::function
+//
+bool BotMap::pathTraverse(divline_t trace,
+                          const std::function<bool(const Line&, const divline_t &, fixed_t)> &lineHit) const
+{
+   return pathTraverse<const std::function<bool(const Line &, const divline_t &,
+                                                fixed_t)> &>(trace, lineHit);
 }
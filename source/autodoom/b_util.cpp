@@ -28,6 +28,7 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <process.h>
 #elif defined __APPLE__
 #define Collection CSCollection  // redefined to avoid namespace collision
 #include <CoreServices/CoreServices.h>
@@ -35,10 +36,22 @@
 #include <mach/mach_time.h>
 #endif
 
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "../z_zone.h"
 
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
 #include "b_util.h"
 #include "../hal/i_platform.h"
+#include "../m_compare.h"
 #include "../metaapi.h"
 #include "../p_maputl.h"
 #include "../r_defs.h"
@@ -314,6 +327,195 @@ double B_RatioAlongLine(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
    / linesize;
 }
 
+//
+// B_WorkerCount
+//
+// Number of threads used by B_ParallelFor, including the calling one
+//
+int B_WorkerCount()
+{
+   unsigned count = std::thread::hardware_concurrency();
+   return count ? (int)count : 1;
+}
+
+//
+// Persistent worker threads for B_ParallelFor. They sleep between calls, so
+// they can also be used for work done every tic.
+//
+class BotWorkerPool
+{
+public:
+   ~BotWorkerPool()
+   {
+      resize(0);
+   }
+
+   void run(int numworkers, int count, int chunk,
+            const std::function<void(int, int, int)> &func);
+
+private:
+   void resize(int count);
+   void workerLoop(int worker, unsigned seenjob);
+
+   std::vector<std::thread> threads;
+   std::mutex               mutex;
+   std::condition_variable  wakeup;    // new work or shutdown
+   std::condition_variable  finished;  // a range completed
+
+   const std::function<void(int, int, int)> *func = nullptr;
+   int      count   = 0;
+   int      chunk   = 0;
+   int      pending = 0;   // worker ranges not yet done
+   unsigned job     = 0;   // bumped for each run
+   bool     quit    = false;
+};
+
+static BotWorkerPool g_workerPool;
+
+//
+// BotWorkerPool::resize
+//
+// Starts or stops threads so there are count of them
+//
+void BotWorkerPool::resize(int newcount)
+{
+   if((int)threads.size() == newcount)
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+   }
+   wakeup.notify_all();
+   for(std::thread &thread : threads)
+      thread.join();
+   threads.clear();
+
+   quit = false;
+   for(int i = 0; i < newcount; ++i)
+      threads.emplace_back(&BotWorkerPool::workerLoop, this, i + 1, job);
+}
+
+//
+// BotWorkerPool::workerLoop
+//
+// Thread n always takes range n. seenjob is the last job started before the
+// thread was created.
+//
+void BotWorkerPool::workerLoop(int worker, unsigned seenjob)
+{
+   std::unique_lock<std::mutex> lock(mutex);
+   for(;;)
+   {
+      wakeup.wait(lock, [&] { return quit || job != seenjob; });
+      if(quit)
+         return;
+      seenjob = job;
+      int begin = worker * chunk;
+      if(begin >= count)
+         continue;
+
+      const std::function<void(int, int, int)> &jobfunc = *func;
+      int end = emin(begin + chunk, count);
+
+      lock.unlock();
+      jobfunc(begin, end, worker);
+      lock.lock();
+
+      if(!--pending)
+         finished.notify_one();
+   }
+}
+
+//
+// BotWorkerPool::run
+//
+void BotWorkerPool::run(int numworkers, int newcount, int newchunk,
+                        const std::function<void(int, int, int)> &newfunc)
+{
+   resize(numworkers - 1);
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      func    = &newfunc;
+      count   = newcount;
+      chunk   = newchunk;
+      pending = (newcount + newchunk - 1) / newchunk - 1;
+      ++job;
+   }
+   wakeup.notify_all();
+
+   newfunc(0, emin(newchunk, newcount), 0);
+
+   std::unique_lock<std::mutex> lock(mutex);
+   finished.wait(lock, [this] { return !pending; });
+}
+
+//
+// B_ParallelFor
+//
+// Splits [0, count) into contiguous ranges, one per worker, and calls
+// func(begin, end, worker) for each, waiting for all to finish. The calling
+// thread takes the first range, so results can be merged in worker order to
+// get the same output as a serial run. At most maxworkers are used, or
+// B_WorkerCount() if it's 0. func must not use the zone heap, the console or
+// the loading screen, unless Z_SetThreaded is on.
+//
+void B_ParallelFor(int count, const std::function<void(int, int, int)> &func,
+                   int maxworkers)
+{
+   if(count <= 0)
+      return;
+   int numworkers = emin(maxworkers > 0 ? maxworkers : B_WorkerCount(), count);
+   int chunk = (count + numworkers - 1) / numworkers;
+   numworkers = (count + chunk - 1) / chunk;
+
+   if(numworkers <= 1)
+      func(0, count, 0);
+   else
+      g_workerPool.run(numworkers, count, chunk, func);
+}
+
+//
+// B_RunProcess
+//
+// Runs a program and waits for it. The argument list must end with nullptr.
+// Returns its exit code, or -1 if it couldn't be started or it crashed. Only
+// uses the C++ heap, so it can be called from any thread.
+//
+int B_RunProcess(const std::vector<const char *> &args)
+{
+#ifdef _WIN32
+   // _spawnv joins the arguments with spaces, so quote them
+   std::vector<std::string> quoted;
+   std::vector<const char *> argv;
+   for(const char *arg : args)
+   {
+      if(!arg)
+         break;
+      quoted.emplace_back(arg);
+      std::string &q = quoted.back();
+      if(q.find(' ') != std::string::npos)
+         q = '"' + q + '"';
+   }
+   for(const std::string &q : quoted)
+      argv.push_back(q.c_str());
+   argv.push_back(nullptr);
+   return (int)_spawnv(_P_WAIT, args[0], &argv[0]);
+#else
+   pid_t pid;
+   if(posix_spawnp(&pid, args[0], nullptr, nullptr,
+                   const_cast<char *const *>(&args[0]), environ))
+   {
+      return -1;
+   }
+   int status;
+   if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+      return -1;
+   return WEXITSTATUS(status);
+#endif
+}
+
 //
 // B_Log
 //
@@ -322,7 +524,7 @@ double B_RatioAlongLine(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
 #ifdef _DEBUG
 void B_Log(const char *output, ...)
 {
-   static char tempstr[1024];
+   static thread_local char tempstr[1024];
    va_list args;
    
    va_start(args, output);
@@ -29,32 +29,15 @@
 #ifndef B_UTIL_H_
 #define B_UTIL_H_
 
+#include <functional>
 #include <unordered_map>
+#include <vector>
 #include "b_lineeffect.h"
 #include "../m_collection.h"
 #include "../m_dllist.h"
 #include "../m_vector.h"
 #include "../tables.h"
 
-// Clock measuring functions
-#ifdef _DEBUG
-
-#define B_BEGIN_CLOCK clock_t B_CLK_MEASURE = clock();
-
-#define B_MEASURE_CLOCK(func) \
-B_CLK_MEASURE = clock() - B_CLK_MEASURE; \
-B_Log("%s/" #func ": %lu ticks", __FUNCTION__, B_CLK_MEASURE);
-
-#define B_NEW_CLOCK B_CLK_MEASURE = clock();
-
-#else
-
-#define B_BEGIN_CLOCK
-#define B_MEASURE_CLOCK(func)
-#define B_NEW_CLOCK
-
-#endif
-
 // ioanch 20151230: defined macros for the validcount sets here
 #ifndef VALID_ALLOC
 #define VALID_ALLOC(set, n) ((set) = ecalloc(byte *, 1, (((n) + 7) & ~7) / 8))
@@ -270,6 +253,15 @@ public:
    }
 };
 
+//
+// Worker threads, for heavy work during level setup and bot thinking
+//
+int B_WorkerCount();
+void B_ParallelFor(int count, const std::function<void(int, int, int)> &func,
+                   int maxworkers = 0);
+
+int B_RunProcess(const std::vector<const char *> &args);
+
 #ifdef _DEBUG
 void B_Log(const char *output, ...);
 #else
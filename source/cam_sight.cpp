@@ -26,6 +26,10 @@
 
 #include "z_zone.h"
 
+#include <mutex>
+#include <unordered_map>
+#include "c_io.h"
+#include "c_runcmd.h"
 #include "cam_common.h"
 #include "cam_sight.h"
 #include "doomstat.h"   // ioanch 20160101: for bullet attacks
@@ -510,6 +514,127 @@ bool CamContext::checkSight(const camsightparams_t &params,
    return result;
 }
 
+//=============================================================================
+//
+// Sight cache
+//
+// Results of CAM_CheckSight calls are kept for the current gametic. The key
+// holds every input of the check and the cache is dropped as soon as anything
+// which can change a line of sight happens (see CAM_InvalidateSightCache), so
+// cached answers are always the same as fresh ones and demos stay in sync.
+// Bots may look from several threads, so the cache is only touched while
+// holding sightcachemutex. The traces themselves run outside of it.
+//
+
+bool cam_sightcache = true;
+
+struct sightkey_t
+{
+   fixed_t cx, cy, cz, cheight;
+   fixed_t tx, ty, tz, theight;
+   int     cgroupid, tgroupid;
+
+   explicit sightkey_t(const camsightparams_t &params) :
+      cx(params.cx), cy(params.cy), cz(params.cz), cheight(params.cheight),
+      tx(params.tx), ty(params.ty), tz(params.tz), theight(params.theight),
+      cgroupid(params.cgroupid), tgroupid(params.tgroupid)
+   {
+   }
+
+   bool operator == (const sightkey_t &other) const
+   {
+      return cx == other.cx && cy == other.cy && cz == other.cz &&
+         cheight == other.cheight && tx == other.tx && ty == other.ty &&
+         tz == other.tz && theight == other.theight &&
+         cgroupid == other.cgroupid && tgroupid == other.tgroupid;
+   }
+};
+
+struct sightkeyhash_t
+{
+   size_t operator () (const sightkey_t &key) const
+   {
+      size_t hash = (size_t)key.cx;
+      hash = hash * 31 + (size_t)key.cy;
+      hash = hash * 31 + (size_t)key.cz;
+      hash = hash * 31 + (size_t)key.cheight;
+      hash = hash * 31 + (size_t)key.tx;
+      hash = hash * 31 + (size_t)key.ty;
+      hash = hash * 31 + (size_t)key.tz;
+      hash = hash * 31 + (size_t)key.theight;
+      hash = hash * 31 + (size_t)key.cgroupid;
+      return hash * 31 + (size_t)key.tgroupid;
+   }
+};
+
+static std::unordered_map<sightkey_t, bool, sightkeyhash_t> sightcache;
+static int sightcachetic = -1;
+static bool sightcachesuspended;
+static std::mutex sightcachemutex;
+
+static uint64_t sightcachehits;
+static uint64_t sightcachemisses;
+
+//
+// CAM_InvalidateSightCache
+//
+// Must be called whenever sector heights, portal states, blocking lines or
+// polyobjects change.
+//
+void CAM_InvalidateSightCache()
+{
+   std::lock_guard<std::mutex> lock(sightcachemutex);
+   sightcachetic = -1;
+}
+
+//
+// CAM_SuspendSightCache
+//
+// While suspended, sight checks neither use nor fill the cache. Used while the
+// renderer has replaced the level's heights with its own.
+//
+void CAM_SuspendSightCache(bool suspend)
+{
+   sightcachesuspended = suspend;
+}
+
+//
+// CAM_lookupSight
+//
+// Gets a cached result into result. Returns false if there's none.
+//
+static bool CAM_lookupSight(const sightkey_t &key, bool &result)
+{
+   std::lock_guard<std::mutex> lock(sightcachemutex);
+   if(sightcachetic != gametic)
+   {
+      sightcache.clear();
+      sightcachetic = gametic;
+   }
+
+   auto it = sightcache.find(key);
+   if(it == sightcache.end())
+   {
+      ++sightcachemisses;
+      return false;
+   }
+   ++sightcachehits;
+   result = it->second;
+   return true;
+}
+
+//
+// CAM_storeSight
+//
+// Keeps a traced result, unless the cache was dropped meanwhile
+//
+static void CAM_storeSight(const sightkey_t &key, bool result)
+{
+   std::lock_guard<std::mutex> lock(sightcachemutex);
+   if(sightcachetic == gametic)
+      sightcache.emplace(key, result);
+}
+
 //
 // CAM_CheckSight
 //
@@ -517,7 +642,65 @@ bool CamContext::checkSight(const camsightparams_t &params,
 //
 bool CAM_CheckSight(const camsightparams_t &params)
 {
-   return CamContext::checkSight(params, nullptr);
+   if(!cam_sightcache || sightcachesuspended)
+      return CamContext::checkSight(params, nullptr);
+
+   const sightkey_t key(params);
+   bool result;
+   if(!CAM_lookupSight(key, result))
+   {
+      result = CamContext::checkSight(params, nullptr);
+      CAM_storeSight(key, result);
+   }
+   return result;
+}
+
+//
+// CAM_CheckSightBatch
+//
+// Runs count sight checks at once. Pairs rejected by the REJECT table are
+// answered without touching the cache, and identical checks in the batch are
+// only traced once.
+//
+void CAM_CheckSightBatch(const camsightparams_t *params, bool *results, int count)
+{
+   for(int i = 0; i < count; ++i)
+   {
+      const camsightparams_t &p = params[i];
+      if(p.cgroupid == p.tgroupid || !P_GetLinkIfExists(p.cgroupid, p.tgroupid))
+      {
+         size_t s1 = R_PointInSubsector(p.cx, p.cy)->sector - sectors;
+         size_t s2 = R_PointInSubsector(p.tx, p.ty)->sector - sectors;
+         size_t pnum = s1 * numsectors + s2;
+         if(rejectmatrix[pnum >> 3] & (1 << (pnum & 7)))
+         {
+            results[i] = false;
+            continue;
+         }
+      }
+      results[i] = CAM_CheckSight(p);
+   }
+}
+
+//
+// Prints the sight cache hit rate
+//
+CONSOLE_COMMAND(sightstats, 0)
+{
+   std::lock_guard<std::mutex> lock(sightcachemutex);
+   uint64_t total = sightcachehits + sightcachemisses;
+   C_Printf("Sight cache: %llu hits, %llu misses (%.1f%% hit rate)\n",
+            (unsigned long long)sightcachehits,
+            (unsigned long long)sightcachemisses,
+            total ? 100.0 * sightcachehits / total : 0.0);
+   if(Console.argc && !strcasecmp(Console.argv[0]->constPtr(), "reset"))
+      sightcachehits = sightcachemisses = 0;
+}
+
+VARIABLE_TOGGLE(cam_sightcache, nullptr, onoff);
+CONSOLE_VARIABLE(cam_sightcache, cam_sightcache, 0)
+{
+   CAM_InvalidateSightCache();
 }
 
 // EOF
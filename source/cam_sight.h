@@ -61,6 +61,9 @@ struct camsightparams_t
 };
 
 bool CAM_CheckSight(const camsightparams_t &params);
+void CAM_CheckSightBatch(const camsightparams_t *params, bool *results, int count);
+void CAM_InvalidateSightCache();
+void CAM_SuspendSightCache(bool suspend);
 
 fixed_t CAM_AimLineAttack(const Mobj *t1, angle_t angle, fixed_t distance, 
                           bool mask, Mobj **outTarget);
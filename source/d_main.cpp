@@ -37,6 +37,8 @@
 #include "acs_intr.h"
 #include "am_map.h"
 #include "autodoom/b_ape.h"
+#include "autodoom/b_bench.h"
+#include "autodoom/b_cachegen.h"
 #include "autodoom/b_statistics.h"
 #include "autodoom/b_think.h" // IOANCH
 #include "c_io.h"
@@ -71,6 +73,7 @@
 #include "m_argv.h"
 #include "m_compare.h"
 #include "m_misc.h"
+#include "m_profile.h"
 #include "m_syscfg.h"
 #include "m_qstr.h"
 #include "m_utils.h"
@@ -577,6 +580,8 @@ void D_DrawWings()
 //
 static void D_Display()
 {
+   PROFILE_ZONE("D_Display");
+
    if(nodrawers)                // for comparative timing / profiling
       return;
 
@@ -1286,6 +1291,17 @@ static void D_DoomInit()
 
    FindResponseFile(); // Append response file arguments to command-line
 
+   // ioanch: level and cache blocks from chunked arenas
+   if(M_CheckParm("-zonearena"))
+      Z_SetArenas(true);
+
+   // ioanch: the bot benchmark coordinator only runs other processes
+   if(B_BenchIsCoordinator())
+   {
+      B_BenchRun();
+      I_QuitFast();
+   }
+
    // haleyjd 08/18/07: set base path and user path
    D_SetBasePath();
    D_SetUserPath();
@@ -1553,6 +1569,21 @@ static void D_DoomInit()
    nodrawers = !!M_CheckParm("-nodraw");
    noblit    = !!M_CheckParm("-noblit");
 
+   // ioanch: bot benchmark workers play their map at full speed
+   if(bench_worker)
+   {
+      d_startlevel.mapname = B_BenchWorkerMap();
+      autostart = true;
+      fastdemo = true;
+   }
+
+   // ioanch: bot map cache workers only set up their level
+   if(B_CacheGenWorkerMap())
+   {
+      d_startlevel.mapname = B_CacheGenWorkerMap();
+      autostart = true;
+   }
+
    // haleyjd: need to do this before M_LoadDefaults
    C_InitPlayerName();
 
@@ -1584,6 +1615,13 @@ static void D_DoomInit()
    if(modifiedgame && (GameModeInfo->flags & GIF_SHAREWARE))
       I_Error("\nYou cannot -file with the shareware version. Register!\n");
 
+   // ioanch: the bot map cache generator only needs the maps of the wads
+   if(B_CacheGenIsCoordinator())
+   {
+      B_CacheGenRun();
+      I_QuitFast();
+   }
+
    // haleyjd 08/03/13: load any deferred mission metadata
    D_DoDeferredMissionMetaData();
 
@@ -1985,10 +2023,16 @@ void D_DoomMain()
    // killough 12/98: inlined D_DoomLoop
    while(1)
    {
+      PROFILE_FRAME();
+      PROFILE_ZONE("Frame");
+
       // frame synchronous IO operations
       I_StartFrame();
 
-      TryRunTics();
+      {
+         PROFILE_ZONE("TryRunTics");
+         TryRunTics();
+      }
 
       // killough 3/16/98: change consoleplayer to displayplayer
       S_UpdateSounds(players[displayplayer].mo); // move positional sounds
@@ -2001,7 +2045,10 @@ void D_DoomMain()
 
       // Synchronous sound output is explicitly called.
       // Update sound output.
-      I_SubmitSound();
+      {
+         PROFILE_ZONE("I_SubmitSound");
+         I_SubmitSound();
+      }
 
       // haleyjd 12/06/06: garbage-collect all alloca blocks
       Z_FreeAlloca();
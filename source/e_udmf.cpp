@@ -46,7 +46,6 @@
 #include "r_state.h"
 #include "v_misc.h"
 #include "w_wad.h"
-#include "z_auto.h"
 
 // SOME CONSTANTS
 static const char DEFAULT_default[] = "@default";
@@ -935,13 +934,10 @@ bool UDMFParser::checkForCompatibilityFlag(qstring nstext)
 bool UDMFParser::parse(WadDirectory &setupwad, int lump)
 {
    {
-      ZAutoBuffer buf;
-
-      setupwad.cacheLumpAuto(lump, buf);
-      auto data = buf.getAs<const char *>();
+      WadLumpView view(setupwad, lump, false);
 
       // store it conveniently
-      setData(data, setupwad.lumpLength(lump));
+      setData(view.getAs<char>(), setupwad.lumpLength(lump));
    }
 
    readresult_e result = readItem();
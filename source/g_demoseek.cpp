@@ -0,0 +1,296 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2026 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//
+//   Demo seeking. Snapshots of the game are kept in memory during demo
+//   playback, so it can jump back or forth without replaying from the start.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <vector>
+#include "z_zone.h"
+
+#include "autodoom/b_botmap.h"
+#include "autodoom/b_compression.h"
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "doomstat.h"
+#include "g_demoseek.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "p_saveg.h"
+#include "s_sound.h"
+#include "v_misc.h"
+
+int demo_keyinterval = 10; // seconds between snapshots
+int demo_keyframes = 64;   // snapshots kept besides the first one, 0 for none
+
+//
+// Snapshot taken right before the demo commands of a tic are read
+//
+struct demokeyframe_t
+{
+   int tic;                // demo tics played so far
+   size_t position;        // offset of the next ticcmd in the demo
+   int paused;             // pausing done by the demo itself isn't saved
+   std::vector<byte> data; // the savegame
+};
+
+static std::vector<demokeyframe_t> keyframes; // sorted by tic
+static int demotic;
+
+//
+// G_keyframeAfter
+//
+// First keyframe past the given tic
+//
+static std::vector<demokeyframe_t>::iterator G_keyframeAfter(int tic)
+{
+   return std::upper_bound(keyframes.begin(), keyframes.end(), tic,
+                           [](int t, const demokeyframe_t &key) {
+                              return t < key.tic;
+                           });
+}
+
+//
+// G_keyframeBefore
+//
+// Latest keyframe at or before the given tic, or null
+//
+static const demokeyframe_t *G_keyframeBefore(int tic)
+{
+   auto it = G_keyframeAfter(tic);
+   return it == keyframes.begin() ? nullptr : &*(it - 1);
+}
+
+//
+// G_ClearDemoKeyframes
+//
+// Called when demo playback starts or stops
+//
+void G_ClearDemoKeyframes()
+{
+   keyframes.clear();
+   keyframes.shrink_to_fit();
+   demotic = 0;
+}
+
+//
+// G_takeKeyframe
+//
+static void G_takeKeyframe()
+{
+   MemoryOutBuffer savefile;
+   savefile.create(64 * 1024, OutBuffer::NENDIAN);
+   if(!P_SaveGameToBuffer(savefile))
+      return;
+   savefile.close();
+
+   demokeyframe_t key;
+   key.tic = demotic;
+   key.position = G_DemoPosition();
+   key.paused = paused;
+   key.data = std::move(savefile.getData());
+   keyframes.insert(G_keyframeAfter(demotic), std::move(key));
+
+   // Drop the earliest ones past the limit, but keep the start of the demo
+   while((int)keyframes.size() > demo_keyframes + 1)
+      keyframes.erase(keyframes.begin() + 1);
+}
+
+//
+// G_DemoKeyframeTicker
+//
+// Called by G_Ticker on each demo tic, before the commands are read. A
+// snapshot is taken if the last one before this tic is old enough, which
+// also fills the gaps left by earlier seeks.
+//
+void G_DemoKeyframeTicker()
+{
+   if(gamestate == GS_LEVEL && demo_keyframes > 0)
+   {
+      const demokeyframe_t *last = G_keyframeBefore(demotic);
+      if(!last || demotic - last->tic >= demo_keyinterval * TICRATE)
+         G_takeKeyframe();
+   }
+   ++demotic;
+}
+
+//
+// G_DemoTic
+//
+// Demo tics played so far
+//
+int G_DemoTic()
+{
+   return demotic;
+}
+
+//
+// G_restoreKeyframe
+//
+static void G_restoreKeyframe(const demokeyframe_t &key)
+{
+   // Loading starts a new game, which ends the demo. Keep what it resets.
+   bool wasnetgame = netgame;
+   int console = consoleplayer;
+   int display = displayplayer;
+
+   MemoryInBuffer loadfile;
+   loadfile.open(key.data.data(), key.data.size(), InBuffer::NENDIAN);
+
+   BotMap::demoPlayingFlag = true;
+   if(!P_LoadGameFromBuffer(loadfile))
+      I_Error("G_DemoSeek: bad keyframe at tic %d\n", key.tic);
+   BotMap::demoPlayingFlag = false;
+
+   demoplayback = true;
+   usergame = false;
+   netgame = wasnetgame;
+   consoleplayer = console;
+   displayplayer = display;
+   paused = key.paused;
+
+   G_SetDemoPosition(key.position);
+   demotic = key.tic;
+}
+
+//
+// G_fastForward
+//
+// Runs the game without drawing until the demo reaches the given tic
+//
+static void G_fastForward(int tic)
+{
+   int start = gametic;
+   int menupause = paused & 2;
+
+   paused &= ~2;
+   while(demoplayback && demotic < tic)
+   {
+      G_Ticker();
+      ++gametic;
+   }
+   paused |= menupause;
+
+   // The netcode keeps counting from the old gametic, so move it back along
+   // with the timers derived from it.
+   int ran = gametic - start;
+   gametic -= ran;
+   basetic -= ran;
+   levelstarttic -= ran;
+
+   // Don't play everything started on the way at once
+   S_StopSounds(false);
+}
+
+//
+// G_DemoSeek
+//
+// Moves demo playback to the given tic. Returns false if no demo is playing,
+// or if going back further than the kept keyframes.
+//
+bool G_DemoSeek(int tic)
+{
+   if(!demoplayback || demorecording)
+      return false;
+   if(tic < 0)
+      tic = 0;
+
+   const demokeyframe_t *key = G_keyframeBefore(tic);
+
+   // Just keep playing if no keyframe is closer than the current spot
+   if(!key || (tic >= demotic && key->tic <= demotic))
+   {
+      if(tic < demotic)
+         return false;
+      key = nullptr;
+   }
+
+   if(key)
+      G_restoreKeyframe(*key);
+   G_fastForward(tic);
+   return true;
+}
+
+//=============================================================================
+//
+// Console commands
+//
+
+VARIABLE_INT(demo_keyinterval, nullptr, 1, 600, nullptr);
+CONSOLE_VARIABLE(demo_keyinterval, demo_keyinterval, 0) {}
+
+VARIABLE_INT(demo_keyframes, nullptr, 0, 1024, nullptr);
+CONSOLE_VARIABLE(demo_keyframes, demo_keyframes, 0) {}
+
+//
+// G_seekCommand
+//
+static void G_seekCommand(int tic)
+{
+   if(!demoplayback)
+   {
+      C_Printf(FC_ERROR "No demo is playing\n");
+      return;
+   }
+   if(!G_DemoSeek(tic))
+   {
+      C_Printf(FC_ERROR "Can't rewind that far\n");
+      return;
+   }
+   int seconds = demotic / TICRATE;
+   C_Printf("Demo at %d:%02d\n", seconds / 60, seconds % 60);
+}
+
+//
+// demo_seek seconds
+//
+// Goes to the given time from the start of the demo
+//
+CONSOLE_COMMAND(demo_seek, cf_notnet)
+{
+   if(Console.argc < 1)
+   {
+      C_Printf("usage: demo_seek seconds\n");
+      return;
+   }
+   G_seekCommand(Console.argv[0]->toInt() * TICRATE);
+}
+
+//
+// demo_skip seconds
+//
+// Goes forward, or back if negative
+//
+CONSOLE_COMMAND(demo_skip, cf_notnet)
+{
+   if(Console.argc < 1)
+   {
+      C_Printf("usage: demo_skip seconds\n");
+      return;
+   }
+   G_seekCommand(demotic + Console.argv[0]->toInt() * TICRATE);
+}
+
+// EOF
+
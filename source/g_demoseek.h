@@ -0,0 +1,43 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2026 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//
+//   Demo seeking. Snapshots of the game are kept in memory during demo
+//   playback, so it can jump back or forth without replaying from the start.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef G_DEMOSEEK_H__
+#define G_DEMOSEEK_H__
+
+extern int demo_keyinterval;
+extern int demo_keyframes;
+
+void G_ClearDemoKeyframes();
+void G_DemoKeyframeTicker();
+
+int  G_DemoTic();
+bool G_DemoSeek(int tic);
+
+#endif
+
+// EOF
+
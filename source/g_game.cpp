@@ -37,6 +37,9 @@
 #include "acs_intr.h"
 #include "am_map.h"
 #include "autodoom/b_ape.h"
+#include "autodoom/b_bench.h"
+#include "autodoom/b_cachegen.h"
+#include "autodoom/b_compression.h"
 #include "autodoom/b_think.h"
 #include "c_io.h"
 #include "c_net.h"
@@ -58,6 +61,7 @@
 #include "f_wipe.h"
 #include "g_bind.h"
 #include "g_demolog.h"
+#include "g_demoseek.h"
 #include "g_dmflag.h"
 #include "g_game.h"
 #include "in_lude.h"
@@ -65,6 +69,7 @@
 #include "m_buffer.h"
 #include "m_collection.h"
 #include "m_misc.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "m_shots.h"
 #include "m_utils.h"
@@ -1372,6 +1377,7 @@ void G_DoPlayDemo(void)
    precache = true;
    usergame = false;
    demoplayback = true;
+   G_ClearDemoKeyframes();
    
    gameaction = ga_nothing;
 
@@ -2131,6 +2137,7 @@ static void G_CameraTicker(void)
 //
 void G_Ticker()
 {
+   PROFILE_ZONE("G_Ticker");
    int i;
 
    // If theplayer (bot) dies, wait a few seconds and then quit.
@@ -2286,8 +2293,28 @@ void G_Ticker()
    }
    else
    {
+      // ioanch: snapshot the demo before reading the next commands
+      if(demoplayback && !demorecording)
+         G_DemoKeyframeTicker();
+
       // get commands, check consistency, and build new consistancy check
       int buf = (gametic / ticdup) % BACKUPTICS;
+
+      for(i=0; i<MAXPLAYERS; i++)
+      {
+         if(playeringame[i])
+            memcpy(&players[i].cmd, &netcmds[i][buf], sizeof(ticcmd_t));
+      }
+
+      // IOANCH: add bot commands if game is running. All bots at once, so
+      // they can think in parallel.
+      if(botMap && !demoplayback && !paused)
+      {
+         // if -netbot (0), then move all other players.
+         // if not -netbot (1), then only move console player
+         BenchClock clock(BENCH_BOT);
+         Bot::DoCommands();
+      }
       
       for(i=0; i<MAXPLAYERS; i++)
       {
@@ -2296,15 +2323,6 @@ void G_Ticker()
             ticcmd_t *cmd = &players[i].cmd;
             playerclass_t *pc = players[i].pclass;
             
-            memcpy(cmd, &netcmds[i][buf], sizeof *cmd);
-            
-            // IOANCH: add bot commands if game is running
-            if(botMap && !demoplayback && !paused)
-            {
-               // if -netbot (0), then move all other players.
-               // if not -netbot (1), then only move console player
-               bots[i].doCommand();
-            }
             if(!paused)
                gPlayerObservers[i].makeObservations();
             
@@ -2400,7 +2418,10 @@ void G_Ticker()
  
    if(gamestate == GS_LEVEL)
    {
-      P_Ticker();
+      {
+         BenchClock clock(BENCH_TICKER);
+         P_Ticker();
+      }
       G_CameraTicker(); // haleyjd: move cameras
       ST_Ticker(); 
       AM_Ticker(); 
@@ -2423,6 +2444,13 @@ void G_Ticker()
          break;
       }
    }
+
+   // ioanch: end bot benchmark and cache workers when done
+   B_BenchTicker();
+   B_CacheGenTicker();
+
+   // ioanch: report saved games and caches written in the background
+   B_PollAsyncWrites();
 }
 
 //
@@ -3068,7 +3096,8 @@ void G_ScrambleRand()
 {
    // SoM 3/13/2002: New SMMU code actually compiles in VC++
    // sf: simpler
-   rngseed = (unsigned int) time(nullptr);
+   // ioanch: bot benchmarks must play the same game every time
+   rngseed = bench_worker ? B_BenchSeed() : (unsigned int) time(nullptr);
 }
 
 void G_DoNewGame()
@@ -3857,6 +3886,7 @@ bool G_CheckDemoStatus()
       // haleyjd 01/08/11: refactored so that stopping netdemos doesn't cause
       // access violations by leaving the game in "netgame" mode.
       Z_ChangeTag(demobuffer, PU_CACHE);
+      G_ClearDemoKeyframes();
       G_ReloadDefaults();    // killough 3/1/98
       netgame = false;       // killough 3/29/98
 
@@ -3871,6 +3901,24 @@ bool G_CheckDemoStatus()
    return false;
 }
 
+//
+// G_DemoPosition
+//
+// ioanch: offset of the next ticcmd in the demo being played back
+//
+size_t G_DemoPosition()
+{
+   return demo_p - demobuffer;
+}
+
+//
+// G_SetDemoPosition
+//
+void G_SetDemoPosition(size_t position)
+{
+   demo_p = demobuffer + position;
+}
+
 void G_StopDemo()
 {
    extern bool advancedemo;
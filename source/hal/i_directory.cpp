@@ -87,6 +87,22 @@ const char *I_PlatformInstallDirectory()
    return nullptr;
 }
 
+//
+// I_ReplaceFile
+//
+// Renames from to to, replacing to if it exists, without a moment when to is
+// missing. Safe to call from any thread.
+//
+bool I_ReplaceFile(const char *from, const char *to)
+{
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+   // POSIX rename already replaces the destination atomically
+   return !rename(from, to);
+#endif
+}
+
 //
 // Clears all symbolic links from a path (which may be relative) and returns the
 // real path in "real"
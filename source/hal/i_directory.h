@@ -33,6 +33,7 @@ class qstring;
 
 
 bool I_CreateDirectory(qstring const &path);
+bool I_ReplaceFile(const char *from, const char *to);
 
 const char *I_PlatformInstallDirectory();
 
@@ -0,0 +1,159 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Read-only memory-mapped files
+//
+//-----------------------------------------------------------------------------
+
+#include "../z_zone.h"
+
+#include "i_mapfile.h"
+#include "i_platform.h"
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+#include <windows.h>
+#elif EE_CURRENT_PLATFORM == EE_PLATFORM_LINUX \
+   || EE_CURRENT_PLATFORM == EE_PLATFORM_MACOSX \
+   || EE_CURRENT_PLATFORM == EE_PLATFORM_FREEBSD
+#define EE_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// MappedFile::open
+//
+// Maps the file. Returns false if it can't be opened or is empty.
+//
+bool MappedFile::open(const char *filename)
+{
+   close();
+
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+   HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if(file == INVALID_HANDLE_VALUE)
+      return false;
+   LARGE_INTEGER filesize;
+   if(!GetFileSizeEx(file, &filesize) || !filesize.QuadPart ||
+      (uint64_t)filesize.QuadPart > SIZE_MAX)
+   {
+      CloseHandle(file);
+      return false;
+   }
+   HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if(!mapping)
+   {
+      CloseHandle(file);
+      return false;
+   }
+   const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if(!view)
+   {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+   }
+   fileHandle = file;
+   mapHandle = mapping;
+   data = static_cast<const byte *>(view);
+   size = (size_t)filesize.QuadPart;
+   mapped = true;
+   return true;
+#elif defined(EE_HAVE_MMAP)
+   int fd = ::open(filename, O_RDONLY);
+   if(fd < 0)
+      return false;
+   struct stat sbuf;
+   if(fstat(fd, &sbuf) || sbuf.st_size <= 0)
+   {
+      ::close(fd);
+      return false;
+   }
+   void *view = mmap(nullptr, (size_t)sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);   // the mapping stays valid
+   if(view == MAP_FAILED)
+      return false;
+   data = static_cast<const byte *>(view);
+   size = (size_t)sbuf.st_size;
+   mapped = true;
+   return true;
+#else
+   FILE *f = fopen(filename, "rb");
+   if(!f)
+      return false;
+   fseek(f, 0, SEEK_END);
+   long filesize = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   if(filesize <= 0)
+   {
+      fclose(f);
+      return false;
+   }
+   byte *buffer = emalloc(byte *, filesize);
+   if(fread(buffer, 1, filesize, f) != (size_t)filesize)
+   {
+      efree(buffer);
+      fclose(f);
+      return false;
+   }
+   fclose(f);
+   data = buffer;
+   size = (size_t)filesize;
+   mapped = false;
+   return true;
+#endif
+}
+
+//
+// MappedFile::close
+//
+void MappedFile::close()
+{
+   if(!data)
+      return;
+
+   if(mapped)
+   {
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_WINDOWS
+      UnmapViewOfFile(data);
+      CloseHandle(mapHandle);
+      CloseHandle(fileHandle);
+      mapHandle = fileHandle = nullptr;
+#elif defined(EE_HAVE_MMAP)
+      munmap(const_cast<byte *>(data), size);
+#endif
+   }
+   else
+      efree(const_cast<byte *>(data));
+
+   data = nullptr;
+   size = 0;
+   mapped = false;
+}
+
+// EOF
+
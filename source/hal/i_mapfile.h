@@ -0,0 +1,84 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Read-only memory-mapped files
+//
+//-----------------------------------------------------------------------------
+
+#ifndef I_MAPFILE_H__
+#define I_MAPFILE_H__
+
+#include "../doomtype.h"
+
+//
+// MappedFile
+//
+// Maps a whole file into memory for reading. Falls back to reading it into
+// the heap on platforms without file mapping.
+//
+class MappedFile
+{
+public:
+   MappedFile() = default;
+   MappedFile(const MappedFile &) = delete;
+   MappedFile &operator = (const MappedFile &) = delete;
+   ~MappedFile()
+   {
+      close();
+   }
+
+   bool open(const char *filename);
+   void close();
+
+   const byte *getData() const
+   {
+      return data;
+   }
+   size_t getSize() const
+   {
+      return size;
+   }
+   bool isOpen() const
+   {
+      return data != nullptr;
+   }
+   bool isMapped() const
+   {
+      return mapped;
+   }
+
+private:
+   const byte *data = nullptr;
+   size_t size = 0;
+   bool mapped = false;    // false if read into the heap
+#ifdef _WIN32
+   void *fileHandle = nullptr;
+   void *mapHandle = nullptr;
+#endif
+};
+
+#endif
+
+// EOF
+
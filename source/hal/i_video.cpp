@@ -41,6 +41,7 @@
 #include "../in_lude.h"
 #include "../m_argv.h"
 #include "../m_misc.h"
+#include "../m_profile.h"
 #include "../m_qstr.h"
 #include "../r_main.h"
 #include "../st_stuff.h"
@@ -198,6 +199,8 @@ bool i_letterbox;
 //
 void I_FinishUpdate()
 {
+   PROFILE_ZONE("I_FinishUpdate");
+
    if(!noblit && in_graphics_mode)
       i_video_driver->FinishUpdate();
 }
@@ -55,6 +55,14 @@ inline int16_t GetBinaryWord(byte *&data)
    return val;
 }
 
+inline int16_t GetBinaryWord(const byte *&data)
+{
+   const int16_t val = SwapShort(read16_le(data, int16_t));
+   data += 2;
+
+   return val;
+}
+
 //
 // GetBinaryUWord
 //
@@ -81,6 +89,14 @@ inline int32_t GetBinaryDWord(byte *&data)
    return val;
 }
 
+inline int32_t GetBinaryDWord(const byte *&data)
+{
+   const int32_t val = SwapLong(read32_le(data, int32_t));
+   data += 4;
+
+   return val;
+}
+
 //
 // GetBinaryUDWord
 //
@@ -109,6 +125,13 @@ inline void GetBinaryString(byte *&data, char *dest, const int len)
    data += len;
 }
 
+inline void GetBinaryString(const byte *&data, char *dest, const int len)
+{
+   memcpy(dest, data, len);
+
+   data += len;
+}
+
 #endif
 
 // EOF
@@ -63,6 +63,7 @@
 #include "r_main.h"
 #include "r_sky.h"
 #include "r_things.h"
+#include "r_threads.h"
 #include "s_sound.h"
 #include "st_stuff.h"
 #include "v_video.h"
@@ -113,6 +114,8 @@ extern int midi_device;
 extern int adlmidi_numchips;
 extern int adlmidi_bank;
 extern int adlmidi_emulator;
+extern bool snd_midicache;
+extern int snd_midicachesize;
 
 const int BANKS_MAX = (adl_getBanksCount() - 1);
 #endif
@@ -120,6 +123,8 @@ const int BANKS_MAX = (adl_getBanksCount() - 1);
 // haleyjd 10/09/07: wipe waiting
 extern int wipewait;
 
+extern int zip_cachesize;
+
 //jff 3/3/98 added min, max, and help string to all entries
 //jff 4/10/98 added isstr field to specify whether value is string or int
 //
@@ -161,6 +166,9 @@ default_t defaults[] =
 
    DEFAULT_INT("s_precache", &s_precache, nullptr, 0, 0, 1, default_t::wad_no,
                "precache sounds at startup"),
+
+   DEFAULT_INT("zip_cachesize", &zip_cachesize, nullptr, 1024, 0, 1 << 20, default_t::wad_no,
+               "size limit of inflated zip lumps kept on disk with -zipcache in MB (0 = none)"),
   
    // killough 2/21/98
    DEFAULT_INT("pitched_sounds", &pitched_sounds, nullptr, 0, 0, 1, default_t::wad_yes,
@@ -831,12 +839,15 @@ default_t defaults[] =
    
    DEFAULT_INT("r_columnengine",&r_column_engine_num, nullptr, 
                1, 0, NUMCOLUMNENGINES - 1, default_t::wad_no, 
-               "0 = normal, 1 = optimized quad cache"),
+               "0 = normal, 1 = optimized quad cache, 2 = wide SIMD cache"),
    
    DEFAULT_INT("r_spanengine",&r_span_engine_num, nullptr,
                0, 0, NUMSPANENGINES - 1, default_t::wad_no, 
                "0 = high precision, 1 = low precision"),
 
+   DEFAULT_INT("r_threads", &r_threads, nullptr, 1, 1, MAXRENDERTHREADS,
+               default_t::wad_no, "number of threads drawing flats and skies"),
+
    DEFAULT_INT("r_tlstyle", &r_tlstyle, nullptr, 1, 0, R_TLSTYLE_NUM - 1, default_t::wad_yes,
                "Doom object translucency style (0 = none, 1 = Boom, 2 = new)"),
    
@@ -873,6 +884,12 @@ default_t defaults[] =
 
    DEFAULT_INT("snd_bank", &adlmidi_bank, nullptr, 72, 0, BANKS_MAX, default_t::wad_yes,
                "TODO: adlmidi_bank description"),
+
+   DEFAULT_BOOL("snd_midicache", &snd_midicache, nullptr, true, default_t::wad_no,
+                "pre-render ADLMIDI music on a background thread"),
+
+   DEFAULT_INT("snd_midicachesize", &snd_midicachesize, nullptr, 256, 0, 1 << 20, default_t::wad_no,
+               "size limit of pre-rendered ADLMIDI music kept on disk in MB (0 = none)"),
 #endif
 
 
@@ -0,0 +1,448 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Hierarchical scoped-timer profiler
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "z_zone.h"
+
+#include "c_io.h"
+#include "c_runcmd.h"
+#include "m_profile.h"
+#include "v_misc.h"
+
+#ifdef EE_FEATURE_PROFILER
+
+// true while zones are being recorded
+bool prof_enabled;
+
+//
+// A finished zone
+//
+struct profevent_t
+{
+   const char *name;
+   int64_t     start, end;    // nanoseconds
+   uint32_t    frame;         // frame number when the zone started
+   int         depth;         // number of enclosing zones on its thread
+};
+
+//
+// ProfileRing
+//
+// Zones recorded by one thread. Only the owner thread writes to it, and the
+// oldest zones get overwritten once it's full.
+//
+class ProfileRing
+{
+public:
+   explicit ProfileRing(int inThread) : thread(inThread), events(RINGSIZE)
+   {
+   }
+
+   void add(const profevent_t &event)
+   {
+      uint64_t pos = head.load(std::memory_order_relaxed);
+      events[pos & (RINGSIZE - 1)] = event;
+      head.store(pos + 1, std::memory_order_release);
+   }
+
+   //
+   // Appends the held zones to the list. The newest zones of other threads
+   // may be missed while they're recording.
+   //
+   void copy(std::vector<profevent_t> &out) const
+   {
+      uint64_t last = head.load(std::memory_order_acquire);
+      uint64_t first = last > RINGSIZE ? last - RINGSIZE : 0;
+      first = std::max(first, cleared.load(std::memory_order_relaxed));
+      for(uint64_t pos = first; pos < last; ++pos)
+         out.push_back(events[pos & (RINGSIZE - 1)]);
+   }
+
+   void clear()
+   {
+      cleared.store(head.load(std::memory_order_acquire),
+                    std::memory_order_relaxed);
+   }
+
+   int getThread() const
+   {
+      return thread;
+   }
+
+private:
+   enum : uint64_t
+   {
+      RINGSIZE = 1 << 16,   // must be a power of two
+   };
+
+   int                      thread;
+   std::vector<profevent_t> events;
+   std::atomic<uint64_t>    head    { 0 };
+   std::atomic<uint64_t>    cleared { 0 };
+};
+
+// All rings ever created. They're never freed, because zones may still be
+// read after their thread ends.
+static std::mutex                               ringmutex;
+static std::vector<std::unique_ptr<ProfileRing>> rings;
+
+static thread_local ProfileRing *threadring;
+static thread_local int          threaddepth;
+
+static std::atomic<uint32_t> curframe;
+static ProfileRing          *mainring;   // thread which counts the frames
+
+//
+// M_profileNow
+//
+static int64_t M_profileNow()
+{
+   using namespace std::chrono;
+   return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// M_profileRing
+//
+// Gets the ring of the calling thread, creating it on first use
+//
+static ProfileRing *M_profileRing()
+{
+   if(!threadring)
+   {
+      std::lock_guard<std::mutex> lock(ringmutex);
+      rings.emplace_back(new ProfileRing((int)rings.size()));
+      threadring = rings.back().get();
+   }
+   return threadring;
+}
+
+//
+// M_ProfileNewFrame
+//
+// Called by the main loop at the start of each frame
+//
+void M_ProfileNewFrame()
+{
+   curframe.fetch_add(1, std::memory_order_relaxed);
+   if(prof_enabled && !mainring)
+      mainring = M_profileRing();
+}
+
+//
+// ProfileZone::begin
+//
+void ProfileZone::begin(const char *inName)
+{
+   name  = inName;
+   frame = curframe.load(std::memory_order_relaxed);
+   ++threaddepth;
+   start = M_profileNow();
+}
+
+//
+// ProfileZone::end
+//
+void ProfileZone::end()
+{
+   profevent_t event;
+   event.end   = M_profileNow();
+   event.name  = name;
+   event.start = start;
+   event.frame = frame;
+   event.depth = --threaddepth;
+   M_profileRing()->add(event);
+}
+
+//
+// Zones of one thread, as gathered for output
+//
+struct profthread_t
+{
+   int                      thread;
+   std::vector<profevent_t> events;
+};
+
+//
+// M_gatherZones
+//
+// Copies the zones of all threads, each sorted by start time, parents first
+//
+static void M_gatherZones(std::vector<profthread_t> &threads)
+{
+   std::lock_guard<std::mutex> lock(ringmutex);
+   threads.resize(rings.size());
+   for(size_t i = 0; i < rings.size(); ++i)
+   {
+      threads[i].thread = rings[i]->getThread();
+      rings[i]->copy(threads[i].events);
+      std::sort(threads[i].events.begin(), threads[i].events.end(),
+                [](const profevent_t &a, const profevent_t &b) {
+         return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+      });
+   }
+}
+
+//=============================================================================
+//
+// Zone trees
+//
+
+//
+// Zones with the same name and parent are merged into one node
+//
+struct profnode_t
+{
+   const char *name;
+   int64_t     total;      // nanoseconds
+   int         count;
+   int         firstchild;
+   int         nextsibling;
+};
+
+//
+// M_buildTree
+//
+// Builds the merged zone tree of a frame. Node 0 is the root.
+//
+static void M_buildTree(const std::vector<profevent_t> &events, uint32_t frame,
+                        std::vector<profnode_t> &nodes)
+{
+   nodes.clear();
+   nodes.push_back({ "", 0, 0, -1, -1 });
+
+   std::vector<int> stack;    // node of each depth
+   for(const profevent_t &event : events)
+   {
+      if(event.frame != frame)
+         continue;
+
+      // Zones whose parent was lost go to the deepest one left
+      stack.resize(std::min((size_t)event.depth, stack.size()));
+      int parent = stack.empty() ? 0 : stack.back();
+
+      int node;
+      for(node = nodes[parent].firstchild; node != -1;
+          node = nodes[node].nextsibling)
+      {
+         if(!strcmp(nodes[node].name, event.name))
+            break;
+      }
+      if(node == -1)
+      {
+         node = (int)nodes.size();
+         nodes.push_back({ event.name, 0, 0, -1, -1 });
+
+         // keep the children in order of first appearance
+         int *link = &nodes[parent].firstchild;
+         while(*link != -1)
+            link = &nodes[*link].nextsibling;
+         *link = node;
+      }
+      nodes[node].total += event.end - event.start;
+      nodes[node].count++;
+      stack.push_back(node);
+   }
+}
+
+//
+// M_printTree
+//
+static void M_printTree(const std::vector<profnode_t> &nodes, int node, int level)
+{
+   for(int child = nodes[node].firstchild; child != -1;
+       child = nodes[child].nextsibling)
+   {
+      const profnode_t &n = nodes[child];
+      C_Printf("%*s%s: %.3f ms", level * 2, "", n.name, n.total / 1e6);
+      if(n.count > 1)
+         C_Printf(" (%dx)", n.count);
+      C_Printf("\n");
+      M_printTree(nodes, child, level + 1);
+   }
+}
+
+//
+// M_slowestFrame
+//
+// Finds the frame whose outermost main thread zones took longest
+//
+static bool M_slowestFrame(const std::vector<profthread_t> &threads,
+                           uint32_t &frame)
+{
+   std::vector<std::pair<uint32_t, int64_t>> frametimes;
+   for(const profthread_t &thread : threads)
+   {
+      if(!mainring || thread.thread != mainring->getThread())
+         continue;
+      for(const profevent_t &event : thread.events)
+      {
+         if(event.depth)
+            continue;
+         if(frametimes.empty() || frametimes.back().first != event.frame)
+            frametimes.emplace_back(event.frame, 0);
+         frametimes.back().second += event.end - event.start;
+      }
+   }
+   if(frametimes.empty())
+      return false;
+   frame = std::max_element(frametimes.begin(), frametimes.end(),
+                            [](const std::pair<uint32_t, int64_t> &a,
+                               const std::pair<uint32_t, int64_t> &b) {
+      return a.second < b.second;
+   })->first;
+   return true;
+}
+
+//
+// M_dumpFrame
+//
+static void M_dumpFrame(const std::vector<profthread_t> &threads, uint32_t frame)
+{
+   std::vector<profnode_t> nodes;
+
+   C_Printf(FC_HI "Frame %u\n", frame);
+   for(const profthread_t &thread : threads)
+   {
+      M_buildTree(thread.events, frame, nodes);
+      if(nodes[0].firstchild == -1)
+         continue;
+      C_Printf(FC_GRAY "Thread %d%s\n", thread.thread,
+               mainring && thread.thread == mainring->getThread() ? " (main)" : "");
+      M_printTree(nodes, 0, 1);
+   }
+}
+
+//=============================================================================
+//
+// Chrome trace export
+//
+
+//
+// M_writeTrace
+//
+// Writes all held zones as Chrome trace event JSON, which can be loaded
+// in chrome://tracing or Perfetto
+//
+static bool M_writeTrace(const char *filename)
+{
+   std::vector<profthread_t> threads;
+   M_gatherZones(threads);
+
+   int64_t origin = INT64_MAX;
+   for(const profthread_t &thread : threads)
+   {
+      if(!thread.events.empty())
+         origin = std::min(origin, thread.events.front().start);
+   }
+
+   FILE *f = fopen(filename, "w");
+   if(!f)
+      return false;
+
+   fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+   bool first = true;
+   for(const profthread_t &thread : threads)
+   {
+      for(const profevent_t &event : thread.events)
+      {
+         fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                 "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                 first ? "" : ",", event.name, thread.thread,
+                 (event.start - origin) / 1e3, (event.end - event.start) / 1e3,
+                 event.frame);
+         first = false;
+      }
+   }
+   fputs("\n]}\n", f);
+   fclose(f);
+   return true;
+}
+
+//=============================================================================
+//
+// Console commands
+//
+
+VARIABLE_TOGGLE(prof_enabled, nullptr, onoff);
+CONSOLE_VARIABLE(profiler, prof_enabled, 0) {}
+
+//
+// prof_dump [frames | slowest]
+//
+// Prints the zone trees of the last complete frames, or of the slowest one
+//
+CONSOLE_COMMAND(prof_dump, 0)
+{
+   std::vector<profthread_t> threads;
+   M_gatherZones(threads);
+
+   if(Console.argc && !strcasecmp(Console.argv[0]->constPtr(), "slowest"))
+   {
+      uint32_t frame;
+      if(M_slowestFrame(threads, frame))
+         M_dumpFrame(threads, frame);
+      else
+         C_Printf("No frames recorded\n");
+      return;
+   }
+
+   int count = Console.argc ? Console.argv[0]->toInt() : 1;
+   uint32_t last = curframe.load(std::memory_order_relaxed);
+   for(int i = count; i >= 1; --i)
+      M_dumpFrame(threads, last - i);
+}
+
+//
+// prof_trace [filename]
+//
+CONSOLE_COMMAND(prof_trace, 0)
+{
+   const char *filename = Console.argc ? Console.argv[0]->constPtr() : "profile.json";
+   if(M_writeTrace(filename))
+      C_Printf("Wrote %s\n", filename);
+   else
+      C_Printf(FC_ERROR "Couldn't write %s\n", filename);
+}
+
+CONSOLE_COMMAND(prof_clear, 0)
+{
+   std::lock_guard<std::mutex> lock(ringmutex);
+   for(const std::unique_ptr<ProfileRing> &ring : rings)
+      ring->clear();
+}
+
+#endif
+
+// EOF
+
@@ -0,0 +1,94 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 2026 Ioan Chera
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+// Additional terms and conditions compatible with the GPLv3 apply. See the
+// file COPYING-EE for details.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//      Hierarchical scoped-timer profiler. PROFILE_ZONE("name") times the rest
+//      of the enclosing scope while the "profiler" console variable is on.
+//      Zones are recorded into per-thread ring buffers, and can be dumped as
+//      per-frame trees (prof_dump) or exported as Chrome trace events
+//      (prof_trace). Building without EE_FEATURE_PROFILER removes it.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef M_PROFILE_H__
+#define M_PROFILE_H__
+
+#ifdef EE_FEATURE_PROFILER
+
+#include <stdint.h>
+
+extern bool prof_enabled;
+
+void M_ProfileNewFrame();
+
+//
+// ProfileZone
+//
+// Records its lifetime as a zone of the calling thread. The name must be a
+// string literal, or anything else which lives until the program ends.
+//
+class ProfileZone
+{
+public:
+   explicit ProfileZone(const char *inName)
+   {
+      if(prof_enabled)
+         begin(inName);
+      else
+         name = nullptr;
+   }
+   ~ProfileZone()
+   {
+      if(name)
+         end();
+   }
+
+   ProfileZone(const ProfileZone &) = delete;
+   ProfileZone &operator = (const ProfileZone &) = delete;
+
+private:
+   void begin(const char *inName);
+   void end();
+
+   const char *name;
+   int64_t     start;   // nanoseconds
+   uint32_t    frame;
+};
+
+#define PROFILE_CONCAT2(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profzone_, __LINE__)(name)
+#define PROFILE_FRAME() M_ProfileNewFrame()
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+
+#endif
+
+#endif
+
+// EOF
+
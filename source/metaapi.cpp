@@ -28,6 +28,7 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <mutex>
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomtype.h"
@@ -146,6 +147,10 @@ static EHashTable<metakey_t, ENCStringHashKey, &metakey_t::key, &metakey_t::link
 // Collection of all key objects
 static PODCollection<metakey_t *> metaKeys;
 
+// ioanch: keys may be looked up from bot threads. Keys used there should
+// already be interned, as MetaKeyForIndex isn't locked.
+static std::mutex metaKeyMutex;
+
 //
 // MetaKey
 //
@@ -157,6 +162,7 @@ static metakey_t &MetaKey(const char *key)
 {
    metakey_t *keyObj;
    unsigned int unmodHC = ENCStringHashKey::HashCode(key);
+   std::lock_guard<std::mutex> lock(metaKeyMutex);
 
    // Do we already have this key?
    if(!(keyObj = metaKeyHash.objectForKey(key, unmodHC)))
@@ -31,6 +31,7 @@
 
 #include "hal/i_gamepads.h"
 
+#include "autodoom/b_compression.h"
 #include "c_io.h"
 #include "c_runcmd.h"
 #include "d_deh.h"
@@ -63,6 +64,7 @@
 #include "mn_menus.h"
 #include "mn_misc.h"
 #include "mn_files.h"
+#include "p_saveg.h"
 #include "p_setup.h"
 #include "p_skin.h"
 #include "r_defs.h"
@@ -1348,7 +1350,9 @@ static void MN_ReadSaveStrings()
       char *name = nullptr;    // killough 3/22/98
       size_t len;
       char description[SAVESTRINGSIZE+1]; // sf
-      FILE *fp;  // killough 11/98: change to use stdio
+      InBuffer plainfile;
+      GZExpansion gzfile;
+      InBuffer *loadfile;  // ioanch: saves may be compressed
 
       len = M_StringAlloca(&name, 2, 26, basesavegame, savegamename);
 
@@ -1360,8 +1364,8 @@ static void MN_ReadSaveStrings()
       // if(savegamenames[i])
       //  Z_Free(savegamenames[i]);
 
-      fp = fopen(name,"rb");
-      if(!fp)
+      loadfile = P_OpenSaveFile(name, plainfile, gzfile);
+      if(!loadfile)
       {   // Ty 03/27/98 - externalized:
          // haleyjd
          if(savegamenames[i])
@@ -1371,13 +1375,13 @@ static void MN_ReadSaveStrings()
       }
 
       memset(description, 0, sizeof(description));
-      if(fread(description, SAVESTRINGSIZE, 1, fp) < 1)
+      if(loadfile->read(description, SAVESTRINGSIZE) < SAVESTRINGSIZE)
          doom_printf("%s", FC_ERROR "Warning: savestring read failed");
       if(savegamenames[i])
          Z_Free(savegamenames[i]);
       savegamenames[i] = Z_Strdup(description, PU_STATIC, nullptr);  // haleyjd
       savegamepresent[i] = true;
-      fclose(fp);
+      loadfile->close();
    }
 }
 
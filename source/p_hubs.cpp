@@ -38,6 +38,7 @@
 
 #include "z_zone.h"
 
+#include "autodoom/b_compression.h"
 #include "c_io.h"
 #include "d_event.h"
 #include "doomstat.h"
@@ -85,6 +86,9 @@ char *temp_hubfile(void)
 void P_ClearHubs(void)
 {
    int i;
+
+   // ioanch: don't let pending writes bring the files back
+   B_WaitAsyncWrites();
    
    for(i=0; i<num_hub_levels; i++)
    {
@@ -887,9 +887,13 @@ bool P_TouchSpecialThing(Mobj *special, Mobj *toucher)
 
       // IOANCH 20130815: add item to bot's stack
       if(botMap)
+      {
          for(int i = 0; i < MAXPLAYERS; ++i)
             if(playeringame[i])
                bots[i].addXYEvent(BOT_PICKUP, v2fixed_t(*special));
+         // keys may unlock doors for path finding
+         botMap->invalidatePassability();
+      }
    }
 
    return !pickedup && !staypick;   // always return false if staypick got it
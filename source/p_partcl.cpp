@@ -28,6 +28,7 @@
 #include "z_zone.h"
 
 #include "a_small.h"
+#include "autodoom/b_util.h"
 #include "autopalette.h"
 #include "c_runcmd.h"
 #include "d_main.h"
@@ -35,6 +36,7 @@
 #include "doomtype.h"
 #include "e_sound.h"
 #include "e_ttypes.h"
+#include "m_collection.h"
 #include "m_random.h"
 #include "p_chase.h"
 #include "p_info.h"
@@ -344,129 +346,210 @@ static void P_SetParticlePosition(particle_t *ptcl)
    ptcl->subsector = ss;
 }
 
-void P_ParticleThinker(void)
+//
+// Per-particle state of a P_ParticleThinker run, indexed by position in the
+// active list
+//
+enum
+{
+   PTCLF_DEAD    = 1, // to be freed
+   PTCLF_CROSSED = 2, // went through a line portal, destination is set
+   PTCLF_SPLASH  = 4, // hit the floor, may make a terrain splash
+};
+
+static PODCollection<int> ptclOrder;
+static PODCollection<byte> ptclFlags;
+static PODCollection<const sector_t *> ptclOldSector;
+static PODCollection<v2fixed_t> ptclDest;
+
+// Particles updated by each worker. Smaller counts stay on the main thread.
+#define PARTICLE_CHUNK 1024
+
+//
+// P_moveParticle
+//
+// Does everything for one particle which only touches the particle itself,
+// so it can run on any thread. Sector links are left for the caller.
+//
+static void P_moveParticle(particle_t *particle, byte &flags, const v2fixed_t &dest)
 {
-   int i;
-   particle_t *particle, *prev;
    const sector_t *psec;
    fixed_t floorheight;
-   
-   i = activeParticles;
-   prev = nullptr;
-   while(i != -1) 
-   {
-      particle = Particles + i;
-      i = particle->next;
 
-      // haleyjd: unlink the particle from the world
-      P_UnsetParticlePosition(particle);
+   // haleyjd: particles with fall to ground style don't start
+   // fading or counting down their TTL until they hit the floor
+   if(!(particle->styleflags & PS_FALLTOGROUND))
+   {
+      // perform fading
+      unsigned oldtrans = particle->trans;
+      particle->trans -= particle->fade;
 
-      // haleyjd: particles with fall to ground style don't start
-      // fading or counting down their TTL until they hit the floor
-      if(!(particle->styleflags & PS_FALLTOGROUND))
+      // is it time to kill this particle?
+      if(oldtrans < particle->trans || --particle->ttl == 0)
       {
-         // perform fading
-         unsigned oldtrans = particle->trans;
-         particle->trans -= particle->fade;
-         
-         // is it time to kill this particle?
-         if(oldtrans < particle->trans || --particle->ttl == 0)
-         {
-            memset(particle, 0, sizeof(particle_t));
-            if(prev)
-               prev->next = i;
-            else
-               activeParticles = i;
-            particle->next = inactiveParticles;
-            inactiveParticles = eindex(particle - Particles);
-            continue;
-         }
+         flags |= PTCLF_DEAD;
+         return;
       }
+   }
 
-      // Check for wall portals
-      if(gMapHasLinePortals && particle->velx | particle->vely)
-      {
-         v2fixed_t destination = P_LinePortalCrossing(particle->x, particle->y, 
-            particle->velx, particle->vely);
-         particle->x = destination.x;
-         particle->y = destination.y;
-      }
-      else
-      {
-         // update and link to new position
-         particle->x += particle->velx;
-         particle->y += particle->vely;
-      }
-      particle->z += particle->velz;
-      P_SetParticlePosition(particle);
-      if(P_IsInVoid(particle->x, particle->y, *particle->subsector))
-      {
-         particle->ttl = 1;
-         particle->trans = 0;
-      }
+   // Check for wall portals
+   if(flags & PTCLF_CROSSED)
+   {
+      particle->x = dest.x;
+      particle->y = dest.y;
+   }
+   else
+   {
+      // update and link to new position
+      particle->x += particle->velx;
+      particle->y += particle->vely;
+   }
+   particle->z += particle->velz;
+   particle->subsector = R_PointInSubsector(particle->x, particle->y);
+   if(P_IsInVoid(particle->x, particle->y, *particle->subsector))
+   {
+      particle->ttl = 1;
+      particle->trans = 0;
+   }
 
-      // apply accelerations
-      particle->velx += particle->accx;
-      particle->vely += particle->accy;
-      particle->velz += particle->accz;
+   // apply accelerations
+   particle->velx += particle->accx;
+   particle->vely += particle->accy;
+   particle->velz += particle->accz;
 
-      // handle special movement flags (post-position-set)
+   // handle special movement flags (post-position-set)
 
-      psec = particle->subsector->sector;
+   psec = particle->subsector->sector;
 
-      // haleyjd 09/04/05: use deep water floor if it is higher
-      // than the real floor.
-      floorheight =
-         (psec->heightsec != -1 &&
-          sectors[psec->heightsec].srf.floor.height > psec->srf.floor.height) ?
-          sectors[psec->heightsec].srf.floor.height :
-          psec->srf.floor.height;
+   // haleyjd 09/04/05: use deep water floor if it is higher
+   // than the real floor.
+   floorheight =
+      (psec->heightsec != -1 &&
+       sectors[psec->heightsec].srf.floor.height > psec->srf.floor.height) ?
+       sectors[psec->heightsec].srf.floor.height :
+       psec->srf.floor.height;
 
-      // did particle hit ground, but is now no longer on it?
-      if(particle->styleflags & PS_HITGROUND && particle->z != floorheight)
-         particle->z = floorheight;
+   // did particle hit ground, but is now no longer on it?
+   if(particle->styleflags & PS_HITGROUND && particle->z != floorheight)
+      particle->z = floorheight;
 
-      // floor clipping
-      if(particle->z < floorheight && psec->srf.floor.pflags & PS_PASSABLE)
-      {
-         const linkdata_t *ldata = R_FPLink(psec);
+   // floor clipping
+   if(particle->z < floorheight && psec->srf.floor.pflags & PS_PASSABLE)
+   {
+      const linkdata_t *ldata = R_FPLink(psec);
 
-         P_UnsetParticlePosition(particle);
-         particle->x += ldata->delta.x;
-         particle->y += ldata->delta.y;
-         particle->z += ldata->delta.z;
-         P_SetParticlePosition(particle);
-      }
-      else if(particle->z < floorheight)
+      particle->x += ldata->delta.x;
+      particle->y += ldata->delta.y;
+      particle->z += ldata->delta.z;
+      particle->subsector = R_PointInSubsector(particle->x, particle->y);
+   }
+   else if(particle->z < floorheight)
+   {
+      // particles with fall to ground style start ticking now
+      if(particle->styleflags & PS_FALLTOGROUND)
+         particle->styleflags &= ~PS_FALLTOGROUND;
+
+      // particles with floor clipping may need to stop
+      if(particle->styleflags & PS_FLOORCLIP)
       {
-         // particles with fall to ground style start ticking now
-         if(particle->styleflags & PS_FALLTOGROUND)
-            particle->styleflags &= ~PS_FALLTOGROUND;
+         particle->z = floorheight;
+         particle->accz = particle->velz = 0;
+         particle->styleflags |= PS_HITGROUND;
 
-         // particles with floor clipping may need to stop
-         if(particle->styleflags & PS_FLOORCLIP)
-         {
-            particle->z = floorheight;
-            particle->accz = particle->velz = 0;
-            particle->styleflags |= PS_HITGROUND;
-            
-            // some particles make splashes
-            if(particle->styleflags & PS_SPLASH)
-               E_PtclTerrainHit(particle);
-         }
+         // some particles make splashes
+         if(particle->styleflags & PS_SPLASH)
+            flags |= PTCLF_SPLASH;
       }
-      else if(particle->z > psec->srf.ceiling.height && psec->srf.ceiling.pflags & PS_PASSABLE)
+   }
+   else if(particle->z > psec->srf.ceiling.height && psec->srf.ceiling.pflags & PS_PASSABLE)
+   {
+      const linkdata_t *ldata = R_CPLink(psec);
+
+      particle->x += ldata->delta.x;
+      particle->y += ldata->delta.y;
+      particle->z += ldata->delta.z;
+      particle->subsector = R_PointInSubsector(particle->x, particle->y);
+   }
+}
+
+//
+// P_ParticleThinker
+//
+// ioanch: runs in stages. Line portal crossings use the shared path traverser,
+// so they're found first on the main thread. Then all particles are moved in
+// parallel chunks, and finally the sector links and the active list are
+// updated in list order. Particles staying in the same sector aren't relinked.
+//
+void P_ParticleThinker(void)
+{
+   ptclOrder.makeEmpty<true>();
+   for(int i = activeParticles; i != -1; i = Particles[i].next)
+      ptclOrder.add(i);
+
+   int count = (int)ptclOrder.getLength();
+   if(!count)
+      return;
+
+   ptclFlags.resize(count);
+   ptclOldSector.resize(count);
+   ptclDest.resize(count);
+   for(int k = 0; k < count; ++k)
+   {
+      const particle_t &particle = Particles[ptclOrder[k]];
+      ptclFlags[k] = 0;
+      ptclOldSector[k] = particle.subsector ? particle.subsector->sector : nullptr;
+      if(gMapHasLinePortals && particle.velx | particle.vely)
       {
-         const linkdata_t *ldata = R_CPLink(psec);
+         ptclDest[k] = P_LinePortalCrossing(particle.x, particle.y,
+                                            particle.velx, particle.vely);
+         ptclFlags[k] |= PTCLF_CROSSED;
+      }
+   }
 
+   B_ParallelFor(count, [](int begin, int end, int) {
+      for(int k = begin; k < end; ++k)
+         P_moveParticle(Particles + ptclOrder[k], ptclFlags[k], ptclDest[k]);
+   }, emax(count / PARTICLE_CHUNK, 1));
+
+   int prev = -1;
+   for(int k = 0; k < count; ++k)
+   {
+      int i = ptclOrder[k];
+      particle_t *particle = Particles + i;
+
+      if(ptclFlags[k] & PTCLF_DEAD)
+      {
+         // haleyjd: unlink the particle from the world
          P_UnsetParticlePosition(particle);
-         particle->x += ldata->delta.x;
-         particle->y += ldata->delta.y;
-         particle->z += ldata->delta.z;
-         P_SetParticlePosition(particle);
+         memset(particle, 0, sizeof(particle_t));
+         particle->next = inactiveParticles;
+         inactiveParticles = i;
+         continue;
       }
-      
-      prev = particle;
+
+      const sector_t *sector = particle->subsector->sector;
+      if(sector != ptclOldSector[k])
+      {
+         particle->seclinks.remove();
+         particle->seclinks.insert(particle, &particle->subsector->sector->ptcllist);
+      }
+
+      if(prev == -1)
+         activeParticles = i;
+      else
+         Particles[prev].next = i;
+      prev = i;
+   }
+   if(prev == -1)
+      activeParticles = -1;
+   else
+      Particles[prev].next = -1;
+
+   // Splashes may spawn things, so wait until the list is whole again
+   for(int k = 0; k < count; ++k)
+   {
+      if((ptclFlags[k] & (PTCLF_DEAD | PTCLF_SPLASH)) == PTCLF_SPLASH)
+         E_PtclTerrainHit(Particles + ptclOrder[k]);
    }
 }
 
@@ -27,6 +27,7 @@
 #include "z_zone.h"
 
 #include "c_io.h"
+#include "cam_sight.h"
 #include "doomstat.h"
 #include "e_exdata.h"
 #include "ev_specials.h"
@@ -1081,6 +1082,7 @@ void P_SetPortalBehavior(portal_t *portal, int newbehavior)
 {
    int   i;
    
+   CAM_InvalidateSightCache();
    portal->flags = newbehavior & PF_FLAGMASK;
    for(i = 0; i < numsectors; i++)
    {
@@ -1104,6 +1106,7 @@ void P_SetFPortalBehavior(sector_t *sec, int newbehavior)
    if(!sec->srf.floor.portal)
       return;
       
+   CAM_InvalidateSightCache();
    sec->srf.floor.pflags = newbehavior;
    P_CheckFPortalState(sec);
 }
@@ -1113,6 +1116,7 @@ void P_SetCPortalBehavior(sector_t *sec, int newbehavior)
    if(!sec->srf.ceiling.portal)
       return;
       
+   CAM_InvalidateSightCache();
    sec->srf.ceiling.pflags = newbehavior;
    P_CheckCPortalState(sec);
 }
@@ -1122,6 +1126,7 @@ void P_SetLPortalBehavior(line_t *line, int newbehavior)
    if(!line->portal)
       return;
       
+   CAM_InvalidateSightCache();
    line->pflags = newbehavior;
    P_CheckLPortalState(line);
 }
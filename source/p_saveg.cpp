@@ -30,7 +30,9 @@
 #include "acs_intr.h"
 #include "am_map.h"
 #include "autodoom/b_botmap.h"
+#include "autodoom/b_compression.h"
 #include "c_io.h"
+#include "cam_sight.h"
 #include "d_dehtbl.h"
 #include "d_event.h"
 #include "d_gi.h"
@@ -739,6 +741,10 @@ static void P_ArchiveWorld(SaveArchive &arc)
       }
    }
 
+   // IOANCH: the bots' cached passability is for the heights before loading
+   if(arc.isLoading() && botMap)
+      botMap->invalidatePassability();
+
    // do lines
    for(i = 0, li = lines; i < numlines; ++i, ++li)
    {
@@ -1310,152 +1316,179 @@ static void P_ArchiveACS(SaveArchive &arc)
 
 #define SAVESTRINGSIZE 24
 
-void P_SaveCurrentLevel(char *filename, char *description)
+//
+// P_writeSave
+//
+// Writes the whole game state. Throws BufferedIOException on failure.
+//
+static void P_writeSave(OutBuffer &savefile, char *description)
 {
    int i;
    char name2[VERSIONSIZE];
    const char *fn;
-   OutBuffer savefile;
    SaveArchive arc(&savefile);
 
-   if(!savefile.createFile(filename, 512*1024, OutBuffer::NENDIAN))
-   {
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-      return;
-   }
+   arc.archiveCString(description, SAVESTRINGSIZE);
+   
+   // killough 2/22/98: "proprietary" version string :-)
+   memset(name2, 0, sizeof(name2));
+   sprintf(name2, VERSIONID);
 
-   // Enable buffered IO exceptions
-   savefile.setThrowing(true);
+   arc.archiveCString(name2, VERSIONSIZE);
 
-   try
-   {
-      arc.archiveCString(description, SAVESTRINGSIZE);
-      
-      // killough 2/22/98: "proprietary" version string :-)
-      memset(name2, 0, sizeof(name2));
-      sprintf(name2, VERSIONID);
-   
-      arc.archiveCString(name2, VERSIONSIZE);
+   arc.writeSaveVersion();
 
-      arc.writeSaveVersion();
+   // killough 2/14/98: save old compatibility flag:
+   // haleyjd 06/16/10: save "inmasterlevels" state
+   int tempskill = (int)gameskill;
    
-      // killough 2/14/98: save old compatibility flag:
-      // haleyjd 06/16/10: save "inmasterlevels" state
-      int tempskill = (int)gameskill;
-      
-      arc << compatibility << tempskill << inmanageddir;
-      arc << vanilla_mode;
-   
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
-      {
-         int8_t lvc = levelmapname[i];
-         arc << lvc;
-      }
+   arc << compatibility << tempskill << inmanageddir;
+   arc << vanilla_mode;
 
-      // haleyjd 06/16/10: support for saving/loading levels in managed wad
-      // directories.
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc = levelmapname[i];
+      arc << lvc;
+   }
 
-      if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
-      {
-         // save length of managed directory filename string and
-         // managed directory filename string
-         arc.writeLString(fn);
-      }
-      else
-      {
-         // just save 0; there is no name to save
-         size_t len = 0;
-         arc.archiveSize(len);
-      }
+   // haleyjd 06/16/10: support for saving/loading levels in managed wad
+   // directories.
+
+   if((fn = W_GetManagedDirFN(g_dir))) // returns null if g_dir == &w_GlobalDir
+   {
+      // save length of managed directory filename string and
+      // managed directory filename string
+      arc.writeLString(fn);
+   }
+   else
+   {
+      // just save 0; there is no name to save
+      size_t len = 0;
+      arc.archiveSize(len);
+   }
   
-      // killough 3/16/98, 12/98: store lump name checksum
-      // FIXME/TODO: Will be simple with future save format
-      /*
-      uint64_t checksum = G_Signature(g_dir);
-      savefile.Write(&checksum, sizeof(checksum));
-
-      // killough 3/16/98: store pwad filenames in savegame  
-      for(wfileadd_t *file = wadfiles; file->filename; ++file)
-      {
-         const char *fn = file->filename;
-         savefile.Write(fn, strlen(fn));
-         savefile.WriteUint8((uint8_t)'\n');
-      }
-      savefile.WriteUint8(0);
-      */
+   // killough 3/16/98, 12/98: store lump name checksum
+   // FIXME/TODO: Will be simple with future save format
+   /*
+   uint64_t checksum = G_Signature(g_dir);
+   savefile.Write(&checksum, sizeof(checksum));
+
+   // killough 3/16/98: store pwad filenames in savegame  
+   for(wfileadd_t *file = wadfiles; file->filename; ++file)
+   {
+      const char *fn = file->filename;
+      savefile.Write(fn, strlen(fn));
+      savefile.WriteUint8((uint8_t)'\n');
+   }
+   savefile.WriteUint8(0);
+   */
   
-      for(i = 0; i < MAXPLAYERS; i++)
-         arc << playeringame[i];
+   for(i = 0; i < MAXPLAYERS; i++)
+      arc << playeringame[i];
 
-      for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
-      {
-         bool dummy = 0;
-         arc << dummy;
-      }
+   for(; i < MIN_MAXPLAYERS; i++)         // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
 
-      // jff 3/17/98 save idmus state
-      int tempGameType = (int)GameType;
-      arc << idmusnum << tempGameType;
+   // jff 3/17/98 save idmus state
+   int tempGameType = (int)GameType;
+   arc << idmusnum << tempGameType;
 
-      byte options[GAME_OPTION_SIZE];
-      G_WriteOptions(options);    // killough 3/1/98: save game options
-      savefile.write(options, sizeof(options));
-   
-      //killough 11/98: save entire word
-      arc << leveltime;
-   
-      // killough 11/98: save revenant tracer state
-      uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
-      arc << tracerState;
+   byte options[GAME_OPTION_SIZE];
+   G_WriteOptions(options);    // killough 3/1/98: save game options
+   savefile.write(options, sizeof(options));
 
-      arc << dmflags;
-   
-      // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
-      // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
-   
-      P_NumberThinkers();    // turn ptrs to numbers
-
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc); // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
-      P_ArchiveMap(arc);    // killough 1/22/98: save automap information
-      P_ArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_DeNumberThinkers();
-
-      uint8_t cmarker = 0xE6; // consistency marker
-      arc << cmarker; 
+   //killough 11/98: save entire word
+   arc << leveltime;
+
+   // killough 11/98: save revenant tracer state
+   uint8_t tracerState = (uint8_t)((gametic-basetic) & 255);
+   arc << tracerState;
+
+   arc << dmflags;
+
+   // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
+   // haleyjd 07/06/09: just Z_CheckHeap after the end. This stuff works by now.
+
+   P_NumberThinkers();    // turn ptrs to numbers
+
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc); // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);    // killough 1/18/98: save RNG information
+   P_ArchiveMap(arc);    // killough 1/22/98: save automap information
+   P_ArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+
+   P_DeNumberThinkers();
+
+   uint8_t cmarker = 0xE6; // consistency marker
+   arc << cmarker;
+}
+
+void P_SaveCurrentLevel(char *filename, char *description)
+{
+   // ioanch: serialize into memory, then compress and write the file on
+   // another thread, so the game doesn't wait for the disk.
+   MemoryOutBuffer savefile;
+   savefile.create(512*1024, OutBuffer::NENDIAN);
+
+   // Enable buffered IO exceptions
+   savefile.setThrowing(true);
+
+   try
+   {
+      P_writeSave(savefile, description);
    }
    catch(BufferedIOException)
    {
-      // An IO error occurred while trying to save.
-      const char *str =
-         errno ? strerror(errno) : FC_ERROR "Could not save game: Error unknown";
-      doom_printf("%s", str);
-
-      // Close the file and remove it
-      savefile.setThrowing(false);
-      savefile.close();
-      remove(filename);
+      doom_printf("%s", FC_ERROR "Could not save game: Error unknown");
       return;
    }
 
-   // Close the save file
+   savefile.setThrowing(false);
    savefile.close();
 
+   // ioanch: the messages wait until the file is written. sf: no 'game
+   // saved' message for hubs, but say when it failed. Ty 03/27/98 -
+   // externalized
+   B_WriteCompressedAsync(filename, std::move(savefile.getData()),
+                          CompressLevel_Speed,
+                          hub_changelevel ? nullptr : DEH_String("GGSAVED"),
+                          FC_ERROR "Could not save game: Error writing file");
+
    // Check the heap.
    Z_CheckHeap();
+}
 
-   if(!hub_changelevel) // sf: no 'game saved' message for hubs
-      doom_printf("%s", DEH_String("GGSAVED"));  // Ty 03/27/98 - externalized
+//
+// P_SaveGameToBuffer
+//
+// ioanch: saves the game into an already created buffer, without any file
+// handling or messages. Used for in-memory snapshots.
+//
+bool P_SaveGameToBuffer(OutBuffer &savefile)
+{
+   char description[SAVESTRINGSIZE] = "";
+
+   savefile.setThrowing(true);
+   try
+   {
+      P_writeSave(savefile, description);
+   }
+   catch(BufferedIOException)
+   {
+      savefile.setThrowing(false);
+      return false;
+   }
+   savefile.setThrowing(false);
+   return true;
 }
 
 //============================================================================
@@ -1463,42 +1496,38 @@ void P_SaveCurrentLevel(char *filename, char *description)
 // Loading -- Main Routine
 //
 
-void P_LoadGame(const char *filename)
+//
+// P_readSave
+//
+// Reads the whole game state. Returns false if the save version isn't
+// supported, and throws on read errors.
+//
+static bool P_readSave(InBuffer &loadfile, bool keepversion)
 {
    int i;
    //uint64_t checksum, rchecksum;
-   InBuffer loadfile;
    SaveArchive arc(&loadfile);
 
-   if(!loadfile.openFile(filename, InBuffer::NENDIAN))
-   {
-      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
-      C_SetConsole();
-      return;
-   }
+   // skip description
+   char throwaway[SAVESTRINGSIZE];
 
-   // Enable buffered IO exceptions
-   loadfile.setThrowing(true);
+   arc.archiveCString(throwaway, SAVESTRINGSIZE);
 
-   try
-   {
-      // skip description
-      char throwaway[SAVESTRINGSIZE];
-
-      arc.archiveCString(throwaway, SAVESTRINGSIZE);
-
-      if(!arc.readSaveVersion())
-         return;
+   if(!arc.readSaveVersion())
+      return false;
 
-      // killough 2/14/98: load compatibility mode
-      // haleyjd 06/16/10: reload "inmasterlevels" state
-      int tempskill;
-      arc << compatibility << tempskill << inmanageddir;
+   // killough 2/14/98: load compatibility mode
+   // haleyjd 06/16/10: reload "inmasterlevels" state
+   int tempskill;
+   arc << compatibility << tempskill << inmanageddir;
 
-      gameskill = (skill_t)tempskill;
+   gameskill = (skill_t)tempskill;
   
-      arc << vanilla_mode;  // -vanilla setting
-      if(vanilla_mode)      // use UDoom version (no point for longtics now).
+   arc << vanilla_mode;  // -vanilla setting
+   // ioanch: a demo being played back keeps its own version
+   if(!keepversion)
+   {
+      if(vanilla_mode) // use UDoom version (no point for longtics now).
       {
          // All the other settings (save longtics) are stored in the save
          demo_version = 109;
@@ -1509,152 +1538,222 @@ void P_LoadGame(const char *filename)
          demo_version    = version;    // killough 7/19/98: use this version's id
          demo_subversion = subversion; // haleyjd 06/17/01
       }
+   }
 
-      // sf: use string rather than episode, map
-      for(i = 0; i < 8; i++)
-      {
-         int8_t lvc;
-         arc << lvc;
-         gamemapname[i] = (char)lvc;
-      }
-      gamemapname[8] = '\0'; // ending nullptr
+   // sf: use string rather than episode, map
+   for(i = 0; i < 8; i++)
+   {
+      int8_t lvc;
+      arc << lvc;
+      gamemapname[i] = (char)lvc;
+   }
+   gamemapname[8] = '\0'; // ending nullptr
 
-      G_SetGameMap(); // get gameepisode, map
+   G_SetGameMap(); // get gameepisode, map
 
-      // start out g_dir pointing at wGlobalDir again
-      g_dir = &wGlobalDir;
+   // start out g_dir pointing at wGlobalDir again
+   g_dir = &wGlobalDir;
 
-      // haleyjd 06/16/10: if the level was saved in a map loaded under a managed
-      // directory, we need to restore the managed directory to g_dir when loading
-      // the game here. When this is the case, the file name of the managed directory
-      // has been saved into the save game.
-      size_t len;
-      arc.archiveSize(len);
+   // haleyjd 06/16/10: if the level was saved in a map loaded under a managed
+   // directory, we need to restore the managed directory to g_dir when loading
+   // the game here. When this is the case, the file name of the managed directory
+   // has been saved into the save game.
+   size_t len;
+   arc.archiveSize(len);
 
-      if(len)
-      {
-         WadDirectory *dir;
-
-         // read a name of len bytes 
-         char *fn = ecalloc(char *, 1, len);
-         arc.archiveCString(fn, len);
-
-         // Try to get an existing managed wad first. If none such exists, try
-         // adding it now. If that doesn't work, the normal error message appears
-         // for a missing wad.
-         // Note: set d_dir as well, so G_InitNew won't overwrite with wGlobalDir!
-         if((dir = W_GetManagedWad(fn)) || (dir = W_AddManagedWad(fn)))
-            g_dir = d_dir = dir;
-
-         // done with temporary file name
-         efree(fn);
-
-         // 11/04/12: Since we loaded a managed directory wad, initialize the
-         // mission. This will take care of any special data loading 
-         // requirements, such as metadata for NR4TL.
-         W_InitManagedMission(inmanageddir);
-      }
-   
-      // killough 3/16/98, 12/98: check lump name checksum
-      // FIXME/TODO: advanced savegame verification is needed
-      /*
-      checksum = G_Signature(g_dir);
+   if(len)
+   {
+      WadDirectory *dir;
+
+      // read a name of len bytes 
+      char *fn = ecalloc(char *, 1, len);
+      arc.archiveCString(fn, len);
+
+      // Try to get an existing managed wad first. If none such exists, try
+      // adding it now. If that doesn't work, the normal error message appears
+      // for a missing wad.
+      // Note: set d_dir as well, so G_InitNew won't overwrite with wGlobalDir!
+      if((dir = W_GetManagedWad(fn)) || (dir = W_AddManagedWad(fn)))
+         g_dir = d_dir = dir;
+
+      // done with temporary file name
+      efree(fn);
+
+      // 11/04/12: Since we loaded a managed directory wad, initialize the
+      // mission. This will take care of any special data loading 
+      // requirements, such as metadata for NR4TL.
+      W_InitManagedMission(inmanageddir);
+   }
 
-      loadfile.Read(&rchecksum, sizeof(rchecksum));
+   // killough 3/16/98, 12/98: check lump name checksum
+   // FIXME/TODO: advanced savegame verification is needed
+   /*
+   checksum = G_Signature(g_dir);
 
-      if(memcmp(&checksum, &rchecksum, sizeof checksum))
-      {
-         char *msg = ecalloc(char *, 1, strlen((const char *)(save_p + sizeof checksum)) + 128);
-         strcpy(msg,"Incompatible Savegame!!!\n");
-         if(save_p[sizeof checksum])
-            strcat(strcat(msg,"Wads expected:\n\n"), (char *)(save_p + sizeof checksum));
-         strcat(msg, "\nAre you sure?");
-         C_Puts(msg);
-         G_LoadGameErr(msg);
-         efree(msg);
-         return;
-      }
-      */
+   loadfile.Read(&rchecksum, sizeof(rchecksum));
 
-      for(i = 0; i < MAXPLAYERS; ++i)
-         arc << playeringame[i];
+   if(memcmp(&checksum, &rchecksum, sizeof checksum))
+   {
+      char *msg = ecalloc(char *, 1, strlen((const char *)(save_p + sizeof checksum)) + 128);
+      strcpy(msg,"Incompatible Savegame!!!\n");
+      if(save_p[sizeof checksum])
+         strcat(strcat(msg,"Wads expected:\n\n"), (char *)(save_p + sizeof checksum));
+      strcat(msg, "\nAre you sure?");
+      C_Puts(msg);
+      G_LoadGameErr(msg);
+      efree(msg);
+      return;
+   }
+   */
 
-      for(; i < MIN_MAXPLAYERS; i++) // killough 2/28/98
-      {
-         bool dummy = 0;
-         arc << dummy;
-      }
+   for(i = 0; i < MAXPLAYERS; ++i)
+      arc << playeringame[i];
+
+   for(; i < MIN_MAXPLAYERS; i++) // killough 2/28/98
+   {
+      bool dummy = 0;
+      arc << dummy;
+   }
 
-      // jff 3/17/98 restore idmus music
-      // jff 3/18/98 account for unsigned byte
-      // killough 11/98: simplify
-      // haleyjd 04/14/03: game type
-      // note: don't set DefaultGameType from save games
-      int tempGameType;
-      arc << idmusnum << tempGameType;
+   // jff 3/17/98 restore idmus music
+   // jff 3/18/98 account for unsigned byte
+   // killough 11/98: simplify
+   // haleyjd 04/14/03: game type
+   // note: don't set DefaultGameType from save games
+   int tempGameType;
+   arc << idmusnum << tempGameType;
 
-      GameType = (gametype_t)tempGameType;
+   GameType = (gametype_t)tempGameType;
 
-      /* cph 2001/05/23 - Must read options before we set up the level */
-      byte options[GAME_OPTION_SIZE];
-      loadfile.read(options, sizeof(options));
+   /* cph 2001/05/23 - Must read options before we set up the level */
+   byte options[GAME_OPTION_SIZE];
+   loadfile.read(options, sizeof(options));
 
-      G_ReadOptions(options);
+   G_ReadOptions(options);
  
-      // load a base level
-      // sf: in hubs, use g_doloadlevel instead of g_initnew
-      if(hub_changelevel)
-         G_DoLoadLevel();
-      else
+   // load a base level
+   // sf: in hubs, use g_doloadlevel instead of g_initnew
+   if(hub_changelevel)
+      G_DoLoadLevel();
+   else
+   {
+      // IOANCH 20140713: guard against creating bot map if demo is playing
+      if(singledemo)
+         BotMap::demoPlayingFlag = true;
+      G_InitNew(gameskill, gamemapname);
+      if(singledemo)
+         BotMap::demoPlayingFlag = false;
+   }
+
+   // killough 3/1/98: Read game options
+   // killough 11/98: move down to here
+
+   // cph - MBF needs to reread the savegame options because 
+   // G_InitNew rereads the WAD options. The demo playback code does 
+   // this too.
+   G_ReadOptions(options);
+
+   // get the times
+   arc << leveltime;
+
+   // killough 11/98: load revenant tracer state
+   uint8_t tracerState;
+   arc << tracerState;
+   basetic = gametic - tracerState;
+
+   // haleyjd 04/14/03: load dmflags
+   arc << dmflags;
+
+   // dearchive all the modifications
+   P_ArchivePlayers(arc);
+   P_ArchiveWorld(arc);
+   P_ArchiveLevelInfo(arc);
+   P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
+   P_ArchiveThinkers(arc);
+   P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
+   P_ArchiveMap(arc);            // killough 1/22/98: load automap information
+   P_UnArchiveSoundSequences(arc);
+   P_ArchiveButtons(arc);
+   P_ArchiveACS(arc);            // davidph 05/30/12
+
+   P_FreeThinkerTable();
+
+   uint8_t cmarker;
+   arc << cmarker;
+   if(cmarker != 0xE6)
+      I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
+
+   // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
+   Z_CheckHeap();
+   return true;
+}
+
+//
+// P_OpenSaveFile
+//
+// ioanch: opens a savegame for reading, waiting for it if it's still being
+// written. Compressed saves are told apart from plain ones by the version
+// string, which follows the description in the latter. Returns whichever of
+// the two buffers got opened, or null on failure.
+//
+InBuffer *P_OpenSaveFile(const char *filename, InBuffer &plainfile,
+                         GZExpansion &gzfile)
+{
+   B_WaitAsyncWrite(filename);
+
+   FILE *f = fopen(filename, "rb");
+   if(!f)
+      return nullptr;
+
+   byte head[SAVESTRINGSIZE + 4];
+   bool plain = true;
+   if(fread(head, 1, sizeof(head), f) == sizeof(head))
+   {
+      const char *version = reinterpret_cast<const char *>(head + SAVESTRINGSIZE);
+      plain = !strncmp(version, VERSIONID, strlen(VERSIONID)) ||
+              !strncmp(version, "MBF ", 4);
+   }
+   if(fseek(f, 0, SEEK_SET))
+   {
+      fclose(f);
+      return nullptr;
+   }
+
+   if(plain)
+   {
+      plainfile.openExisting(f, InBuffer::NENDIAN);
+      return &plainfile;
+   }
+   // closes the file on failure
+   return gzfile.openExisting(f, InBuffer::NENDIAN) ? &gzfile : nullptr;
+}
+
+void P_LoadGame(const char *filename)
+{
+   InBuffer plainfile;
+   GZExpansion gzfile;
+   InBuffer *loadfile = P_OpenSaveFile(filename, plainfile, gzfile);
+
+   if(!loadfile)
+   {
+      C_Printf(FC_ERROR "Failed to load savegame %s\n", filename);
+      C_SetConsole();
+      return;
+   }
+
+   // Enable buffered IO exceptions
+   loadfile->setThrowing(true);
+
+   // the world is replaced, including gametic
+   CAM_InvalidateSightCache();
+
+   try
+   {
+      if(!P_readSave(*loadfile, false))
       {
-         // IOANCH 20140713: guard against creating bot map if demo is playing
-         if(singledemo)
-            BotMap::demoPlayingFlag = true;
-         G_InitNew(gameskill, gamemapname);
-         if(singledemo)
-            BotMap::demoPlayingFlag = false;
+         loadfile->close();
+         return;
       }
-
-      // killough 3/1/98: Read game options
-      // killough 11/98: move down to here
-   
-      // cph - MBF needs to reread the savegame options because 
-      // G_InitNew rereads the WAD options. The demo playback code does 
-      // this too.
-      G_ReadOptions(options);
-
-      // get the times
-      arc << leveltime;
-
-      // killough 11/98: load revenant tracer state
-      uint8_t tracerState;
-      arc << tracerState;
-      basetic = gametic - tracerState;
-
-      // haleyjd 04/14/03: load dmflags
-      arc << dmflags;
-
-      // dearchive all the modifications
-      P_ArchivePlayers(arc);
-      P_ArchiveWorld(arc);
-      P_ArchiveLevelInfo(arc);
-      P_ArchivePolyObjects(arc);    // haleyjd 03/27/06
-      P_ArchiveThinkers(arc);
-      P_ArchiveRNG(arc);            // killough 1/18/98: load RNG information
-      P_ArchiveMap(arc);            // killough 1/22/98: load automap information
-      P_UnArchiveSoundSequences(arc);
-      P_ArchiveButtons(arc);
-      P_ArchiveACS(arc);            // davidph 05/30/12
-
-      P_FreeThinkerTable();
-
-      uint8_t cmarker;
-      arc << cmarker;
-      if(cmarker != 0xE6)
-         I_Error("Bad savegame: last byte is 0x%x\n", cmarker);
-
-      // haleyjd: move up Z_CheckHeap to before Z_Free (safer)
-      Z_CheckHeap(); 
    }
    catch(...)
    {
@@ -1662,7 +1761,7 @@ void P_LoadGame(const char *filename)
       I_Error("P_LoadGame: Savegame read error\n");
    }
 
-   loadfile.close();
+   loadfile->close();
 
    if (setsizeneeded)
       R_ExecuteSetViewSize();
@@ -1691,6 +1790,37 @@ void P_LoadGame(const char *filename)
       P_RestorePlayerPosition();
 }
 
+//
+// P_LoadGameFromBuffer
+//
+// ioanch: restores a snapshot made by P_SaveGameToBuffer. The demo version
+// is left alone, so a demo being played back can continue from it.
+//
+bool P_LoadGameFromBuffer(InBuffer &loadfile)
+{
+   loadfile.setThrowing(true);
+
+   CAM_InvalidateSightCache();
+
+   try
+   {
+      if(!P_readSave(loadfile, true))
+         return false;
+   }
+   catch(...)
+   {
+      I_Error("P_LoadGameFromBuffer: Savegame read error\n");
+   }
+
+   loadfile.setThrowing(false);
+
+   if(setsizeneeded)
+      R_ExecuteSetViewSize();
+   R_FillBackScreen(scaledwindow);
+   ST_Start();
+   return true;
+}
+
 //----------------------------------------------------------------------------
 //
 // $Log: p_saveg.c,v $
@@ -33,6 +33,7 @@ class  Thinker;
 class  Mobj;
 class  OutBuffer;
 class  InBuffer;
+class  GZExpansion;
 struct inventoryslot_t;
 struct spectransfer_t;
 struct mapthing_t;
@@ -134,6 +135,12 @@ void P_SetNewTarget(Mobj **mop, Mobj *targ);
 
 void P_SaveCurrentLevel(char *filename, char *description);
 void P_LoadGame(const char *filename);
+InBuffer *P_OpenSaveFile(const char *filename, InBuffer &plainfile,
+                         GZExpansion &gzfile);
+
+// ioanch: in-memory snapshots
+bool P_SaveGameToBuffer(OutBuffer &savefile);
+bool P_LoadGameFromBuffer(InBuffer &loadfile);
 
 #endif
 
@@ -38,6 +38,7 @@
 #include "am_map.h"
 #include "c_io.h"
 #include "c_runcmd.h"
+#include "cam_sight.h"
 #include "d_gi.h"
 #include "d_io.h" // SoM 3/14/2002: strncasecmp
 #include "d_main.h"
@@ -316,8 +317,6 @@ inline static int SafeRealUintIndex(uint16_t input, int limit,
 //
 static void P_LoadConsoleVertexes(int lump)
 {
-   ZAutoBuffer buf;
-
    // Determine number of vertexes
    numvertexes = setupwad->lumpLength(lump) / PSX_VERTEX_LEN;
 
@@ -325,8 +324,8 @@ static void P_LoadConsoleVertexes(int lump)
    vertexes = estructalloctag(vertex_t, numvertexes, PU_LEVEL);
 
    // Load lump
-   setupwad->cacheLumpAuto(lump, buf);
-   auto data = buf.getAs<byte *>();
+   WadLumpView view(*setupwad, lump, false);
+   auto data = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numvertexes * PSX_VERTEX_LEN);
@@ -349,8 +348,6 @@ static void P_LoadConsoleVertexes(int lump)
 //
 static void P_LoadVertexes(int lump)
 {
-   ZAutoBuffer buf;
-   
    // Determine number of vertexes:
    //  total lump length / vertex record length.
    numvertexes = setupwad->lumpLength(lump) / DOOM_VERTEX_LEN;
@@ -358,9 +355,9 @@ static void P_LoadVertexes(int lump)
    // Allocate zone memory for buffer.
    vertexes = estructalloctag(vertex_t, numvertexes, PU_LEVEL);
    
-   // Load data into cache.
-   setupwad->cacheLumpAuto(lump, buf);
-   auto data = buf.getAs<byte *>();
+   // Read the data in place.
+   WadLumpView view(*setupwad, lump, false);
+   auto data = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numvertexes * DOOM_VERTEX_LEN);
@@ -395,11 +392,12 @@ static void P_CalcSegLength(seg_t *lseg)
 static void P_LoadSegs(int lump)
 {
    int  i;
-   byte *data;
+   const byte *data;
    
    numsegs = setupwad->lumpLength(lump) / sizeof(mapseg_t);
    segs = estructalloctag(seg_t, numsegs, PU_LEVEL);
-   data = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   data = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numsegs * sizeof(mapseg_t));
@@ -407,7 +405,7 @@ static void P_LoadSegs(int lump)
    for(i = 0; i < numsegs; ++i)
    {
       seg_t *li = segs + i;
-      mapseg_t *ml = (mapseg_t *)data + i;
+      const mapseg_t *ml = (const mapseg_t *)data + i;
       
       int side, linedef;
       line_t *ldef;
@@ -441,8 +439,6 @@ static void P_LoadSegs(int lump)
 
       P_CalcSegLength(li);
    }
-   
-   Z_Free(data);
 }
 
 //
@@ -454,11 +450,11 @@ static void P_LoadSegs_V4(int lump)
 {
    numsegs = setupwad->lumpLength(lump) / sizeof(mapseg_v4_t);
    segs = estructalloctag(seg_t, numsegs, PU_LEVEL);
-   auto data = static_cast<byte *>(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   auto data = view.getAs<byte>();
 
    if(!numsegs || !segs || !data)
    {
-      Z_Free(data);
       level_error = "no segs in level";
       return;
    }
@@ -498,7 +494,6 @@ static void P_LoadSegs_V4(int lump)
       if(side < 0 || side > 1)
       {
          level_error = "Seg line side number out of range";
-         Z_Free(data);
          return;
       }
 
@@ -513,7 +508,6 @@ static void P_LoadSegs_V4(int lump)
 
       P_CalcSegLength(li);
    }
-   Z_Free(data);
 }
 
 //
@@ -523,27 +517,26 @@ static void P_LoadSegs_V4(int lump)
 //
 static void P_LoadSubsectors(int lump)
 {
-   mapsubsector_t *mss;
-   byte *data;
+   const mapsubsector_t *mss;
+   const byte *data;
    int  i;
    
    numsubsectors = setupwad->lumpLength(lump) / sizeof(mapsubsector_t);
    subsectors = estructalloctag(subsector_t, numsubsectors, PU_LEVEL);
-   data = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   data = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numsubsectors * sizeof(mapsubsector_t));
    
    for(i = 0; i < numsubsectors; ++i)
    {
-      mss = &(((mapsubsector_t *)data)[i]);
+      mss = &(((const mapsubsector_t *)data)[i]);
 
       // haleyjd 06/19/06: convert indices to unsigned
       subsectors[i].numlines  = (int)SwapShort(mss->numsegs ) & 0xffff;
       subsectors[i].firstline = (int)SwapShort(mss->firstseg) & 0xffff;
    }
-   
-   Z_Free(data);
 }
 
 //
@@ -557,13 +550,12 @@ static void P_LoadSubsectors_V4(int lump)
    numsubsectors = setupwad->lumpLength(lump) / sizeof(mapsubsector_v4_t);
    subsectors = estructalloctag(subsector_t, numsubsectors, PU_LEVEL);
 
-   auto data = static_cast<mapsubsector_v4_t *>(
-      setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   auto data = view.getAs<mapsubsector_v4_t>();
 
    if(!numsubsectors || !data)
    {
       level_error = "no subsectors in level";
-      Z_Free(data);
       return;
    }
 
@@ -573,8 +565,6 @@ static void P_LoadSubsectors_V4(int lump)
          & 0xffff;
       subsectors[i].firstline = static_cast<int>(SwapLong(data[i].firstseg));
    }
-
-   Z_Free(data);
 }
 
 //
@@ -660,14 +650,13 @@ void P_InitSector(sector_t *ss)
 //
 static void P_LoadPSXSectors(int lumpnum)
 {
-   ZAutoBuffer buf;
    char namebuf[9];
    
    numsectors  = setupwad->lumpLength(lumpnum) / PSX_SECTOR_SIZE;
    sectors     = estructalloctag(sector_t, numsectors, PU_LEVEL);
    
-   setupwad->cacheLumpAuto(lumpnum, buf);
-   auto data = buf.getAs<byte *>();
+   WadLumpView view(*setupwad, lumpnum, false);
+   auto data = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numsectors * PSX_SECTOR_SIZE);
@@ -705,14 +694,13 @@ static void P_LoadPSXSectors(int lumpnum)
 //
 static void P_LoadSectors(int lumpnum)
 {
-   ZAutoBuffer buf;
    char namebuf[9];
    
    numsectors  = setupwad->lumpLength(lumpnum) / DOOM_SECTOR_SIZE;
    sectors     = estructalloctag(sector_t, numsectors, PU_LEVEL);
    
-   setupwad->cacheLumpAuto(lumpnum, buf);
-   auto data = buf.getAs<byte *>();
+   WadLumpView view(*setupwad, lumpnum, false);
+   auto data = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numsectors * DOOM_SECTOR_SIZE);
@@ -902,7 +890,7 @@ static void P_CalcNodeCoefficients2(const node_t &node, fnode_t &fnode)
 //
 static void P_LoadNodes(int lump)
 {
-   byte *data;
+   const byte *data;
    int  i;
    
    numnodes = setupwad->lumpLength(lump) / sizeof(mapnode_t);
@@ -924,7 +912,8 @@ static void P_LoadNodes(int lump)
 
    nodes  = estructalloctag(node_t,  numnodes, PU_LEVEL);
    fnodes = estructalloctag(fnode_t, numnodes, PU_LEVEL);
-   data   = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   data   = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numnodes * sizeof(mapnode_t));
@@ -932,7 +921,7 @@ static void P_LoadNodes(int lump)
    for(i = 0; i < numnodes; i++)
    {
       node_t *no = nodes + i;
-      mapnode_t *mn = (mapnode_t *)data + i;
+      const mapnode_t *mn = (const mapnode_t *)data + i;
       int j;
 
       no->x  = SwapShort(mn->x);
@@ -957,8 +946,6 @@ static void P_LoadNodes(int lump)
             no->bbox[j][k] = SwapShort(mn->bbox[j][k]) << FRACBITS;
       }
    }
-   
-   Z_Free(data);
 }
 
 //
@@ -1587,7 +1574,8 @@ static void P_addToBotMap(int index, const mapthing_t &ft, const Mobj &mobj)
 static void P_LoadThings(int lump)
 {
    int  i;
-   byte *data = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   const byte *data = view.getAs<byte>();
    mapthing_t *mapthings;
    
    numthings = setupwad->lumpLength(lump) / sizeof(mapthingdoom_t); //sf: use global
@@ -1605,7 +1593,7 @@ static void P_LoadThings(int lump)
    
    for(i = 0; i < numthings; i++)
    {
-      mapthingdoom_t *mt = (mapthingdoom_t *)data + i;
+      const mapthingdoom_t *mt = (const mapthingdoom_t *)data + i;
       mapthing_t     *ft = &mapthings[i];
       
       // haleyjd 09/11/06: wow, this should be up here.
@@ -1655,7 +1643,6 @@ static void P_LoadThings(int lump)
       }
    }
 
-   Z_Free(data);
    Z_Free(mapthings);
 }
 
@@ -1667,7 +1654,8 @@ static void P_LoadThings(int lump)
 static void P_LoadHexenThings(int lump)
 {
    int  i;
-   byte *data = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   const byte *data = view.getAs<byte>();
    mapthing_t *mapthings;
    
    numthings = setupwad->lumpLength(lump) / sizeof(mapthinghexen_t);
@@ -1685,7 +1673,7 @@ static void P_LoadHexenThings(int lump)
    
    for(i = 0; i < numthings; i++)
    {
-      mapthinghexen_t *mt = (mapthinghexen_t *)data + i;
+      const mapthinghexen_t *mt = (const mapthinghexen_t *)data + i;
       mapthing_t      *ft = &mapthings[i];
       
       ft->tid     = SwapShort(mt->tid);
@@ -1729,7 +1717,6 @@ static void P_LoadHexenThings(int lump)
       }
    }
 
-   Z_Free(data);
    Z_Free(mapthings);
 }
 
@@ -1834,18 +1821,19 @@ void P_PostProcessLineFlags(line_t *ld)
 //
 static void P_LoadLineDefs(int lump, UDMFSetupSettings &setupSettings)
 {
-   byte *data;
+   const byte *data;
 
    numlines = setupwad->lumpLength(lump) / sizeof(maplinedef_t);
    lines    = estructalloctag(line_t, numlines, PU_LEVEL);
-   data     = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   data     = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numlines * sizeof(maplinedef_t));
 
    for(int i = 0; i < numlines; i++)
    {
-      maplinedef_t *mld = (maplinedef_t *)data + i;
+      const maplinedef_t *mld = (const maplinedef_t *)data + i;
       line_t *ld = lines + i;
 
       ld->flags   = SwapShort(mld->flags);
@@ -1876,7 +1864,6 @@ static void P_LoadLineDefs(int lump, UDMFSetupSettings &setupSettings)
       // haleyjd 04/30/11: Do some post-ExtraData line flag adjustments
       P_PostProcessLineFlags(ld);
    }
-   Z_Free(data);
 }
 
 // these flags are shared with Hexen in the normal flags fields
@@ -1944,19 +1931,20 @@ static void P_ConvertHexenLineFlags(line_t *line)
 //
 static void P_LoadHexenLineDefs(int lump)
 {
-   byte *data;
+   const byte *data;
    int  i;
 
    numlines = setupwad->lumpLength(lump) / sizeof(maplinedefhexen_t);
    lines    = estructalloctag(line_t, numlines, PU_LEVEL);
-   data     = (byte *)(setupwad->cacheLumpNum(lump, PU_STATIC));
+   WadLumpView view(*setupwad, lump);
+   data     = view.getAs<byte>();
 
    // IOANCH: hash it
    g_levelHash.addData(data, numlines * sizeof(maplinedefhexen_t));
 
    for(i = 0; i < numlines; ++i)
    {
-      maplinedefhexen_t *mld = (maplinedefhexen_t *)data + i;
+      const maplinedefhexen_t *mld = (const maplinedefhexen_t *)data + i;
       line_t *ld = lines + i;
 
       ld->flags   = SwapShort(mld->flags);
@@ -1981,7 +1969,6 @@ static void P_LoadHexenLineDefs(int lump)
       // haleyjd 03/28/11: do shared loading logic in one place
       P_InitLineDef(ld);
    }
-   Z_Free(data);
 }
 
 //
@@ -3599,6 +3586,8 @@ void P_SetupLevel(WadDirectory *dir, const char *mapname, int playermask,
    G_DemoLog("%d\tSetup %s\n", gametic, mapname);
    G_DemoLogSetExited(false);
 
+   CAM_InvalidateSightCache();
+
    // haleyjd 07/28/10: we are no longer in GS_LEVEL during the execution of
    // this routine.
    gamestate = GS_LOADING;
@@ -86,6 +86,7 @@
 #include "r_state.h"
 #include "s_sound.h"
 #include "sounds.h"
+#include "t_plane.h"
 #include "v_misc.h"
 #include "v_video.h"
 #include "w_wad.h"
@@ -2456,6 +2457,9 @@ bool P_MoveAttached(const sector_t *sector, bool ceiling, fixed_t delta,
 
    for(i = 0; i < count; i++)
    {
+      const fixed_t oldfloor   = list[i].sector->srf.floor.height;
+      const fixed_t oldceiling = list[i].sector->srf.ceiling.height;
+
       if(list[i].type & AS_CEILING)
       {
          P_SetCeilingHeight(list[i].sector, list[i].sector->srf.ceiling.height + delta);
@@ -2489,6 +2493,8 @@ bool P_MoveAttached(const sector_t *sector, bool ceiling, fixed_t delta,
          if(nointerp)
             P_SaveSectorPosition(*list[i].sector, ssurf_floor);
       }
+
+      P_SectorHeightsChanged(*list[i].sector, oldfloor, oldceiling);
    }
 
    return ok;
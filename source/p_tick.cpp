@@ -32,6 +32,7 @@
 #include "d_main.h"
 #include "doomstat.h"
 #include "i_system.h"
+#include "m_profile.h"
 #include "p_anim.h"
 #include "p_chase.h"
 #include "p_saveg.h"
@@ -261,6 +262,8 @@ void Thinker::serialize(SaveArchive &arc)
 //
 void P_Ticker()
 {
+   PROFILE_ZONE("P_Ticker");
+
    // pause if in menu and at least one tic has been run
    //
    // killough 9/29/98: note that this ties in with basetic,
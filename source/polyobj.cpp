@@ -1127,6 +1127,8 @@ static bool Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y, bool onload = fa
    if(po->flags & POF_ISBAD)
       return false;
 
+   CAM_InvalidateSightCache();
+
    PODCollection<portalthing_t> pts;
    if(po->numPortals)
       for(i = 0; i < po->numLines; ++i)
@@ -1328,6 +1330,8 @@ static bool Polyobj_rotate(polyobj_t *po, angle_t delta, bool onload = false)
    if(po->flags & POF_ISBAD)
       return false;
 
+   CAM_InvalidateSightCache();
+
    angle = (po->angle + delta) >> ANGLETOFINESHIFT;
 
    // point about which to rotate is the spawn spot
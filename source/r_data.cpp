@@ -88,7 +88,7 @@ spritespan_t **r_spritespan;
 static void R_InitSpriteLumps(void)
 {
    int i;
-   patch_t *patch;
+   patchheader_t header;
 
    const WadDirectory::namespace_t &ns = 
       wGlobalDir.getNamespace(lumpinfo_t::ns_sprites);
@@ -111,12 +111,13 @@ static void R_InitSpriteLumps(void)
       if(!(i&127))            // killough
          V_LoadingIncrease();
       
-      patch = PatchLoader::CacheNum(wGlobalDir, firstspritelump + i, PU_CACHE);
+      // ioanch: only the header is needed, so don't cache every sprite
+      PatchLoader::GetHeader(wGlobalDir, firstspritelump + i, header);
 
-      spritewidth[i]     = patch->width << FRACBITS;
-      spriteoffset[i]    = patch->leftoffset << FRACBITS;
-      spritetopoffset[i] = patch->topoffset << FRACBITS;
-      spriteheight[i]    = (float)patch->height;
+      spritewidth[i]     = header.width << FRACBITS;
+      spriteoffset[i]    = header.leftoffset << FRACBITS;
+      spritetopoffset[i] = header.topoffset << FRACBITS;
+      spriteheight[i]    = (float)header.height;
    }
 }
 
@@ -606,6 +607,22 @@ void R_PrecacheLevel(void)
       ++sky;
    }
 
+   // ioanch: let the lumps of the textures to build be read together first
+   PODCollection<int> prefetch;
+   for(i = texturecount; --i >= 0; )
+   {
+      const texture_t *tex = textures[i];
+      if(!hitlist[i] || tex->bufferalloc)
+         continue;
+      for(int j = 0; j < tex->ccount; ++j)
+      {
+         if(tex->components[j].lump != -1)
+            prefetch.add(tex->components[j].lump);
+      }
+   }
+   if(!prefetch.isEmpty())
+      wGlobalDir.prefetchLumps(&prefetch[0], (int)prefetch.getLength());
+
    // Precache textures.
    for(i = texturecount; --i >= 0; )
    {
@@ -627,6 +644,21 @@ void R_PrecacheLevel(void)
       }
    }
 
+   prefetch.makeEmpty();
+   for(i = numsprites; --i >= 0; )
+   {
+      if(hitlist[i])
+      {
+         for(int j = 0; j < sprites[i].numframes; ++j)
+         {
+            for(int16_t lump : sprites[i].spriteframes[j].lump)
+               prefetch.add(firstspritelump + lump);
+         }
+      }
+   }
+   if(!prefetch.isEmpty())
+      wGlobalDir.prefetchLumps(&prefetch[0], (int)prefetch.getLength());
+
    for(i = numsprites; --i >= 0; )
    {
       if (hitlist[i])
@@ -644,6 +676,9 @@ void R_PrecacheLevel(void)
       }
    }
    efree(hitlist);
+
+   // ioanch: don't keep inflated lumps which nothing went on to read
+   wGlobalDir.releasePrefetchedLumps();
 }
 
 //
@@ -184,7 +184,7 @@ struct cb_column_t
 };
 
 
-extern cb_column_t column;
+extern thread_local cb_column_t column; // per render thread
 
 #endif
 
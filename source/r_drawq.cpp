@@ -23,6 +23,9 @@
 // Optimized quad column buffer code.
 // By SoM.
 //
+// Also builds the wide engine, which uses the same code with a larger
+// buffer and vectorized flushers.
+//
 //-----------------------------------------------------------------------------
 
 #include "z_zone.h"
@@ -36,8 +39,20 @@
 #include "v_video.h"
 #include "w_wad.h"
 
+#if defined(__AVX2__)
+#define R_DRAWQ_AVX2
+#define R_DRAWQ_SSE2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define R_DRAWQ_SSE2
+#include <emmintrin.h>
+#endif
+
 extern int *columnofs; 
 
+// Columns buffered by the wide engine
+#define WIDECOLUMNS 16
+
 // SoM: OPTIMIZE for ANYRES
 typedef enum
 {
@@ -51,7 +66,7 @@ typedef enum
 } columntype_e;
 
 static int    temp_x = 0;
-static int    tempyl[4], tempyh[4];
+static int    tempyl[WIDECOLUMNS], tempyh[WIDECOLUMNS];
 static int    startx = 0;
 static int    temptype = COL_NONE;
 static int    commontop, commonbot;
@@ -67,12 +82,12 @@ static byte   *newskymask;
 
 VALLOCATION(tempbuf)
 {
-   tempbuf = ecalloctag(byte *, h*4, sizeof(byte), PU_VALLOC, nullptr);
+   tempbuf = ecalloctag(byte *, h*WIDECOLUMNS, sizeof(byte), PU_VALLOC, nullptr);
 }
 
 VALLOCATION(newskymask)
 {
-   newskymask = ecalloctag(byte *, h*4, sizeof(byte), PU_VALLOC, nullptr);
+   newskymask = ecalloctag(byte *, h*WIDECOLUMNS, sizeof(byte), PU_VALLOC, nullptr);
 }
 
 //
@@ -99,6 +114,7 @@ static void R_QuadFlushNil(void)
 // This is used when a quad flush isn't possible.
 // Opaque version -- no remapping whatsoever.
 //
+template<int N>
 static void R_FlushWholeOpaque()
 {
    const byte *source;
@@ -108,14 +124,14 @@ static void R_FlushWholeOpaque()
    while(--temp_x >= 0)
    {
       yl     = tempyl[temp_x];
-      source = tempbuf + temp_x + (yl << 2);
+      source = tempbuf + temp_x + (yl * N);
       dest   = R_ADDRESS(startx + temp_x, yl);
       count  = tempyh[temp_x] - yl + 1;
       
       while(--count >= 0)
       {
          *dest = *source;
-         source += 4;
+         source += N;
          dest += linesize;
       }
    }
@@ -124,6 +140,7 @@ static void R_FlushWholeOpaque()
 //
 // ioanch: doublesky variant
 //
+template<int N>
 static void R_FlushWholeNewSky()
 {
    const byte *source;
@@ -134,8 +151,8 @@ static void R_FlushWholeNewSky()
    while(--temp_x >= 0)
    {
       yl     = tempyl[temp_x];
-      source = tempbuf + temp_x + (yl << 2);
-      mask = newskymask + temp_x + (yl << 2);
+      source = tempbuf + temp_x + (yl * N);
+      mask = newskymask + temp_x + (yl * N);
       dest   = R_ADDRESS(startx + temp_x, yl);
       count  = tempyh[temp_x] - yl + 1;
 
@@ -143,8 +160,8 @@ static void R_FlushWholeNewSky()
       {
          if(*mask)
             *dest = *source;
-         source += 4;
-         mask += 4;
+         source += N;
+         mask += N;
          dest += linesize;
       }
    }
@@ -157,6 +174,7 @@ static void R_FlushWholeNewSky()
 // preparation for a quad flush.
 // Opaque version -- no remapping whatsoever.
 //
+template<int N>
 static void R_FlushHTOpaque(void)
 {
    const byte *source;
@@ -164,7 +182,7 @@ static void R_FlushHTOpaque(void)
    int count, colnum = 0;
    int yl, yh;
 
-   while(colnum < 4)
+   while(colnum < N)
    {
       yl = tempyl[colnum];
       yh = tempyh[colnum];
@@ -172,14 +190,14 @@ static void R_FlushHTOpaque(void)
       // flush column head
       if(yl < commontop)
       {
-         source = tempbuf + colnum + (yl << 2);
+         source = tempbuf + colnum + (yl * N);
          dest   = R_ADDRESS(startx + colnum, yl);
          count  = commontop - yl;
          
          while(--count >= 0)
          {
             *dest = *source;
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -187,14 +205,14 @@ static void R_FlushHTOpaque(void)
       // flush column tail
       if(yh > commonbot)
       {
-         source = tempbuf + colnum + ((commonbot + 1) << 2);
+         source = tempbuf + colnum + ((commonbot + 1) * N);
          dest   = R_ADDRESS(startx + colnum, commonbot + 1);
          count  = yh - commonbot;
          
          while(--count >= 0)
          {
             *dest = *source;
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }         
@@ -205,6 +223,7 @@ static void R_FlushHTOpaque(void)
 //
 // ioanch: doublesky variant
 //
+template<int N>
 static void R_FlushHTNewSky()
 {
    const byte *source;
@@ -213,7 +232,7 @@ static void R_FlushHTNewSky()
    int count, colnum = 0;
    int yl, yh;
 
-   while(colnum < 4)
+   while(colnum < N)
    {
       yl = tempyl[colnum];
       yh = tempyh[colnum];
@@ -221,8 +240,8 @@ static void R_FlushHTNewSky()
       // flush column head
       if(yl < commontop)
       {
-         source = tempbuf + colnum + (yl << 2);
-         mask = newskymask + colnum + (yl << 2);
+         source = tempbuf + colnum + (yl * N);
+         mask = newskymask + colnum + (yl * N);
          dest   = R_ADDRESS(startx + colnum, yl);
          count  = commontop - yl;
 
@@ -230,8 +249,8 @@ static void R_FlushHTNewSky()
          {
             if(*mask)
                *dest = *source;
-            source += 4;
-            mask += 4;
+            source += N;
+            mask += N;
             dest += linesize;
          }
       }
@@ -239,8 +258,8 @@ static void R_FlushHTNewSky()
       // flush column tail
       if(yh > commonbot)
       {
-         source = tempbuf + colnum + ((commonbot + 1) << 2);
-         mask = newskymask + colnum + ((commonbot + 1) << 2);
+         source = tempbuf + colnum + ((commonbot + 1) * N);
+         mask = newskymask + colnum + ((commonbot + 1) * N);
          dest   = R_ADDRESS(startx + colnum, commonbot + 1);
          count  = yh - commonbot;
 
@@ -248,8 +267,8 @@ static void R_FlushHTNewSky()
          {
             if(*mask)
                *dest = *source;
-            source += 4;
-            mask += 4;
+            source += N;
+            mask += N;
             dest += linesize;
          }
       }
@@ -257,6 +276,7 @@ static void R_FlushHTNewSky()
    }
 }
 
+template<int N>
 static void R_FlushWholeTL()
 {
    const byte *source;
@@ -266,7 +286,7 @@ static void R_FlushWholeTL()
    while(--temp_x >= 0)
    {
       yl     = tempyl[temp_x];
-      source = tempbuf + temp_x + (yl << 2);
+      source = tempbuf + temp_x + (yl * N);
       dest   = R_ADDRESS(startx + temp_x, yl);
       count  = tempyh[temp_x] - yl + 1;
 
@@ -274,12 +294,13 @@ static void R_FlushWholeTL()
       {
          // haleyjd 09/11/04: use temptranmap here
          *dest = temptranmap[(*dest<<8) + *source];
-         source += 4;
+         source += N;
          dest += linesize;
       }
    }
 }
 
+template<int N>
 static void R_FlushHTTL()
 {
    const byte *source;
@@ -287,7 +308,7 @@ static void R_FlushHTTL()
    int count;
    int colnum = 0, yl, yh;
 
-   while(colnum < 4)
+   while(colnum < N)
    {
       yl = tempyl[colnum];
       yh = tempyh[colnum];
@@ -295,7 +316,7 @@ static void R_FlushHTTL()
       // flush column head
       if(yl < commontop)
       {
-         source = tempbuf + colnum + (yl << 2);
+         source = tempbuf + colnum + (yl * N);
          dest   = R_ADDRESS(startx + colnum, yl);
          count  = commontop - yl;
 
@@ -303,7 +324,7 @@ static void R_FlushHTTL()
          {
             // haleyjd 09/11/04: use temptranmap here
             *dest = temptranmap[(*dest<<8) + *source];
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -311,7 +332,7 @@ static void R_FlushHTTL()
       // flush column tail
       if(yh > commonbot)
       {
-         source = tempbuf + colnum + ((commonbot + 1) << 2);
+         source = tempbuf + colnum + ((commonbot + 1) * N);
          dest   = R_ADDRESS(startx + colnum, commonbot + 1);
          count  = yh - commonbot;
 
@@ -319,7 +340,7 @@ static void R_FlushHTTL()
          {
             // haleyjd 09/11/04: use temptranmap here
             *dest = temptranmap[(*dest<<8) + *source];
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -331,6 +352,7 @@ static void R_FlushHTTL()
 #define SRCPIXEL \
    tempfuzzmap[6*256+dest[fuzzoffset[fuzzpos] ? video.pitch: -video.pitch]]
 
+template<int N>
 static void R_FlushWholeFuzz()
 {
    const byte *source;
@@ -340,7 +362,7 @@ static void R_FlushWholeFuzz()
    while(--temp_x >= 0)
    {
       yl     = tempyl[temp_x];
-      source = tempbuf + temp_x + (yl << 2);
+      source = tempbuf + temp_x + (yl * N);
       dest   = R_ADDRESS(startx + temp_x, yl);
       count  = tempyh[temp_x] - yl + 1;
 
@@ -353,7 +375,7 @@ static void R_FlushWholeFuzz()
          if(++fuzzpos == FUZZTABLE) 
             fuzzpos = 0;
          
-         source += 4;
+         source += N;
          dest += linesize;
       }
    }
@@ -367,7 +389,7 @@ static void R_FlushHTFuzz()
    int count;
    int colnum = 0, yl, yh;
 
-   while(colnum < 4)
+   while(colnum < N)
    {
       yl = tempyl[colnum];
       yh = tempyh[colnum];
@@ -375,7 +397,7 @@ static void R_FlushHTFuzz()
       // flush column head
       if(yl < commontop)
       {
-         source = tempbuf + colnum + (yl << 2);
+         source = tempbuf + colnum + (yl * N);
          dest   = ylookup[yl] + columnofs[startx + colnum];
          count  = commontop - yl;
 
@@ -388,7 +410,7 @@ static void R_FlushHTFuzz()
             if(++fuzzpos == FUZZTABLE) 
                fuzzpos = 0;
             
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -396,7 +418,7 @@ static void R_FlushHTFuzz()
       // flush column tail
       if(yh > commonbot)
       {
-         source = tempbuf + colnum + ((commonbot + 1) << 2);
+         source = tempbuf + colnum + ((commonbot + 1) * N);
          dest   = ylookup[(commonbot + 1)] + columnofs[startx + colnum];
          count  = yh - commonbot;
 
@@ -409,7 +431,7 @@ static void R_FlushHTFuzz()
             if(++fuzzpos == FUZZTABLE) 
                fuzzpos = 0;
             
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -421,6 +443,7 @@ static void R_FlushHTFuzz()
 
 #undef SRCPIXEL
 
+template<int N>
 static void R_FlushWholeFlex()
 {
    const byte *source;
@@ -431,7 +454,7 @@ static void R_FlushWholeFlex()
    while(--temp_x >= 0)
    {
       yl     = tempyl[temp_x];
-      source = tempbuf + temp_x + (yl << 2);
+      source = tempbuf + temp_x + (yl * N);
       dest   = R_ADDRESS(startx + temp_x, yl);
       count  = tempyh[temp_x] - yl + 1;
 
@@ -443,12 +466,13 @@ static void R_FlushWholeFlex()
          fg = (fg+bg) | 0x1f07c1f;
          *dest = RGB32k[0][0][fg & (fg>>15)];
          
-         source += 4;
+         source += N;
          dest += linesize;
       }
    }
 }
 
+template<int N>
 static void R_FlushHTFlex()
 {
    const byte *source;
@@ -457,7 +481,7 @@ static void R_FlushHTFlex()
    int colnum = 0, yl, yh;
    unsigned int fg, bg;
 
-   while(colnum < 4)
+   while(colnum < N)
    {
       yl = tempyl[colnum];
       yh = tempyh[colnum];
@@ -465,7 +489,7 @@ static void R_FlushHTFlex()
       // flush column head
       if(yl < commontop)
       {
-         source = tempbuf + colnum + (yl << 2);
+         source = tempbuf + colnum + (yl * N);
          dest   = R_ADDRESS(startx + colnum, yl);
          count  = commontop - yl;
 
@@ -477,7 +501,7 @@ static void R_FlushHTFlex()
             fg = (fg+bg) | 0x1f07c1f;
             *dest = RGB32k[0][0][fg & (fg>>15)];
             
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -485,7 +509,7 @@ static void R_FlushHTFlex()
       // flush column tail
       if(yh > commonbot)
       {
-         source = tempbuf + colnum + ((commonbot + 1) << 2);
+         source = tempbuf + colnum + ((commonbot + 1) * N);
          dest   = R_ADDRESS(startx + colnum, commonbot + 1);
          count  = yh - commonbot;
 
@@ -497,7 +521,7 @@ static void R_FlushHTFlex()
             fg = (fg+bg) | 0x1f07c1f;
             *dest = RGB32k[0][0][fg & (fg>>15)];
             
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -506,6 +530,7 @@ static void R_FlushHTFlex()
    }
 }
 
+template<int N>
 static void R_FlushWholeFlexAdd()
 {
    const byte *source;
@@ -516,7 +541,7 @@ static void R_FlushWholeFlexAdd()
    while(--temp_x >= 0)
    {
       yl     = tempyl[temp_x];
-      source = tempbuf + temp_x + (yl << 2);
+      source = tempbuf + temp_x + (yl * N);
       dest   = R_ADDRESS(startx + temp_x, yl);
       count  = tempyh[temp_x] - yl + 1;
 
@@ -534,12 +559,13 @@ static void R_FlushWholeFlexAdd()
          
          *dest = RGB32k[0][0][a & (a >> 15)];
          
-         source += 4;
+         source += N;
          dest += linesize;
       }
    }
 }
 
+template<int N>
 static void R_FlushHTFlexAdd()
 {
    const byte *source;
@@ -548,7 +574,7 @@ static void R_FlushHTFlexAdd()
    int colnum = 0, yl, yh;
    unsigned int a, b;
 
-   while(colnum < 4)
+   while(colnum < N)
    {
       yl = tempyl[colnum];
       yh = tempyh[colnum];
@@ -556,7 +582,7 @@ static void R_FlushHTFlexAdd()
       // flush column head
       if(yl < commontop)
       {
-         source = tempbuf + colnum + (yl << 2);
+         source = tempbuf + colnum + (yl * N);
          dest   = R_ADDRESS(startx + colnum, yl);
          count  = commontop - yl;
 
@@ -574,7 +600,7 @@ static void R_FlushHTFlexAdd()
             
             *dest = RGB32k[0][0][a & (a >> 15)];
             
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -582,7 +608,7 @@ static void R_FlushHTFlexAdd()
       // flush column tail
       if(yh > commonbot)
       {
-         source = tempbuf + colnum + ((commonbot + 1) << 2);
+         source = tempbuf + colnum + ((commonbot + 1) * N);
          dest   = R_ADDRESS(startx + colnum, commonbot + 1);
          count  = yh - commonbot;
 
@@ -600,7 +626,7 @@ static void R_FlushHTFlexAdd()
             
             *dest = RGB32k[0][0][a & (a >> 15)];
             
-            source += 4;
+            source += N;
             dest += linesize;
          }
       }
@@ -612,45 +638,202 @@ static void R_FlushHTFlexAdd()
 static void (*R_FlushWholeColumns)() = R_FlushWholeNil;
 static void (*R_FlushHTColumns)()    = R_FlushHTNil;
 
+//
+// Row blending helpers for the quad flushers. Each call handles one row of N
+// buffered columns. With SSE2 or AVX2 available, the copies and the flex
+// translucency math run on whole vectors; the scalar loops finish the rest
+// (or everything, on other targets).
+//
+
+template<int N>
+inline static void R_copyRow(byte *dest, const byte *source)
+{
+   int i = 0;
+#ifdef R_DRAWQ_SSE2
+   for(; i + 16 <= N; i += 16)
+   {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i)));
+   }
+#endif
+   if(i < N)
+      memcpy(dest + i, source + i, N - i);
+}
+
+template<int N>
+inline static void R_maskRow(byte *dest, const byte *source, const byte *mask)
+{
+   int i = 0;
+#ifdef R_DRAWQ_SSE2
+   for(; i + 16 <= N; i += 16)
+   {
+      __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+      __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + i));
+      __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + i));
+      d = _mm_or_si128(_mm_andnot_si128(m, d), _mm_and_si128(s, m));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), d);
+   }
+#endif
+   for(; i < N; ++i)
+      dest[i] = (dest[i] & ~mask[i]) | (source[i] & mask[i]);
+}
+
+//
+// Flex translucency: fg + bg, with the guard bits of each channel set so
+// the final lookup index can be folded out of the packed value.
+//
+inline static unsigned int R_flexPixel(unsigned int a)
+{
+   a |= 0x1f07c1f;
+   return a & (a >> 15);
+}
+
+//
+// Additive translucency: same as above, but channels which overflowed are
+// clamped to their maximum first.
+//
+inline static unsigned int R_addPixel(unsigned int a)
+{
+   unsigned int b = a & 0x40100400;
+   a = (a | 0x01f07c1f) & 0x3fffffff;
+   b = b - (b >> 5);
+   a |= b;
+   return a & (a >> 15);
+}
+
+#if defined(R_DRAWQ_AVX2)
+inline static __m256i R_flexPixels(__m256i a)
+{
+   a = _mm256_or_si256(a, _mm256_set1_epi32(0x1f07c1f));
+   return _mm256_and_si256(a, _mm256_srli_epi32(a, 15));
+}
+
+inline static __m256i R_addPixels(__m256i a)
+{
+   __m256i b = _mm256_and_si256(a, _mm256_set1_epi32(0x40100400));
+   a = _mm256_or_si256(a, _mm256_set1_epi32(0x01f07c1f));
+   a = _mm256_and_si256(a, _mm256_set1_epi32(0x3fffffff));
+   b = _mm256_sub_epi32(b, _mm256_srli_epi32(b, 5));
+   a = _mm256_or_si256(a, b);
+   return _mm256_and_si256(a, _mm256_srli_epi32(a, 15));
+}
+
+//
+// Looks up the RGB values of 8 palette indices
+//
+inline static __m256i R_gatherRGB(const unsigned int *table, const byte *pixels)
+{
+   __m128i indices = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels));
+   return _mm256_i32gather_epi32(reinterpret_cast<const int *>(table),
+                                 _mm256_cvtepu8_epi32(indices), 4);
+}
+#elif defined(R_DRAWQ_SSE2)
+inline static __m128i R_flexPixels(__m128i a)
+{
+   a = _mm_or_si128(a, _mm_set1_epi32(0x1f07c1f));
+   return _mm_and_si128(a, _mm_srli_epi32(a, 15));
+}
+
+inline static __m128i R_addPixels(__m128i a)
+{
+   __m128i b = _mm_and_si128(a, _mm_set1_epi32(0x40100400));
+   a = _mm_or_si128(a, _mm_set1_epi32(0x01f07c1f));
+   a = _mm_and_si128(a, _mm_set1_epi32(0x3fffffff));
+   b = _mm_sub_epi32(b, _mm_srli_epi32(b, 5));
+   a = _mm_or_si128(a, b);
+   return _mm_and_si128(a, _mm_srli_epi32(a, 15));
+}
+
+//
+// Looks up the RGB values of 4 palette indices
+//
+inline static __m128i R_gatherRGB(const unsigned int *table, const byte *pixels)
+{
+   return _mm_setr_epi32(table[pixels[0]], table[pixels[1]], table[pixels[2]],
+                         table[pixels[3]]);
+}
+#endif
+
+//
+// Blends a row of buffered pixels onto the screen through the fg2rgb and
+// bg2rgb tables. ADD selects additive translucency.
+//
+template<int N, bool ADD>
+inline static void R_flexRow(byte *dest, const byte *source)
+{
+   int i = 0;
+#if defined(R_DRAWQ_AVX2)
+   for(; i + 8 <= N; i += 8)
+   {
+      __m256i a = _mm256_add_epi32(R_gatherRGB(temp_fg2rgb, source + i),
+                                   R_gatherRGB(temp_bg2rgb, dest + i));
+      alignas(32) unsigned int index[8];
+      _mm256_store_si256(reinterpret_cast<__m256i *>(index),
+                         ADD ? R_addPixels(a) : R_flexPixels(a));
+      for(int j = 0; j < 8; ++j)
+         dest[i + j] = RGB32k[0][0][index[j]];
+   }
+#elif defined(R_DRAWQ_SSE2)
+   for(; i + 4 <= N; i += 4)
+   {
+      __m128i a = _mm_add_epi32(R_gatherRGB(temp_fg2rgb, source + i),
+                                R_gatherRGB(temp_bg2rgb, dest + i));
+      alignas(16) unsigned int index[4];
+      _mm_store_si128(reinterpret_cast<__m128i *>(index),
+                      ADD ? R_addPixels(a) : R_flexPixels(a));
+      for(int j = 0; j < 4; ++j)
+         dest[i + j] = RGB32k[0][0][index[j]];
+   }
+#endif
+   for(; i < N; ++i)
+   {
+      unsigned int a = temp_fg2rgb[source[i]] + temp_bg2rgb[dest[i]];
+      dest[i] = RGB32k[0][0][ADD ? R_addPixel(a) : R_flexPixel(a)];
+   }
+}
+
 // Begin: Quad column flushing functions.
+template<int N>
 static void R_FlushQuadOpaque()
 {
-   const int *source = reinterpret_cast<const int *>(tempbuf + (commontop << 2));
-   int *dest = reinterpret_cast<int *>(R_ADDRESS(startx, commontop));
+   const byte *source = tempbuf + (commontop * N);
+   byte *dest = R_ADDRESS(startx, commontop);
    int count;
-   int deststep = linesize / 4;
 
    count = commonbot - commontop + 1;
 
    while(--count >= 0)
    {
-      *dest = *source++;
-      dest += deststep;
+      R_copyRow<N>(dest, source);
+      source += N;
+      dest += linesize;
    }
 }
 
 // ioanch: doublesky variant
+template<int N>
 static void R_FlushQuadNewSky()
 {
-   const int *source = reinterpret_cast<const int *>(tempbuf + (commontop << 2));
-   const int *mask = reinterpret_cast<const int *>(newskymask + (commontop << 2));
-   int *dest = reinterpret_cast<int *>(R_ADDRESS(startx, commontop));
+   const byte *source = tempbuf + (commontop * N);
+   const byte *mask = newskymask + (commontop * N);
+   byte *dest = R_ADDRESS(startx, commontop);
    int count;
-   int deststep = linesize / 4;
 
    count = commonbot - commontop + 1;
 
    while(--count >= 0)
    {
-      *dest = (*dest & ~*mask) | (*source++ & *mask);
-      ++mask;
-      dest += deststep;
+      R_maskRow<N>(dest, source, mask);
+      source += N;
+      mask += N;
+      dest += linesize;
    }
 }
 
+template<int N>
 static void R_FlushQuadTL()
 {
-   const byte *source = tempbuf + (commontop << 2);
+   const byte *source = tempbuf + (commontop * N);
    byte *dest   = R_ADDRESS(startx, commontop);
    int count;
 
@@ -658,11 +841,9 @@ static void R_FlushQuadTL()
 
    while(--count >= 0)
    {
-      *dest   = temptranmap[(*dest<<8) + *source];
-      dest[1] = temptranmap[(dest[1]<<8) + source[1]];
-      dest[2] = temptranmap[(dest[2]<<8) + source[2]];
-      dest[3] = temptranmap[(dest[3]<<8) + source[3]];
-      source += 4;
+      for(int i = 0; i < N; ++i)
+         dest[i] = temptranmap[(dest[i]<<8) + source[i]];
+      source += N;
       dest += linesize;
    }
 }
@@ -710,101 +891,47 @@ static void R_FlushQuadFuzz()
 #undef SRCPIXEL
 */
 
+template<int N>
 static void R_FlushQuadFlex()
 {
-   const byte *source = tempbuf + (commontop << 2);
+   const byte *source = tempbuf + (commontop * N);
    byte *dest   = R_ADDRESS(startx, commontop);
    int count;
-   unsigned int fg, bg;
 
    count = commonbot - commontop + 1;
 
    while(--count >= 0)
    {
       // haleyjd 09/12/04: use precalculated lookups
-      fg = temp_fg2rgb[*source];
-      bg = temp_bg2rgb[*dest];
-      fg = (fg+bg) | 0x1f07c1f;
-      *dest = RGB32k[0][0][fg & (fg>>15)];
-
-      fg = temp_fg2rgb[source[1]];
-      bg = temp_bg2rgb[dest[1]];
-      fg = (fg+bg) | 0x1f07c1f;
-      dest[1] = RGB32k[0][0][fg & (fg>>15)];
-
-      fg = temp_fg2rgb[source[2]];
-      bg = temp_bg2rgb[dest[2]];
-      fg = (fg+bg) | 0x1f07c1f;
-      dest[2] = RGB32k[0][0][fg & (fg>>15)];
-
-      fg = temp_fg2rgb[source[3]];
-      bg = temp_bg2rgb[dest[3]];
-      fg = (fg+bg) | 0x1f07c1f;
-      dest[3] = RGB32k[0][0][fg & (fg>>15)];
-
-      source += 4;
+      R_flexRow<N, false>(dest, source);
+      source += N;
       dest += linesize;
    }
 }
 
+template<int N>
 static void R_FlushQuadFlexAdd()
 {
-   const byte *source = tempbuf + (commontop << 2);
+   const byte *source = tempbuf + (commontop * N);
    byte *dest   = R_ADDRESS(startx, commontop);
    int count;
-   unsigned int a, b;
 
    count = commonbot - commontop + 1;
 
    while(--count >= 0)
    {
-      // haleyjd 02/08/05: this is NOT gonna be very fast.
-      a = temp_fg2rgb[*source] + temp_bg2rgb[*dest];
-      b = a;
-      a |= 0x01f07c1f;
-      b &= 0x40100400;
-      a &= 0x3fffffff;
-      b  = b - (b >> 5);
-      a |= b;
-      *dest = RGB32k[0][0][a & (a >> 15)];
-
-      a = temp_fg2rgb[source[1]] + temp_bg2rgb[dest[1]];
-      b = a;
-      a |= 0x01f07c1f;
-      b &= 0x40100400;
-      a &= 0x3fffffff;
-      b  = b - (b >> 5);
-      a |= b;
-      dest[1] = RGB32k[0][0][a & (a >> 15)];
-
-      a = temp_fg2rgb[source[2]] + temp_bg2rgb[dest[2]];
-      b = a;
-      a |= 0x01f07c1f;
-      b &= 0x40100400;
-      a &= 0x3fffffff;
-      b  = b - (b >> 5);
-      a |= b;
-      dest[2] = RGB32k[0][0][a & (a >> 15)];
-
-      a = temp_fg2rgb[source[3]] + temp_bg2rgb[dest[3]];
-      b = a;
-      a |= 0x01f07c1f;
-      b &= 0x40100400;
-      a &= 0x3fffffff;
-      b  = b - (b >> 5);
-      a |= b;
-      dest[3] = RGB32k[0][0][a & (a >> 15)];
-
-      source += 4;
+      R_flexRow<N, true>(dest, source);
+      source += N;
       dest += linesize;
    }
 }
 
 static void (*R_FlushQuadColumn)(void) = R_QuadFlushNil;
 
+template<int N>
 static void R_FlushColumns(void)
 {
-   if(temp_x != 4 || commontop >= commonbot || temptype == COL_FUZZ)
+   if(temp_x != N || commontop >= commonbot || temptype == COL_FUZZ)
       R_FlushWholeColumns();
    else
    {
@@ -821,11 +948,12 @@ static void R_FlushColumns(void)
 // which gets rid of the unnecessary reset of various variables during
 // column drawing.
 //
+template<int N>
 static void R_QResetColumnBuffer(void)
 {
    // haleyjd 10/06/05: this must not be done if temp_x == 0!
    if(temp_x)
-      R_FlushColumns();
+      R_FlushColumns<N>();
    temptype = COL_NONE;
    R_FlushWholeColumns = R_FlushWholeNil;
    R_FlushHTColumns    = R_FlushHTNil;
@@ -836,12 +964,13 @@ static void R_QResetColumnBuffer(void)
 // functions to minimize the number of branches and take advantage
 // of as much precalculated information as possible.
 
+template<int N>
 static byte *R_GetBufferOpaque(void)
 {
    // haleyjd: reordered predicates
-   if(temp_x == 4 ||
+   if(temp_x == N ||
       (temp_x && (temptype != COL_OPAQUE || temp_x + startx != column.x)))
-      R_FlushColumns();
+      R_FlushColumns<N>();
 
    if(!temp_x)
    {
@@ -850,10 +979,10 @@ static byte *R_GetBufferOpaque(void)
       *tempyl = commontop = column.y1;
       *tempyh = commonbot = column.y2;
       temptype = COL_OPAQUE;
-      R_FlushWholeColumns = R_FlushWholeOpaque;
-      R_FlushHTColumns    = R_FlushHTOpaque;
-      R_FlushQuadColumn   = R_FlushQuadOpaque;
-      return tempbuf + (column.y1 << 2);
+      R_FlushWholeColumns = R_FlushWholeOpaque<N>;
+      R_FlushHTColumns    = R_FlushHTOpaque<N>;
+      R_FlushQuadColumn   = R_FlushQuadOpaque<N>;
+      return tempbuf + (column.y1 * N);
    }
 
    tempyl[temp_x] = column.y1;
@@ -864,18 +993,19 @@ static byte *R_GetBufferOpaque(void)
    if(column.y2 < commonbot)
       commonbot = column.y2;
       
-   return tempbuf + (column.y1 << 2) + temp_x++;
+   return tempbuf + (column.y1 * N) + temp_x++;
 }
 
 //
 // ioanch: doublesky variant
 //
+template<int N>
 static byte *R_GetBufferNewSky(byte *&mask)
 {
    // haleyjd: reordered predicates
-   if(temp_x == 4 ||
+   if(temp_x == N ||
       (temp_x && (temptype != COL_NEWSKY || temp_x + startx != column.x)))
-      R_FlushColumns();
+      R_FlushColumns<N>();
 
    if(!temp_x)
    {
@@ -884,11 +1014,11 @@ static byte *R_GetBufferNewSky(byte *&mask)
       *tempyl = commontop = column.y1;
       *tempyh = commonbot = column.y2;
       temptype = COL_NEWSKY;
-      R_FlushWholeColumns = R_FlushWholeNewSky;
-      R_FlushHTColumns    = R_FlushHTNewSky;
-      R_FlushQuadColumn   = R_FlushQuadNewSky;
-      mask = newskymask + (column.y1 << 2);
-      return tempbuf + (column.y1 << 2);
+      R_FlushWholeColumns = R_FlushWholeNewSky<N>;
+      R_FlushHTColumns    = R_FlushHTNewSky<N>;
+      R_FlushQuadColumn   = R_FlushQuadNewSky<N>;
+      mask = newskymask + (column.y1 * N);
+      return tempbuf + (column.y1 * N);
    }
 
    tempyl[temp_x] = column.y1;
@@ -899,16 +1029,17 @@ static byte *R_GetBufferNewSky(byte *&mask)
    if(column.y2 < commonbot)
       commonbot = column.y2;
 
-   mask = newskymask + (column.y1 << 2) + temp_x;
-   return tempbuf + (column.y1 << 2) + temp_x++;
+   mask = newskymask + (column.y1 * N) + temp_x;
+   return tempbuf + (column.y1 * N) + temp_x++;
 }
 
+template<int N>
 static byte *R_GetBufferTrans(void)
 {
    // haleyjd: reordered predicates
-   if(temp_x == 4 || tranmap != temptranmap ||
+   if(temp_x == N || tranmap != temptranmap ||
       (temp_x && (temptype != COL_TRANS || temp_x + startx != column.x)))
-      R_FlushColumns();
+      R_FlushColumns<N>();
 
    if(!temp_x)
    {
@@ -918,10 +1049,10 @@ static byte *R_GetBufferTrans(void)
       *tempyh = commonbot = column.y2;
       temptype = COL_TRANS;
       temptranmap = tranmap;
-      R_FlushWholeColumns = R_FlushWholeTL;
-      R_FlushHTColumns    = R_FlushHTTL;
-      R_FlushQuadColumn   = R_FlushQuadTL;
-      return tempbuf + (column.y1 << 2);
+      R_FlushWholeColumns = R_FlushWholeTL<N>;
+      R_FlushHTColumns    = R_FlushHTTL<N>;
+      R_FlushQuadColumn   = R_FlushQuadTL<N>;
+      return tempbuf + (column.y1 * N);
    }
 
    tempyl[temp_x] = column.y1;
@@ -932,15 +1063,16 @@ static byte *R_GetBufferTrans(void)
    if(column.y2 < commonbot)
       commonbot = column.y2;
       
-   return tempbuf + (column.y1 << 2) + temp_x++;
+   return tempbuf + (column.y1 * N) + temp_x++;
 }
 
+template<int N>
 static byte *R_GetBufferFlexTrans(void)
 {
    // haleyjd: reordered predicates
-   if(temp_x == 4 || temptranslevel != column.translevel ||
+   if(temp_x == N || temptranslevel != column.translevel ||
       (temp_x && (temptype != COL_FLEXTRANS || temp_x + startx != column.x)))
-      R_FlushColumns();
+      R_FlushColumns<N>();
 
    if(!temp_x)
    {
@@ -962,10 +1094,10 @@ static byte *R_GetBufferFlexTrans(void)
          temp_bg2rgb  = Col2RGB8[bglevel >> 10];
       }
 
-      R_FlushWholeColumns = R_FlushWholeFlex;
-      R_FlushHTColumns    = R_FlushHTFlex;
-      R_FlushQuadColumn   = R_FlushQuadFlex;
-      return tempbuf + (column.y1 << 2);
+      R_FlushWholeColumns = R_FlushWholeFlex<N>;
+      R_FlushHTColumns    = R_FlushHTFlex<N>;
+      R_FlushQuadColumn   = R_FlushQuadFlex<N>;
+      return tempbuf + (column.y1 * N);
    }
 
    tempyl[temp_x] = column.y1;
@@ -976,15 +1108,16 @@ static byte *R_GetBufferFlexTrans(void)
    if(column.y2 < commonbot)
       commonbot = column.y2;
       
-   return tempbuf + (column.y1 << 2) + temp_x++;
+   return tempbuf + (column.y1 * N) + temp_x++;
 }
 
+template<int N>
 static byte *R_GetBufferFlexAdd(void)
 {
    // haleyjd: reordered predicates
-   if(temp_x == 4 || temptranslevel != column.translevel ||
+   if(temp_x == N || temptranslevel != column.translevel ||
       (temp_x && (temptype != COL_FLEXADD || temp_x + startx != column.x)))
-      R_FlushColumns();
+      R_FlushColumns<N>();
 
    if(!temp_x)
    {
@@ -1004,10 +1137,10 @@ static byte *R_GetBufferFlexAdd(void)
          temp_bg2rgb  = Col2RGB8_LessPrecision[bglevel >> 10];
       }
 
-      R_FlushWholeColumns = R_FlushWholeFlexAdd;
-      R_FlushHTColumns    = R_FlushHTFlexAdd;
-      R_FlushQuadColumn   = R_FlushQuadFlexAdd;
-      return tempbuf + (column.y1 << 2);
+      R_FlushWholeColumns = R_FlushWholeFlexAdd<N>;
+      R_FlushHTColumns    = R_FlushHTFlexAdd<N>;
+      R_FlushQuadColumn   = R_FlushQuadFlexAdd<N>;
+      return tempbuf + (column.y1 * N);
    }
 
    tempyl[temp_x] = column.y1;
@@ -1018,15 +1151,16 @@ static byte *R_GetBufferFlexAdd(void)
    if(column.y2 < commonbot)
       commonbot = column.y2;
       
-   return tempbuf + (column.y1 << 2) + temp_x++;
+   return tempbuf + (column.y1 * N) + temp_x++;
 }
 
+template<int N>
 static byte *R_GetBufferFuzz(void)
 {
    // haleyjd: reordered predicates
-   if(temp_x == 4 ||
+   if(temp_x == N ||
       (temp_x && (temptype != COL_FUZZ || temp_x + startx != column.x)))
-      R_FlushColumns();
+      R_FlushColumns<N>();
 
    if(!temp_x)
    {
@@ -1036,10 +1170,10 @@ static byte *R_GetBufferFuzz(void)
       *tempyh = commonbot = column.y2;
       temptype = COL_FUZZ;
       tempfuzzmap = column.colormap; // SoM 7-28-04: Fix the fuzz problem.
-      R_FlushWholeColumns = R_FlushWholeFuzz;
+      R_FlushWholeColumns = R_FlushWholeFuzz<N>;
       R_FlushHTColumns    = R_FlushHTNil;
       R_FlushQuadColumn   = R_QuadFlushNil;
-      return tempbuf + (column.y1 << 2);
+      return tempbuf + (column.y1 * N);
    }
 
    tempyl[temp_x] = column.y1;
@@ -1050,9 +1184,10 @@ static byte *R_GetBufferFuzz(void)
    if(column.y2 < commonbot)
       commonbot = column.y2;
       
-   return tempbuf + (column.y1 << 2) + temp_x++;
+   return tempbuf + (column.y1 * N) + temp_x++;
 }
 
+template<int N>
 static void R_QDrawColumn() 
 { 
    int      count; 
@@ -1073,7 +1208,7 @@ static void R_QDrawColumn()
 
    // Framebuffer destination address.
    // SoM: MAGIC
-   dest = R_GetBufferOpaque();
+   dest = R_GetBufferOpaque<N>();
 
    // Determine scaling, which is the only mapping to be done.
 
@@ -1110,7 +1245,7 @@ static void R_QDrawColumn()
             // heightmask is the Tutti-Frutti fix -- killough
             
             *dest = colormap[source[frac>>FRACBITS]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1121,10 +1256,10 @@ static void R_QDrawColumn()
          while((count -= 2) >= 0)   // texture height is a power of 2 -- killough
          {
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1137,6 +1272,7 @@ static void R_QDrawColumn()
 // ioanch: Hexen-style double-sky drawer. Like R_QDrawColumn but avoids drawing
 // if source has index 0.
 //
+template<int N>
 static void R_QDrawNewSkyColumn()
 {
    int      count;
@@ -1158,7 +1294,7 @@ static void R_QDrawNewSkyColumn()
 
    // Framebuffer destination address.
    // SoM: MAGIC
-   dest = R_GetBufferNewSky(mask);
+   dest = R_GetBufferNewSky<N>(mask);
 
    // Determine scaling, which is the only mapping to be done.
 
@@ -1196,8 +1332,8 @@ static void R_QDrawNewSkyColumn()
 
             *dest = colormap[source[frac>>FRACBITS]];
             *mask = -!!source[frac>>FRACBITS];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
-            mask += 4;
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
+            mask += N;
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          }
@@ -1209,13 +1345,13 @@ static void R_QDrawNewSkyColumn()
          {
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
             *mask = -!!source[(frac>>FRACBITS) & heightmask];
-            dest += 4; //SoM: MAGIC
-            mask += 4;
+            dest += N; //SoM: MAGIC
+            mask += N;
             frac += fracstep;
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
             *mask = -!!source[(frac>>FRACBITS) & heightmask];
-            dest += 4;
-            mask += 4;
+            dest += N;
+            mask += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1227,6 +1363,7 @@ static void R_QDrawNewSkyColumn()
    }
 }
 
+template<int N>
 static void R_QDrawTLColumn()                                           
 { 
    int      count; 
@@ -1247,7 +1384,7 @@ static void R_QDrawTLColumn()
 #endif 
    
    // SoM: MAGIC
-   dest = R_GetBufferTrans();
+   dest = R_GetBufferTrans<N>();
       
    fracstep = column.step; 
    frac = column.texmid + (int)((column.y1 - view.ycenter + 1) * fracstep);
@@ -1275,7 +1412,7 @@ static void R_QDrawTLColumn()
          do
          {
             *dest = colormap[source[frac>>FRACBITS]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1286,10 +1423,10 @@ static void R_QDrawTLColumn()
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1302,6 +1439,7 @@ static void R_QDrawTLColumn()
 #define SRCPIXEL \
    colormap[column.translation[source[(frac>>FRACBITS) & heightmask]]]
 
+template<int N>
 static void R_QDrawTLTRColumn()
 { 
    int      count; 
@@ -1322,7 +1460,7 @@ static void R_QDrawTLTRColumn()
 #endif 
 
    // SoM: MAGIC
-   dest = R_GetBufferTrans();
+   dest = R_GetBufferTrans<N>();
    
    fracstep = column.step; 
    frac = column.texmid + (int)((column.y1 - view.ycenter + 1) * fracstep);
@@ -1346,7 +1484,7 @@ static void R_QDrawTLTRColumn()
          do
          {
             *dest = colormap[column.translation[source[frac>>FRACBITS]]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1357,10 +1495,10 @@ static void R_QDrawTLTRColumn()
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = SRCPIXEL;
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = SRCPIXEL;
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1375,6 +1513,7 @@ static void R_QDrawTLTRColumn()
 // Spectre/Invisibility.
 //
 
+template<int N>
 static void R_QDrawFuzzColumn(void) 
 { 
    // Adjust borders. Low...
@@ -1398,7 +1537,7 @@ static void R_QDrawFuzzColumn(void)
 #endif
 
    // SoM: MAGIC
-   R_GetBufferFuzz();
+   R_GetBufferFuzz<N>();
    
    // REAL MAGIC... you ready for this?
    return; // DONE
@@ -1407,6 +1546,7 @@ static void R_QDrawFuzzColumn(void)
 #define SRCPIXEL \
    colormap[column.translation[source[(frac>>FRACBITS) & heightmask]]]
 
+template<int N>
 static void R_QDrawTRColumn(void) 
 { 
    int      count; 
@@ -1425,7 +1565,7 @@ static void R_QDrawTRColumn(void)
 #endif 
 
    // SoM: MAGIC
-   dest = R_GetBufferOpaque();
+   dest = R_GetBufferOpaque<N>();
    
    // Looks familiar.
    fracstep = column.step; 
@@ -1453,7 +1593,7 @@ static void R_QDrawTRColumn(void)
          do
          {
             *dest = colormap[column.translation[source[frac>>FRACBITS]]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1464,10 +1604,10 @@ static void R_QDrawTRColumn(void)
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = SRCPIXEL;
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = SRCPIXEL;
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1483,6 +1623,7 @@ static void R_QDrawTRColumn(void)
 //
 // haleyjd 09/01/02: zdoom-style translucency
 //
+template<int N>
 static void R_QDrawFlexColumn()
 { 
    int      count; 
@@ -1503,7 +1644,7 @@ static void R_QDrawFlexColumn()
 #endif 
    
    // SoM: MAGIC
-   dest = R_GetBufferFlexTrans();
+   dest = R_GetBufferFlexTrans<N>();
   
    fracstep = column.step; 
    frac = column.texmid + (int)((column.y1 - view.ycenter + 1) * fracstep);
@@ -1527,7 +1668,7 @@ static void R_QDrawFlexColumn()
          do
          {
             *dest = colormap[source[frac>>FRACBITS]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1538,10 +1679,10 @@ static void R_QDrawFlexColumn()
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1559,6 +1700,7 @@ static void R_QDrawFlexColumn()
 // haleyjd 11/05/02: zdoom-style translucency w/translation, for
 // player sprites
 //
+template<int N>
 static void R_QDrawFlexTRColumn(void) 
 { 
    int      count; 
@@ -1577,7 +1719,7 @@ static void R_QDrawFlexTRColumn(void)
 #endif 
 
    // MAGIC
-   dest = R_GetBufferFlexTrans();
+   dest = R_GetBufferFlexTrans<N>();
    
    // Looks familiar.
    fracstep = column.step; 
@@ -1605,7 +1747,7 @@ static void R_QDrawFlexTRColumn(void)
          do
          {
             *dest = colormap[column.translation[source[frac>>FRACBITS]]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1616,10 +1758,10 @@ static void R_QDrawFlexTRColumn(void)
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = SRCPIXEL;
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = SRCPIXEL;
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1635,6 +1777,7 @@ static void R_QDrawFlexTRColumn(void)
 //
 // haleyjd 02/08/05: additive translucency
 //
+template<int N>
 static void R_QDrawAddColumn()
 { 
    int      count; 
@@ -1655,7 +1798,7 @@ static void R_QDrawAddColumn()
 #endif 
    
    // SoM: MAGIC
-   dest = R_GetBufferFlexAdd();
+   dest = R_GetBufferFlexAdd<N>();
   
    fracstep = column.step; 
    frac = column.texmid + (int)((column.y1 - view.ycenter + 1) * fracstep);
@@ -1679,7 +1822,7 @@ static void R_QDrawAddColumn()
          do
          {            
             *dest = colormap[source[frac>>FRACBITS]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1690,10 +1833,10 @@ static void R_QDrawAddColumn()
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = colormap[source[(frac>>FRACBITS) & heightmask]];
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1710,6 +1853,7 @@ static void R_QDrawAddColumn()
 //
 // haleyjd 02/08/05: additive translucency + translation
 //
+template<int N>
 static void R_QDrawAddTRColumn(void) 
 { 
    int      count; 
@@ -1728,7 +1872,7 @@ static void R_QDrawAddTRColumn(void)
 #endif 
 
    // MAGIC
-   dest = R_GetBufferFlexAdd();
+   dest = R_GetBufferFlexAdd<N>();
    
    // Looks familiar.
    fracstep = column.step;
@@ -1756,7 +1900,7 @@ static void R_QDrawAddTRColumn(void)
          do
          {
             *dest = colormap[column.translation[source[frac>>FRACBITS]]];
-            dest += 4; //SoM: Oh, Oh it's MAGIC! You know...
+            dest += N; //SoM: Oh, Oh it's MAGIC! You know...
             if((frac += fracstep) >= (int)heightmask)
                frac -= heightmask;
          } 
@@ -1767,10 +1911,10 @@ static void R_QDrawAddTRColumn(void)
          while((count -= 2) >= 0) // texture height is a power of 2 -- killough
          {
             *dest = SRCPIXEL;
-            dest += 4; //SoM: MAGIC 
+            dest += N; //SoM: MAGIC 
             frac += fracstep;
             *dest = SRCPIXEL;
-            dest += 4;
+            dest += N;
             frac += fracstep;
          }
          if(count & 1)
@@ -1784,31 +1928,44 @@ static void R_QDrawAddTRColumn(void)
 //
 // haleyjd 09/04/06: Quad Column Drawer Object
 //
-columndrawer_t r_quad_drawer =
+template<int N>
+static columndrawer_t R_makeBufferedDrawer()
 {
-   R_QDrawColumn,
-   R_QDrawNewSkyColumn,
-   R_QDrawTLColumn,
-   R_QDrawTRColumn,
-   R_QDrawTLTRColumn,
-   R_QDrawFuzzColumn,
-   R_QDrawFlexColumn,
-   R_QDrawFlexTRColumn,
-   R_QDrawAddColumn,
-   R_QDrawAddTRColumn,
-
-   R_QResetColumnBuffer,
-
+   return
    {
-      // Normal            Translated
-      { R_QDrawColumn,     R_QDrawTRColumn     }, // NORMAL
-      { R_QDrawFuzzColumn, R_QDrawFuzzColumn   }, // SHADOW
-      { R_QDrawFlexColumn, R_QDrawFlexTRColumn }, // ALPHA
-      { R_QDrawAddColumn,  R_QDrawAddTRColumn  }, // ADD
-      { R_QDrawTLColumn,   R_QDrawTLTRColumn   }, // SUB
-      { R_QDrawTLColumn,   R_QDrawTLTRColumn   }, // TRANMAP
-   },
-};
+      R_QDrawColumn<N>,
+      R_QDrawNewSkyColumn<N>,
+      R_QDrawTLColumn<N>,
+      R_QDrawTRColumn<N>,
+      R_QDrawTLTRColumn<N>,
+      R_QDrawFuzzColumn<N>,
+      R_QDrawFlexColumn<N>,
+      R_QDrawFlexTRColumn<N>,
+      R_QDrawAddColumn<N>,
+      R_QDrawAddTRColumn<N>,
+
+      R_QResetColumnBuffer<N>,
 
-// EOF
+      {
+         // Normal               Translated
+         { R_QDrawColumn<N>,     R_QDrawTRColumn<N>     }, // NORMAL
+         { R_QDrawFuzzColumn<N>, R_QDrawFuzzColumn<N>   }, // SHADOW
+         { R_QDrawFlexColumn<N>, R_QDrawFlexTRColumn<N> }, // ALPHA
+         { R_QDrawAddColumn<N>,  R_QDrawAddTRColumn<N>  }, // ADD
+         { R_QDrawTLColumn<N>,   R_QDrawTLTRColumn<N>   }, // SUB
+         { R_QDrawTLColumn<N>,   R_QDrawTLTRColumn<N>   }, // TRANMAP
+      },
+   };
+}
+
+columndrawer_t r_quad_drawer = R_makeBufferedDrawer<4>();
 
+//
+// Wide Column Drawer Object
+//
+// Same as the quad one, but buffers WIDECOLUMNS columns so the flushers can
+// work on whole vectors.
+//
+columndrawer_t r_wide_drawer = R_makeBufferedDrawer<WIDECOLUMNS>();
+
+// EOF
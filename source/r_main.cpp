@@ -29,6 +29,7 @@
 
 #include "c_io.h"
 #include "c_runcmd.h"
+#include "cam_sight.h"
 #include "d_deh.h"
 #include "d_dehtbl.h"
 #include "d_gi.h"
@@ -41,6 +42,7 @@
 #include "hu_over.h"
 #include "i_video.h"
 #include "m_bbox.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "mn_engin.h"
 #include "p_chase.h"
@@ -156,6 +158,7 @@ static columndrawer_t *r_column_engines[NUMCOLUMNENGINES] =
 {
    &r_normal_drawer, // normal engine
    &r_quad_drawer,   // quad cache engine
+   &r_wide_drawer,   // wide (SIMD) cache engine
 };
 
 //
@@ -887,6 +890,9 @@ static void R_setSectorInterpolationState(secinterpstate_e state)
 {
    int i;
 
+   // the heights are only for drawing, so keep them out of the sight cache
+   CAM_SuspendSightCache(state == SEC_INTERPOLATE);
+
    switch(state)
    {
    case SEC_INTERPOLATE:
@@ -1219,6 +1225,7 @@ extern void R_UntaintPortals();
 //
 void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
 {
+   PROFILE_ZONE("R_RenderPlayerView");
    bool quake = false;
    unsigned int savedflags = 0;
 
@@ -1252,7 +1259,10 @@ void R_RenderPlayerView(player_t* player, camera_t *camerapoint)
       player->mo->intflags &= ~MIF_HIDDENBYQUAKE;  // zero it otherwise
 
    // The head node is the last node output.
-   R_RenderBSPNode(numnodes - 1);
+   {
+      PROFILE_ZONE("R_RenderBSPNode");
+      R_RenderBSPNode(numnodes - 1);
+   }
 
    if(quake)
       player->mo->flags2 = savedflags;
@@ -1463,7 +1473,7 @@ void R_DoomTLStyle()
 
 static const char *handedstr[]  = { "right", "left" };
 static const char *ptranstr[]   = { "none", "smooth", "general" };
-static const char *coleng[]     = { "normal", "quad" };
+static const char *coleng[]     = { "normal", "quad", "wide" };
 static const char *spaneng[]    = { "highprecision" };
 static const char *tlstylestr[] = { "none", "boom", "new" };
 
@@ -36,6 +36,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <vector>
+
 #include "z_zone.h"    /* memory allocation wrappers -- killough */
 #include "i_system.h"
 
@@ -43,6 +45,7 @@
 #include "d_gi.h"
 #include "doomstat.h"
 #include "ev_specials.h"
+#include "m_profile.h"
 #include "p_anim.h"
 #include "p_info.h"
 #include "p_slopes.h"
@@ -55,6 +58,7 @@
 #include "r_sky.h"
 #include "r_state.h"
 #include "r_things.h"
+#include "r_threads.h"
 #include "v_alloc.h"
 #include "v_misc.h"
 #include "v_video.h"
@@ -137,7 +141,7 @@ VALLOCATION(overlayfclip)
 }
 
 // spanstart holds the start of a plane span; initialized to 0 at start
-static int *spanstart;
+static thread_local int *spanstart;
 
 VALLOCATION(spanstart)
 {
@@ -148,9 +152,9 @@ VALLOCATION(spanstart)
 // texture mapping
 //
 
-cb_span_t      span;
-cb_plane_t     plane;
-cb_slopespan_t slopespan;
+thread_local cb_span_t      span;
+thread_local cb_plane_t     plane;
+thread_local cb_slopespan_t slopespan;
 
 VALLOCATION(slopespan)
 {
@@ -166,8 +170,18 @@ static void R_Throw()
    I_Error("R_Throw called.\n");
 }
 
-void (*flatfunc)()  = R_Throw;
-void (*slopefunc)() = R_Throw;
+static thread_local void (*flatfunc)()  = R_Throw;
+static thread_local void (*slopefunc)() = R_Throw;
+
+//
+// Column range drawn by the current render thread
+//
+struct planeslice_t
+{
+   int x1, x2;
+};
+
+static thread_local planeslice_t planeslice;
 
 //
 // R_SpanLight
@@ -203,6 +217,9 @@ static void R_MapPlane(int y, int x1, int x2)
 {
    float dy, xstep, ystep, realy, slope;
 
+   if(x2 < planeslice.x1 || x1 > planeslice.x2)
+      return;
+
 #ifdef RANGECHECK
    if(x2 < x1 || x1 < 0 || x2 >= viewwindow.width || y < 0 || y >= viewwindow.height)
       I_Error("R_MapPlane: %i, %i at %i\n", x1, x2, y);
@@ -243,6 +260,18 @@ static void R_MapPlane(int y, int x1, int x2)
       span.ystep = R_doubleToUint32(ystep * plane.fixedunity);
    }
 
+   // Clip to the slice. The drawers step the same way, so the pixels are
+   // the same as those of the whole span.
+   if(x1 < planeslice.x1)
+   {
+      unsigned int skip = planeslice.x1 - x1;
+      span.xfrac += skip * span.xstep;
+      span.yfrac += skip * span.ystep;
+      x1 = planeslice.x1;
+   }
+   if(x2 > planeslice.x2)
+      x2 = planeslice.x2;
+
    // killough 2/28/98: Add offsets
    if((span.colormap = plane.fixedcolormap) == nullptr) // haleyjd 10/16/06
       span.colormap = plane.colormap + R_SpanLight(realy) * 256;
@@ -311,6 +340,11 @@ static void R_MapSlope(int y, int x1, int x2)
    v3double_t s;
    double map1, map2;
 
+   // Sloped spans are drawn whole by the slice where they start, because
+   // their stepping can't be resumed from the middle.
+   if(x1 < planeslice.x1 || x1 > planeslice.x2)
+      return;
+
    s.x = x1 - view.xcenter;
    s.y = y - view.ycenter + 1;
    s.z = view.xfoc;
@@ -828,14 +862,83 @@ static void R_MakeSpans(int x, int t1, int b1, int t2, int b2)
       spanstart[b2--] = x;
 }
 
+//
+// Sky layer drawing info. All the column fields except the position and the
+// source are worked out before drawing.
+//
+struct skylayer_t
+{
+   int         texture;
+   int         offset;
+   angle_t     an, flip;
+   cb_column_t column;
+   void      (*drawer)();
+};
+
+//
+// Everything needed to draw a visplane, prepared on the main thread so the
+// drawing itself can be split among column slices
+//
+struct planedraw_t
+{
+   enum kind_e
+   {
+      PD_NONE,
+      PD_SKY,
+      PD_FLAT
+   };
+
+   visplane_t *pl;
+   kind_e      kind;
+   bool        serial;     // must not be drawn from worker threads
+
+   // skies: drawn in order
+   int         numlayers;
+   skylayer_t  layers[2];
+
+   // regular flats
+   cb_plane_t  plane;
+   cb_span_t   span;
+   void      (*flatfunc)();
+   void      (*slopefunc)();
+};
+
+//
+// R_setSkyLayer
+//
+// Fills in the column info common to all sky layers
+//
+static void R_setSkyLayer(skylayer_t &layer, const skytexture_t *sky)
+{
+   layer.column.texheight = sky->height;
+
+   // haleyjd: don't stretch textures over 200 tall
+   // 10/07/06: don't stretch skies in old demos (no mlook)
+   if(demo_version >= 300 && layer.column.texheight < 200 && stretchsky)
+      layer.column.step = M_FloatToFixed(view.pspriteystep * 0.5f);
+   else
+      layer.column.step = M_FloatToFixed(view.pspriteystep);
+}
+
+//
+// R_checkSkyTexture
+//
+// Makes sure the sky texture can be read from any thread
+//
+static void R_checkSkyTexture(int texture, planedraw_t &pd)
+{
+   if(textures[texture]->flags & TF_SWIRLY)
+      pd.serial = true;
+   else
+      R_GetLinearBuffer(texture);
+}
+
 // haleyjd: moved here from r_newsky.c
-static void do_draw_newsky(visplane_t *pl)
+static bool R_prepareNewSky(planedraw_t &pd, void (*skydrawer)(),
+                            void (*newskydrawer)())
 {
-   int x, offset, skyTexture, offset2, skyTexture2;
    skytexture_t *sky1, *sky2;
    
-   angle_t an = viewangle;
-   
    // render two layers
 
    // get scrolling offsets and textures
@@ -843,330 +946,474 @@ static void do_draw_newsky(visplane_t *pl)
    skyflat_t *skyflat2 = R_SkyFlatForIndex(1);
 
    if(!(skyflat1 && skyflat2))
-      return; // feh!
+      return false; // feh!
+
+   // first draw sky 2 with R_DrawColumn (unmasked)
+   skylayer_t &layer2 = pd.layers[0];
+   layer2.texture = texturetranslation[skyflat2->texture];
+   layer2.offset  = skyflat2->columnoffset >> 16;
+   sky2 = R_GetSkyTexture(layer2.texture);
 
-   offset      = skyflat1->columnoffset >> 16;
-   skyTexture  = texturetranslation[skyflat1->texture];
-   offset2     = skyflat2->columnoffset >> 16;
-   skyTexture2 = texturetranslation[skyflat2->texture];
+   // now draw sky 1 with R_DrawNewSkyColumn (masked)
+   skylayer_t &layer1 = pd.layers[1];
+   layer1.texture = texturetranslation[skyflat1->texture];
+   layer1.offset  = skyflat1->columnoffset >> 16;
+   sky1 = R_GetSkyTexture(layer1.texture);
+
+   if(comp[comp_skymap] || !(layer2.column.colormap = fixedcolormap))
+      layer2.column.colormap = fullcolormap;
+   layer1.column.colormap = layer2.column.colormap;
+
+   layer2.an = layer1.an = viewangle;
+   layer2.flip = layer1.flip = 0;
+
+   layer2.column.texmid = sky2->texturemid;
+   R_setSkyLayer(layer2, sky2);
+   layer2.drawer = skydrawer;
+
+   layer1.column.texmid = sky1->texturemid;
+   R_setSkyLayer(layer1, sky1);
+   layer1.drawer = newskydrawer;
+
+   R_checkSkyTexture(layer2.texture, pd);
+   R_checkSkyTexture(layer1.texture, pd);
+
+   pd.numlayers = 2;
+   return true;
+}
+
+// Log base 2 LUT
+static const int MultiplyDeBruijnBitPosition2[32] = 
+{
+  0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 
+  31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
 
-   sky1 = R_GetSkyTexture(skyTexture);
-   sky2 = R_GetSkyTexture(skyTexture2);
+//
+// R_prepareSky
+//
+static void R_prepareSky(planedraw_t &pd, const skyflat_t *skyflat, void (*drawer)())
+{
+   visplane_t *pl = pd.pl;
+   skylayer_t &layer = pd.layers[0];
+   skytexture_t *sky;
+
+   // killough 10/98: allow skies to come from sidedefs.
+   // Allows scrolling and/or animated skies, as well as
+   // arbitrary multiple skies per level without having
+   // to use info lumps.
+
+   layer.an = viewangle;
+   layer.offset = 0;
+   
+   if(pl->picnum & PL_SKYFLAT)
+   { 
+      // Sky Linedef
+      const line_t *l = &lines[pl->picnum & ~PL_SKYFLAT];
       
-   if(comp[comp_skymap] || !(column.colormap = fixedcolormap))
-      column.colormap = fullcolormap;
+      // Sky transferred from first sidedef
+      const side_t *s = *l->sidenum + sides;
       
-   // first draw sky 2 with R_DrawColumn (unmasked)
-   column.texmid    = sky2->texturemid;      
-   column.texheight = sky2->height;
+      // Texture comes from upper texture of reference sidedef
+      layer.texture = texturetranslation[s->toptexture];
 
-   // haleyjd: don't stretch textures over 200 tall
-   if(demo_version >= 300 && column.texheight < 200 && stretchsky)
-      column.step = M_FloatToFixed(view.pspriteystep * 0.5f);
-   else
-      column.step = M_FloatToFixed(view.pspriteystep);
+      // haleyjd 08/30/02: set skytexture info pointer
+      sky = R_GetSkyTexture(layer.texture);
+
+      // Horizontal offset is turned into an angle offset,
+      // to allow sky rotation as well as careful positioning.
+      // However, the offset is scaled very small, so that it
+      // allows a long-period of sky rotation.
+      
+      layer.an += s->textureoffset;
       
-   for(x = pl->minx; (column.x = x) <= pl->maxx; x++)
+      // Vertical offset allows careful sky positioning.        
+      
+      layer.column.texmid = s->rowoffset - 28*FRACUNIT;
+      
+      // We sometimes flip the picture horizontally.
+      //
+      // Doom always flipped the picture, so we make it optional,
+      // to make it easier to use the new feature, while to still
+      // allow old sky textures to be used.
+      int staticFn = EV_StaticInitForSpecial(l->special);
+
+      bool flipCond = staticFn == EV_STATIC_SKY_TRANSFER_FLIPPED
+      || (staticFn == EV_STATIC_INIT_PARAM
+          && l->args[ev_StaticInit_Arg_Flip]);
+
+      layer.flip = flipCond ? 0u : ~0u;
+   }
+   else 	 // Normal Doom sky, only one allowed per level
+   {
+      layer.texture       = skyflat->texture;            // Default texture
+      sky                 = R_GetSkyTexture(layer.texture); // haleyjd 08/30/02
+      layer.column.texmid = sky->texturemid;             // Default y-offset
+      layer.flip          = 0;                           // Doom flips it
+      layer.offset        = skyflat->columnoffset >> 16; // Hexen-style scrolling
+   }
+
+   // Sky is always drawn full bright, i.e. colormaps[0] is used.
+   // Because of this hack, sky is not affected by INVUL inverse mapping.
+   //
+   // killough 7/19/98: fix hack to be more realistic:
+   // haleyjd 10/31/10: use plane colormaps, not global vars!
+   if(comp[comp_skymap] || !(layer.column.colormap = pl->fixedcolormap))
+      layer.column.colormap = pl->fullcolormap;
+
+   //dc_texheight = (textureheight[texture])>>FRACBITS; // killough
+   // haleyjd: use height determined from patches in texture
+   R_setSkyLayer(layer, sky);
+   layer.drawer = drawer;
+
+   R_checkSkyTexture(layer.texture, pd);
+   pd.numlayers = 1;
+}
+
+//
+// R_prepareFlat
+//
+static void R_prepareFlat(planedraw_t &pd)
+{
+   visplane_t *pl = pd.pl;
+   texture_t *tex;
+   int        stop, light;
+   int        stylenum;
+
+   int picnum = texturetranslation[pl->picnum];
+
+   // haleyjd 05/19/06: rewritten to avoid crashes
+   // ioanch: apply swirly if original (pl->picnum) has the flag. This is so
+   // Hexen animations can control only their own sequence swirling.
+   if((r_swirl && textures[picnum]->flags & TF_ANIMATED)
+      || textures[pl->picnum]->flags & TF_SWIRLY)
+   {
+      plane.source = R_DistortedFlat(picnum);
+      tex = plane.tex = textures[picnum];
+      pd.serial = true;    // the distorted flat buffer is shared
+   }
+   else
+   {
+      // SoM: Handled outside
+      tex = plane.tex = R_CacheTexture(picnum);
+      plane.source = tex->bufferdata;
+   }
+
+   // haleyjd: TODO: feed pl->drawstyle to the first dimension to enable
+   // span drawstyles (ie. translucency)
+
+   stylenum = (pl->bflags & PS_ADDITIVE) ? SPAN_STYLE_ADD : 
+              (pl->opacity < 255)  ? SPAN_STYLE_TL :
+              SPAN_STYLE_NORMAL;
+
+   if(plane.tex->flags & TF_MASKED && pl->bflags & PS_OVERLAY)
    {
-      if((column.y1 = pl->top[x]) <= (column.y2 = pl->bottom[x]))
+      switch(stylenum)
       {
-         column.source = 
-            R_GetRawColumn(skyTexture2,
-               (((an + xtoviewangle[x])) >> (ANGLETOSKYSHIFT))+offset2);
-            
-         colfunc();
+         case SPAN_STYLE_TL:
+            stylenum = SPAN_STYLE_TL_MASKED;
+            break;
+         case SPAN_STYLE_ADD:
+            stylenum = SPAN_STYLE_ADD_MASKED;
+            break;
+         default:
+            stylenum = SPAN_STYLE_NORMAL_MASKED;
       }
+      span.alphamask = static_cast<const byte *>(plane.source) + tex->width * tex->height;
    }
+             
+   flatfunc  = r_span_engine->DrawSpan[stylenum][tex->flatsize];
+   slopefunc = r_span_engine->DrawSlope[stylenum][tex->flatsize];
+   
+   if(stylenum == SPAN_STYLE_TL || stylenum == SPAN_STYLE_TL_MASKED)
+   {
+      int level = (pl->opacity + 1) >> 2;
       
-   // now draw sky 1 with R_DrawNewSkyColumn (masked)
-   column.texmid = sky1->texturemid;
-   column.texheight = sky1->height;
+      span.fg2rgb = Col2RGB8[level];
+      span.bg2rgb = Col2RGB8[64 - level];
+   }
+   else if(stylenum == SPAN_STYLE_ADD || stylenum == SPAN_STYLE_ADD_MASKED)
+   {
+      int level = (pl->opacity + 1) >> 2;
+      
+      span.fg2rgb = Col2RGB8_LessPrecision[level];
+      span.bg2rgb = Col2RGB8_LessPrecision[64];
+   }
+   else
+      span.fg2rgb = span.bg2rgb = nullptr;
 
-   // haleyjd: don't stretch textures over 200 tall
-   if(demo_version >= 300 && column.texheight < 200 && stretchsky)
-      column.step = M_FloatToFixed(view.pspriteystep * 0.5f);
+   if(pl->pslope)
+      plane.slope = &pl->rslope;
    else
-      column.step = M_FloatToFixed(view.pspriteystep);
+      plane.slope = nullptr;
       
-   colfunc = r_column_engine->DrawNewSkyColumn;
-   for(x = pl->minx; (column.x = x) <= pl->maxx; x++)
    {
-      if((column.y1 = pl->top[x]) <= (column.y2 = pl->bottom[x]))
+      int rw, rh;
+      
+      rh = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->height * 0x077CB531U) >> 27];
+      rw = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->width  * 0x077CB531U) >> 27];
+
+      if(plane.slope)
       {
-         column.source =
-            R_GetRawColumn(skyTexture,
-               (((an + xtoviewangle[x])) >> (ANGLETOSKYSHIFT))+offset);
-            
-         colfunc();
+         span.ymask = tex->height - 1;
+         
+         span.xshift = 16 - rh;
+         span.xmask = (tex->width - 1) << (16 - span.xshift);
+      }
+      else
+      {
+         span.yshift = 32 - rh;
+         
+         span.xshift = span.yshift - rw;
+         span.xmask = (tex->width - 1) << (32 - rw - span.xshift);
+         
+         plane.fixedunitx = (float)(1 << (32 - rw));
+         plane.fixedunity = (float)(1 << span.yshift);
       }
    }
-   colfunc = r_column_engine->DrawColumn;
-}
+    
+     
+   plane.xoffset = pl->xoffsf;  // killough 2/28/98: Add offsets
+   plane.yoffset = pl->yoffsf;
+
+   plane.xscale = pl->scale.x;
+   plane.yscale = pl->scale.y;
+
+   plane.pviewx   = pl->viewxf;
+   plane.pviewy   = pl->viewyf;
+   plane.pviewz   = pl->viewzf;
+   plane.pviewsin = pl->viewsin; // haleyjd 01/05/08: Add angle
+   plane.pviewcos = pl->viewcos;
+   plane.height   = pl->heightf - pl->viewzf;
+   
+   // SoM 10/19/02: deep water colormap fix
+   if(fixedcolormap)
+      light = (255  >> LIGHTSEGSHIFT);
+   else
+      light = (pl->lightlevel >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
 
-// Log base 2 LUT
-static const int MultiplyDeBruijnBitPosition2[32] = 
-{
-  0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 
-  31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
-};
+   if(light >= LIGHTLEVELS)
+      light = LIGHTLEVELS-1;
+
+   if(light < 0)
+      light = 0;
+
+   stop = pl->maxx + 1;
+   pl->top[pl->minx-1] = pl->top[stop] = 0x7FFFFFFF;
+
+   plane.planezlight   = pl->colormap[light]; //zlight[light];
+   plane.colormap      = pl->fullcolormap;
+   plane.fixedcolormap = pl->fixedcolormap; // haleyjd 10/16/06
+   plane.lightlevel    = pl->lightlevel;
+
+   R_PlaneLight();
+
+   plane.MapFunc = (plane.slope == nullptr ? R_MapPlane : R_MapSlope);
+
+
+   pd.plane     = plane;
+   pd.span      = span;
+   pd.flatfunc  = flatfunc;
+   pd.slopefunc = slopefunc;
+}
 
 //
-// do_draw_plane
+// R_preparePlane
 //
 // New function, by Lee Killough
 // haleyjd 08/30/02: slight restructuring to use hashed sky texture info cache.
 //
-static void do_draw_plane(visplane_t *pl)
+// Works out how to draw the visplane. Sky columns go through the given
+// drawers. Returns false if there's nothing to draw.
+//
+static bool R_preparePlane(visplane_t *pl, planedraw_t &pd, void (*skydrawer)(),
+                           void (*newskydrawer)())
 {
-   int x;
-
    if(!(pl->minx <= pl->maxx))
-      return;
+      return false;
+
+   pd.pl = pl;
+   pd.serial = false;
 
    // haleyjd: hexen-style skies
    if(R_IsSkyFlat(pl->picnum) && LevelInfo.doubleSky)
    {
-      do_draw_newsky(pl);
-      return;
+      pd.kind = planedraw_t::PD_SKY;
+      return R_prepareNewSky(pd, skydrawer, newskydrawer);
    }
    
    skyflat_t *skyflat = R_SkyFlatForPicnum(pl->picnum);
    
    if(skyflat || pl->picnum & PL_SKYFLAT)  // sky flat
    {
-      int texture;
-      int offset = 0;
-      angle_t an, flip;
-      skytexture_t *sky;
-      
-      // killough 10/98: allow skies to come from sidedefs.
-      // Allows scrolling and/or animated skies, as well as
-      // arbitrary multiple skies per level without having
-      // to use info lumps.
-
-      an = viewangle;
-      
-      if(pl->picnum & PL_SKYFLAT)
-      { 
-         // Sky Linedef
-         const line_t *l = &lines[pl->picnum & ~PL_SKYFLAT];
-         
-         // Sky transferred from first sidedef
-         const side_t *s = *l->sidenum + sides;
-         
-         // Texture comes from upper texture of reference sidedef
-         texture = texturetranslation[s->toptexture];
+      pd.kind = planedraw_t::PD_SKY;
+      R_prepareSky(pd, skyflat, skydrawer);
+   }
+   else // regular flat
+   {
+      pd.kind = planedraw_t::PD_FLAT;
+      R_prepareFlat(pd);
+   }
+   return true;
+}
 
-         // haleyjd 08/30/02: set skytexture info pointer
-         sky = R_GetSkyTexture(texture);
+//
+// R_drawPlaneSlice
+//
+// Draws the part of a prepared visplane which is inside the current plane
+// slice
+//
+static void R_drawPlaneSlice(const planedraw_t &pd)
+{
+   const visplane_t *pl = pd.pl;
+   int x;
 
-         // Horizontal offset is turned into an angle offset,
-         // to allow sky rotation as well as careful positioning.
-         // However, the offset is scaled very small, so that it
-         // allows a long-period of sky rotation.
-         
-         an += s->textureoffset;
-         
-         // Vertical offset allows careful sky positioning.        
-         
-         column.texmid = s->rowoffset - 28*FRACUNIT;
-         
-         // We sometimes flip the picture horizontally.
-         //
-         // Doom always flipped the picture, so we make it optional,
-         // to make it easier to use the new feature, while to still
-         // allow old sky textures to be used.
-         int staticFn = EV_StaticInitForSpecial(l->special);
-
-         bool flipCond = staticFn == EV_STATIC_SKY_TRANSFER_FLIPPED
-         || (staticFn == EV_STATIC_INIT_PARAM
-             && l->args[ev_StaticInit_Arg_Flip]);
-
-         flip = flipCond ? 0u : ~0u;
-      }
-      else 	 // Normal Doom sky, only one allowed per level
-      {
-         texture       = skyflat->texture;            // Default texture
-         sky           = R_GetSkyTexture(texture);    // haleyjd 08/30/02
-         column.texmid = sky->texturemid;             // Default y-offset
-         flip          = 0;                           // Doom flips it
-         offset        = skyflat->columnoffset >> 16; // Hexen-style scrolling
-      }
+   if(pl->maxx < planeslice.x1 || pl->minx > planeslice.x2)
+      return;
 
-      // Sky is always drawn full bright, i.e. colormaps[0] is used.
-      // Because of this hack, sky is not affected by INVUL inverse mapping.
-      //
-      // killough 7/19/98: fix hack to be more realistic:
-      // haleyjd 10/31/10: use plane colormaps, not global vars!
-      if(comp[comp_skymap] || !(column.colormap = pl->fixedcolormap))
-         column.colormap = pl->fullcolormap;
-
-      //dc_texheight = (textureheight[texture])>>FRACBITS; // killough
-      // haleyjd: use height determined from patches in texture
-      column.texheight = sky->height;
-      
-      // haleyjd:  don't stretch textures over 200 tall
-      // 10/07/06: don't stretch skies in old demos (no mlook)
-      if(demo_version >= 300 && column.texheight < 200 && stretchsky)
-         column.step = M_FloatToFixed(view.pspriteystep * 0.5f);
-      else
-         column.step = M_FloatToFixed(view.pspriteystep);
+   if(pd.kind == planedraw_t::PD_SKY)
+   {
+      int startx = emax(pl->minx, planeslice.x1);
+      int stopx  = emin(pl->maxx, planeslice.x2);
 
-      // killough 10/98: Use sky scrolling offset, and possibly flip picture
-      for(x = pl->minx; x <= pl->maxx; x++)
+      for(int i = 0; i < pd.numlayers; ++i)
       {
-         column.x = x;
+         const skylayer_t &layer = pd.layers[i];
 
-         column.y1 = pl->top[x];
-         column.y2 = pl->bottom[x];
+         column = layer.column;
 
-         if(column.y1 <= column.y2)
+         // killough 10/98: Use sky scrolling offset, and possibly flip picture
+         for(x = startx; x <= stopx; x++)
          {
-            column.source = R_GetRawColumn(texture,
-               (((an + xtoviewangle[x])^flip) >> ANGLETOSKYSHIFT) + offset);
-            
-            colfunc();
+            column.x = x;
+            column.y1 = pl->top[x];
+            column.y2 = pl->bottom[x];
+
+            if(column.y1 <= column.y2)
+            {
+               column.source = R_GetRawColumn(layer.texture,
+                  (((layer.an + xtoviewangle[x])^layer.flip) >> ANGLETOSKYSHIFT) + 
+                  layer.offset);
+               
+               layer.drawer();
+            }
          }
       }
    }
-   else // regular flat
-   {  
-      texture_t *tex;
-      int        stop, light;
-      int        stylenum;
-
-      int picnum = texturetranslation[pl->picnum];
-
-      // haleyjd 05/19/06: rewritten to avoid crashes
-      // ioanch: apply swirly if original (pl->picnum) has the flag. This is so
-      // Hexen animations can control only their own sequence swirling.
-      if((r_swirl && textures[picnum]->flags & TF_ANIMATED)
-         || textures[pl->picnum]->flags & TF_SWIRLY)
-      {
-         plane.source = R_DistortedFlat(picnum);
-         tex = plane.tex = textures[picnum];
-      }
-      else
-      {
-         // SoM: Handled outside
-         tex = plane.tex = R_CacheTexture(picnum);
-         plane.source = tex->bufferdata;
-      }
+   else
+   {
+      plane     = pd.plane;
+      span      = pd.span;
+      flatfunc  = pd.flatfunc;
+      slopefunc = pd.slopefunc;
+
+      int stop = pl->maxx + 1;
+      for(x = pl->minx ; x <= stop ; x++)
+         R_MakeSpans(x, pl->top[x-1], pl->bottom[x-1], pl->top[x], pl->bottom[x]);
+   }
+}
+
+//
+// do_draw_plane
+//
+// Draws a whole visplane on the calling thread
+//
+static void do_draw_plane(visplane_t *pl)
+{
+   planedraw_t pd;
 
-      // haleyjd: TODO: feed pl->drawstyle to the first dimension to enable
-      // span drawstyles (ie. translucency)
+   if(!R_preparePlane(pl, pd, colfunc, r_column_engine->DrawNewSkyColumn))
+      return;
 
-      stylenum = (pl->bflags & PS_ADDITIVE) ? SPAN_STYLE_ADD : 
-                 (pl->opacity < 255)  ? SPAN_STYLE_TL :
-                 SPAN_STYLE_NORMAL;
+   planeslice.x1 = 0;
+   planeslice.x2 = viewwindow.width - 1;
+   R_drawPlaneSlice(pd);
 
-      if(plane.tex->flags & TF_MASKED && pl->bflags & PS_OVERLAY)
-      {
-         switch(stylenum)
-         {
-            case SPAN_STYLE_TL:
-               stylenum = SPAN_STYLE_TL_MASKED;
-               break;
-            case SPAN_STYLE_ADD:
-               stylenum = SPAN_STYLE_ADD_MASKED;
-               break;
-            default:
-               stylenum = SPAN_STYLE_NORMAL_MASKED;
-         }
-         span.alphamask = static_cast<const byte *>(plane.source) + tex->width * tex->height;
-      }
-                
-      flatfunc  = r_span_engine->DrawSpan[stylenum][tex->flatsize];
-      slopefunc = r_span_engine->DrawSlope[stylenum][tex->flatsize];
-      
-      if(stylenum == SPAN_STYLE_TL || stylenum == SPAN_STYLE_TL_MASKED)
-      {
-         int level = (pl->opacity + 1) >> 2;
-         
-         span.fg2rgb = Col2RGB8[level];
-         span.bg2rgb = Col2RGB8[64 - level];
-      }
-      else if(stylenum == SPAN_STYLE_ADD || stylenum == SPAN_STYLE_ADD_MASKED)
-      {
-         int level = (pl->opacity + 1) >> 2;
-         
-         span.fg2rgb = Col2RGB8_LessPrecision[level];
-         span.bg2rgb = Col2RGB8_LessPrecision[64];
-      }
-      else
-         span.fg2rgb = span.bg2rgb = nullptr;
+   if(pd.kind == planedraw_t::PD_SKY && pd.numlayers == 2)
+      colfunc = r_column_engine->DrawColumn;
+}
 
-      if(pl->pslope)
-         plane.slope = &pl->rslope;
-      else
-         plane.slope = nullptr;
-         
-      {
-         int rw, rh;
-         
-         rh = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->height * 0x077CB531U) >> 27];
-         rw = MultiplyDeBruijnBitPosition2[(uint32_t)(tex->width  * 0x077CB531U) >> 27];
+//
+// Visplanes prepared for drawing in slices
+//
+static PODCollection<planedraw_t> slicedplanes;
 
-         if(plane.slope)
-         {
-            span.ymask = tex->height - 1;
-            
-            span.xshift = 16 - rh;
-            span.xmask = (tex->width - 1) << (16 - span.xshift);
-         }
-         else
-         {
-            span.yshift = 32 - rh;
-            
-            span.xshift = span.yshift - rw;
-            span.xmask = (tex->width - 1) << (32 - rw - span.xshift);
-            
-            plane.fixedunitx = (float)(1 << (32 - rw));
-            plane.fixedunity = (float)(1 << span.yshift);
-         }
-      }
-       
-        
-      plane.xoffset = pl->xoffsf;  // killough 2/28/98: Add offsets
-      plane.yoffset = pl->yoffsf;
-
-      plane.xscale = pl->scale.x;
-      plane.yscale = pl->scale.y;
-
-      plane.pviewx   = pl->viewxf;
-      plane.pviewy   = pl->viewyf;
-      plane.pviewz   = pl->viewzf;
-      plane.pviewsin = pl->viewsin; // haleyjd 01/05/08: Add angle
-      plane.pviewcos = pl->viewcos;
-      plane.height   = pl->heightf - pl->viewzf;
-      
-      // SoM 10/19/02: deep water colormap fix
-      if(fixedcolormap)
-         light = (255  >> LIGHTSEGSHIFT);
-      else
-         light = (pl->lightlevel >> LIGHTSEGSHIFT) + (extralight * LIGHTBRIGHT);
+//
+// Per-thread buffers used when drawing planes outside the main thread
+//
+struct planebuffers_t
+{
+   std::vector<int> spanstart;
+   std::vector<lighttable_t *> slopecolormap;
+};
 
-      if(light >= LIGHTLEVELS)
-         light = LIGHTLEVELS-1;
+static planebuffers_t slicebuffers[MAXRENDERTHREADS];
 
-      if(light < 0)
-         light = 0;
+//
+// R_drawPlanesInSlice
+//
+// Draws the column range of all prepared visplanes
+//
+static void R_drawPlanesInSlice(const rslice_t &slice, void *)
+{
+   PROFILE_ZONE("R_drawPlanesInSlice");
 
-      stop = pl->maxx + 1;
-      pl->top[pl->minx-1] = pl->top[stop] = 0x7FFFFFFF;
+   if(slice.index)
+   {
+      planebuffers_t &buffers = slicebuffers[slice.index];
+      spanstart = buffers.spanstart.data();
+      slopespan.colormap = buffers.slopecolormap.data();
+   }
 
-      plane.planezlight   = pl->colormap[light]; //zlight[light];
-      plane.colormap      = pl->fullcolormap;
-      plane.fixedcolormap = pl->fixedcolormap; // haleyjd 10/16/06
-      plane.lightlevel    = pl->lightlevel;
+   planeslice.x1 = slice.x1;
+   planeslice.x2 = slice.x2;
+
+   for(const planedraw_t &pd : slicedplanes)
+      if(!pd.serial)
+         R_drawPlaneSlice(pd);
+}
 
-      R_PlaneLight();
+//
+// R_drawPlanesSliced
+//
+// Draws the visplanes of the table split among the render threads. Each
+// screen pixel belongs to one visplane only, so the result is the same as
+// drawing them in order on a single thread. Preparation, and anything which
+// uses shared buffers, stays on the main thread.
+//
+static void R_drawPlanesSliced(planehash_t *table)
+{
+   // finish any buffered columns before other threads write the screen
+   if(r_column_engine->ResetBuffer)
+      r_column_engine->ResetBuffer();
 
-      plane.MapFunc = (plane.slope == nullptr ? R_MapPlane : R_MapSlope);
+   int numslices = R_SliceCount();
+   for(int i = 1; i < numslices; ++i)
+   {
+      planebuffers_t &buffers = slicebuffers[i];
+      buffers.spanstart.resize(video.height);
+      buffers.slopecolormap.resize(video.width);
+   }
 
-      for(x = pl->minx ; x <= stop ; x++)
-         R_MakeSpans(x, pl->top[x-1], pl->bottom[x-1], pl->top[x], pl->bottom[x]);
+   slicedplanes.makeEmpty<true>();
+   for(int i = 0; i < table->chaincount; ++i)
+   {
+      for(visplane_t *pl = table->chains[i]; pl; pl = pl->next)
+      {
+         planedraw_t &pd = slicedplanes.addNew();
+         if(!R_preparePlane(pl, pd, r_normal_drawer.DrawColumn,
+                            r_normal_drawer.DrawNewSkyColumn))
+            slicedplanes.pop();
+         else if(pd.serial)
+         {
+            planeslice.x1 = 0;
+            planeslice.x2 = viewwindow.width - 1;
+            R_drawPlaneSlice(pd);
+         }
+      }
    }
+
+   R_RunSlices(R_drawPlanesInSlice, nullptr);
 }
 
 //
@@ -1177,11 +1424,18 @@ static void do_draw_plane(visplane_t *pl)
 //
 void R_DrawPlanes(planehash_t *table)
 {
+   PROFILE_ZONE("R_DrawPlanes");
    visplane_t *pl;
    int i;
    
    if(!table)
       table = &mainhash;
+
+   if(R_SliceCount() > 1)
+   {
+      R_drawPlanesSliced(table);
+      return;
+   }
    
    for(i = 0; i < table->chaincount; ++i)
    {
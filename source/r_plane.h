@@ -124,10 +124,11 @@ struct cb_slopespan_t
 };
 
 
-extern cb_span_t  span;
-extern cb_plane_t plane;
+// per render thread
+extern thread_local cb_span_t  span;
+extern thread_local cb_plane_t plane;
 
-extern cb_slopespan_t slopespan;
+extern thread_local cb_slopespan_t slopespan;
 
 planehash_t *R_NewOverlaySet();
 void R_FreeOverlaySet(planehash_t *set);
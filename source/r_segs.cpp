@@ -46,7 +46,7 @@
 // OPTIMIZE: closed two sided lines as single sided
 // SoM: Done.
 // SoM: Cardboard globals
-cb_column_t column;
+thread_local cb_column_t column;
 cb_seg_t    seg;
 cb_seg_t    segclip;
 
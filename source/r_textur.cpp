@@ -221,8 +221,9 @@ struct texturelump_t
 {
    int  lumpnum;     // number of lump
    int  maxoff;      // max offset, determined from size of lump
-   byte *data;       // cached data
-   byte *directory;  // directory pointer
+   WadLumpView *view; // read-only lump data
+   const byte *data;  // start of the data
+   const byte *directory; // directory pointer
    int  numtextures; // number of textures
    int  format;      // format of textures in this lump
 };
@@ -248,9 +249,9 @@ struct texturelump_t
     (((int32_t)*((x) + 2)) << 16) | \
     (((int32_t)*((x) + 3)) << 24)); (x) += 4
 
-static byte *R_ReadDoomPatch(byte *rawpatch, mappatch_t &tp)
+static const byte *R_ReadDoomPatch(const byte *rawpatch, mappatch_t &tp)
 {
-   byte *rover = rawpatch;
+   const byte *rover = rawpatch;
 
    tp.originx = TEXSHORT(rover);
    tp.originy = TEXSHORT(rover);
@@ -260,9 +261,9 @@ static byte *R_ReadDoomPatch(byte *rawpatch, mappatch_t &tp)
    return rover; // positioned at next patch
 }
 
-static byte *R_ReadStrifePatch(byte *rawpatch, mappatch_t &tp)
+static const byte *R_ReadStrifePatch(const byte *rawpatch, mappatch_t &tp)
 {
-   byte *rover = rawpatch;
+   const byte *rover = rawpatch;
 
    tp.originx = TEXSHORT(rover);
    tp.originy = TEXSHORT(rover);
@@ -273,16 +274,16 @@ static byte *R_ReadStrifePatch(byte *rawpatch, mappatch_t &tp)
    return rover; // positioned at next patch
 }
 
-static byte *R_ReadUnknownPatch(byte *rawpatch, mappatch_t &tp)
+static const byte *R_ReadUnknownPatch(const byte *rawpatch, mappatch_t &tp)
 {
    I_Error("R_ReadUnknownPatch called\n");
 
    return nullptr;
 }
 
-static byte *R_ReadDoomTexture(byte *rawtexture, maptexture_t &tt)
+static const byte *R_ReadDoomTexture(const byte *rawtexture, maptexture_t &tt)
 {
-   byte *rover = rawtexture;
+   const byte *rover = rawtexture;
    int i;
 
    for(i = 0; i < 8; ++i)
@@ -298,9 +299,9 @@ static byte *R_ReadDoomTexture(byte *rawtexture, maptexture_t &tt)
    return rover; // positioned for patch reading
 }
 
-static byte *R_ReadStrifeTexture(byte *rawtexture, maptexture_t &tt)
+static const byte *R_ReadStrifeTexture(const byte *rawtexture, maptexture_t &tt)
 {
-   byte *rover = rawtexture;
+   const byte *rover = rawtexture;
    int i;
 
    for(i = 0; i < 8; ++i)
@@ -317,7 +318,7 @@ static byte *R_ReadStrifeTexture(byte *rawtexture, maptexture_t &tt)
    return rover; // positioned for patch reading
 }
 
-static byte *R_ReadUnknownTexture(byte *rawtexture, maptexture_t &tt)
+static const byte *R_ReadUnknownTexture(const byte *rawtexture, maptexture_t &tt)
 {
    I_Error("R_ReadUnknownTexture called\n");
 
@@ -326,8 +327,8 @@ static byte *R_ReadUnknownTexture(byte *rawtexture, maptexture_t &tt)
 
 struct texturehandler_t
 {
-   byte *(*ReadTexture)(byte *, maptexture_t &tt);
-   byte *(*ReadPatch)(byte *, mappatch_t &tp);
+   const byte *(*ReadTexture)(const byte *, maptexture_t &tt);
+   const byte *(*ReadPatch)(const byte *, mappatch_t &tp);
 };
 
 static texturehandler_t TextureHandlers[] =
@@ -350,10 +351,12 @@ static texturelump_t *R_InitTextureLump(const char *lname)
 
    if(tlump->lumpnum >= 0)
    {
-      byte *temp;
+      const byte *temp;
 
+      // ioanch: only read, so it can come straight from the mapped wad
+      tlump->view        = new WadLumpView(wGlobalDir, tlump->lumpnum, false);
       tlump->maxoff      = W_LumpLength(tlump->lumpnum);
-      tlump->data = temp = (byte *)(wGlobalDir.cacheLumpNum(tlump->lumpnum, PU_STATIC));
+      tlump->data = temp = tlump->view->getAs<byte>();
       tlump->numtextures = TEXINT(temp);
       tlump->directory   = temp;
    }
@@ -368,8 +371,7 @@ static texturelump_t *R_InitTextureLump(const char *lname)
 //
 static void R_FreeTextureLump(texturelump_t *tlump)
 {
-   if(tlump->data)
-      Z_Free(tlump->data);
+   delete tlump->view;
    Z_Free(tlump);
 }
 
@@ -387,12 +389,12 @@ static void R_FreeTextureLump(texturelump_t *tlump)
 static void R_DetectTextureFormat(texturelump_t *tlump)
 {
    int format = texture_doom; // we start out assuming DOOM format...
-   byte *directory = tlump->directory;
+   const byte *directory = tlump->directory;
 
    for(int i = 0; i < tlump->numtextures; i++)
    {
       int offset;
-      byte *mtexture;
+      const byte *mtexture;
 
       offset = TEXINT(directory);
 
@@ -483,14 +485,14 @@ static int R_ReadTextureLump(texturelump_t *tlump, int *patchlookup,
                              int nummappatches, int texnum, int *errors, texturehash_t &duptable)
 {
    int i, j;
-   byte *directory = tlump->directory;
+   const byte *directory = tlump->directory;
    edefstructvar(maptexture_t, tt);
    edefstructvar(mappatch_t, tp);
 
    for(i = 0; i < tlump->numtextures; i++, texnum++)
    {
       int            offset;
-      byte           *rawtex, *rawpatch;
+      const byte     *rawtex, *rawpatch;
       texture_t      *texture;
       tcomponent_t   *component;
 
@@ -542,9 +544,10 @@ static int R_ReadTextureLump(texturelump_t *tlump, int *patchlookup,
          }
          else
          {
-            patch_t *p = PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
-            component->width  = p->width;
-            component->height = p->height;
+            patchheader_t header;
+            PatchLoader::GetHeader(wGlobalDir, component->lump, header);
+            component->width  = header.width;
+            component->height = header.height;
          }
       }
       
@@ -573,9 +576,10 @@ static int R_ReadTextureNamespace(int texnum)
 
       lumpinfo_t *lump = wni.current();
       texture_t  *texture;
-      patch_t    *patch  = PatchLoader::CacheNum(wGlobalDir, lump->selfindex, PU_CACHE);
-      uint16_t    width  = patch->width;
-      uint16_t    height = patch->height;
+      patchheader_t header;
+      PatchLoader::GetHeader(wGlobalDir, lump->selfindex, header);
+      uint16_t    width  = header.width;
+      uint16_t    height = header.height;
 
       texture = textures[texnum] = R_AllocTexStruct(lump->name, width, height, 1);
       texture->index = texnum;
@@ -685,7 +689,8 @@ static void AddTexColumn(texture_t *tex, const byte *src, int srcstep,
 //
 static void AddTexFlat(texture_t *tex, tcomponent_t *component)
 {
-   byte      *src = (byte *)(wGlobalDir.cacheLumpNum(component->lump, PU_CACHE));
+   WadLumpView view(wGlobalDir, component->lump, false);
+   const byte *src = view.getAs<byte>();
    int       destoff, srcoff, deststep, srcxstep, srcystep;
    int       xstart, ystart, xstop, ystop;
    int       width, height, wcount, hcount;
@@ -759,7 +764,10 @@ static void AddTexFlat(texture_t *tex, tcomponent_t *component)
 //
 static void AddTexPatch(texture_t *tex, tcomponent_t *component)
 {
-   patch_t *patch = PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
+   // ioanch: paint straight from the mapped wad when the patch allows it
+   const patch_t *raw   = PatchLoader::GetRaw(wGlobalDir, component->lump);
+   const patch_t *patch = raw ? raw :
+      PatchLoader::CacheNum(wGlobalDir, component->lump, PU_CACHE);
    int      destoff;
    int      xstart, ystart, xstop;
    int      colindex, colstep;
@@ -790,8 +798,10 @@ static void AddTexPatch(texture_t *tex, tcomponent_t *component)
    for(x = xstart; x < xstop; x += xstep, colindex += colstep)
    {
       int top, y1, y2, destbase;
+      int32_t colofs = raw ? SwapLong(patch->columnofs[colindex]) :
+                             patch->columnofs[colindex];
       const column_t *column = 
-         (const column_t *)((byte *)patch + patch->columnofs[colindex]);
+         (const column_t *)((const byte *)patch + colofs);
          
       destbase = x * tex->height;
       top = 0;
@@ -1195,8 +1205,8 @@ static int *R_LoadPNames(int &nummappatches)
    int  i, lumpnum;
    int  *patchlookup;
    char name[9];
-   char *names;
-   char *name_p;
+   const char *names;
+   const char *name_p;
 
    if((lumpnum = wGlobalDir.checkNumForName("PNAMES")) < 0)
    {
@@ -1214,14 +1224,14 @@ static int *R_LoadPNames(int &nummappatches)
 
    // Load the patch names from pnames.lmp.
    name[8] = 0;
-   names = (char *)wGlobalDir.cacheLumpNum(lumpnum, PU_STATIC);
-   nummappatches = SwapLong(*((int *)names));
+   WadLumpView view(wGlobalDir, lumpnum);
+   names = view.getAs<char>();
+   nummappatches = SwapLong(*((const int *)names));
 
    if(nummappatches * 8 + 4 > lumpsize)
    {
       usermsg("\nError: PNAMES size %d smaller than expected %d\n", lumpsize,
               nummappatches * 8 + 4);
-      efree(names);
       nummappatches = 0;
       return nullptr;
    }
@@ -1252,9 +1262,6 @@ static int *R_LoadPNames(int &nummappatches)
       }
    }
 
-   // done with PNAMES
-   Z_Free(names);
-
    return patchlookup;
 }
 
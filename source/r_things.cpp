@@ -35,6 +35,7 @@
 #include "m_argv.h"
 #include "m_bbox.h"
 #include "m_compare.h"
+#include "m_profile.h"
 #include "m_swap.h"
 #include "p_chase.h"
 #include "p_info.h"
@@ -1802,6 +1803,7 @@ static void R_DrawSpriteInDSRange(vissprite_t *spr, int firstds, int lastds)
 //
 void R_DrawPostBSP()
 {
+   PROFILE_ZONE("R_DrawPostBSP");
    maskedrange_t *masked;
    drawseg_t     *ds;
    int           firstds, lastds, firstsprite, lastsprite;
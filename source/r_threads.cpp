@@ -0,0 +1,198 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2026 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//
+//   Renderer worker threads, splitting the view into column slices.
+//
+//   The view is cut into r_threads vertical slices of equal width. The
+//   calling thread renders the first slice while the pool renders the rest,
+//   so a frame stage run through R_RunSlices behaves like a normal function
+//   call. Work given to the slices must not use the zone heap, the WAD cache
+//   or anything else which isn't thread-safe.
+//
+//-----------------------------------------------------------------------------
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "z_zone.h"
+#include "c_runcmd.h"
+#include "r_draw.h"
+#include "r_threads.h"
+
+// Number of column slices (1 = render on the main thread only)
+int r_threads = 1;
+
+//
+// Persistent worker threads. They sleep between frame stages.
+//
+class RenderThreadPool
+{
+public:
+   ~RenderThreadPool()
+   {
+      resize(0);
+   }
+
+   void run(int count, void (*func)(const rslice_t &, void *), void *data);
+
+private:
+   void resize(int count);
+   void workerLoop(int index, unsigned seenstage);
+
+   std::vector<std::thread> threads;
+   std::mutex               mutex;
+   std::condition_variable  wakeup;    // new work or shutdown
+   std::condition_variable  finished;  // a slice completed
+
+   void (*func)(const rslice_t &, void *) = nullptr;
+   void *data      = nullptr;
+   int   slices    = 0;      // slices in the current stage
+   int   pending   = 0;      // worker slices not yet done
+   unsigned stage  = 0;      // bumped for each R_RunSlices
+   bool  quit      = false;
+};
+
+static RenderThreadPool pool;
+
+//
+// Computes the column range of a slice
+//
+static rslice_t R_makeSlice(int index, int count)
+{
+   rslice_t slice;
+   slice.index = index;
+   slice.x1 = viewwindow.width * index / count;
+   slice.x2 = viewwindow.width * (index + 1) / count - 1;
+   return slice;
+}
+
+//
+// RenderThreadPool::resize
+//
+// Starts or stops workers so there are count of them
+//
+void RenderThreadPool::resize(int count)
+{
+   if((int)threads.size() == count)
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+   }
+   wakeup.notify_all();
+   for(std::thread &thread : threads)
+      thread.join();
+   threads.clear();
+
+   quit = false;
+   for(int i = 0; i < count; ++i)
+      threads.emplace_back(&RenderThreadPool::workerLoop, this, i + 1, stage);
+}
+
+//
+// RenderThreadPool::workerLoop
+//
+// Worker index n always renders slice n. seenstage is the last stage started
+// before the worker was created.
+//
+void RenderThreadPool::workerLoop(int index, unsigned seenstage)
+{
+   std::unique_lock<std::mutex> lock(mutex);
+   for(;;)
+   {
+      wakeup.wait(lock, [&] { return quit || stage != seenstage; });
+      if(quit)
+         return;
+      seenstage = stage;
+      if(index >= slices)
+         continue;
+
+      void (*stagefunc)(const rslice_t &, void *) = func;
+      void *stagedata = data;
+      rslice_t slice = R_makeSlice(index, slices);
+
+      lock.unlock();
+      stagefunc(slice, stagedata);
+      lock.lock();
+
+      if(!--pending)
+         finished.notify_one();
+   }
+}
+
+//
+// RenderThreadPool::run
+//
+void RenderThreadPool::run(int count, void (*func)(const rslice_t &, void *),
+                           void *data)
+{
+   resize(count - 1);
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->func = func;
+      this->data = data;
+      slices     = count;
+      pending    = count - 1;
+      ++stage;
+   }
+   wakeup.notify_all();
+
+   func(R_makeSlice(0, count), data);
+
+   std::unique_lock<std::mutex> lock(mutex);
+   finished.wait(lock, [this] { return !pending; });
+}
+
+//
+// R_SliceCount
+//
+// Number of slices the next frame stage will be split into
+//
+int R_SliceCount()
+{
+   int count = r_threads < 1 ? 1 : r_threads;
+   return count > viewwindow.width ? viewwindow.width : count;
+}
+
+//
+// R_RunSlices
+//
+// Calls func for each slice of the view and waits for all of them to finish
+//
+void R_RunSlices(void (*func)(const rslice_t &, void *), void *data)
+{
+   int count = R_SliceCount();
+   if(count <= 1)
+      func(R_makeSlice(0, 1), data);
+   else
+      pool.run(count, func, data);
+}
+
+VARIABLE_INT(r_threads, nullptr, 1, MAXRENDERTHREADS, nullptr);
+CONSOLE_VARIABLE(r_threads, r_threads, 0) {}
+
+// EOF
+
@@ -0,0 +1,49 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2026 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//--------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//
+//   Renderer worker threads, splitting the view into column slices.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef R_THREADS_H__
+#define R_THREADS_H__
+
+#define MAXRENDERTHREADS 32
+
+extern int r_threads;
+
+//
+// Column range of a slice, inclusive
+//
+struct rslice_t
+{
+   int index;
+   int x1, x2;
+};
+
+int  R_SliceCount();
+void R_RunSlices(void (*func)(const rslice_t &, void *), void *data);
+
+#endif
+
+// EOF
+
@@ -28,6 +28,11 @@
 #include "i_sound.h"
 #include "s_reverb.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define S_REVERB_SSE2
+#include <emmintrin.h>
+#endif
+
 //
 // Defines and constants
 //
@@ -82,9 +87,10 @@
 // denorms
 //
 
-static inline void undenormalize(double &d)
+static const float anti_denormal = 1e-18f;
+
+static inline void undenormalize(float &d)
 {
-   static const double anti_denormal = 1e-18;
    d += anti_denormal;
    d -= anti_denormal;
 }
@@ -97,7 +103,7 @@ static inline void undenormalize(double &d)
 #define MAXDELAY 250u
 #define MAXSR    44100u
 
-static double delayBuffer[MAXDELAY*MAXSR/1000];
+static float delayBuffer[MAXDELAY*MAXSR/1000];
 
 static size_t delaySize;
 static size_t readPos;
@@ -106,7 +112,7 @@ static size_t writePos;
 static void delay_clearBuffer()
 {
    for(size_t i = 0; i < delaySize; i++)
-      delayBuffer[i] = 0.0;
+      delayBuffer[i] = 0.0f;
 }
 
 static void delay_set(size_t delayms, size_t sr = MAXSR)
@@ -126,16 +132,16 @@ static void delay_set(size_t delayms, size_t sr = MAXSR)
    }
 }
 
-static void delay_writeSample(double sample)
+static void delay_writeSample(float sample)
 {
    delayBuffer[writePos] = sample;
    if(++writePos >= delaySize)
       writePos = 0;
 }
 
-static double delay_readSample()
+static float delay_readSample()
 {
-   double ret = delayBuffer[readPos];
+   float ret = delayBuffer[readPos];
    if(++readPos >= delaySize)
       readPos = 0;
    return ret;
@@ -145,49 +151,96 @@ static double delay_readSample()
 //
 // comb
 //
+// ioanch: all the combs of both channels are kept together and run as one
+// bank, so their filters can be computed side by side. They always share the
+// feedback and damping.
+//
 
-class comb
+#define NUMBANKCOMBS (2 * NUMCOMBS)
+
+class combbank
 {
 public:
-   double  feedback;
-   double  filterstore;
-   double  damp1;
-   double  damp2;
-   double *buffer;
-   int     bufsize;
-   int     bufidx;
-
-   void setbuffer(double *buf, int size)
+   float  feedback;
+   float  damp1;
+   float  damp2;
+   alignas(16) float filterstore[NUMBANKCOMBS]; // left combs first
+   float *buffer[NUMBANKCOMBS];
+   int    bufsize[NUMBANKCOMBS];
+   int    bufidx[NUMBANKCOMBS];
+
+   void setbuffer(int comb, float *buf, int size)
    {
-      buffer  = buf;
-      bufsize = size;
+      buffer[comb]  = buf;
+      bufsize[comb] = size;
    }
 
-   double process(double input)
+   void process(float input, float &outL, float &outR)
    {
-      double output;
-      
-      output = buffer[bufidx];
-      undenormalize(output);
+      alignas(16) float output[NUMBANKCOMBS];
 
-      filterstore = (output * damp2) + (filterstore * damp1);
-      undenormalize(filterstore);
+      for(int i = 0; i < NUMBANKCOMBS; i++)
+         output[i] = buffer[i][bufidx[i]];
 
-      buffer[bufidx] = input + (filterstore * feedback);
+#ifdef S_REVERB_SSE2
+      const __m128 ad  = _mm_set1_ps(anti_denormal);
+      const __m128 d1  = _mm_set1_ps(damp1);
+      const __m128 d2  = _mm_set1_ps(damp2);
+      const __m128 fb  = _mm_set1_ps(feedback);
+      const __m128 in  = _mm_set1_ps(input);
+      alignas(16) float feed[NUMBANKCOMBS];
 
-      if(++bufidx >= bufsize)
-         bufidx = 0;
+      for(int i = 0; i < NUMBANKCOMBS; i += 4)
+      {
+         __m128 out = _mm_sub_ps(_mm_add_ps(_mm_load_ps(output + i), ad), ad);
+         _mm_store_ps(output + i, out);
 
-      return output;
+         __m128 store = _mm_add_ps(_mm_mul_ps(out, d2),
+                                   _mm_mul_ps(_mm_load_ps(filterstore + i), d1));
+         store = _mm_sub_ps(_mm_add_ps(store, ad), ad);
+         _mm_store_ps(filterstore + i, store);
+
+         _mm_store_ps(feed + i, _mm_add_ps(in, _mm_mul_ps(store, fb)));
+      }
+      for(int i = 0; i < NUMBANKCOMBS; i++)
+         buffer[i][bufidx[i]] = feed[i];
+#else
+      for(int i = 0; i < NUMBANKCOMBS; i++)
+      {
+         undenormalize(output[i]);
+
+         filterstore[i] = (output[i] * damp2) + (filterstore[i] * damp1);
+         undenormalize(filterstore[i]);
+
+         buffer[i][bufidx[i]] = input + (filterstore[i] * feedback);
+      }
+#endif
+
+      for(int i = 0; i < NUMBANKCOMBS; i++)
+      {
+         if(++bufidx[i] >= bufsize[i])
+            bufidx[i] = 0;
+      }
+
+      // accumulate in the same order as each channel's combs used to be
+      outL = outR = 0;
+      for(int i = 0; i < NUMCOMBS; i++)
+      {
+         outL += output[i];
+         outR += output[NUMCOMBS + i];
+      }
    }
 
    void mute()
    {
-      for(int i = 0; i < bufsize; i++)
-         buffer[i] = 0;
+      for(int i = 0; i < NUMBANKCOMBS; i++)
+      {
+         for(int j = 0; j < bufsize[i]; j++)
+            buffer[i][j] = 0;
+      }
    }
 
-   void setdamp(double val)
+   void setdamp(float val)
    {
       damp1 = val;
       damp2 = 1 - val;
@@ -202,20 +255,20 @@ public:
 class allpass
 {
 public:
-   double  feedback;
-   double *buffer;
+   float   feedback;
+   float  *buffer;
    int     bufsize;
    int     bufidx;
 
-   void setbuffer(double *buf, int size)
+   void setbuffer(float *buf, int size)
    {
       buffer  = buf;
       bufsize = size;
    }
 
-   double process(double input)
+   float process(float input)
    {
-      double output, bufout;
+      float output, bufout;
 
       bufout = buffer[bufidx];
       undenormalize(bufout);
@@ -253,31 +306,31 @@ struct EQSTATE
 {
   // Filter #1 (Low band)
 
-  double  lf;       // Frequency
-  double  f1p0;     // Poles ...
-  double  f1p1;    
-  double  f1p2;
-  double  f1p3;
+  float   lf;       // Frequency
+  float   f1p0;     // Poles ...
+  float   f1p1;    
+  float   f1p2;
+  float   f1p3;
 
   // Filter #2 (High band)
 
-  double  hf;       // Frequency
-  double  f2p0;     // Poles ...
-  double  f2p1;
-  double  f2p2;
-  double  f2p3;
+  float   hf;       // Frequency
+  float   f2p0;     // Poles ...
+  float   f2p1;
+  float   f2p2;
+  float   f2p3;
 
   // Sample history buffer
 
-  double  sdm1;     // Sample data minus 1
-  double  sdm2;     //                   2
-  double  sdm3;     //                   3
+  float   sdm1;     // Sample data minus 1
+  float   sdm2;     //                   2
+  float   sdm3;     //                   3
 
   // Gain Controls
 
-  double  lg;       // low  gain
-  double  mg;       // mid  gain
-  double  hg;       // high gain
+  float   lg;       // low  gain
+  float   mg;       // mid  gain
+  float   hg;       // high gain
 };
 
 struct eqparams_t
@@ -289,12 +342,12 @@ struct eqparams_t
    double highgain;
 };
 
-static double do_3band(EQSTATE &es, double sample)
+static float do_3band(EQSTATE &es, float sample)
 {
-   static double vsa = (1.0 / 4294967295.0);
+   static const float vsa = (1.0f / 4294967295.0f);
    
    // Locals
-   double l, m, h;    // Low / Mid / High - Sample Values
+   float l, m, h;    // Low / Mid / High - Sample Values
 
    // Filter #1 (lowpass)
    es.f1p0  += (es.lf * (sample  - es.f1p0)) + vsa;
@@ -335,18 +388,18 @@ static void init_3band(const eqparams_t &params, EQSTATE &eql, EQSTATE &eqr)
    memset(&eqr, 0, sizeof(eqr));
 
    // Set Low/Mid/High gains 
-   eql.lg = eqr.lg = params.lowgain;
-   eql.mg = eqr.mg = params.midgain;
-   eql.hg = eqr.hg = params.highgain;
+   eql.lg = eqr.lg = (float)params.lowgain;
+   eql.mg = eqr.mg = (float)params.midgain;
+   eql.hg = eqr.hg = (float)params.highgain;
 
    // Calculate filter cutoff frequencies
-   eql.lf = eqr.lf = 2 * sin(SND_PI * (params.lowfreq  / (double)MAXSR));
-   eql.hf = eqr.hf = 2 * sin(SND_PI * (params.highfreq / (double)MAXSR));
+   eql.lf = eqr.lf = (float)(2 * sin(SND_PI * (params.lowfreq  / (double)MAXSR)));
+   eql.hf = eqr.hf = (float)(2 * sin(SND_PI * (params.highfreq / (double)MAXSR)));
 }
 
 static void clear_3band(EQSTATE &eq)
 {
-   eq.sdm1 = eq.sdm2 = eq.sdm3 = 0.0;
+   eq.sdm1 = eq.sdm2 = eq.sdm3 = 0.0f;
 }
 
 //=============================================================================
@@ -372,59 +425,58 @@ public:
    eqparams_t eqparams;
 
    // comb filters
-   comb combL[NUMCOMBS];
-   comb combR[NUMCOMBS];
+   combbank combs;
 
    // allpass filters
    allpass allpassL[NUMALLPASSES];
    allpass allpassR[NUMALLPASSES];
 
    // Buffers for the combs
-   double bufcombL1[COMBTUNINGL1];
-   double bufcombR1[COMBTUNINGR1];
-   double bufcombL2[COMBTUNINGL2];
-   double bufcombR2[COMBTUNINGR2];
-   double bufcombL3[COMBTUNINGL3];
-   double bufcombR3[COMBTUNINGR3];
-   double bufcombL4[COMBTUNINGL4];
-   double bufcombR4[COMBTUNINGR4];
-   double bufcombL5[COMBTUNINGL5];
-   double bufcombR5[COMBTUNINGR5];
-   double bufcombL6[COMBTUNINGL6];
-   double bufcombR6[COMBTUNINGR6];
-   double bufcombL7[COMBTUNINGL7];
-   double bufcombR7[COMBTUNINGR7];
-   double bufcombL8[COMBTUNINGL8];
-   double bufcombR8[COMBTUNINGR8];
+   float bufcombL1[COMBTUNINGL1];
+   float bufcombR1[COMBTUNINGR1];
+   float bufcombL2[COMBTUNINGL2];
+   float bufcombR2[COMBTUNINGR2];
+   float bufcombL3[COMBTUNINGL3];
+   float bufcombR3[COMBTUNINGR3];
+   float bufcombL4[COMBTUNINGL4];
+   float bufcombR4[COMBTUNINGR4];
+   float bufcombL5[COMBTUNINGL5];
+   float bufcombR5[COMBTUNINGR5];
+   float bufcombL6[COMBTUNINGL6];
+   float bufcombR6[COMBTUNINGR6];
+   float bufcombL7[COMBTUNINGL7];
+   float bufcombR7[COMBTUNINGR7];
+   float bufcombL8[COMBTUNINGL8];
+   float bufcombR8[COMBTUNINGR8];
 
    // Buffers for the allpasses
-   double bufallpassL1[ALLPASSTUNINGL1];
-   double bufallpassR1[ALLPASSTUNINGR1];
-   double bufallpassL2[ALLPASSTUNINGL2];
-   double bufallpassR2[ALLPASSTUNINGR2];
-   double bufallpassL3[ALLPASSTUNINGL3];
-   double bufallpassR3[ALLPASSTUNINGR3];
-   double bufallpassL4[ALLPASSTUNINGL4];
-   double bufallpassR4[ALLPASSTUNINGR4];
+   float bufallpassL1[ALLPASSTUNINGL1];
+   float bufallpassR1[ALLPASSTUNINGR1];
+   float bufallpassL2[ALLPASSTUNINGL2];
+   float bufallpassR2[ALLPASSTUNINGR2];
+   float bufallpassL3[ALLPASSTUNINGL3];
+   float bufallpassR3[ALLPASSTUNINGR3];
+   float bufallpassL4[ALLPASSTUNINGL4];
+   float bufallpassR4[ALLPASSTUNINGR4];
 
    revmodel()
    {
-      combL[0].setbuffer(bufcombL1, COMBTUNINGL1);
-      combR[0].setbuffer(bufcombR1, COMBTUNINGR1);
-      combL[1].setbuffer(bufcombL2, COMBTUNINGL2);
-      combR[1].setbuffer(bufcombR2, COMBTUNINGR2);
-      combL[2].setbuffer(bufcombL3, COMBTUNINGL3);
-      combR[2].setbuffer(bufcombR3, COMBTUNINGR3);
-      combL[3].setbuffer(bufcombL4, COMBTUNINGL4);
-      combR[3].setbuffer(bufcombR4, COMBTUNINGR4);
-      combL[4].setbuffer(bufcombL5, COMBTUNINGL5);
-      combR[4].setbuffer(bufcombR5, COMBTUNINGR5);
-      combL[5].setbuffer(bufcombL6, COMBTUNINGL6);
-      combR[5].setbuffer(bufcombR6, COMBTUNINGR6);
-      combL[6].setbuffer(bufcombL7, COMBTUNINGL7);
-      combR[6].setbuffer(bufcombR7, COMBTUNINGR7);
-      combL[7].setbuffer(bufcombL8, COMBTUNINGL8);
-      combR[7].setbuffer(bufcombR8, COMBTUNINGR8);
+      combs.setbuffer(0, bufcombL1, COMBTUNINGL1);
+      combs.setbuffer(NUMCOMBS + 0, bufcombR1, COMBTUNINGR1);
+      combs.setbuffer(1, bufcombL2, COMBTUNINGL2);
+      combs.setbuffer(NUMCOMBS + 1, bufcombR2, COMBTUNINGR2);
+      combs.setbuffer(2, bufcombL3, COMBTUNINGL3);
+      combs.setbuffer(NUMCOMBS + 2, bufcombR3, COMBTUNINGR3);
+      combs.setbuffer(3, bufcombL4, COMBTUNINGL4);
+      combs.setbuffer(NUMCOMBS + 3, bufcombR4, COMBTUNINGR4);
+      combs.setbuffer(4, bufcombL5, COMBTUNINGL5);
+      combs.setbuffer(NUMCOMBS + 4, bufcombR5, COMBTUNINGR5);
+      combs.setbuffer(5, bufcombL6, COMBTUNINGL6);
+      combs.setbuffer(NUMCOMBS + 5, bufcombR6, COMBTUNINGR6);
+      combs.setbuffer(6, bufcombL7, COMBTUNINGL7);
+      combs.setbuffer(NUMCOMBS + 6, bufcombR7, COMBTUNINGR7);
+      combs.setbuffer(7, bufcombL8, COMBTUNINGL8);
+      combs.setbuffer(NUMCOMBS + 7, bufcombR8, COMBTUNINGR8);
       allpassL[0].setbuffer(bufallpassL1, ALLPASSTUNINGL1);
       allpassR[0].setbuffer(bufallpassR1, ALLPASSTUNINGR1);
       allpassL[1].setbuffer(bufallpassL2, ALLPASSTUNINGL2);
@@ -475,11 +527,7 @@ public:
       if(getMode() >= FREEZEMODE)
          return;
 
-      for(int i = 0; i < NUMCOMBS; i++)
-      {
-         combL[i].mute();
-         combR[i].mute();
-      }
+      combs.mute();
       for(int i = 0; i < NUMALLPASSES; i++)
       {
          allpassL[i].mute();
@@ -495,12 +543,13 @@ public:
                        float *outputL, float *outputR,
                        int numsamples, int skip)
    {
-      double outL, outR, input;
+      float outL, outR, input;
+      const float fgain = (float)gain;
+      const float fwet1 = (float)wet1, fwet2 = (float)wet2, fdry = (float)dry;
 
       while(numsamples-- > 0)
       {
-         outL = outR = 0;
-         input = (*inputL + *inputR) * gain;
+         input = (*inputL + *inputR) * fgain;
 
          // pre-delay
          if(delay)
@@ -510,11 +559,7 @@ public:
          }
 
          // accumulate comb filters in parallel
-         for(int i = 0; i < NUMCOMBS; i++)
-         {
-            outL += combL[i].process(input);
-            outR += combR[i].process(input);
-         }
+         combs.process(input, outL, outR);
 
          // feed through allpasses in series
          for(int i = 0; i < NUMALLPASSES; i++)
@@ -531,8 +576,8 @@ public:
          }
 
          // calculate output replacing anything already there
-         *outputL = (float)(outL * wet1 + outR * wet2 + *inputL * dry);
-         *outputR = (float)(outR * wet1 + outL * wet2 + *inputR * dry);
+         *outputL = outL * fwet1 + outR * fwet2 + *inputL * fdry;
+         *outputR = outR * fwet1 + outL * fwet2 + *inputR * fdry;
 
          // increment sample pointers
          inputL  += skip;
@@ -546,12 +591,13 @@ public:
                    float *outputL, float *outputR,
                    int numsamples, int skip)
    {
-      double outL, outR, input;
+      float outL, outR, input;
+      const float fgain = (float)gain;
+      const float fwet1 = (float)wet1, fwet2 = (float)wet2, fdry = (float)dry;
 
       while(numsamples-- > 0)
       {
-         outL = outR = 0;
-         input = (*inputL + *inputR) * gain;
+         input = (*inputL + *inputR) * fgain;
 
          // pre-delay
          if(delay)
@@ -561,11 +607,7 @@ public:
          }
 
          // accumulate comb filters in parallel
-         for(int i = 0; i < NUMCOMBS; i++)
-         {
-            outL += combL[i].process(input);
-            outR += combR[i].process(input);
-         }
+         combs.process(input, outL, outR);
 
          // feed through allpasses in series
          for(int i = 0; i < NUMALLPASSES; i++)
@@ -582,8 +624,8 @@ public:
          }
 
          // calculate output mixing with anything already there
-         *outputL += (float)(outL * wet1 + outR * wet2 + *inputL * dry);
-         *outputR += (float)(outR * wet1 + outL * wet2 + *inputR * dry);
+         *outputL += outL * fwet1 + outR * fwet2 + *inputL * fdry;
+         *outputR += outR * fwet1 + outL * fwet2 + *inputR * fdry;
 
          // increment sample pointers
          inputL  += skip;
@@ -611,13 +653,8 @@ public:
          gain      = FIXEDGAIN;
       }
 
-      for(int i = 0; i < NUMCOMBS; i++)
-      {
-         combL[i].feedback = roomsize1;
-         combL[i].setdamp(damp1);
-         combR[i].feedback = roomsize1;
-         combR[i].setdamp(damp1);
-      }
+      combs.feedback = (float)roomsize1;
+      combs.setdamp((float)damp1);
 
       init_3band(eqparams, eql, eqr);
    }
@@ -40,6 +40,7 @@
 #include "i_sound.h"
 #include "i_system.h"
 #include "m_compare.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "m_queue.h"
 #include "p_chase.h"
@@ -922,6 +923,8 @@ static void S_updateEnvironment(sector_t *earsec)
 //
 void S_UpdateSounds(const Mobj *listener)
 {
+   PROFILE_ZONE("S_UpdateSounds");
+
    // sf: a camera_t holding the information about the player
    camera_t playercam = { 0 };
    sector_t *earsec = nullptr;
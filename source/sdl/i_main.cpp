@@ -93,9 +93,11 @@ int main(int argc, char **argv)
    // haleyjd 04/15/02: added check for failure
    // ioanch: avoid loading SDL_VIDEO if -nodraw and -nosound are combined.
    // FIXME: code duplication; the global booleans aren't assigned yet.
-   Uint32 initflags = (M_CheckParm("-nodraw") &&
-                       (M_CheckParm("-nosound") || (M_CheckParm("-nosfx") &&
-                                                    M_CheckParm("-nomusic")))) ?
+   // The bot benchmark and cache generator never open a window either.
+   Uint32 initflags = ((M_CheckParm("-nodraw") &&
+                        (M_CheckParm("-nosound") || (M_CheckParm("-nosfx") &&
+                                                     M_CheckParm("-nomusic")))) ||
+                       M_CheckParm("-botbench") || M_CheckParm("-botcache")) ?
    SDL_INIT_JOYSTICK : SDL_INIT_VIDEO | SDL_INIT_JOYSTICK;
    if(SDL_Init(initflags) == -1)
    {
@@ -0,0 +1,525 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2026 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Pre-rendering of libADLMIDI music. A registered song is rendered to PCM
+//    on a worker thread, and played from there once the render is ahead of
+//    the live synthesizer. Finished renders are kept in a size-limited disk
+//    cache.
+//
+//-----------------------------------------------------------------------------
+
+#ifdef HAVE_ADLMIDILIB
+
+#if __cplusplus >= 201703L || _MSC_VER >= 1914
+#include "../hal/i_platform.h"
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_MACOSX
+#include "../hal/i_directory.h"
+namespace fs = fsStopgap;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#ifdef __APPLE__
+#include "SDL2/SDL.h"
+#else
+#include "SDL.h"
+#endif
+
+#include "adlmidi.hpp"
+
+#include "../z_zone.h"
+#include "../doomstat.h"
+#include "../hal/i_directory.h"
+#include "../m_compare.h"
+#include "../m_hash.h"
+#include "../m_qstr.h"
+#include "i_midicache.h"
+
+extern int adlmidi_numchips;
+extern int adlmidi_bank;
+extern int adlmidi_emulator;
+extern SDL_AudioSpec audio_spec;
+
+bool snd_midicache     = true; // pre-render ADLMIDI songs
+int  snd_midicachesize = 256;  // disk cache limit in megabytes (0 = no disk cache)
+
+static const char     MIDICACHE_MAGIC[4] = { 'E', 'E', 'M', 'P' };
+static const uint32_t MIDICACHE_VERSION  = 1;
+static const char     MIDICACHE_EXT[]    = ".pcm";
+
+// Longest render kept in memory
+static const size_t MIDIRENDER_MAXBYTES = 512u << 20;
+
+// Frames rendered at once
+#define MIDIRENDER_CHUNK 4096
+
+// Seconds the render must be ahead before playback switches to it
+#define MIDIRENDER_LEAD 2
+
+// Room past the reported song length, in seconds
+#define MIDIRENDER_SLACK 5
+
+struct midicacheheader_t
+{
+   char     magic[4];
+   uint32_t version;
+   uint64_t size;      // PCM bytes following the header
+   int64_t  lastused;  // time()
+};
+
+//
+// A song being rendered. Shared by the main thread, the worker and the audio
+// callback, so it must stay off the zone heap.
+//
+struct midirender_t
+{
+   // set up by the main thread
+   std::vector<Uint8> data;      // the MIDI
+   std::string        path;      // disk cache file, or empty
+   int                freq;
+   int                chips;
+   int                bank;
+   int                emulator;
+   int                sampletype;
+   int                framesize;
+   size_t             loopstart; // loop markers in bytes, loopend 0 if none
+   size_t             loopend;
+
+   // written by the worker
+   std::vector<Uint8>  pcm;      // never reallocated once published
+   std::atomic<size_t> rendered { 0 };
+   std::atomic<bool>   complete { false }; // pcm holds the whole song
+   std::atomic<bool>   cancel   { false };
+   std::thread         thread;
+
+   // audio callback state
+   size_t playpos   = 0;          // song position in bytes, wrapped at the loop
+   bool   streaming = false;      // playing from pcm, else live
+
+   size_t bytesAt(double seconds) const
+   {
+      return static_cast<size_t>(seconds * freq) * framesize;
+   }
+};
+
+//=============================================================================
+//
+// Disk cache
+//
+
+//
+// I_midiCacheFolder
+//
+static bool I_midiCacheFolder(qstring &folder)
+{
+   if(!userpath)
+      return false;
+   folder = userpath;
+   folder.pathConcatenate("midicache");
+   I_CreateDirectory(folder);
+
+   const fs::directory_entry dir(folder.constPtr());
+   return dir.exists() && dir.is_directory();
+}
+
+//
+// I_midiCacheHousekeeping
+//
+// Deletes the least recently used renders while all of them take more than
+// snd_midicachesize megabytes. Only called while no render is running.
+//
+static void I_midiCacheHousekeeping(const qstring &folder)
+{
+   struct cachefile_t
+   {
+      std::string path;
+      uintmax_t   size;
+      int64_t     lastused;
+   };
+   std::vector<cachefile_t> files;
+   uintmax_t total = 0;
+
+   const fs::directory_iterator itr(fs::directory_entry(folder.constPtr()));
+   for(const fs::directory_entry &ent : itr)
+   {
+      if(ent.is_directory() || ent.path().extension().generic_u8string() != MIDICACHE_EXT)
+         continue;
+
+      cachefile_t file = { ent.path().generic_u8string(), (uintmax_t)ent.file_size(), 0 };
+      if(FILE *f = fopen(file.path.c_str(), "rb"))
+      {
+         midicacheheader_t header;
+         if(fread(&header, sizeof(header), 1, f) == 1)
+            file.lastused = header.lastused;
+         fclose(f);
+      }
+      total += file.size;
+      files.push_back(std::move(file));
+   }
+
+   const uintmax_t limit = (uintmax_t)snd_midicachesize << 20;
+   if(total <= limit)
+      return;
+
+   std::sort(files.begin(), files.end(),
+             [](const cachefile_t &a, const cachefile_t &b) {
+      return a.lastused < b.lastused;
+   });
+   for(const cachefile_t &file : files)
+   {
+      if(total <= limit)
+         break;
+      if(!remove(file.path.c_str()))
+         total -= file.size;
+   }
+}
+
+//
+// I_loadMidiCache
+//
+// Reads a finished render into pcm, and marks it as used. Returns its size, or
+// 0 if there's none.
+//
+static size_t I_loadMidiCache(midirender_t &render)
+{
+   FILE *f = fopen(render.path.c_str(), "r+b");
+   if(!f)
+      return 0;
+
+   midicacheheader_t header;
+   size_t size = 0;
+   if(fread(&header, sizeof(header), 1, f) == 1 &&
+      !memcmp(header.magic, MIDICACHE_MAGIC, sizeof(header.magic)) &&
+      header.version == MIDICACHE_VERSION && header.size &&
+      header.size <= render.pcm.size() &&
+      fread(render.pcm.data(), 1, (size_t)header.size, f) == header.size)
+   {
+      size = (size_t)header.size;
+      header.lastused = (int64_t)time(nullptr);
+      if(!fseek(f, 0, SEEK_SET))
+         fwrite(&header, sizeof(header), 1, f);
+   }
+   fclose(f);
+   return size;
+}
+
+//
+// I_saveMidiCache
+//
+static void I_saveMidiCache(const midirender_t &render, size_t size)
+{
+   std::string tmppath = render.path + ".tmp";
+   FILE *f = fopen(tmppath.c_str(), "wb");
+   if(!f)
+      return;
+
+   midicacheheader_t header = {};
+   memcpy(header.magic, MIDICACHE_MAGIC, sizeof(header.magic));
+   header.version  = MIDICACHE_VERSION;
+   header.size     = size;
+   header.lastused = (int64_t)time(nullptr);
+
+   bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(render.pcm.data(), 1, size, f) == size;
+   ok = !fclose(f) && ok;
+
+   if(ok)
+      ok = I_ReplaceFile(tmppath.c_str(), render.path.c_str());
+   if(!ok)
+      remove(tmppath.c_str());
+}
+
+//=============================================================================
+//
+// Rendering
+//
+
+//
+// I_midiRenderThread
+//
+// Fills pcm from the disk cache or with its own player. Stops early if
+// cancelled, or if the song turns out longer than the buffer.
+//
+static void I_midiRenderThread(midirender_t *render, size_t capacity)
+{
+   // Not zeroed on the main thread; the audio callback waits for rendered
+   try
+   {
+      render->pcm.resize(capacity);
+   }
+   catch(const std::bad_alloc &)
+   {
+      return;
+   }
+
+   if(!render->path.empty())
+   {
+      if(size_t size = I_loadMidiCache(*render))
+      {
+         render->rendered.store(size, std::memory_order_release);
+         render->complete.store(true, std::memory_order_release);
+         return;
+      }
+   }
+
+   ADL_MIDIPlayer *player = adl_init(render->freq);
+   if(!player)
+      return;
+   adl_setNumChips(player, render->chips);
+   adl_setBank(player, render->bank);
+   adl_switchEmulator(player, render->emulator);
+   adl_setNumFourOpsChn(player, -1);
+   adl_setLoopEnabled(player, 0);
+   if(adl_openData(player, render->data.data(), static_cast<unsigned long>(render->data.size())))
+   {
+      adl_close(player);
+      return;
+   }
+
+   const unsigned int container =
+      render->sampletype == ADLMIDI_SampleType_F32 ? sizeof(float) : sizeof(Sint16);
+   ADLMIDI_AudioFormat fmt =
+   {
+      static_cast<ADLMIDI_SampleType>(render->sampletype), container,
+      static_cast<unsigned int>(render->framesize)
+   };
+   const size_t chunk = MIDIRENDER_CHUNK * render->framesize;
+
+   size_t pos = 0;
+   bool   complete = false;
+   while(!render->cancel.load(std::memory_order_relaxed))
+   {
+      size_t want = emin(chunk, capacity - pos);
+      if(!want)
+         break; // longer than reported; playback goes live past this point
+
+      ADL_UInt8 *out = render->pcm.data() + pos;
+      int samples = static_cast<int>(want / render->framesize * 2);
+      size_t got = static_cast<size_t>(adl_playFormat(player, samples, out, out + container, &fmt)) *
+                   render->framesize / 2;
+
+      pos += got;
+      render->rendered.store(pos, std::memory_order_release);
+      if(got < want || adl_atEnd(player))
+      {
+         complete = pos > 0;
+         break;
+      }
+   }
+   adl_close(player);
+
+   if(complete)
+   {
+      render->complete.store(true, std::memory_order_release);
+      if(!render->path.empty())
+         I_saveMidiCache(*render, pos);
+   }
+}
+
+//
+// I_MidiRenderStart
+//
+// Starts rendering the song just opened by the live player, which is only
+// used for its timing here. Returns null if the song isn't pre-rendered.
+//
+midirender_t *I_MidiRenderStart(ADL_MIDIPlayer *player, const void *data, int size,
+                                int sampletype, int framesize)
+{
+   if(!snd_midicache || size <= 0 || framesize <= 0)
+      return nullptr;
+
+   const double length = adl_totalTimeLength(player);
+   if(length <= 0)
+      return nullptr;
+
+   auto render = new midirender_t;
+   render->data.assign(static_cast<const Uint8 *>(data), static_cast<const Uint8 *>(data) + size);
+   render->freq       = audio_spec.freq;
+   render->chips      = adlmidi_numchips;
+   render->bank       = adlmidi_bank;
+   render->emulator   = adlmidi_emulator;
+   render->sampletype = sampletype;
+   render->framesize  = framesize;
+
+   const size_t capacity = render->bytesAt(length + MIDIRENDER_SLACK);
+   if(capacity > MIDIRENDER_MAXBYTES)
+   {
+      delete render;
+      return nullptr;
+   }
+
+   // Songs with loop markers jump back within themselves
+   const double loopstart = adl_loopStartTime(player);
+   const double loopend   = adl_loopEndTime(player);
+   if(loopstart >= 0 && loopend > loopstart)
+   {
+      render->loopstart = render->bytesAt(loopstart);
+      render->loopend   = render->bytesAt(loopend);
+   }
+   else
+      render->loopstart = render->loopend = 0;
+
+   qstring folder;
+   if(snd_midicachesize > 0 && I_midiCacheFolder(folder))
+   {
+      I_midiCacheHousekeeping(folder);
+
+      // Name the render after everything that affects it
+      const int32_t settings[] =
+      {
+         (int32_t)MIDICACHE_VERSION, render->freq, render->chips, render->bank,
+         render->emulator, render->sampletype, render->framesize
+      };
+      HashData hash(HashData::SHA1, render->data.data(), (uint32_t)render->data.size(), false);
+      hash.addData(reinterpret_cast<const uint8_t *>(settings), sizeof(settings));
+      hash.wrapUp();
+
+      char *digest = hash.digestToString();
+      folder.pathConcatenate(digest);
+      folder << MIDICACHE_EXT;
+      efree(digest);
+      render->path = folder.constPtr();
+   }
+
+   render->thread = std::thread(I_midiRenderThread, render, capacity);
+   return render;
+}
+
+//
+// I_MidiRenderStop
+//
+void I_MidiRenderStop(midirender_t *render)
+{
+   if(!render)
+      return;
+   render->cancel.store(true, std::memory_order_relaxed);
+   if(render->thread.joinable())
+      render->thread.join();
+   delete render;
+}
+
+//
+// I_midiLoopEnd
+//
+// Where a looping song jumps back to loopstart while streaming. Without loop
+// markers the real end is only known once the render is complete; until then
+// the render is never wrapped, and the live player wraps in its place.
+//
+static size_t I_midiLoopEnd(const midirender_t &render, bool complete, size_t avail)
+{
+   if(render.loopend)
+      return render.loopend;
+   return complete ? avail : SIZE_MAX;
+}
+
+//
+// I_midiPlayLive
+//
+// Synthesizes len bytes with the live player, and keeps playpos where the
+// player is, loops included. Returns the bytes made.
+//
+static int I_midiPlayLive(midirender_t *render, ADL_MIDIPlayer *player,
+                          const ADLMIDI_AudioFormat &fmt, Uint8 *stream, int len)
+{
+   const int samples = (len * 2) / static_cast<int>(fmt.sampleOffset);
+   const int got = adl_playFormat(player, samples, stream, stream + fmt.containerSize, &fmt) *
+                   static_cast<int>(fmt.sampleOffset) / 2;
+   render->playpos = render->bytesAt(adl_positionTell(player));
+   return got;
+}
+
+//
+// I_MidiRenderPlay
+//
+// Called from the audio callback. Fills len bytes of the song, or as much as
+// is left of it, and returns how many. Plays from the render while it's far
+// enough ahead, otherwise synthesizes with the live player. If the render
+// falls behind, or stops short of the end, the live player is sought to the
+// same spot and takes over until the render is ahead again.
+//
+int I_MidiRenderPlay(midirender_t *render, ADL_MIDIPlayer *player,
+                     const ADLMIDI_AudioFormat &fmt, Uint8 *stream, int len, bool looping)
+{
+   const size_t avail    = render->rendered.load(std::memory_order_acquire);
+   const bool   complete = render->complete.load(std::memory_order_acquire);
+   const size_t loopend  = I_midiLoopEnd(*render, complete, avail);
+   // The worker sizes pcm before publishing anything, so only look at it once
+   // some of it is there. Without any, nothing is copied from it below.
+   const Uint8 *pcm      = avail ? render->pcm.data() : nullptr;
+
+   int done = 0;
+   while(done < len)
+   {
+      if(!render->streaming)
+      {
+         if(!complete &&
+            render->playpos + (len - done) + render->bytesAt(MIDIRENDER_LEAD) > avail)
+         {
+            done += I_midiPlayLive(render, player, fmt, stream + done, len - done);
+            break;
+         }
+         render->streaming = true;
+      }
+
+      if(looping && render->playpos >= loopend)
+      {
+         if(render->loopstart >= loopend)
+            break;
+         render->playpos = render->loopstart;
+      }
+
+      size_t end = emin(loopend, avail);
+      if(render->playpos >= end)
+      {
+         if(complete)
+            break; // the song is over
+
+         // the render fell behind or gave up; pick up live from here
+         render->streaming = false;
+         adl_positionSeek(player,
+                          static_cast<double>(render->playpos / render->framesize) /
+                          render->freq);
+         continue;
+      }
+
+      size_t count = emin(static_cast<size_t>(len - done), end - render->playpos);
+      memcpy(stream + done, pcm + render->playpos, count);
+      render->playpos += count;
+      done += static_cast<int>(count);
+   }
+   return done;
+}
+
+#endif
+
+// EOF
+
@@ -0,0 +1,53 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 2026 James Haley et al.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Pre-rendering of libADLMIDI music. A registered song is rendered to PCM
+//    on a worker thread, and played from there whenever the render is ahead
+//    of the live synthesizer. Finished renders are kept in a size-limited
+//    disk cache.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef I_MIDICACHE_H__
+#define I_MIDICACHE_H__
+
+#ifdef HAVE_ADLMIDILIB
+
+struct ADL_MIDIPlayer;
+struct ADLMIDI_AudioFormat;
+struct midirender_t;
+
+extern bool snd_midicache;
+extern int  snd_midicachesize;
+
+midirender_t *I_MidiRenderStart(ADL_MIDIPlayer *player, const void *data, int size,
+                                int sampletype, int framesize);
+void I_MidiRenderStop(midirender_t *render);
+
+int  I_MidiRenderPlay(midirender_t *render, ADL_MIDIPlayer *player,
+                      const ADLMIDI_AudioFormat &fmt, Uint8 *stream, int len, bool looping);
+
+#endif
+
+#endif
+
+// EOF
+
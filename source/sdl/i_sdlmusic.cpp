@@ -36,6 +36,7 @@
 #include "SDL_mixer.h"
 #endif
 
+#include "i_midicache.h"
 #include "i_midirpc.h"
 
 #include "../z_zone.h"
@@ -181,6 +182,10 @@ static void I_effectSPC(void *udata, Uint8 *stream, int len)
 static ADL_MIDIPlayer *adlmidi_player = nullptr;
 volatile bool adlplaying = false;
 
+// ioanch: background render of the song, and whether it loops
+static midirender_t *adlmidi_render = nullptr;
+static bool adlmidi_looping;
+
 int midi_device      = 0;
 int adlmidi_numchips = 2;
 int adlmidi_bank     = 72;
@@ -222,10 +227,20 @@ static void I_effectADLMIDI(void *udata, Uint8 *stream, int len)
       lastadlmidisamples = numsamples;
    }
 
-   ADL_UInt8 *const l_out = reinterpret_cast<ADL_UInt8 *>(adlmidi_buffer);
-   ADL_UInt8 *const r_out = reinterpret_cast<ADL_UInt8 *>(adlmidi_buffer + 1);
-   const int gotlen = adl_playFormat(adlmidi_player, numsamples, l_out, r_out, &fmt) *
-                      fmt.sampleOffset / 2;
+   // Play the pre-rendered song where it's far enough, else synthesize it now
+   int gotlen;
+   if(adlmidi_render)
+   {
+      gotlen = I_MidiRenderPlay(adlmidi_render, adlmidi_player, fmt,
+                                reinterpret_cast<Uint8 *>(adlmidi_buffer), len, adlmidi_looping);
+   }
+   else
+   {
+      ADL_UInt8 *const l_out = reinterpret_cast<ADL_UInt8 *>(adlmidi_buffer);
+      ADL_UInt8 *const r_out = reinterpret_cast<ADL_UInt8 *>(adlmidi_buffer + 1);
+      gotlen = adl_playFormat(adlmidi_player, numsamples, l_out, r_out, &fmt) *
+               fmt.sampleOffset / 2;
+   }
    if(snd_MusicVolume == 15)
       memcpy(stream, reinterpret_cast<Uint8 *>(adlmidi_buffer), size_t(gotlen));
    else
@@ -378,6 +393,7 @@ static void I_SDLPlaySong(int handle, int looping)
 #ifdef HAVE_ADLMIDILIB
       if(adlmidi_player)
       {
+         adlmidi_looping = !!looping;
          Mix_HookMusic(float_samples ? I_effectADLMIDI<float> : I_effectADLMIDI<Sint16>, nullptr);
          adl_setLoopEnabled(adlmidi_player, looping);
       }
@@ -521,6 +537,8 @@ static void I_SDLUnRegisterSong(int handle)
    if(adlmidi_player)
    {
       Mix_HookMusic(nullptr, nullptr);
+      I_MidiRenderStop(adlmidi_render);
+      adlmidi_render = nullptr;
       adl_close(adlmidi_player);
       adlmidi_player = nullptr;
    }
@@ -705,7 +723,15 @@ static int I_SDLRegisterSong(void *data, int size)
       adl_switchEmulator(adlmidi_player, adlmidi_emulator);
       adl_setNumFourOpsChn(adlmidi_player, -1);
       if(adl_openData(adlmidi_player, data, static_cast<unsigned long>(size)) == 0)
+      {
+         const int channels = audio_spec.channels;
+         adlmidi_render = float_samples ?
+            I_MidiRenderStart(adlmidi_player, data, size, ADLMIDI_SampleType_F32,
+                              int(sizeof(float) * channels)) :
+            I_MidiRenderStart(adlmidi_player, data, size, ADLMIDI_SampleType_S16,
+                              int(sizeof(Sint16) * channels));
          return 1;
+      }
       // Opening data went wrong
       adl_close(adlmidi_player);
       adlmidi_player = nullptr;
@@ -40,6 +40,7 @@
 #include "../i_system.h"
 #include "../m_argv.h"
 #include "../m_compare.h"
+#include "../m_swap.h"
 #include "../mn_engin.h"
 #include "../s_reverb.h"
 #include "../s_formats.h"
@@ -47,6 +48,15 @@
 #include "../v_misc.h"
 #include "../w_wad.h"
 
+#if defined(__AVX2__)
+#define I_SDLSOUND_AVX2
+#define I_SDLSOUND_SSE2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define I_SDLSOUND_SSE2
+#include <emmintrin.h>
+#endif
+
 extern bool snd_init;
 
 // Needed for calling the actual sound output.
@@ -232,37 +242,37 @@ static void updateSoundParams(int handle, int volume, int separation, int pitch)
 // Three-Band Equalization
 //
 
-static double preampmul;
+static float preampmul;
 
 struct EQSTATE
 {
   // Filter #1 (Low band)
 
-  double  lf;       // Frequency
-  double  f1p0;     // Poles ...
-  double  f1p1;    
-  double  f1p2;
-  double  f1p3;
+  float   lf;       // Frequency
+  float   f1p0;     // Poles ...
+  float   f1p1;    
+  float   f1p2;
+  float   f1p3;
 
   // Filter #2 (High band)
 
-  double  hf;       // Frequency
-  double  f2p0;     // Poles ...
-  double  f2p1;
-  double  f2p2;
-  double  f2p3;
+  float   hf;       // Frequency
+  float   f2p0;     // Poles ...
+  float   f2p1;
+  float   f2p2;
+  float   f2p3;
 
   // Sample history buffer
 
-  double  sdm1;     // Sample data minus 1
-  double  sdm2;     //                   2
-  double  sdm3;     //                   3
+  float   sdm1;     // Sample data minus 1
+  float   sdm2;     //                   2
+  float   sdm3;     //                   3
 
   // Gain Controls
 
-  double  lg;       // low  gain
-  double  mg;       // mid  gain
-  double  hg;       // high gain
+  float   lg;       // low  gain
+  float   mg;       // mid  gain
+  float   hg;       // high gain
   
 };  
 
@@ -284,7 +294,7 @@ static EQSTATE eqstate[2];
 // The first two derivatives of the function vanish at -3 and 3, so the 
 // transition to the hard clipped region is C2-continuous.
 //
-static double rational_tanh(double x)
+static float rational_tanh(float x)
 {
    if(x < -3)
       return -1;
@@ -318,9 +328,9 @@ static void do_3band(float *stream, float *end, T *dest)
 
    // haleyjd: This "very small addend" is supposed to take care of P4
    // denormalization problems. Do we actually need it?
-   static double vsa = (1.0 / 4294967295.0);
+   static const float vsa = (1.0f / 4294967295.0f);
    // Locals
-   double sample, l, m, h;    // Low / Mid / High - Sample Values
+   float sample, l, m, h;    // Low / Mid / High - Sample Values
 
    while(stream != end)
    {
@@ -362,15 +372,106 @@ static void do_3band(float *stream, float *end, T *dest)
       // Return result
       // haleyjd: use rational_tanh for soft clipping
       if constexpr(std::is_same_v<T, Sint16>)
-         *dest = static_cast<Sint16>(rational_tanh(l + m + h) * 32767.0);
+         *dest = static_cast<Sint16>(rational_tanh(l + m + h) * 32767.0f);
       else if constexpr(std::is_same_v<T, float>)
-         *dest = static_cast<float>(rational_tanh(l + m + h));
+         *dest = rational_tanh(l + m + h);
       static_assert(std::is_same_v<T, Sint16> || std::is_same_v<T, float>,
                     "do_3band called with incompatible template parameter");
       dest++;
    }
 }
 
+#ifdef I_SDLSOUND_SSE2
+//
+// do_3band_sse2
+//
+// ioanch: same as do_3band for a stereo stream, with both equalizers run side
+// by side in the low two lanes. The operations match the scalar version one
+// for one, so the output is the same.
+//
+template<typename T>
+static void do_3band_sse2(float *stream, float *end, T *dest)
+{
+   EQSTATE &el = eqstate[0];
+   EQSTATE &er = eqstate[1];
+
+   const __m128 vsa  = _mm_set1_ps(1.0f / 4294967295.0f);
+   const __m128 pre  = _mm_set1_ps(preampmul);
+   const __m128 lf   = _mm_setr_ps(el.lf, er.lf, 0, 0);
+   const __m128 hf   = _mm_setr_ps(el.hf, er.hf, 0, 0);
+   const __m128 lg   = _mm_setr_ps(el.lg, er.lg, 0, 0);
+   const __m128 mg   = _mm_setr_ps(el.mg, er.mg, 0, 0);
+   const __m128 hg   = _mm_setr_ps(el.hg, er.hg, 0, 0);
+   const __m128 clip = _mm_set1_ps(3.0f);
+   const __m128 c27  = _mm_set1_ps(27.0f);
+   const __m128 c9   = _mm_set1_ps(9.0f);
+
+   __m128 f1p0 = _mm_setr_ps(el.f1p0, er.f1p0, 0, 0);
+   __m128 f1p1 = _mm_setr_ps(el.f1p1, er.f1p1, 0, 0);
+   __m128 f1p2 = _mm_setr_ps(el.f1p2, er.f1p2, 0, 0);
+   __m128 f1p3 = _mm_setr_ps(el.f1p3, er.f1p3, 0, 0);
+   __m128 f2p0 = _mm_setr_ps(el.f2p0, er.f2p0, 0, 0);
+   __m128 f2p1 = _mm_setr_ps(el.f2p1, er.f2p1, 0, 0);
+   __m128 f2p2 = _mm_setr_ps(el.f2p2, er.f2p2, 0, 0);
+   __m128 f2p3 = _mm_setr_ps(el.f2p3, er.f2p3, 0, 0);
+   __m128 sdm1 = _mm_setr_ps(el.sdm1, er.sdm1, 0, 0);
+   __m128 sdm2 = _mm_setr_ps(el.sdm2, er.sdm2, 0, 0);
+   __m128 sdm3 = _mm_setr_ps(el.sdm3, er.sdm3, 0, 0);
+
+   for(; stream != end; stream += 2, dest += 2)
+   {
+      __m128 sample = _mm_mul_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(stream))), pre);
+
+      f1p0 = _mm_add_ps(f1p0, _mm_add_ps(_mm_mul_ps(lf, _mm_sub_ps(sample, f1p0)), vsa));
+      f1p1 = _mm_add_ps(f1p1, _mm_mul_ps(lf, _mm_sub_ps(f1p0, f1p1)));
+      f1p2 = _mm_add_ps(f1p2, _mm_mul_ps(lf, _mm_sub_ps(f1p1, f1p2)));
+      f1p3 = _mm_add_ps(f1p3, _mm_mul_ps(lf, _mm_sub_ps(f1p2, f1p3)));
+
+      f2p0 = _mm_add_ps(f2p0, _mm_add_ps(_mm_mul_ps(hf, _mm_sub_ps(sample, f2p0)), vsa));
+      f2p1 = _mm_add_ps(f2p1, _mm_mul_ps(hf, _mm_sub_ps(f2p0, f2p1)));
+      f2p2 = _mm_add_ps(f2p2, _mm_mul_ps(hf, _mm_sub_ps(f2p1, f2p2)));
+      f2p3 = _mm_add_ps(f2p3, _mm_mul_ps(hf, _mm_sub_ps(f2p2, f2p3)));
+
+      __m128 l = f1p3;
+      __m128 h = _mm_sub_ps(sdm3, f2p3);
+      __m128 m = _mm_sub_ps(sdm3, _mm_add_ps(h, l));
+
+      l = _mm_mul_ps(l, lg);
+      m = _mm_mul_ps(m, mg);
+      h = _mm_mul_ps(h, hg);
+
+      sdm3 = sdm2;
+      sdm2 = sdm1;
+      sdm1 = sample;
+
+      // rational_tanh, with the input clamped instead of the output: it's
+      // exactly 1 at 3.
+      __m128 x  = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(l, m), h),
+                                        _mm_sub_ps(_mm_setzero_ps(), clip)), clip);
+      __m128 x2 = _mm_mul_ps(x, x);
+      __m128 y  = _mm_div_ps(_mm_mul_ps(x, _mm_add_ps(c27, x2)),
+                             _mm_add_ps(c27, _mm_mul_ps(_mm_mul_ps(c9, x), x)));
+
+      if constexpr(std::is_same_v<T, Sint16>)
+      {
+         __m128i v = _mm_cvttps_epi32(_mm_mul_ps(y, _mm_set1_ps(32767.0f)));
+         int packed = _mm_cvtsi128_si32(_mm_packs_epi32(v, v));
+         memcpy(dest, &packed, 2 * sizeof(Sint16));
+      }
+      else if constexpr(std::is_same_v<T, float>)
+         _mm_storel_pi(reinterpret_cast<__m64 *>(dest), y);
+   }
+
+   alignas(16) float lanes[4];
+#define STORE(field) \
+   _mm_store_ps(lanes, field); el.field = lanes[0]; er.field = lanes[1]
+   STORE(f1p0); STORE(f1p1); STORE(f1p2); STORE(f1p3);
+   STORE(f2p0); STORE(f2p1); STORE(f2p2); STORE(f2p3);
+   STORE(sdm1); STORE(sdm2); STORE(sdm3);
+#undef STORE
+}
+#endif
+
 //
 // End Equalizer Code
 //
@@ -436,11 +537,94 @@ static void inline I_SDLConvertSoundBuffer(Uint8 *stream, int len)
 static inline void I_SDLMixBuffers()
 {
    float *bptr = mixbuffer[0];
+   float *rptr = mixbuffer[1];
    float *end  = bptr + mixbuffer_size;
    while(bptr != end)
    {
-      *bptr = *bptr + *(bptr + mixbuffer_size);
+      *bptr = *bptr + *rptr;
       ++bptr;
+      ++rptr;
+   }
+}
+
+//
+// I_SDLMixFrames
+//
+// Adds a run of frames from a channel to an interleaved mix buffer, advancing
+// the sample pointer and the 0.16 remainder. The caller makes sure the sound
+// doesn't end within the run. Sample i of the run is read from
+// src[(frac + i * chanstep) >> 16], like the stepping in the old loop.
+//
+static void I_SDLMixFrames(float *out, float *&src, unsigned int &frac,
+                           unsigned int chanstep, int frames,
+                           float leftvol, float rightvol)
+{
+   int i = 0;
+
+#ifdef I_SDLSOUND_SSE2
+   if(step == 2)
+   {
+      const __m128 vol = _mm_setr_ps(leftvol, rightvol, leftvol, rightvol);
+
+      if(chanstep == FPFRACUNIT)
+      {
+         // Unpitched sounds are read straight through
+         for(; i + 4 <= frames; i += 4, src += 4, out += 8)
+         {
+            __m128 s  = _mm_loadu_ps(src);
+            __m128 lo = _mm_mul_ps(_mm_unpacklo_ps(s, s), vol);
+            __m128 hi = _mm_mul_ps(_mm_unpackhi_ps(s, s), vol);
+            _mm_storeu_ps(out,     _mm_add_ps(_mm_loadu_ps(out),     lo));
+            _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), hi));
+         }
+      }
+      else
+      {
+#ifdef I_SDLSOUND_AVX2
+         const __m256 vol8  = _mm256_setr_ps(leftvol, rightvol, leftvol, rightvol,
+                                             leftvol, rightvol, leftvol, rightvol);
+         const __m128i lane = _mm_setr_epi32(0, int(chanstep), int(2 * chanstep),
+                                             int(3 * chanstep));
+         for(; i + 4 <= frames; i += 4, out += 8)
+         {
+            __m128i idx = _mm_srli_epi32(_mm_add_epi32(_mm_set1_epi32(int(frac)), lane), 16);
+            __m128  s   = _mm_i32gather_ps(src, idx, 4);
+            __m256  v   = _mm256_set_m128(_mm_unpackhi_ps(s, s), _mm_unpacklo_ps(s, s));
+            _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out), _mm256_mul_ps(v, vol8)));
+
+            frac += 4 * chanstep;
+            src  += frac >> 16;
+            frac &= 0xffff;
+         }
+#else
+         for(; i + 2 <= frames; i += 2, out += 4)
+         {
+            float s0 = *src;
+            frac += chanstep;
+            src  += frac >> 16;
+            frac &= 0xffff;
+            float s1 = *src;
+            frac += chanstep;
+            src  += frac >> 16;
+            frac &= 0xffff;
+
+            __m128 v = _mm_mul_ps(_mm_setr_ps(s0, s0, s1, s1), vol);
+            _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), v));
+         }
+#endif
+      }
+   }
+#endif
+
+   for(; i < frames; ++i, out += step)
+   {
+      float sample = *src;
+      *(out + 0) = *(out + 0) + sample * leftvol;
+      *(out + 1) = *(out + 1) + sample * rightvol;
+
+      frac += chanstep;
+      src  += frac >> 16;
+      frac &= 0xffff;
    }
 }
 
@@ -459,11 +643,9 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
    // convert input samples to floating point
    I_SDLConvertSoundBuffer<T>(stream, len);
 
-   float *leftout;
    // Pointer to end of mixbuffer
    float *leftend0 = mixbuffer[0] + (len/sample_size);
-   float *leftend1 = mixbuffer[1] + (len/sample_size);
-   float *leftend;
+   const int numframes = len / sample_size / step;
 
    // Mix audio channels
    for(channel_info_t *chan = channelinfo; chan != &channelinfo[numChannels]; chan++)
@@ -478,16 +660,7 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
          continue;
 
       // Left and right channel are in audio stream, alternating.
-      if(chan->reverb)
-      {
-         leftout  = mixbuffer[1];
-         leftend  = leftend1;
-      }
-      else
-      {
-         leftout = mixbuffer[0];
-         leftend = leftend0;
-      }
+      float *leftout = chan->reverb ? mixbuffer[1] : mixbuffer[0];
 
       // Lost before semaphore acquired? (very unlikely, but must check for 
       // safety). BTW, don't move this up or you'll chew major CPU whenever this
@@ -498,26 +671,28 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
          continue;
       }
 
-      while(leftout != leftend)
+      // The main thread may change these meanwhile
+      const unsigned int chanstep = chan->step;
+      const float leftvol  = chan->leftvol;
+      const float rightvol = chan->rightvol;
+
+      // ioanch: mix in runs which end either with the buffer or the sound, so
+      // the inner loop doesn't need to check for the end.
+      int frames = numframes;
+      while(frames > 0)
       {
-         float sample  = *(chan->data);         
-         *(leftout + 0) = *(leftout + 0) + sample * chan->leftvol;
-         *(leftout + 1) = *(leftout + 1) + sample * chan->rightvol;
-         
-         // Increment current pointers in stream
-         leftout += step;
-         
-         // Increment index
-         chan->stepremainder += chan->step;
-         
-         // MSB is next sample
-         chan->data += chan->stepremainder >> 16;
-         
-         // Limit to LSB
-         chan->stepremainder &= 0xffff;
-         
+         int64_t need = (static_cast<int64_t>(chan->enddata - chan->data) << 16) -
+                        chan->stepremainder;
+         int64_t toend = need <= 0 ? 1 : (need + chanstep - 1) / chanstep;
+         int count = toend < frames ? static_cast<int>(toend) : frames;
+
+         I_SDLMixFrames(leftout, chan->data, chan->stepremainder, chanstep, count,
+                        leftvol, rightvol);
+         leftout += count * step;
+         frames  -= count;
+
          // Check whether we are done
-         if(chan->data >= chan->enddata)
+         if(count == toend)
          {
             if(chan->loop && !paused && 
                ((!menuactive && !consoleactive) || demoplayback || netgame))
@@ -547,6 +722,13 @@ static void I_SDLUpdateSoundCB(void *userdata, Uint8 *stream, int len)
    I_SDLMixBuffers();
 
    // haleyjd 04/21/10: equalization output pass
+#ifdef I_SDLSOUND_SSE2
+   if(step == 2)
+   {
+      do_3band_sse2(mixbuffer[0], leftend0, reinterpret_cast<T *>(stream));
+      return;
+   }
+#endif
    do_3band(mixbuffer[0], leftend0, reinterpret_cast<T *>(stream));
 }
 
@@ -607,6 +789,135 @@ static void I_SetChannels()
    preampmul = s_eqpreamp;
 }
 
+//=============================================================================
+//
+// Offline Rendering
+//
+// With -wavrender, no audio device is opened. Instead the mixer runs once per
+// game tic on the main thread, and its output is written to a WAV file. Music
+// isn't included. The sample rate usually isn't a multiple of TICRATE, so
+// some tics get one frame more than WAVTICFRAMES to keep up with the game.
+//
+
+#define WAVTICFRAMES (snd_samplerate / TICRATE)
+
+static FILE   *wavfile;
+static Sint16 *wavbuffer;
+static int     wavtic;     // game tics rendered so far
+static int     wavfrac;    // frames owed, in 1/TICRATE units
+static Uint32  wavbytes;   // sample data written
+static Uint64  wavcounter; // time spent mixing
+
+//
+// I_SDLWriteWavHeader
+//
+static void I_SDLWriteWavHeader(Uint32 databytes)
+{
+   const Uint32 blockalign = 2 * sizeof(Sint16);
+   const Uint32 fields[] =
+   {
+      36 + databytes,               // RIFF size
+      16,                           // fmt size
+      1 | 2 << 16,                  // PCM, stereo
+      snd_samplerate,
+      snd_samplerate * blockalign,  // bytes per second
+      blockalign | 16 << 16,        // block align, bits per sample
+      databytes,
+   };
+   Uint8 header[44];
+
+   memcpy(header, "RIFF", 4);
+   memcpy(header + 8, "WAVEfmt ", 8);
+   memcpy(header + 36, "data", 4);
+   const int offsets[] = { 4, 16, 20, 24, 28, 32, 40 };
+   for(size_t i = 0; i < earrlen(fields); ++i)
+   {
+      for(int b = 0; b < 4; ++b)
+         header[offsets[i] + b] = static_cast<Uint8>(fields[i] >> (8 * b));
+   }
+
+   fseek(wavfile, 0, SEEK_SET);
+   fwrite(header, 1, sizeof(header), wavfile);
+   fseek(wavfile, 0, SEEK_END);
+}
+
+//
+// I_SDLRenderTics
+//
+// Mixes the sound of all game tics up to the current one. Called before any
+// channel changes, so sounds start on the tic they were started in.
+//
+static void I_SDLRenderTics()
+{
+   if(!wavfile || wavtic >= gametic)
+      return;
+
+   Uint64 start = SDL_GetPerformanceCounter();
+   for(; wavtic < gametic; ++wavtic)
+   {
+      int frames = WAVTICFRAMES;
+      wavfrac += snd_samplerate % TICRATE;
+      if(wavfrac >= TICRATE)
+      {
+         wavfrac -= TICRATE;
+         ++frames;
+      }
+      const int len = frames * 2 * sizeof(Sint16);
+      mixbuffer_size = frames * step;
+
+      memset(wavbuffer, 0, len);
+      I_SDLUpdateSoundCB<Sint16>(nullptr, reinterpret_cast<Uint8 *>(wavbuffer), len);
+      for(int i = 0; i < frames * 2; ++i)
+         wavbuffer[i] = SwapShort(wavbuffer[i]);
+      fwrite(wavbuffer, 1, len, wavfile);
+      wavbytes += len;
+   }
+   wavcounter += SDL_GetPerformanceCounter() - start;
+}
+
+//
+// I_SDLInitWavRender
+//
+static bool I_SDLInitWavRender(const char *filename)
+{
+   if(!(wavfile = fopen(filename, "wb")))
+   {
+      printf("Couldn't open %s for sound rendering.\n", filename);
+      return false;
+   }
+   I_SDLWriteWavHeader(0);
+
+   sample_size   = sizeof(Sint16);
+   float_samples = false;
+   step          = 2;
+
+   // room for the longest tic; I_SDLRenderTics sets the size of each one
+   mixbuffer_size = (WAVTICFRAMES + 1) * step;
+   wavbuffer = emalloc(Sint16 *, mixbuffer_size * sizeof(Sint16));
+   wavtic = gametic;
+   wavfrac = 0;
+
+   // music goes through SDL_mixer, which has no device to play on
+   nomusicparm = true;
+
+   printf("Rendering sound to %s.\n", filename);
+   return true;
+}
+
+//
+// I_SDLFinishWavRender
+//
+static void I_SDLFinishWavRender()
+{
+   I_SDLRenderTics();
+   I_SDLWriteWavHeader(wavbytes);
+   fclose(wavfile);
+   wavfile = nullptr;
+
+   printf("Rendered %d tics of sound, mixing took %.1f ms.\n", wavtic,
+          wavcounter * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
 //=============================================================================
 // 
 // Driver Routines
@@ -643,6 +954,7 @@ static void I_SDLUpdateEQParams()
 //
 static void I_SDLUpdateSoundParams(int handle, int vol, int sep, int pitch)
 {
+   I_SDLRenderTics();
    updateSoundParams(handle, vol, sep, pitch);
 }
 
@@ -655,6 +967,8 @@ static int I_SDLStartSound(sfxinfo_t *sound, int cnum, int vol, int sep,
    static unsigned int id = 1;
    int handle;
 
+   I_SDLRenderTics();
+
    // haleyjd 06/03/06: look for an unused hardware channel
    for(handle = 0; handle < numChannels; handle++)
    {
@@ -691,6 +1005,8 @@ static void I_SDLStopSound(int handle, int id)
       I_Error("I_SDLStopSound: handle out of range\n");
 #endif
    
+   I_SDLRenderTics();
+
    if(channelinfo[handle].idnum == static_cast<unsigned int>(id))
       channelinfo[handle].shouldstop = true;
 }
@@ -741,6 +1057,8 @@ static void I_SDLUpdateSound()
    // 10/30/10: Moved channel stopping logic to I_StartSound to avoid problems
    // with thread contention when running with d_fastrefresh enabled. Calling
    // this from the main loop too often caused the sound to stutter.
+
+   I_SDLRenderTics();
 }
 
 //
@@ -758,7 +1076,10 @@ static void I_SDLSubmitSound()
 //
 static void I_SDLShutdownSound()
 {
-   Mix_CloseAudio();
+   if(wavfile)
+      I_SDLFinishWavRender();
+   else
+      Mix_CloseAudio();
 }
 
 //
@@ -801,6 +1122,19 @@ bool I_GenSDLAudioSpec(int samplerate, SDL_AudioFormat fmt, int channels, int sa
 //
 static int I_SDLInitSound()
 {
+   int p;
+
+   if((p = M_CheckParm("-wavrender")) && p < myargc - 1)
+   {
+      if(!I_SDLInitWavRender(myargv[p + 1]))
+      {
+         nosfxparm = true;
+         return 0;
+      }
+      I_SetChannels();
+      return 1;
+   }
+
    // haleyjd: the docs say we should do this
    if(SDL_InitSubSystem(SDL_INIT_AUDIO))
    {
@@ -413,11 +413,15 @@ extern int midi_device;
 extern int adlmidi_numchips;
 extern int adlmidi_bank;
 extern int adlmidi_emulator;
+extern bool snd_midicache;
+extern int snd_midicachesize;
 
 VARIABLE_INT(midi_device, nullptr, -1, 0, mididevicestr);
 VARIABLE_INT(adlmidi_numchips, nullptr, 1, 8, nullptr);
 VARIABLE_INT(adlmidi_bank, nullptr, 0, BANKS_MAX, adlbankstr);
 VARIABLE_INT(adlmidi_emulator, nullptr, 0, ADLMIDI_EMU_end - 1, adlemustr);
+VARIABLE_TOGGLE(snd_midicache, nullptr, onoff);
+VARIABLE_INT(snd_midicachesize, nullptr, 0, 1 << 20, nullptr);
 #endif
 
 // Equalizer variables
@@ -463,6 +467,8 @@ CONSOLE_VARIABLE(snd_mididevice, midi_device, 0) {}
 CONSOLE_VARIABLE(snd_numchips, adlmidi_numchips, 0) {}
 CONSOLE_VARIABLE(snd_bank, adlmidi_bank, 0) {}
 CONSOLE_VARIABLE(snd_oplemulator, adlmidi_emulator, 0) {}
+CONSOLE_VARIABLE(snd_midicache, snd_midicache, 0) {}
+CONSOLE_VARIABLE(snd_midicachesize, snd_midicachesize, 0) {}
 #endif
 #endif
 
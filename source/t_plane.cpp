@@ -25,6 +25,8 @@
 
 #include "z_zone.h"
 
+#include "autodoom/b_botmap.h"
+#include "cam_sight.h"
 #include "doomstat.h"
 #include "p_map.h"
 #include "p_portal.h"
@@ -53,6 +55,51 @@
 // none of its code between cases, called T_MovePlane.
 //
 
+//
+// P_SectorHeightsChanged
+//
+// Called by the playsim after it moved a floor or ceiling of a real sector.
+// Never call it for the renderer's temporary sectors.
+//
+void P_SectorHeightsChanged(const sector_t &sector, fixed_t oldfloor,
+                            fixed_t oldceiling)
+{
+   if(sector.srf.floor.height == oldfloor && sector.srf.ceiling.height == oldceiling)
+      return;
+   if(&sector < sectors || &sector >= sectors + numsectors)
+      return;
+
+   CAM_InvalidateSightCache();
+
+   // IOANCH: moving planes may change bot path passability
+   if(botMap)
+      botMap->sectorMoved(sector, oldfloor, oldceiling);
+}
+
+//
+// PlaneMoveWatch
+//
+// Reports the sector once a T_Move function is done with it, whichever way it
+// returns. Moves which got undone because of crushing aren't reported.
+//
+class PlaneMoveWatch
+{
+public:
+   explicit PlaneMoveWatch(const sector_t *sector) : m_sector(*sector),
+      m_floor(sector->srf.floor.height), m_ceiling(sector->srf.ceiling.height)
+   {
+   }
+   ~PlaneMoveWatch()
+   {
+      P_SectorHeightsChanged(m_sector, m_floor, m_ceiling);
+   }
+
+private:
+   const sector_t &m_sector;
+   const fixed_t   m_floor;
+   const fixed_t   m_ceiling;
+};
+
 //
 // T_MoveFloorDown
 //
@@ -60,6 +107,8 @@
 //
 result_e T_MoveFloorDown(sector_t *sector, fixed_t speed, fixed_t dest, int crush)
 {
+   PlaneMoveWatch watch(sector);
+
    fixed_t lastpos;     
 
    bool flag;
@@ -168,6 +217,8 @@ result_e T_MoveFloorDown(sector_t *sector, fixed_t speed, fixed_t dest, int crus
 result_e T_MoveFloorUp(sector_t *sector, fixed_t speed, fixed_t dest, int crush,
                        bool emulateStairCrush)
 {
+   PlaneMoveWatch watch(sector);
+
    fixed_t destheight;
    fixed_t lastpos;
 
@@ -284,6 +335,8 @@ result_e T_MoveFloorUp(sector_t *sector, fixed_t speed, fixed_t dest, int crush,
 result_e T_MoveCeilingDown(sector_t *sector, fixed_t speed, fixed_t dest,
                            int crush, bool crushrest)
 {
+   PlaneMoveWatch watch(sector);
+
    fixed_t destheight;
    fixed_t lastpos;
 
@@ -402,6 +455,8 @@ result_e T_MoveCeilingDown(sector_t *sector, fixed_t speed, fixed_t dest,
 //
 result_e T_MoveCeilingUp(sector_t *sector, fixed_t speed, fixed_t dest, int crush)
 {
+   PlaneMoveWatch watch(sector);
+
    fixed_t lastpos;
 
    bool flag;
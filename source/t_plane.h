@@ -52,6 +52,9 @@ result_e T_MoveFloorInDirection(sector_t *sector, fixed_t speed, fixed_t dest,
 result_e T_MoveCeilingInDirection(sector_t *sector, fixed_t speed, fixed_t dest, 
                                   int crush, int direction);
 
+void P_SectorHeightsChanged(const sector_t &sector, fixed_t oldfloor,
+                            fixed_t oldceiling);
+
 #endif
 
 // EOF
@@ -69,13 +69,13 @@ patch_t *PatchLoader::GetDefaultPatch()
 //
 // Check the format of patch_t data for validity
 //
-bool PatchLoader::checkData(void *data, size_t size) const
+bool PatchLoader::checkData(const void *data, size_t size) const
 {
    // Must be at least as large as the header.
    if(size < 8)
       return false; // invalid header
 
-   patch_t *patch  = static_cast<patch_t *>(data);   
+   const patch_t *patch = static_cast<const patch_t *>(data);
    short    width  = SwapShort(patch->width);
    short    height = SwapShort(patch->height);
 
@@ -97,11 +97,11 @@ bool PatchLoader::checkData(void *data, size_t size) const
          return false; // offset lies outside the data
 
       // Verify the series of posts at that offset
-      byte *base  = reinterpret_cast<byte *>(patch);
-      byte *rover = base + offset;
+      const byte *base  = reinterpret_cast<const byte *>(patch);
+      const byte *rover = base + offset;
       while(*rover != 0xff)
       {
-         byte *nextPost = rover + *(rover + 1) + 4;
+         const byte *nextPost = rover + *(rover + 1) + 4;
 
          if(nextPost >= base + size)
             return false; // Unterminated series of posts, or too long
@@ -249,6 +249,55 @@ patch_t *PatchLoader::CacheNum(WadDirectory &dir, int lumpnum, int tag)
       return GetDefaultPatch();
 }
 
+//
+// PatchLoader::GetRaw
+//
+// ioanch: returns the patch as it is stored in the wad, without copying it,
+// if it's mapped in memory, valid, and not already cached as a patch_t. Its
+// fields are still little-endian and must go through SwapShort/SwapLong.
+// Returns null otherwise; use CacheNum then.
+//
+const patch_t *PatchLoader::GetRaw(const WadDirectory &dir, int lumpnum)
+{
+   if(lumpnum < 0)
+      return nullptr;
+
+   const lumpinfo_t *lump = dir.getLumpInfo()[lumpnum];
+   if(lump->cache[lumpinfo_t::fmt_patch])
+      return nullptr;
+
+   const void *data = dir.getLumpView(lumpnum);
+   if(!data || !patchFmt.checkData(data, lump->size))
+      return nullptr;
+
+   return static_cast<const patch_t *>(data);
+}
+
+//
+// PatchLoader::GetHeader
+//
+// ioanch: gets a patch's size and offsets. Reads the wad data in place when
+// possible, so callers who need nothing else don't cache the whole patch.
+//
+void PatchLoader::GetHeader(WadDirectory &dir, int lumpnum,
+                            patchheader_t &header)
+{
+   if(const patch_t *raw = GetRaw(dir, lumpnum))
+   {
+      header.width      = SwapShort(raw->width);
+      header.height     = SwapShort(raw->height);
+      header.leftoffset = SwapShort(raw->leftoffset);
+      header.topoffset  = SwapShort(raw->topoffset);
+      return;
+   }
+
+   const patch_t *patch = CacheNum(dir, lumpnum, PU_CACHE);
+   header.width      = patch->width;
+   header.height     = patch->height;
+   header.leftoffset = patch->leftoffset;
+   header.topoffset  = patch->topoffset;
+}
+
 //
 // PatchLoader::CacheName
 //
@@ -33,13 +33,20 @@
 
 struct patch_t;
 
+// The fields of a patch_t before its column offsets, already swapped
+struct patchheader_t
+{
+   int16_t width, height;
+   int16_t leftoffset, topoffset;
+};
+
 class PatchLoader : public WadLumpLoader
 {
 private:
    static size_t   DefaultPatchSize;
    static patch_t *GetDefaultPatch();   
 
-   bool checkData(void *data, size_t size) const;
+   bool checkData(const void *data, size_t size) const;
    void formatRaw(void *data) const;
    
 public:
@@ -52,6 +59,8 @@ public:
 
    static patch_t *CacheName(WadDirectory &dir, const char *name, int tag, int ns = lumpinfo_t::ns_global);
    static patch_t *CacheNum(WadDirectory &dir, int lumpnum, int tag);
+   static const patch_t *GetRaw(const WadDirectory &dir, int lumpnum);
+   static void GetHeader(WadDirectory &dir, int lumpnum, patchheader_t &header);
    
    
    static bool VerifyAndFormat(void *data, size_t size);
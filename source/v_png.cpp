@@ -346,13 +346,12 @@ bool VPNGImagePimpl::readImage(const void *data)
 //
 bool VPNGImagePimpl::readFromLumpNum(WadDirectory &dir, int lump)
 {
-   ZAutoBuffer lumpBuffer;
    bool result = false;
 
    if(lump >= 0)
    {
-      dir.cacheLumpAuto(lump, lumpBuffer);
-      result = readImage(lumpBuffer.get());
+      WadLumpView view(dir, lump, false);
+      result = readImage(view.get());
    }
 
    return result;
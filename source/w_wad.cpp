@@ -46,6 +46,7 @@ namespace fs = std::experimental::filesystem;
 #include "d_files.h"
 #include "e_hash.h"
 #include "hal/i_directory.h"
+#include "hal/i_mapfile.h"
 #include "m_argv.h"
 #include "m_collection.h"
 #include "m_dllist.h"
@@ -156,11 +157,45 @@ public:
 
    PODCollection<lumpinfo_t *>  infoptrs; // lumpinfo_t allocations
    DLListItem<ZipFile>         *zipFiles; // zip files attached to this waddir
+   PODCollection<MappedFile *>  mappings; // ioanch: archives mapped in memory
 
    WadDirectoryPimpl()
-      : ZoneObject(), infoptrs(), zipFiles(nullptr)
+      : ZoneObject(), infoptrs(), zipFiles(nullptr), mappings()
    {
    }
+
+   ~WadDirectoryPimpl()
+   {
+      unmapFiles();
+   }
+
+   //
+   // ioanch: maps an opened archive file in memory, so its lumps can be read
+   // without going through stdio. Returns null if that's not possible, or if
+   // the file would just be read into the heap.
+   //
+   const byte *mapFile(const char *filename, FILE *handle, size_t &size)
+   {
+      if(M_CheckParm("-nowadmap"))
+         return nullptr;
+      auto mapping = new MappedFile;
+      if(!mapping->open(filename) || !mapping->isMapped() ||
+         (long)mapping->getSize() != M_FileLength(handle))
+      {
+         delete mapping;
+         return nullptr;
+      }
+      mappings.add(mapping);
+      size = mapping->getSize();
+      return mapping->getData();
+   }
+
+   void unmapFiles()
+   {
+      for(MappedFile *mapping : mappings)
+         delete mapping;
+      mappings.clear();
+   }
 };
 
 qstring             WadDirectoryPimpl::FnPrototype;
@@ -334,6 +369,11 @@ bool WadDirectory::addSingleFile(openwad_t &openData, const wfileadd_t &addInfo,
    lump_p->direct.file     = openData.handle;
    lump_p->direct.position = static_cast<size_t>(singleinfo.filepos);
 
+   // ioanch: read it from memory if possible
+   size_t mapsize;
+   lump_p->direct.mapping = pImpl->mapFile(openData.filename, openData.handle,
+                                           mapsize);
+
    lump_p->li_namespace = addInfo.li_namespace; // killough 4/17/98
 
    strncpy(lump_p->name, singleinfo.name, 8);
@@ -536,6 +576,12 @@ bool WadDirectory::addWadFile(openwad_t &openData, const wfileadd_t &addInfo,
          IWADSource = source;
    }
 
+   // ioanch: map the whole file, unless it's part of another one
+   const byte *mapping = nullptr;
+   size_t      mapsize = 0;
+   if(!(addInfo.flags & WFA_SUBFILE))
+      mapping = pImpl->mapFile(openData.filename, openData.handle, mapsize);
+
    // Add lumpinfo_t's for all lumps in the wad file
    lump_p = reAllocLumpInfo(header.numlumps, startlump);
 
@@ -554,6 +600,13 @@ bool WadDirectory::addWadFile(openwad_t &openData, const wfileadd_t &addInfo,
       if(addInfo.flags & WFA_SUBFILE)
          lump_p->direct.position += static_cast<size_t>(baseoffset);
 
+      // lumps pointing outside of the file still go through stdio
+      if(mapping && lump_p->direct.position <= mapsize &&
+         lump_p->size <= mapsize - lump_p->direct.position)
+      {
+         lump_p->direct.mapping = mapping;
+      }
+
       lump_p->li_namespace = addInfo.li_namespace;     // killough 4/17/98
 
       strncpy(lump_p->name, fileinfo->name, 8);
@@ -592,6 +645,16 @@ bool WadDirectory::addZipFile(openwad_t &openData,
       return true;
    }
 
+   // ioanch: -zipcache keeps the inflated lumps on disk for later runs
+   if(M_CheckParm("-zipcache") && userpath)
+   {
+      qstring cachedir(userpath);
+      cachedir.pathConcatenate("zipcache");
+      I_CreateDirectory(cachedir);
+      if(!zip->openLumpCache(cachedir.constPtr()) && in_textmode)
+         printf("Failed to open the lump cache for %s\n", openData.filename);
+   }
+
    // update IWAD handle?
    if(!(addInfo.flags & WFA_PRIVATE) && this->ispublic)
    {
@@ -1724,6 +1787,107 @@ void WadDirectory::cacheLumpAuto(const char *name, ZAutoBuffer &buffer) const
    cacheLumpAuto(getNumForName(name), buffer);
 }
 
+//
+// WadDirectory::prefetchLumps
+//
+// ioanch: lets the given lumps be read faster soon after. Lumps from zip files
+// are inflated together on worker threads. Cached lumps are skipped.
+//
+void WadDirectory::prefetchLumps(const int *lumps, int count) const
+{
+   PODCollection<ZipLump *> zipLumps;
+
+   for(int i = 0; i < count; ++i)
+   {
+      if(lumps[i] < 0 || lumps[i] >= numlumps)
+         continue;
+      const lumpinfo_t *lptr = lumpinfo[lumps[i]];
+      if(lptr->type != lumpinfo_t::lump_zip)
+         continue;
+      bool cached = false;
+      for(int fmt = 0; fmt < lumpinfo_t::fmt_maxfmts; ++fmt)
+         cached = cached || lptr->cache[fmt];
+      if(!cached)
+         zipLumps.add(lptr->zip.zipLump);
+   }
+
+   if(!zipLumps.isEmpty())
+      ZIP_Prefetch(&zipLumps[0], (int)zipLumps.getLength());
+}
+
+//
+// WadDirectory::releasePrefetchedLumps
+//
+// ioanch: frees whatever prefetchLumps inflated but nobody read since
+//
+void WadDirectory::releasePrefetchedLumps() const
+{
+   for(int i = 0; i < numlumps; ++i)
+   {
+      if(lumpinfo[i]->type == lumpinfo_t::lump_zip)
+         lumpinfo[i]->zip.zipLump->releasePrefetched();
+   }
+}
+
+//
+// WadDirectory::getLumpView
+//
+// ioanch: returns the lump data as it is in memory, if it's mapped or loaded
+// there, or null if it has to be read. Mind that such data may be unaligned,
+// so unless aligned is false, only lumps starting at a 4-byte boundary are
+// returned.
+//
+const void *WadDirectory::getLumpView(int lump, bool aligned) const
+{
+   if(lump < 0 || lump >= numlumps)
+      I_Error("WadDirectory::getLumpView: %i >= numlumps\n", lump);
+
+   const lumpinfo_t *lptr = lumpinfo[lump];
+   const byte *data;
+
+   if(!lptr->size)
+      return nullptr;
+   if(lptr->type == lumpinfo_t::lump_direct && lptr->direct.mapping)
+      data = lptr->direct.mapping + lptr->direct.position;
+   else if(lptr->type == lumpinfo_t::lump_memory)
+      data = static_cast<const byte *>(lptr->memory.data) + lptr->memory.position;
+   else
+      return nullptr;
+
+   return aligned && reinterpret_cast<uintptr_t>(data) & 3 ? nullptr : data;
+}
+
+//
+// WadLumpView::WadLumpView
+//
+WadLumpView::WadLumpView(const WadDirectory &dir, int lump, bool aligned)
+   : copy(nullptr)
+{
+   if((data = dir.getLumpView(lump, aligned)))
+      return;
+
+   // Reuse a copy someone else keeps cached, but never free it from here.
+   // Purgable copies could go away while the view is still in use.
+   void *cached = dir.getLumpInfo()[lump]->cache[lumpinfo_t::fmt_default];
+   if(cached && Z_CheckTag(cached) < PU_PURGELEVEL)
+   {
+      data = cached;
+      return;
+   }
+
+   data = copy = Z_Malloc(dir.lumpLength(lump), PU_STATIC, nullptr);
+   dir.readLump(lump, copy);
+}
+
+//
+// WadLumpView::~WadLumpView
+//
+WadLumpView::~WadLumpView()
+{
+   if(copy)
+      Z_Free(copy);
+}
+
 //
 // WadDirectory::writeLump
 //
@@ -1755,7 +1919,9 @@ bool WadDirectory::writeLump(const char *lumpname, const char *destpath) const
 //
 uint32_t W_LumpCheckSum(int lumpnum)
 {
-   uint8_t  *lump    = (uint8_t *)(wGlobalDir.cacheLumpNum(lumpnum, PU_CACHE));
+   const void *view = wGlobalDir.getLumpView(lumpnum, false);
+   auto      lump    = (const uint8_t *)(view ? view :
+                          wGlobalDir.cacheLumpNum(lumpnum, PU_CACHE));
    uint32_t  lumplen = (uint32_t )(wGlobalDir.lumpLength(lumpnum));
 
    return HashData(HashData::CRC32, lump, lumplen).getDigestPart(0);
@@ -1828,6 +1994,7 @@ void WadDirectory::close()
 
       if(lumpinfo[0]->type == lumpinfo_t::lump_direct && lumpinfo[0]->direct.file)
          fclose(lumpinfo[0]->direct.file);
+      pImpl->unmapFiles();
 
       // free all lumpinfo_t's allocated for the wad
       freeDirectoryAllocs();
@@ -1856,6 +2023,13 @@ static size_t W_DirectReadLump(lumpinfo_t *l, void *dest)
    size_t ret;
    directlump_t &direct = l->direct;
 
+   // ioanch: mapped files are just copied from
+   if(direct.mapping)
+   {
+      memcpy(dest, direct.mapping + direct.position, size);
+      return size;
+   }
+
    // killough 10/98: Add flashing disk indicator
    fseek(direct.file, static_cast<long>(direct.position), SEEK_SET);
    ret = fread(dest, 1, size, direct.file);
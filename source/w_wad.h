@@ -54,6 +54,7 @@ struct directlump_t
 {
    FILE *file;       // for a direct lump, a pointer to the file it is in
    size_t position;  // for direct and memory lumps, offset into file/buffer
+   const byte *mapping; // ioanch: the whole file mapped in memory, if any
 };
 
 // A memory lump is loaded in a buffer in RAM and just needs to be memcpy'd.
@@ -328,6 +329,9 @@ public:
    void  cacheLumpAuto(int lumpnum, ZAutoBuffer &buffer) const;
    void  cacheLumpAuto(const char *name, ZAutoBuffer &buffer) const;
    bool  writeLump(const char *lumpname, const char *destpath) const;
+   const void *getLumpView(int lump, bool aligned = true) const;
+   void  prefetchLumps(const int *lumps, int count) const;
+   void  releasePrefetchedLumps() const;
    void  close(); // haleyjd 03/09/11
 
    lumpinfo_t *getLumpNameChain(const char *name) const;
@@ -352,6 +356,37 @@ public:
 
 extern WadDirectory wGlobalDir; // the global wad directory
 
+//
+// WadLumpView
+//
+// ioanch: read-only access to a lump's raw data. Points straight into the
+// archive where it's mapped in memory, otherwise into a cached copy which is
+// freed along with the view. Code which changes the data in place must use
+// cacheLumpNum or cacheLumpAuto, which always make their own copy. Pass
+// aligned = false if the data is only read byte by byte.
+//
+class WadLumpView
+{
+public:
+   WadLumpView(const WadDirectory &dir, int lump, bool aligned = true);
+   ~WadLumpView();
+   WadLumpView(const WadLumpView &) = delete;
+   WadLumpView &operator = (const WadLumpView &) = delete;
+
+   const void *get() const
+   {
+      return data;
+   }
+   template<typename T> const T *getAs() const
+   {
+      return static_cast<const T *>(data);
+   }
+
+private:
+   const void *data;
+   void *copy;       // set if the lump had to be read
+};
+
 int      W_CheckNumForName(const char *name);   // killough 4/17/98
 int      W_CheckNumForNameNS(const char *name, int li_namespace);
 int      W_GetNumForName(const char* name);
@@ -26,14 +26,37 @@
 //
 //-----------------------------------------------------------------------------
 
+#if __cplusplus >= 201703L || _MSC_VER >= 1914
+#include "hal/i_platform.h"
+#if EE_CURRENT_PLATFORM == EE_PLATFORM_MACOSX
+#include "hal/i_directory.h"
+namespace fs = fsStopgap;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
 #include "z_auto.h"
 
+#include "hal/i_directory.h"
+#include "hal/i_mapfile.h"
 #include "i_system.h"
 #include "m_buffer.h"
 #include "m_compare.h"
+#include "m_hash.h"
 #include "m_qstr.h"
 #include "m_structio.h"
 #include "m_swap.h"
+#include "m_utils.h"
 #include "w_wad.h"
 #include "w_zip.h"
 
@@ -265,6 +288,8 @@ ZipFile::~ZipFile()
       {
          if(lumps[i].name)
             efree(lumps[i].name);
+         if(lumps[i].prefetched)
+            efree(lumps[i].prefetched);
       }
 
       // free the lump directory
@@ -294,6 +319,12 @@ ZipFile::~ZipFile()
       fclose(file);
       file = nullptr;
    }
+
+   if(lumpCache)
+   {
+      delete lumpCache;
+      lumpCache = nullptr;
+   }
 }
 
 //
@@ -399,6 +430,7 @@ bool ZipFile::readCentralDirEntry(InBuffer &fin, ZipLump &lump, bool &skip)
    lump.method     = entry.method;
    lump.compressed = entry.compressed;
    lump.size       = entry.uncompressed;
+   lump.crc        = entry.crc32;
    lump.offset     = entry.localOffset;
 
    // Lump will need true offset to file data calculated the first time it is
@@ -722,6 +754,20 @@ void ZipLump::read(void *buffer)
 {
    InBuffer reader;
 
+   // ioanch: use the data inflated in advance, if any
+   if(cached)
+   {
+      memcpy(buffer, cached, size);
+      return;
+   }
+   if(prefetched)
+   {
+      memcpy(buffer, prefetched, size);
+      efree(prefetched);
+      prefetched = nullptr;
+      return;
+   }
+
    reader.openExisting(file->getFile(), InBuffer::LENDIAN);
 
    // Calculate an offset beyond the lump's local file header, if such hasn't
@@ -752,6 +798,28 @@ void ZipLump::read(void *buffer)
    }
 }
 
+//
+// ZipLump::readCompressed
+//
+// ioanch: reads the lump data as it's stored in the zip file
+//
+void ZipLump::readCompressed(void *buffer)
+{
+   InBuffer reader;
+
+   reader.openExisting(file->getFile(), InBuffer::LENDIAN);
+
+   if(flags & ZipFile::LF_CALCOFFSET)
+      setAddress(reader);
+   else
+   {
+      if(reader.seek(offset, SEEK_SET))
+         I_Error("ZipLump::readCompressed: could not seek to lump '%s'\n", name);
+   }
+
+   ZIP_ReadStored(reader, buffer, compressed);
+}
+
 //
 // ZipLump::read(ZAutoBuffer &, bool)
 //
@@ -769,5 +837,439 @@ void ZipLump::read(ZAutoBuffer &buf, bool asString)
    }
 }
 
+//=============================================================================
+//
+// Inflating in advance
+//
+// ioanch: deflated lumps can be inflated on worker threads, either just before
+// they're needed, or once for a cache file which is mapped on later runs.
+//
+
+// Uncompressed bytes inflated at once
+static const size_t ZIP_BATCHSIZE = 64 * 1024 * 1024;
+
+//
+// ZIP_inflateMemory
+//
+// Inflates a whole lump which is already in memory. Safe to call from any
+// thread, as failures are just returned.
+//
+static bool ZIP_inflateMemory(const byte *source, uint32_t compressed,
+                              byte *dest, uint32_t size)
+{
+   z_stream zlStream = z_stream();
+
+   if(inflateInit2(&zlStream, -MAX_WBITS) != Z_OK)
+      return false;
+
+   zlStream.next_in   = const_cast<Bytef *>(source);
+   zlStream.avail_in  = static_cast<uInt>(compressed);
+   zlStream.next_out  = static_cast<Bytef *>(dest);
+   zlStream.avail_out = static_cast<uInt>(size);
+
+   int code = inflate(&zlStream, Z_FINISH);
+   inflateEnd(&zlStream);
+
+   // Anything short of the whole stream ending exactly at the expected size
+   // is a corrupt lump
+   return code == Z_STREAM_END && zlStream.total_out == size;
+}
+
+//
+// ZIP_inflateBatch
+//
+// Reads the compressed data of the lumps, as the zip files may only be used
+// from the main thread, then inflates it on all cores. Lumps which fail to
+// inflate get a null output, and are left to be read normally.
+//
+static void ZIP_inflateBatch(ZipLump *const *lumps, byte **outputs, int count)
+{
+   std::vector<byte *> inputs(count);
+   std::vector<char>   ok(count);
+
+   for(int i = 0; i < count; ++i)
+   {
+      inputs[i]  = emalloc(byte *, lumps[i]->compressed + 1);
+      outputs[i] = emalloc(byte *, lumps[i]->size);
+      lumps[i]->readCompressed(inputs[i]);
+   }
+
+   std::atomic<int> next(0);
+   auto work = [&]() {
+      int i;
+      while((i = next++) < count)
+      {
+         ok[i] = ZIP_inflateMemory(inputs[i], lumps[i]->compressed, outputs[i],
+                                   lumps[i]->size);
+      }
+   };
+
+   int numthreads = emin((int)std::thread::hardware_concurrency(), count) - 1;
+   std::vector<std::thread> threads;
+   for(int i = 0; i < numthreads; ++i)
+      threads.emplace_back(work);
+   work();
+   for(std::thread &thread : threads)
+      thread.join();
+
+   for(int i = 0; i < count; ++i)
+   {
+      efree(inputs[i]);
+      if(!ok[i])
+      {
+         efree(outputs[i]);
+         outputs[i] = nullptr;
+      }
+   }
+}
+
+//
+// ZIP_inflateLumps
+//
+// Inflates the lumps in batches of limited size. onInflated takes each lump
+// and its allocated data.
+//
+template<typename F>
+static void ZIP_inflateLumps(ZipLump *const *lumps, int count, F &&onInflated)
+{
+   std::vector<byte *> outputs;
+
+   for(int first = 0; first < count;)
+   {
+      int    last  = first;
+      size_t total = 0;
+      while(last < count && (last == first || total + lumps[last]->size <= ZIP_BATCHSIZE))
+         total += lumps[last++]->size;
+
+      outputs.resize(last - first);
+      ZIP_inflateBatch(lumps + first, outputs.data(), last - first);
+      for(int i = first; i < last; ++i)
+      {
+         if(outputs[i - first])
+            onInflated(*lumps[i], outputs[i - first]);
+      }
+      first = last;
+   }
+}
+
+//
+// ZIP_Prefetch
+//
+// Inflates the given lumps ahead of their next read. Stored lumps and lumps
+// found in a cache are skipped.
+//
+void ZIP_Prefetch(ZipLump *const *lumps, int count)
+{
+   std::vector<ZipLump *> todo;
+
+   for(int i = 0; i < count; ++i)
+   {
+      ZipLump *lump = lumps[i];
+      if(lump->method == ZipFile::METHOD_DEFLATE && lump->size &&
+         !lump->cached && !lump->prefetched)
+      {
+         todo.push_back(lump);
+      }
+   }
+   std::sort(todo.begin(), todo.end());
+   todo.erase(std::unique(todo.begin(), todo.end()), todo.end());
+
+   ZIP_inflateLumps(todo.data(), (int)todo.size(), [](ZipLump &lump, byte *data) {
+      lump.prefetched = data;
+   });
+}
+
+//
+// ZipLump::releasePrefetched
+//
+// ioanch: frees data inflated by ZIP_Prefetch which was never read
+//
+void ZipLump::releasePrefetched()
+{
+   if(prefetched)
+   {
+      efree(prefetched);
+      prefetched = nullptr;
+   }
+}
+
+//
+// Lump cache files
+//
+// Header, then one entry per lump of the zip, then the inflated data of all
+// deflated lumps.
+//
+
+static const char     ZIP_CACHE_MAGIC[4] = { 'E', 'E', 'Z', 'C' };
+static const uint32_t ZIP_CACHE_VERSION  = 2;
+static const char     ZIP_CACHE_EXT[]    = ".zlc";
+
+int zip_cachesize = 1024; // disk cache limit in megabytes (0 = no disk cache)
+
+struct zipcacheheader_t
+{
+   char     magic[4];
+   uint32_t version;
+   uint32_t numlumps;
+   uint32_t reserved;
+   int64_t  lastused; // time of the last run which mapped the file
+};
+
+//
+// ZIP_readCacheHeader
+//
+static bool ZIP_readCacheHeader(FILE *f, zipcacheheader_t &header)
+{
+   return fread(&header, sizeof(header), 1, f) == 1 &&
+      !memcmp(header.magic, ZIP_CACHE_MAGIC, 4) &&
+      header.version == ZIP_CACHE_VERSION;
+}
+
+//
+// ZIP_touchLumpCache
+//
+// Marks a cache file as used now, before it gets mapped
+//
+static void ZIP_touchLumpCache(const char *path)
+{
+   FILE *f = fopen(path, "r+b");
+   if(!f)
+      return;
+
+   zipcacheheader_t header;
+   if(ZIP_readCacheHeader(f, header))
+   {
+      header.lastused = (int64_t)time(nullptr);
+      if(!fseek(f, 0, SEEK_SET))
+         fwrite(&header, sizeof(header), 1, f);
+   }
+   fclose(f);
+}
+
+//
+// ZIP_lumpCacheHousekeeping
+//
+// Deletes the least recently used cache files while all of them take more than
+// zip_cachesize megabytes. The file named keep is never deleted.
+//
+static void ZIP_lumpCacheHousekeeping(const char *dirpath, const std::string &keep)
+{
+   struct cachefile_t
+   {
+      std::string path;
+      uintmax_t   size;
+      int64_t     lastused;
+   };
+   std::vector<cachefile_t> files;
+   uintmax_t total = 0;
+
+   const fs::directory_entry    dir(dirpath);
+   const fs::directory_iterator itr(dir);
+   for(const fs::directory_entry &ent : itr)
+   {
+      if(ent.is_directory() || ent.path().extension().generic_u8string() != ZIP_CACHE_EXT)
+         continue;
+
+      cachefile_t file = { ent.path().generic_u8string(), (uintmax_t)ent.file_size(), 0 };
+      if(FILE *f = fopen(file.path.c_str(), "rb"))
+      {
+         zipcacheheader_t header;
+         if(ZIP_readCacheHeader(f, header))
+            file.lastused = header.lastused;
+         fclose(f);
+      }
+      total += file.size;
+      if(file.path.size() < keep.size() ||
+         file.path.compare(file.path.size() - keep.size(), keep.size(), keep))
+      {
+         files.push_back(std::move(file));
+      }
+   }
+
+   const uintmax_t limit = (uintmax_t)zip_cachesize << 20;
+   if(total <= limit)
+      return;
+
+   std::sort(files.begin(), files.end(),
+             [](const cachefile_t &a, const cachefile_t &b) {
+      return a.lastused < b.lastused;
+   });
+   for(const cachefile_t &file : files)
+   {
+      if(total <= limit)
+         break;
+      if(!remove(file.path.c_str()))
+         total -= file.size;
+   }
+}
+
+struct zipcacheentry_t
+{
+   uint64_t offset;  // 0 if the lump isn't in the cache
+   uint32_t size;
+   uint32_t crc;
+};
+
+//
+// ZIP_mapLumpCache
+//
+// Maps a cache file and points the lumps into it. Returns null if the file
+// is missing or doesn't match the zip directory.
+//
+static MappedFile *ZIP_mapLumpCache(const char *path, ZipLump *lumps,
+                                    int numLumps)
+{
+   auto cache = new MappedFile;
+   const size_t tablesize = numLumps * sizeof(zipcacheentry_t);
+
+   if(!cache->open(path) ||
+      cache->getSize() < sizeof(zipcacheheader_t) + tablesize)
+   {
+      delete cache;
+      return nullptr;
+   }
+
+   const byte *data = cache->getData();
+   zipcacheheader_t header;
+   memcpy(&header, data, sizeof(header));
+   if(memcmp(header.magic, ZIP_CACHE_MAGIC, 4) ||
+      header.version != ZIP_CACHE_VERSION || header.numlumps != (uint32_t)numLumps)
+   {
+      delete cache;
+      return nullptr;
+   }
+
+   std::vector<zipcacheentry_t> table(numLumps);
+   memcpy(table.data(), data + sizeof(header), tablesize);
+   for(int i = 0; i < numLumps; ++i)
+   {
+      const zipcacheentry_t &entry = table[i];
+      if(entry.size != lumps[i].size || entry.crc != lumps[i].crc ||
+         entry.offset > cache->getSize() ||
+         entry.size > cache->getSize() - entry.offset)
+      {
+         delete cache;
+         return nullptr;
+      }
+   }
+
+   for(int i = 0; i < numLumps; ++i)
+   {
+      if(table[i].offset)
+         lumps[i].cached = data + table[i].offset;
+   }
+   return cache;
+}
+
+//
+// ZIP_writeLumpCache
+//
+// Inflates all deflated lumps into a new cache file
+//
+static bool ZIP_writeLumpCache(const char *path, ZipLump *lumps, int numLumps)
+{
+   qstring tmppath(path);
+   tmppath << ".tmp";
+
+   FILE *f = fopen(tmppath.constPtr(), "wb");
+   if(!f)
+      return false;
+
+   zipcacheheader_t header = {};
+   memcpy(header.magic, ZIP_CACHE_MAGIC, 4);
+   header.version  = ZIP_CACHE_VERSION;
+   header.numlumps = (uint32_t)numLumps;
+   header.lastused = (int64_t)time(nullptr);
+
+   std::vector<zipcacheentry_t> table(numLumps);
+   std::vector<ZipLump *>       todo;
+   for(int i = 0; i < numLumps; ++i)
+   {
+      table[i].offset = 0;
+      table[i].size   = lumps[i].size;
+      table[i].crc    = lumps[i].crc;
+      if(lumps[i].method == ZipFile::METHOD_DEFLATE && lumps[i].size)
+         todo.push_back(&lumps[i]);
+   }
+
+   bool     ok       = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                       fwrite(table.data(), sizeof(zipcacheentry_t), numLumps, f) ==
+                       (size_t)numLumps;
+   uint64_t position = sizeof(header) + numLumps * sizeof(zipcacheentry_t);
+
+   ZIP_inflateLumps(todo.data(), (int)todo.size(), [&](ZipLump &lump, byte *data) {
+      static const byte padding[16] = {};
+      size_t pad = (size_t)(-position & 15);
+      if(ok && (!pad || fwrite(padding, 1, pad, f) == pad) &&
+         fwrite(data, 1, lump.size, f) == lump.size)
+      {
+         position += pad;
+         table[&lump - lumps].offset = position;
+         position += lump.size;
+      }
+      else
+         ok = false;
+      efree(data);
+   });
+
+   if(ok)
+   {
+      ok = !fseek(f, sizeof(header), SEEK_SET) &&
+           fwrite(table.data(), sizeof(zipcacheentry_t), numLumps, f) ==
+           (size_t)numLumps;
+   }
+   ok = !fclose(f) && ok;
+
+   if(ok)
+      ok = I_ReplaceFile(tmppath.constPtr(), path);
+   if(!ok)
+      remove(tmppath.constPtr());
+   return ok;
+}
+
+//
+// ZipFile::openLumpCache
+//
+// ioanch: keeps the inflated lumps in a file under dirpath, named after a hash
+// of the zip directory. The file is made on the first run, and mapped later.
+// Making one trims the folder down to zip_cachesize.
+//
+bool ZipFile::openLumpCache(const char *dirpath)
+{
+   if(lumpCache || !numLumps || zip_cachesize <= 0)
+      return lumpCache != nullptr;
+
+   HashData hash(HashData::SHA1);
+   long     filelength = M_FileLength(file);
+
+   hash.addData((const uint8_t *)&filelength, (uint32_t)sizeof(filelength));
+   for(int i = 0; i < numLumps; ++i)
+   {
+      const ZipLump &lump = lumps[i];
+      hash.addData((const uint8_t *)lump.name, (uint32_t)strlen(lump.name) + 1);
+      hash.addData((const uint8_t *)&lump.method, (uint32_t)sizeof(lump.method));
+      hash.addData((const uint8_t *)&lump.compressed,
+                   (uint32_t)sizeof(lump.compressed));
+      hash.addData((const uint8_t *)&lump.size, (uint32_t)sizeof(lump.size));
+      hash.addData((const uint8_t *)&lump.crc, (uint32_t)sizeof(lump.crc));
+   }
+   hash.wrapUp();
+
+   char   *digest = hash.digestToString();
+   const std::string filename = std::string(digest) + ZIP_CACHE_EXT;
+   qstring path(dirpath);
+   path.pathConcatenate(filename.c_str());
+   efree(digest);
+
+   ZIP_touchLumpCache(path.constPtr());
+   lumpCache = ZIP_mapLumpCache(path.constPtr(), lumps, numLumps);
+   if(!lumpCache && ZIP_writeLumpCache(path.constPtr(), lumps, numLumps))
+   {
+      ZIP_lumpCacheHousekeeping(dirpath, filename);
+      lumpCache = ZIP_mapLumpCache(path.constPtr(), lumps, numLumps);
+   }
+   return lumpCache != nullptr;
+}
+
 // EOF
 
@@ -33,6 +33,7 @@
 #include "m_dllist.h"
 
 class  InBuffer;
+class  MappedFile;
 class  WadDirectory;
 class  ZAutoBuffer;
 struct ZIPEndOfCentralDir;
@@ -45,13 +46,20 @@ struct ZipLump
    int       method;     // compression method
    uint32_t  compressed; // compressed size
    uint32_t  size;       // uncompressed size
+   uint32_t  crc;        // checksum of the uncompressed data
    long      offset;     // file offset
    char     *name;       // full name 
    ZipFile  *file;       // parent zipfile
 
+   // ioanch: inflated data kept by ZipFile::openLumpCache or ZIP_Prefetch
+   const byte *cached;     // in the lump cache
+   byte       *prefetched; // allocated, freed when first read
+
    void setAddress(InBuffer &fin);
+   void readCompressed(void *buffer);
    void read(void *buffer);
    void read(ZAutoBuffer &buf, bool asString);
+   void releasePrefetched();
 };
 
 struct ZipWad
@@ -93,19 +101,23 @@ protected:
 
    DLListItem<ZipWad> *wads;  // wads loaded from inside the zip
 
+   MappedFile *lumpCache;     // ioanch: inflated lumps, see openLumpCache
+
    bool readEndOfCentralDir(InBuffer &fin, ZIPEndOfCentralDir &zcd);
    bool readCentralDirEntry(InBuffer &fin, ZipLump &lump, bool &skip);
    bool readCentralDirectory(InBuffer &fin, long offset, uint32_t size);
 
 public:
    ZipFile() 
-      : ZoneObject(), lumps(nullptr), numLumps(0), file(nullptr), links(), wads(nullptr) 
+      : ZoneObject(), lumps(nullptr), numLumps(0), file(nullptr), links(), wads(nullptr),
+        lumpCache(nullptr)
    {
    }
    
    ~ZipFile();
 
    bool readFromFile(FILE *f);
+   bool openLumpCache(const char *dirpath);
 
    void checkForWadFiles(WadDirectory &parentDir);
 
@@ -116,6 +128,10 @@ public:
    FILE    *getFile()     const { return file;     }
 };
 
+extern int zip_cachesize;
+
+void ZIP_Prefetch(ZipLump *const *lumps, int count);
+
 #endif
 
 // EOF
@@ -29,6 +29,11 @@
 // When running with this heap, there is no limitation to the amount of memory
 // allocated except what the system will provide.
 //
+// With arenas on (Z_SetArenas), PU_LEVEL and PU_CACHE blocks are carved out
+// of large chunks instead. A freed arena block is kept on a freelist for its
+// size, and once nothing is left in an arena, its chunks are released at
+// once. Freeing the level then doesn't cost one system call per block.
+//
 // Limitations:
 // * Purgables are never currently dumped unless the machine runs out of RAM.
 // * Instrumentation cannot track the amount of free memory.
@@ -36,6 +41,7 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <mutex>
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomstat.h"
@@ -80,6 +86,18 @@
 // signature for block header
 #define ZONEID  0x931d4a11
 
+// ioanch: arena chunk size, and the largest block taken from an arena
+static const size_t ARENA_CHUNKSIZE = 1024 * 1024;
+static const size_t ARENA_MAXBLOCK = 32768;
+
+// Arena size classes: multiples of 16 bytes up to 1024, then powers of two
+static const size_t ARENA_SMALLSTEP = 16;
+static const size_t ARENA_SMALLMAX = 1024;
+enum
+{
+   ARENA_NUMCLASSES = ARENA_SMALLMAX / ARENA_SMALLSTEP + 5 // up to 32768
+};
+
 // End Tunables
 
 //=============================================================================
@@ -87,6 +105,8 @@
 // Memblock Structure
 // 
 
+struct zonearena_t;
+
 struct memblock_t
 {
 #ifdef ZONEIDCHECK
@@ -96,6 +116,7 @@ struct memblock_t
   struct memblock_t *next,**prev;
   size_t size;
   void **user;
+  zonearena_t *arena;  // ioanch: owning arena, or null if from malloc
   unsigned char tag;
 
 #ifdef INSTRUMENTED
@@ -117,9 +138,80 @@ static const size_t header_size = (sizeof(memblock_t) + 15) & ~15;
 
 static memblock_t *blockbytag[PU_MAX];   // used for tracking all zone blocks
 
+//
+// zonechunk_t
+//
+// Header of a region from which arena blocks are carved
+//
+struct zonechunk_t
+{
+   zonechunk_t *next;
+};
+
+static const size_t chunkheader_size = (sizeof(zonechunk_t) + 15) & ~15;
+
+//
+// zonearena_t
+//
+// ioanch: blocks allocated with a given tag. They may be retagged, but stay
+// in their arena until freed.
+//
+struct zonearena_t
+{
+   int          tag;      // tag of the blocks allocated here
+   zonechunk_t *chunks;
+   byte        *cursor;   // free room in the newest chunk
+   byte        *limit;
+   memblock_t  *freelist[ARENA_NUMCLASSES];
+   size_t       live;     // blocks in use
+   size_t       withuser; // blocks in use which have a user
+   size_t       away;     // blocks in use which were retagged
+};
+
+static bool        zonearenas;
+static zonearena_t levelarena = { PU_LEVEL };
+static zonearena_t cachearena = { PU_CACHE };
+
+// Arena blocks are tracked apart from the others, so they can be dropped at
+// once. Also counts the arena blocks which were retagged to each tag.
+static memblock_t *arenabytag[PU_MAX];
+static size_t      arenavisitors[PU_MAX];
+
+static memblock_t **const blocklists[] = { blockbytag, arenabytag };
+
 // ZoneObject class statics
 ZoneObject *ZoneObject::objectbytag[PU_MAX]; // like blockbytag but for objects
-void       *ZoneObject::newalloc;            // most recent ZoneObject alloc
+thread_local void *ZoneObject::newalloc;     // most recent ZoneObject alloc
+
+// ioanch: heap changes are serialized while other threads may use the heap
+static std::recursive_mutex zonemutex;
+static bool                 zonethreaded;
+
+//
+// ZoneLock
+//
+// Holds zonemutex for its scope, if Z_SetThreaded is on
+//
+class ZoneLock
+{
+public:
+   ZoneLock() : locked(zonethreaded)
+   {
+      if(locked)
+         zonemutex.lock();
+   }
+   ~ZoneLock()
+   {
+      if(locked)
+         zonemutex.unlock();
+   }
+
+   ZoneLock(const ZoneLock &) = delete;
+   ZoneLock &operator = (const ZoneLock &) = delete;
+
+private:
+   bool locked;
+};
 
 //=============================================================================
 //
@@ -298,6 +390,177 @@ void Z_Init(void)
    Z_LogPrintf("Initialized zone heap (using native implementation)\n");
 }
 
+//=============================================================================
+//
+// Arenas
+//
+
+//
+// Z_arenaClass
+//
+// Gets the size class of a block, and the room it takes
+//
+static int Z_arenaClass(size_t size, size_t &room)
+{
+   if(size <= ARENA_SMALLMAX)
+   {
+      size_t steps = (size + ARENA_SMALLSTEP - 1) / ARENA_SMALLSTEP;
+      room = steps * ARENA_SMALLSTEP;
+      return (int)steps - 1;
+   }
+   int cls = ARENA_SMALLMAX / ARENA_SMALLSTEP;
+   for(room = ARENA_SMALLMAX * 2; room < size; room <<= 1)
+      ++cls;
+   return cls;
+}
+
+//
+// Z_arenaFor
+//
+// Returns the arena for a new block, if any
+//
+static zonearena_t *Z_arenaFor(size_t size, int tag)
+{
+   if(!zonearenas || size > ARENA_MAXBLOCK)
+      return nullptr;
+   if(tag == PU_LEVEL)
+      return &levelarena;
+   if(tag == PU_CACHE)
+      return &cachearena;
+   return nullptr;
+}
+
+//
+// Z_arenaAlloc
+//
+// Takes a block from the freelists, or else from the newest chunk. Returns
+// null if no chunk can be allocated.
+//
+static memblock_t *Z_arenaAlloc(zonearena_t &arena, size_t size)
+{
+   size_t room;
+   int cls = Z_arenaClass(size, room);
+
+   memblock_t *block = arena.freelist[cls];
+   if(block)
+      arena.freelist[cls] = block->next;
+   else
+   {
+      size_t need = header_size + room;
+      if(!arena.cursor || arena.cursor + need > arena.limit)
+      {
+         auto chunk = (zonechunk_t *)malloc(ARENA_CHUNKSIZE);
+         if(!chunk)
+            return nullptr;
+         chunk->next = arena.chunks;
+         arena.chunks = chunk;
+         arena.cursor = (byte *)chunk + chunkheader_size;
+         arena.limit = (byte *)chunk + ARENA_CHUNKSIZE;
+      }
+      block = (memblock_t *)arena.cursor;
+      arena.cursor += need;
+   }
+
+   block->arena = &arena;
+   ++arena.live;
+   return block;
+}
+
+//
+// Z_arenaRetag
+//
+// Keeps count of the retagged blocks, as they hold the arena. NUMTAGS stands
+// for a freed block.
+//
+static void Z_arenaRetag(memblock_t *block, int oldtag, int newtag)
+{
+   zonearena_t &arena = *block->arena;
+   if(oldtag != arena.tag)
+   {
+      --arena.away;
+      --arenavisitors[oldtag];
+   }
+   if(newtag != arena.tag && newtag != PU_MAX)
+   {
+      ++arena.away;
+      ++arenavisitors[newtag];
+   }
+}
+
+//
+// Z_arenaFree
+//
+// Puts a block back on its freelist
+//
+static void Z_arenaFree(memblock_t *block, int tag)
+{
+   zonearena_t &arena = *block->arena;
+   size_t room;
+   int cls = Z_arenaClass(block->size, room);
+
+   Z_arenaRetag(block, tag, PU_MAX);
+   if(block->user)
+      --arena.withuser;
+   --arena.live;
+
+   block->next = arena.freelist[cls];
+   arena.freelist[cls] = block;
+}
+
+//
+// Z_arenaReset
+//
+// Releases all chunks of an arena. No block may be in use.
+//
+static void Z_arenaReset(zonearena_t &arena)
+{
+   while(arena.chunks)
+   {
+      zonechunk_t *next = arena.chunks->next;
+      free(arena.chunks);
+      arena.chunks = next;
+   }
+   arena.cursor = arena.limit = nullptr;
+   memset(arena.freelist, 0, sizeof(arena.freelist));
+   arena.live = arena.withuser = arena.away = 0;
+}
+
+//
+// Z_freeArenaTag
+//
+// Frees the arena blocks having the tag. If they're all the blocks of an
+// arena, and none of them has a user to clear, the arena is just reset.
+//
+static void Z_freeArenaTag(int tag, const char *file, int line)
+{
+   zonearena_t *arena = tag == PU_LEVEL ? &levelarena :
+                        tag == PU_CACHE ? &cachearena : nullptr;
+
+   if(arena && !arena->away && !arena->withuser && !arenavisitors[tag])
+   {
+      arenabytag[tag] = nullptr;
+      if(arena->chunks)
+         Z_arenaReset(*arena);
+      INSTRUMENT(memorybytag[tag] = 0);   // all other blocks were freed
+      return;
+   }
+
+   memblock_t *block;
+   for(block = arenabytag[tag], arenabytag[tag] = nullptr; block;)
+   {
+      memblock_t *next = block->next;
+
+      Z_IDCheck(IDBOOL(block->id != ZONEID),
+                "Z_FreeTags: Changed a tag without ZONEID", 
+                block, file, line);
+
+      (Z_Free)((byte *)block + header_size, file, line);
+      block = next;               // Advance to next block
+   }
+   if(arena && !arena->live && arena->chunks)
+      Z_arenaReset(*arena);
+}
+
 //=============================================================================
 //
 // Core Memory Management Routines
@@ -312,6 +575,7 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
 {
    memblock_t *block;
    byte *ret;
+   ZoneLock lock;
 
    DEBUG_CHECKHEAP();
 
@@ -322,27 +586,38 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
    if(!size)
       return user ? *user = nullptr : nullptr;          // malloc(0) returns nullptr
    
-   if(!(block = (memblock_t *)(malloc(size + header_size))))
+   zonearena_t *arena = Z_arenaFor(size, tag);
+   if(arena && (block = Z_arenaAlloc(*arena, size)))
+   {
+      if(user)
+         ++arena->withuser;
+   }
+   else
    {
-      if(blockbytag[PU_CACHE])
+      if(!(block = (memblock_t *)(malloc(size + header_size))))
       {
-         Z_FreeTags(PU_CACHE, PU_CACHE);
-         block = (memblock_t *)(malloc(size + header_size));
+         if(blockbytag[PU_CACHE] || arenabytag[PU_CACHE])
+         {
+            Z_FreeTags(PU_CACHE, PU_CACHE);
+            block = (memblock_t *)(malloc(size + header_size));
+         }
       }
-   }
 
-   if(!block)
-   {
-      I_FatalError(I_ERR_KILL, "Z_Malloc: Failure trying to allocate %u bytes\n"
-                               "Source: %s:%d\n", (unsigned int)size, file, line);
+      if(!block)
+      {
+         I_FatalError(I_ERR_KILL, "Z_Malloc: Failure trying to allocate %u bytes\n"
+                                  "Source: %s:%d\n", (unsigned int)size, file, line);
+      }
+      block->arena = nullptr;
    }
    
    block->size = size;
    
-   if((block->next = blockbytag[tag]))
+   memblock_t **lists = block->arena ? arenabytag : blockbytag;
+   if((block->next = lists[tag]))
       block->next->prev = &block->next;
-   blockbytag[tag] = block;
-   block->prev = &blockbytag[tag];
+   lists[tag] = block;
+   block->prev = &lists[tag];
            
    INSTRUMENT(memorybytag[tag] += block->size);
    INSTRUMENT(block->file = file);
@@ -371,6 +646,8 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
 //
 void (Z_Free)(void *p, const char *file, int line)
 {
+   ZoneLock lock;
+
    DEBUG_CHECKHEAP();
 
    if(p)
@@ -402,6 +679,7 @@ void (Z_Free)(void *p, const char *file, int line)
                      );
       }
       INSTRUMENT(memorybytag[block->tag] -= block->size);
+      int tag = block->tag;
       block->tag = PU_FREE;       // Mark block freed
 
       // scramble memory -- weed out any bugs
@@ -413,7 +691,10 @@ void (Z_Free)(void *p, const char *file, int line)
       if((*block->prev = block->next))
          block->next->prev = block->prev;
          
-      free(block);
+      if(block->arena)
+         Z_arenaFree(block, tag);
+      else
+         free(block);
          
       Z_LogPrintf("* Z_Free(p=%p, file=%s:%d)\n", p, file, line);
    }
@@ -425,6 +706,7 @@ void (Z_Free)(void *p, const char *file, int line)
 void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
 {
    memblock_t *block;
+   ZoneLock lock;
 
    // haleyjd 03/30/2011: delete ZoneObjects of the same tags as well
    ZoneObject::FreeTags(lowtag, hightag);
@@ -448,6 +730,7 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
          (Z_Free)((byte *)block + header_size, file, line);
          block = next;               // Advance to next block
       }
+      Z_freeArenaTag(lowtag, file, line);
    }
 
    Z_LogPrintf("* Z_FreeTags(lowtag=%d, hightag=%d, file=%s:%d)\n",
@@ -460,6 +743,7 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
 void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
 {
    memblock_t *block;
+   ZoneLock lock;
    
    DEBUG_CHECKHEAP();
    
@@ -483,12 +767,16 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
              "Z_ChangeTag: an owner is required for purgable blocks",
              block, file, line);
 
+   memblock_t **lists = block->arena ? arenabytag : blockbytag;
    if((*block->prev = block->next))
       block->next->prev = block->prev;
-   if((block->next = blockbytag[tag]))
+   if((block->next = lists[tag]))
       block->next->prev = &block->next;
-   block->prev = &blockbytag[tag];
-   blockbytag[tag] = block;
+   block->prev = &lists[tag];
+   lists[tag] = block;
+
+   if(block->arena)
+      Z_arenaRetag(block, block->tag, tag);
 
    INSTRUMENT(memorybytag[block->tag] -= block->size);
    INSTRUMENT(memorybytag[tag] += block->size);
@@ -510,6 +798,7 @@ void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
 {
    void *p;
    memblock_t *block, *newblock, *origblock;
+   ZoneLock lock;
 
    // if not allocated at all, defer to Z_Malloc
    if(!ptr)
@@ -538,6 +827,29 @@ void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
    if(block->user)
       *(block->user) = nullptr;
 
+   // ioanch: arena blocks can't grow, so they're moved. The contents are set
+   // aside and the block freed first, since Z_Malloc may purge PU_CACHE and
+   // this block with it. The zone lock keeps the buffer to this thread.
+   if(block->arena)
+   {
+      static byte movebuffer[ARENA_MAXBLOCK];
+      size_t movesize = n < block->size ? n : block->size;
+
+      if(block->user)
+      {
+         --block->arena->withuser;
+         block->user = nullptr;
+      }
+      memcpy(movebuffer, ptr, movesize);
+      (Z_Free)(ptr, file, line);
+      p = (Z_Malloc)(n, tag, user, file, line);
+      memcpy(p, movebuffer, movesize);
+
+      Z_LogPrintf("* %p = Z_Realloc(ptr=%p, n=%lu, tag=%d, user=%p, source=%s:%d)\n", 
+                  p, ptr, n, tag, user, file, line);
+      return p;
+   }
+
    // detach from list before reallocation
    if((*block->prev = block->next))
       block->next->prev = block->prev;
@@ -551,7 +863,7 @@ void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user,
    {
       // haleyjd 07/09/10: Note that unlinking the block above makes this safe 
       // even if the current block is PU_CACHE; Z_FreeTags won't find it.
-      if(blockbytag[PU_CACHE])
+      if(blockbytag[PU_CACHE] || arenabytag[PU_CACHE])
       {
          Z_FreeTags(PU_CACHE, PU_CACHE);
          newblock = (memblock_t *)(realloc(block, n + header_size));
@@ -632,11 +944,14 @@ void (Z_CheckHeap)(const char *file, int line)
 
    for(lowtag = PU_FREE+1; lowtag < PU_MAX; ++lowtag)
    {
-      for(block = blockbytag[lowtag]; block; block = block->next)
+      for(memblock_t **lists : blocklists)
       {
-         Z_IDCheck(IDBOOL(block->id != ZONEID),
-                   "Z_CheckHeap: Block found without ZONEID", 
-                   block, file, line);
+         for(block = lists[lowtag]; block; block = block->next)
+         {
+            Z_IDCheck(IDBOOL(block->id != ZONEID),
+                      "Z_CheckHeap: Block found without ZONEID", 
+                      block, file, line);
+         }
       }
    }
 #endif
@@ -693,33 +1008,36 @@ void Z_PrintZoneHeap(void)
 
    for(lowtag = PU_FREE; lowtag < PU_MAX; ++lowtag)
    {
-      for(block = blockbytag[lowtag]; block; block = block->next)
+      for(memblock_t **lists : blocklists)
       {
-         fprintf(outfile, fmtstr, block,
+         for(block = lists[lowtag]; block; block = block->next)
+         {
+            fprintf(outfile, fmtstr, block,
 #if defined(ZONEIDCHECK)
-                 block->id, 
+                    block->id, 
 #endif
-                 block->next, block->prev, block->size,
-                 block->user, block->tag
+                    block->next, block->prev, block->size,
+                    block->user, block->tag
 #if defined(INSTRUMENTED)
 #if defined(ZONEVERBOSE)
-                 , block->file, block->line
+                    , block->file, block->line
 #else
-                 , "not printed", 0
+                    , "not printed", 0
 #endif
 #endif
-                 );
-         // warnings
+                    );
+            // warnings
 #if defined(ZONEIDCHECK)
-         if(block->tag != PU_FREE && block->id != ZONEID)
-            fputs("\tWARNING: block does not have ZONEID\n", outfile);
+            if(block->tag != PU_FREE && block->id != ZONEID)
+               fputs("\tWARNING: block does not have ZONEID\n", outfile);
 #endif
-         if(!block->user && block->tag >= PU_PURGELEVEL)
-            fputs("\tWARNING: purgable block with no user\n", outfile);
-         if(block->tag >= PU_MAX)
-            fputs("\tWARNING: invalid cache level\n", outfile);
+            if(!block->user && block->tag >= PU_PURGELEVEL)
+               fputs("\tWARNING: purgable block with no user\n", outfile);
+            if(block->tag >= PU_MAX)
+               fputs("\tWARNING: invalid cache level\n", outfile);
          
-         fflush(outfile);
+            fflush(outfile);
+         }
       }
    }
 
@@ -755,8 +1073,11 @@ void Z_DumpCore()
 
    for(tag = PU_FREE+1; tag < PU_MAX; tag++)
    {
-      for(block = blockbytag[tag]; block; block = block->next)
-         ++numentries;
+      for(memblock_t **lists : blocklists)
+      {
+         for(block = lists[tag]; block; block = block->next)
+            ++numentries;
+      }
    }
 
    dirlen = numentries * 64; // crazy PAK format...
@@ -771,28 +1092,34 @@ void Z_DumpCore()
    uint32_t offs = 12 + 64 * numentries;
    for(tag = PU_FREE+1; tag < PU_MAX; tag++)
    {
-      for(block = blockbytag[tag]; block; block = block->next)
+      for(memblock_t **lists : blocklists)
       {
-         char     name[56];
-         uint32_t filepos = offs;
-         uint32_t filelen = (uint32_t)(block->size);
-
-         memset(name, 0, sizeof(name));
-         sprintf(name, "/%s/%p", 
-                 block->tag < PU_MAX ? namefortag[block->tag] : "UNKNOWN",
-                 block);
-         fwrite(name,     sizeof(name),    1, f);
-         fwrite(&filepos, sizeof(filepos), 1, f);
-         fwrite(&filelen, sizeof(filelen), 1, f);
-
-         offs += filelen;
+         for(block = lists[tag]; block; block = block->next)
+         {
+            char     name[56];
+            uint32_t filepos = offs;
+            uint32_t filelen = (uint32_t)(block->size);
+
+            memset(name, 0, sizeof(name));
+            sprintf(name, "/%s/%p", 
+                    block->tag < PU_MAX ? namefortag[block->tag] : "UNKNOWN",
+                    block);
+            fwrite(name,     sizeof(name),    1, f);
+            fwrite(&filepos, sizeof(filepos), 1, f);
+            fwrite(&filelen, sizeof(filelen), 1, f);
+
+            offs += filelen;
+         }
       }
    }
 
    for(tag = PU_FREE+1; tag < PU_MAX; tag++)
    {
-      for(block = blockbytag[tag]; block; block = block->next)
-         fwrite(((byte *)block + header_size), block->size, 1, f);
+      for(memblock_t **lists : blocklists)
+      {
+         for(block = lists[tag]; block; block = block->next)
+            fwrite(((byte *)block + header_size), block->size, 1, f);
+      }
    }
 
    fclose(f);
@@ -879,6 +1206,31 @@ void Z_SysFree(void *p)
       free(p);
 }
 
+//
+// Z_SetThreaded
+//
+// ioanch: while on, zone heap calls may be made from several threads at once.
+// Must only be changed from the main thread while no other thread uses the
+// heap. Purgable blocks can still be freed by any allocation, so threads must
+// not rely on PU_CACHE data.
+//
+void Z_SetThreaded(bool on)
+{
+   zonethreaded = on;
+}
+
+//
+// Z_SetArenas
+//
+// ioanch: while on, new PU_LEVEL and PU_CACHE blocks come from arenas. Can be
+// switched at any time, as each block remembers where it came from.
+//
+void Z_SetArenas(bool on)
+{
+   ZoneLock lock;
+   zonearenas = on;
+}
+
 //=============================================================================
 //
 // Zone Alloca
@@ -1033,6 +1385,8 @@ ZoneObject::ZoneObject()
 //
 void ZoneObject::removeFromTagList()
 {
+   ZoneLock lock;
+
    if(zoneprev && (*zoneprev = zonenext))
       zonenext->zoneprev = zoneprev;
 
@@ -1047,6 +1401,8 @@ void ZoneObject::removeFromTagList()
 //
 void ZoneObject::addToTagList(int tag)
 {
+   ZoneLock lock;
+
    if((zonenext = objectbytag[tag]))
       zonenext->zoneprev = &zonenext;
    objectbytag[tag] = this;
@@ -120,6 +120,9 @@ void *Z_SysCalloc(size_t n1, size_t n2);
 void *Z_SysRealloc(void *ptr, size_t size);
 void  Z_SysFree(void *p);
 
+void  Z_SetThreaded(bool on);
+void  Z_SetArenas(bool on);
+
 #define Z_Free(a)          (Z_Free)     (a,      __FILE__,__LINE__)
 #define Z_FreeTags(a,b)    (Z_FreeTags) (a,b,    __FILE__,__LINE__)
 #define Z_ChangeTag(a,b)   (Z_ChangeTag)(a,b,    __FILE__,__LINE__)
@@ -204,7 +207,7 @@ class ZoneObject
 private:
    // static data
    static ZoneObject *objectbytag[PU_MAX];
-   static void *newalloc;
+   static thread_local void *newalloc;
 
    // instance data
    void        *zonealloc; // If non-null, the object is living on the zone heap